@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <QMessageBox>
 #include "qt-wrappers.hpp"
+#include "obs-app.hpp"
 #include "audio-encoders.hpp"
 #include "window-basic-main.hpp"
 #include "window-basic-main-outputs.hpp"
@@ -35,6 +36,26 @@ static void OBSStreamStopping(void *data, calldata_t *params)
 				"StreamDelayStopping", Q_ARG(int, sec));
 }
 
+static void SetDelaySpool(OBSBasic *main, obs_output_t *output)
+{
+	bool enable = config_get_bool(main->Config(), "Output",
+			"DelaySpoolEnable");
+	uint64_t memoryMB = config_get_uint(main->Config(), "Output",
+			"DelaySpoolMemoryMB");
+	uint64_t sizeMB = config_get_uint(main->Config(), "Output",
+			"DelaySpoolSizeMB");
+	char path[512];
+
+	if (!enable ||
+	    GetConfigPath(path, sizeof(path), "obs-studio/delay") <= 0) {
+		obs_output_set_delay_spool(output, nullptr, 0, 0);
+		return;
+	}
+
+	obs_output_set_delay_spool(output, path, memoryMB * 1024 * 1024,
+			sizeMB * 1024 * 1024);
+}
+
 static void OBSStartStreaming(void *data, calldata_t *params)
 {
 	BasicOutputHandler *output = static_cast<BasicOutputHandler*>(data);
@@ -627,6 +648,17 @@ inline void SimpleOutput::SetupOutputs()
 			obs_encoder_set_audio(aacRecording,  obs_get_audio());
 		}
 	}
+
+	/* give each encoder its own thread when streaming and recording use
+	 * separate encoders, so they don't run back to back on the video
+	 * thread.  an encoder that can't keep up drops its own frames rather
+	 * than holding up the video thread, and with it the other encoder */
+	bool separateEncoders = usingRecordingPreset && !ffmpegOutput;
+	obs_encoder_set_threaded(h264Streaming, separateEncoders, 0,
+			OBS_ENCODER_QUEUE_DROP);
+	if (separateEncoders)
+		obs_encoder_set_threaded(h264Recording, true, 0,
+				OBS_ENCODER_QUEUE_DROP);
 }
 
 const char *FindAudioEncoderFromCodec(const char *type)
@@ -736,6 +768,8 @@ bool SimpleOutput::StartStreaming(obs_service_t *service)
 			"NewSocketLoopEnable");
 	bool enableLowLatencyMode = config_get_bool(main->Config(), "Output",
 			"LowLatencyEnable");
+	bool enableDynBitrate = config_get_bool(main->Config(), "Output",
+			"DynamicBitrate");
 
 	obs_data_t *settings = obs_data_create();
 	obs_data_set_string(settings, "bind_ip", bindIP);
@@ -751,6 +785,9 @@ bool SimpleOutput::StartStreaming(obs_service_t *service)
 
 	obs_output_set_delay(streamOutput, useDelay ? delaySec : 0,
 			preserveDelay ? OBS_OUTPUT_DELAY_PRESERVE : 0);
+	SetDelaySpool(main, streamOutput);
+
+	obs_output_set_dynamic_bitrate(streamOutput, enableDynBitrate, 0, 0);
 
 	obs_output_set_reconnect_settings(streamOutput, maxRetries,
 			retryDelay);
@@ -1375,6 +1412,14 @@ void AdvancedOutput::SetupOutputs()
 	obs_encoder_set_video(h264Streaming, obs_get_video());
 	if (h264Recording)
 		obs_encoder_set_video(h264Recording, obs_get_video());
+
+	/* see SimpleOutput::SetupOutputs */
+	obs_encoder_set_threaded(h264Streaming, !!h264Recording, 0,
+			OBS_ENCODER_QUEUE_DROP);
+	if (h264Recording)
+		obs_encoder_set_threaded(h264Recording, true, 0,
+				OBS_ENCODER_QUEUE_DROP);
+
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
 		obs_encoder_set_audio(aacTrack[i], obs_get_audio());
 
@@ -1499,6 +1544,8 @@ bool AdvancedOutput::StartStreaming(obs_service_t *service)
 			"NewSocketLoopEnable");
 	bool enableLowLatencyMode = config_get_bool(main->Config(), "Output",
 			"LowLatencyEnable");
+	bool enableDynBitrate = config_get_bool(main->Config(), "Output",
+			"DynamicBitrate");
 
 	obs_data_t *settings = obs_data_create();
 	obs_data_set_string(settings, "bind_ip", bindIP);
@@ -1514,6 +1561,9 @@ bool AdvancedOutput::StartStreaming(obs_service_t *service)
 
 	obs_output_set_delay(streamOutput, useDelay ? delaySec : 0,
 			preserveDelay ? OBS_OUTPUT_DELAY_PRESERVE : 0);
+	SetDelaySpool(main, streamOutput);
+
+	obs_output_set_dynamic_bitrate(streamOutput, enableDynBitrate, 0, 0);
 
 	obs_output_set_reconnect_settings(streamOutput, maxRetries,
 			retryDelay);
@@ -1117,12 +1117,17 @@ obs_data_array_t *OBSBasic::SaveTransitions()
 		obs_data_t *sourceData = obs_data_create();
 		obs_data_t *settings = obs_source_get_settings(tr);
 
+		/* copied because the collection is written on another thread */
+		obs_data_t *settingsCopy = obs_data_create();
+		obs_data_apply(settingsCopy, settings);
+
 		obs_data_set_string(sourceData, "name", obs_source_get_name(tr));
 		obs_data_set_string(sourceData, "id", obs_obj_get_id(tr));
-		obs_data_set_obj(sourceData, "settings", settings);
+		obs_data_set_obj(sourceData, "settings", settingsCopy);
 
 		obs_data_array_push_back(transitions, sourceData);
 
+		obs_data_release(settingsCopy);
 		obs_data_release(settings);
 		obs_data_release(sourceData);
 	}
@@ -449,7 +449,7 @@ obs_data_array_t *OBSBasic::SavePreviewProjectors()
 	return saveProjector;
 }
 
-void OBSBasic::Save(const char *file)
+void OBSBasic::Save(const char *file, bool background)
 {
 	OBSScene scene = GetCurrentScene();
 	OBSSource curProgramScene = OBSGetStrongRef(programScene);
@@ -483,8 +483,15 @@ void OBSBasic::Save(const char *file)
 		obs_data_release(moduleObj);
 	}
 
-	if (!obs_data_save_json_safe(saveData, file, "tmp", "bak"))
-		blog(LOG_ERROR, "Could not save scene data to %s", file);
+	if (background) {
+		QueueSave(saveData, file);
+	} else {
+		WaitForSave();
+
+		if (!obs_data_save_json_safe(saveData, file, "tmp", "bak"))
+			blog(LOG_ERROR, "Could not save scene data to %s",
+					file);
+	}
 
 	obs_data_release(saveData);
 	obs_data_array_release(sceneOrder);
@@ -494,6 +501,80 @@ void OBSBasic::Save(const char *file)
 	obs_data_array_release(savedPreviewProjectorList);
 }
 
+void OBSBasic::SaveThread()
+{
+	unique_lock<mutex> lock(saveMutex);
+
+	for (;;) {
+		saveCondition.wait(lock, [this] ()
+		{
+			return pendingSaveData || saveThreadStopping;
+		});
+
+		if (!pendingSaveData)
+			break;
+
+		obs_data_t *data = pendingSaveData;
+		string file = move(pendingSaveFile);
+		pendingSaveData = nullptr;
+		saveInProgress = true;
+
+		lock.unlock();
+
+		if (!obs_data_save_json_safe(data, file.c_str(), "tmp", "bak"))
+			blog(LOG_ERROR, "Could not save scene data to %s",
+					file.c_str());
+		obs_data_release(data);
+
+		lock.lock();
+
+		saveInProgress = false;
+		saveCondition.notify_all();
+	}
+}
+
+/* the save data must not be modified after it has been queued; sources are
+ * saved as copies by libobs so this only applies to the data built here */
+void OBSBasic::QueueSave(obs_data_t *data, const char *file)
+{
+	lock_guard<mutex> lock(saveMutex);
+
+	if (!saveThread.joinable()) {
+		saveThreadStopping = false;
+		saveThread = thread([this] () {SaveThread();});
+	}
+
+	obs_data_addref(data);
+	obs_data_release(pendingSaveData);
+	pendingSaveData = data;
+	pendingSaveFile = file;
+
+	saveCondition.notify_all();
+}
+
+void OBSBasic::WaitForSave()
+{
+	unique_lock<mutex> lock(saveMutex);
+	saveCondition.wait(lock, [this] ()
+	{
+		return !pendingSaveData && !saveInProgress;
+	});
+}
+
+void OBSBasic::StopSaveThread()
+{
+	if (!saveThread.joinable())
+		return;
+
+	{
+		lock_guard<mutex> lock(saveMutex);
+		saveThreadStopping = true;
+		saveCondition.notify_all();
+	}
+
+	saveThread.join();
+}
+
 static void LoadAudioDevice(const char *name, int channel, obs_data_t *parent)
 {
 	obs_data_t *data = obs_data_get_obj(parent, name);
@@ -1080,6 +1161,12 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_bool  (basicConfig, "Output", "DelayEnable", false);
 	config_set_default_uint  (basicConfig, "Output", "DelaySec", 20);
 	config_set_default_bool  (basicConfig, "Output", "DelayPreserve", true);
+	config_set_default_bool  (basicConfig, "Output", "DelaySpoolEnable",
+			false);
+	config_set_default_uint  (basicConfig, "Output", "DelaySpoolMemoryMB",
+			512);
+	config_set_default_uint  (basicConfig, "Output", "DelaySpoolSizeMB",
+			8192);
 
 	config_set_default_bool  (basicConfig, "Output", "Reconnect", true);
 	config_set_default_uint  (basicConfig, "Output", "RetryDelay", 10);
@@ -1090,6 +1177,8 @@ bool OBSBasic::InitBasicConfigDefaults()
 			false);
 	config_set_default_bool  (basicConfig, "Output", "LowLatencyEnable",
 			false);
+	config_set_default_bool  (basicConfig, "Output", "DynamicBitrate",
+			false);
 
 	int i = 0;
 	uint32_t scale_cx = cx;
@@ -1746,6 +1835,8 @@ OBSBasic::~OBSBasic()
 	if (updateCheckThread && updateCheckThread->isRunning())
 		updateCheckThread->wait();
 
+	StopSaveThread();
+
 	delete programOptions;
 	delete program;
 
@@ -1835,11 +1926,13 @@ OBSBasic::~OBSBasic()
 
 void OBSBasic::SaveProjectNow()
 {
-	if (disableSaving)
+	if (disableSaving) {
+		WaitForSave();
 		return;
+	}
 
 	projectChanged = true;
-	SaveProjectDeferred();
+	SaveProjectFile(false);
 }
 
 void OBSBasic::SaveProject()
@@ -1853,6 +1946,11 @@ void OBSBasic::SaveProject()
 }
 
 void OBSBasic::SaveProjectDeferred()
+{
+	SaveProjectFile(true);
+}
+
+void OBSBasic::SaveProjectFile(bool background)
 {
 	if (disableSaving)
 		return;
@@ -1880,7 +1978,7 @@ void OBSBasic::SaveProjectDeferred()
 	if (ret <= 0)
 		return;
 
-	Save(savePath);
+	Save(savePath, background);
 }
 
 OBSScene OBSBasic::GetCurrentScene()
@@ -3182,6 +3280,7 @@ void OBSBasic::closeEvent(QCloseEvent *event)
 	signalHandlers.clear();
 
 	SaveProjectNow();
+	StopSaveThread();
 
 	if (api)
 		api->on_event(OBS_FRONTEND_EVENT_EXIT);
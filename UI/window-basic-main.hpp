@@ -23,6 +23,9 @@
 #include <obs.hpp>
 #include <vector>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "window-main.hpp"
 #include "window-basic-interaction.hpp"
 #include "window-basic-properties.hpp"
@@ -119,6 +122,16 @@ private:
 	bool loaded = false;
 	long disableSaving = 1;
 	bool projectChanged = false;
+
+	/* scene collections are written out on a separate thread, only the
+	 * most recent pending save is kept */
+	std::thread saveThread;
+	std::mutex saveMutex;
+	std::condition_variable saveCondition;
+	obs_data_t *pendingSaveData = nullptr;
+	std::string pendingSaveFile;
+	bool saveInProgress = false;
+	bool saveThreadStopping = false;
 	bool previewEnabled = true;
 	bool fullscreenInterface = false;
 
@@ -188,7 +201,12 @@ private:
 
 	void          UploadLog(const char *file);
 
-	void          Save(const char *file);
+	void          Save(const char *file, bool background = false);
+	void          SaveThread();
+	void          QueueSave(obs_data_t *data, const char *file);
+	void          WaitForSave();
+	void          StopSaveThread();
+	void          SaveProjectFile(bool background);
 	void          Load(const char *file);
 
 	void          InitHotkeys();
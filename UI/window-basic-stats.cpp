@@ -4,6 +4,7 @@
 #include "window-basic-main.hpp"
 #include "platform.hpp"
 #include "obs-app.hpp"
+#include "qt-wrappers.hpp"
 
 #include <QDesktopWidget>
 #include <QPushButton>
@@ -12,9 +13,12 @@
 #include <QHBoxLayout>
 #include <QGridLayout>
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #define TIMER_INTERVAL 2000
+#define MAX_TICK_SOURCES 10
 
 static void setThemeID(QWidget *widget, const QString &themeID)
 {
@@ -36,6 +40,7 @@ OBSBasicStats::OBSBasicStats(QWidget *parent)
 	QVBoxLayout *mainLayout = new QVBoxLayout();
 	QGridLayout *topLayout = new QGridLayout();
 	outputLayout = new QGridLayout();
+	sourceLayout = new QGridLayout();
 
 	int row = 0;
 
@@ -58,10 +63,12 @@ OBSBasicStats::OBSBasicStats(QWidget *parent)
 	cpuUsage = new QLabel(this);
 	hddSpace = new QLabel(this);
 	memUsage = new QLabel(this);
+	texturePoolUsage = new QLabel(this);
 
 	newStat("CPUUsage", cpuUsage, 0);
 	newStat("HDDSpaceAvailable", hddSpace, 0);
 	newStat("MemoryUsage", memUsage, 0);
+	newStat("TexturePoolUsage", texturePoolUsage, 0);
 
 	fps = new QLabel(this);
 	renderTime = new QLabel(this);
@@ -106,8 +113,22 @@ OBSBasicStats::OBSBasicStats(QWidget *parent)
 
 	/* --------------------------------------------- */
 
+	col = 0;
+	auto addSourceCol = [&] (const char *loc)
+	{
+		QLabel *label = new QLabel(QTStr(loc), this);
+		label->setStyleSheet("font-weight: bold");
+		sourceLayout->addWidget(label, 0, col++);
+	};
+
+	addSourceCol("Basic.Stats.Source");
+	addSourceCol("Basic.Stats.TickTime");
+
+	/* --------------------------------------------- */
+
 	QVBoxLayout *outputContainerLayout = new QVBoxLayout();
 	outputContainerLayout->addLayout(outputLayout);
+	outputContainerLayout->addLayout(sourceLayout);
 	outputContainerLayout->addStretch();
 
 	QWidget *widget = new QWidget(this);
@@ -303,6 +324,16 @@ void OBSBasicStats::Update()
 
 	/* ------------------ */
 
+	uint64_t poolUsed, poolIdle;
+	obs_get_texture_pool_usage(&poolUsed, &poolIdle);
+
+	str = QTStr("Basic.Stats.TexturePoolUsage.Value")
+		.arg(QString::number((double)poolUsed / MBYTE, 'f', 1),
+		     QString::number((double)poolIdle / MBYTE, 'f', 1));
+	texturePoolUsage->setText(str);
+
+	/* ------------------ */
+
 	num = (long double)obs_get_average_frame_time_ns() / 1000000.0l;
 
 	str = QString::number(num, 'f', 1) + QStringLiteral(" ms");
@@ -384,6 +415,65 @@ void OBSBasicStats::Update()
 
 	outputLabels[0].Update(strOutput, false);
 	outputLabels[1].Update(recOutput, true);
+
+	/* ------------------------------------------- */
+	/* source tick times                           */
+
+	UpdateSourceTickTimes();
+}
+
+void OBSBasicStats::UpdateSourceTickTimes()
+{
+	using SourceTime = std::pair<uint64_t, std::string>;
+	std::vector<SourceTime> times;
+
+	auto addSource = [] (void *param, obs_source_t *source)
+	{
+		auto &times = *reinterpret_cast<std::vector<SourceTime>*>(param);
+		const char *name = obs_source_get_name(source);
+		times.emplace_back(obs_source_get_tick_time(source),
+				name ? name : "");
+		return true;
+	};
+
+	obs_enum_sources(addSource, &times);
+
+	std::sort(times.begin(), times.end(),
+			[] (const SourceTime &a, const SourceTime &b)
+			{
+				return a.first > b.first;
+			});
+
+	if (times.size() > MAX_TICK_SOURCES)
+		times.resize(MAX_TICK_SOURCES);
+
+	while (sourceLabels.size() < (int)times.size()) {
+		SourceLabels sl;
+		sl.name = new QLabel(this);
+		sl.tickTime = new QLabel(this);
+
+		int row = sourceLabels.size() + 1;
+		sourceLayout->addWidget(sl.name, row, 0);
+		sourceLayout->addWidget(sl.tickTime, row, 1);
+		sourceLabels.push_back(sl);
+	}
+
+	for (int i = 0; i < sourceLabels.size(); i++) {
+		SourceLabels &sl = sourceLabels[i];
+		bool visible = i < (int)times.size();
+
+		sl.name->setVisible(visible);
+		sl.tickTime->setVisible(visible);
+
+		if (!visible)
+			continue;
+
+		long double ms = (long double)times[i].first / 1000000.0l;
+		sl.name->setText(QT_UTF8(times[i].second.c_str()));
+		sl.tickTime->setText(
+				QString::number(ms, 'f', 2) +
+				QStringLiteral(" ms"));
+	}
 }
 
 void OBSBasicStats::Reset()
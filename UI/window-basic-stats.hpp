@@ -18,12 +18,14 @@ class OBSBasicStats : public QWidget {
 	QLabel *cpuUsage = nullptr;
 	QLabel *hddSpace = nullptr;
 	QLabel *memUsage = nullptr;
+	QLabel *texturePoolUsage = nullptr;
 
 	QLabel *renderTime = nullptr;
 	QLabel *skippedFrames = nullptr;
 	QLabel *missedFrames = nullptr;
 
 	QGridLayout *outputLayout = nullptr;
+	QGridLayout *sourceLayout = nullptr;
 
 	os_cpu_usage_info_t *cpu_info = nullptr;
 
@@ -48,7 +50,15 @@ class OBSBasicStats : public QWidget {
 
 	QList<OutputLabels> outputLabels;
 
+	struct SourceLabels {
+		QPointer<QLabel> name;
+		QPointer<QLabel> tickTime;
+	};
+
+	QList<SourceLabels> sourceLabels;
+
 	void AddOutputLabels(QString name);
+	void UpdateSourceTickTimes();
 	void Update();
 	void Reset();
 
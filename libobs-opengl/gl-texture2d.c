@@ -226,6 +226,42 @@ failed:
 	blog(LOG_ERROR, "gs_texture_unmap (GL) failed");
 }
 
+bool gs_texture_set_image_rect(gs_texture_t *tex, const uint8_t *data,
+		uint32_t linesize, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+	uint32_t pixel_size;
+
+	if (!is_texture_2d(tex, "gs_texture_set_image_rect"))
+		goto fail;
+	if (gs_is_compressed_format(tex->format))
+		goto fail;
+	if (x + cx > tex2d->width || y + cy > tex2d->height)
+		goto fail;
+
+	pixel_size = gs_get_format_bpp(tex->format) / 8;
+	data += y * linesize + x * pixel_size;
+
+	if (!gl_bind_texture(GL_TEXTURE_2D, tex2d->base.texture))
+		goto fail;
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / pixel_size);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, cx, cy,
+			tex->gl_format, tex->gl_type, data);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	if (!gl_success("glTexSubImage2D"))
+		goto fail;
+
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+	return true;
+
+fail:
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+	blog(LOG_ERROR, "gs_texture_set_image_rect (GL) failed");
+	return false;
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	const struct gs_texture_2d *tex2d = (const struct gs_texture_2d*)tex;
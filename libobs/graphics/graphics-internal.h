@@ -159,6 +159,9 @@ struct gs_exports {
 	bool     (*gs_texture_map)(gs_texture_t *tex, uint8_t **ptr,
 			uint32_t *linesize);
 	void     (*gs_texture_unmap)(gs_texture_t *tex);
+	bool     (*gs_texture_set_image_rect)(gs_texture_t *tex,
+			const uint8_t *data, uint32_t linesize,
+			uint32_t x, uint32_t y, uint32_t cx, uint32_t cy);
 	bool     (*gs_texture_is_rect)(const gs_texture_t *tex);
 	void    *(*gs_texture_get_obj)(const gs_texture_t *tex);
 
@@ -260,6 +263,17 @@ struct gs_exports {
 #endif
 };
 
+struct gs_texture_pool_entry {
+	gs_texture_t         *tex;
+	uint64_t             last_used;
+};
+
+struct gs_texture_pool_bucket {
+	uint32_t             cx, cy;
+	enum gs_color_format format;
+	DARRAY(struct gs_texture_pool_entry) idle;
+};
+
 struct blend_state {
 	bool               enabled;
 	enum gs_blend_type src_c;
@@ -299,4 +313,13 @@ struct graphics_subsystem {
 
 	struct blend_state     cur_blend_state;
 	DARRAY(struct blend_state) blend_state_stack;
+
+	DARRAY(struct gs_texture_pool_bucket) texture_pool;
+	uint64_t               texture_pool_frame;
+	uint64_t               texture_pool_used_bytes;
+	uint64_t               texture_pool_idle_bytes;
+	uint32_t               texture_pool_used_count;
+	uint32_t               texture_pool_idle_count;
+	uint32_t               texture_pool_max_idle_frames;
+	uint64_t               texture_pool_max_idle_bytes;
 };
@@ -177,6 +177,8 @@ static bool graphics_init(struct graphics_subsystem *graphics)
 	return true;
 }
 
+extern void gs_texture_pool_init(graphics_t *graphics);
+
 int gs_create(graphics_t **pgraphics, const char *module, uint32_t adapter)
 {
 	int errcode = GS_ERROR_FAIL;
@@ -184,6 +186,7 @@ int gs_create(graphics_t **pgraphics, const char *module, uint32_t adapter)
 	graphics_t *graphics = bzalloc(sizeof(struct graphics_subsystem));
 	pthread_mutex_init_value(&graphics->mutex);
 	pthread_mutex_init_value(&graphics->effect_mutex);
+	gs_texture_pool_init(graphics);
 
 	graphics->module = os_dlopen(module);
 	if (!graphics->module) {
@@ -213,6 +216,7 @@ error:
 }
 
 extern void gs_effect_actually_destroy(gs_effect_t *effect);
+extern void gs_texture_pool_free(graphics_t *graphics);
 
 void gs_destroy(graphics_t *graphics)
 {
@@ -234,6 +238,8 @@ void gs_destroy(graphics_t *graphics)
 			effect = next;
 		}
 
+		gs_texture_pool_free(graphics);
+
 		graphics->exports.gs_vertexbuffer_destroy(
 				graphics->sprite_buffer);
 		graphics->exports.gs_vertexbuffer_destroy(
@@ -1173,6 +1179,26 @@ void gs_texture_set_image(gs_texture_t *tex, const uint8_t *data,
 	gs_texture_unmap(tex);
 }
 
+bool gs_texture_set_image_rect(gs_texture_t *tex, const uint8_t *data,
+		uint32_t linesize, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p2("gs_texture_set_image_rect", tex, data))
+		return false;
+
+	/* not all subsystems can update a sub-region, so fall back to
+	 * uploading the whole image */
+	if (graphics->exports.gs_texture_set_image_rect &&
+	    graphics->exports.gs_texture_set_image_rect(tex, data, linesize,
+		    x, y, cx, cy))
+		return true;
+
+	gs_texture_set_image(tex, data, linesize, false);
+	return true;
+}
+
 void gs_cubetexture_set_image(gs_texture_t *cubetex, uint32_t side,
 		const void *data, uint32_t linesize, bool invert)
 {
@@ -411,6 +411,39 @@ EXPORT void gs_texrender_end(gs_texrender_t *texrender);
 EXPORT void gs_texrender_reset(gs_texrender_t *texrender);
 EXPORT gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender);
 
+/* ---------------------------------------------------
+ * render target texture pool
+ * --------------------------------------------------- */
+
+struct gs_texture_pool_stats {
+	uint64_t used_bytes;
+	uint64_t idle_bytes;
+	uint32_t used_textures;
+	uint32_t idle_textures;
+};
+
+/**
+ * Gets a render target texture of the given size and format from the pool,
+ * creating one if no idle texture of that size and format is available.
+ * Textures acquired from the pool must be returned with
+ * gs_texture_pool_release rather than destroyed.
+ */
+EXPORT gs_texture_t *gs_texture_pool_acquire(uint32_t cx, uint32_t cy,
+		enum gs_color_format format);
+EXPORT void gs_texture_pool_release(gs_texture_t *tex);
+
+/** Frees textures that have been idle for too long, called once per frame */
+EXPORT void gs_texture_pool_tick(void);
+
+/**
+ * Sets how long (in calls to gs_texture_pool_tick) and how much idle texture
+ * memory the pool may keep.  A max_idle_bytes of 0 disables pooling, and
+ * released textures are destroyed right away.
+ */
+EXPORT void gs_texture_pool_set_limits(uint32_t max_idle_frames,
+		uint64_t max_idle_bytes);
+EXPORT void gs_texture_pool_get_stats(struct gs_texture_pool_stats *stats);
+
 /* ---------------------------------------------------
  * graphics subsystem
  * --------------------------------------------------- */
@@ -544,6 +577,15 @@ EXPORT void gs_viewport_pop(void);
 
 EXPORT void gs_texture_set_image(gs_texture_t *tex, const uint8_t *data,
 		uint32_t linesize, bool invert);
+
+/**
+ * Uploads a sub-region of an image to a texture.  The data and linesize
+ * describe the full image, of which only the cx x cy region at x, y is
+ * uploaded.  Subsystems that cannot do partial updates upload the full image.
+ */
+EXPORT bool gs_texture_set_image_rect(gs_texture_t *tex, const uint8_t *data,
+		uint32_t linesize, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy);
 EXPORT void gs_cubetexture_set_image(gs_texture_t *cubetex, uint32_t side,
 		const void *data, uint32_t linesize, bool invert);
 
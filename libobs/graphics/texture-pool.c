@@ -0,0 +1,262 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ *   Render target textures are frequently created and destroyed by filters
+ * and transitions whenever their target changes size.  Rather than going back
+ * to the driver every time, released textures are kept in buckets keyed by
+ * size and format so they can be handed out again.  Textures that stay idle
+ * for too long (or that exceed the idle budget) are freed in
+ * gs_texture_pool_tick.  The limits are kept small by default since the idle
+ * textures are VRAM that nobody is using, and can be changed (or pooling
+ * disabled entirely) with gs_texture_pool_set_limits.
+ */
+
+#include "../util/base.h"
+#include "../util/bmem.h"
+#include "graphics-internal.h"
+
+/* roughly one second at 60 FPS, enough to cover a filter being recreated */
+#define DEFAULT_MAX_IDLE_FRAMES 60
+#define DEFAULT_MAX_IDLE_BYTES  (64ULL * 1024ULL * 1024ULL)
+
+static inline uint64_t texture_size(uint32_t cx, uint32_t cy,
+		enum gs_color_format format)
+{
+	return (uint64_t)cx * (uint64_t)cy *
+		(uint64_t)gs_get_format_bpp(format) / 8;
+}
+
+static inline bool pool_valid(graphics_t *graphics, const char *f)
+{
+	if (!graphics) {
+		blog(LOG_DEBUG, "%s: called while not in a graphics context",
+				f);
+		return false;
+	}
+
+	return true;
+}
+
+static struct gs_texture_pool_bucket *find_bucket(graphics_t *graphics,
+		uint32_t cx, uint32_t cy, enum gs_color_format format)
+{
+	for (size_t i = 0; i < graphics->texture_pool.num; i++) {
+		struct gs_texture_pool_bucket *bucket =
+			graphics->texture_pool.array + i;
+
+		if (bucket->cx == cx && bucket->cy == cy &&
+		    bucket->format == format)
+			return bucket;
+	}
+
+	return NULL;
+}
+
+gs_texture_t *gs_texture_pool_acquire(uint32_t cx, uint32_t cy,
+		enum gs_color_format format)
+{
+	graphics_t *graphics = gs_get_context();
+	struct gs_texture_pool_bucket *bucket;
+	gs_texture_t *tex = NULL;
+
+	if (!pool_valid(graphics, "gs_texture_pool_acquire"))
+		return NULL;
+
+	bucket = find_bucket(graphics, cx, cy, format);
+	if (bucket && bucket->idle.num) {
+		struct gs_texture_pool_entry *entry = da_end(bucket->idle);
+		tex = entry->tex;
+		da_pop_back(bucket->idle);
+
+		graphics->texture_pool_idle_bytes -=
+			texture_size(cx, cy, format);
+		graphics->texture_pool_idle_count--;
+	}
+
+	if (!tex) {
+		tex = gs_texture_create(cx, cy, format, 1, NULL,
+				GS_RENDER_TARGET);
+		if (!tex)
+			return NULL;
+	}
+
+	graphics->texture_pool_used_bytes += texture_size(cx, cy, format);
+	graphics->texture_pool_used_count++;
+	return tex;
+}
+
+void gs_texture_pool_release(gs_texture_t *tex)
+{
+	graphics_t *graphics = gs_get_context();
+	struct gs_texture_pool_bucket *bucket;
+	struct gs_texture_pool_entry entry;
+	enum gs_color_format format;
+	uint32_t cx, cy;
+
+	if (!tex)
+		return;
+	if (!pool_valid(graphics, "gs_texture_pool_release"))
+		return;
+
+	cx     = gs_texture_get_width(tex);
+	cy     = gs_texture_get_height(tex);
+	format = gs_texture_get_color_format(tex);
+
+	graphics->texture_pool_used_bytes -= texture_size(cx, cy, format);
+	graphics->texture_pool_used_count--;
+
+	if (!graphics->texture_pool_max_idle_bytes) {
+		gs_texture_destroy(tex);
+		return;
+	}
+
+	bucket = find_bucket(graphics, cx, cy, format);
+	if (!bucket) {
+		bucket = da_push_back_new(graphics->texture_pool);
+		bucket->cx     = cx;
+		bucket->cy     = cy;
+		bucket->format = format;
+	}
+
+	entry.tex       = tex;
+	entry.last_used = graphics->texture_pool_frame;
+	da_push_back(bucket->idle, &entry);
+
+	graphics->texture_pool_idle_bytes += texture_size(cx, cy, format);
+	graphics->texture_pool_idle_count++;
+}
+
+static inline void free_idle_entry(graphics_t *graphics,
+		struct gs_texture_pool_bucket *bucket, size_t idx)
+{
+	gs_texture_destroy(bucket->idle.array[idx].tex);
+	da_erase(bucket->idle, idx);
+
+	graphics->texture_pool_idle_bytes -=
+		texture_size(bucket->cx, bucket->cy, bucket->format);
+	graphics->texture_pool_idle_count--;
+}
+
+static bool free_oldest_entry(graphics_t *graphics)
+{
+	struct gs_texture_pool_bucket *oldest_bucket = NULL;
+	uint64_t oldest = UINT64_MAX;
+
+	for (size_t i = 0; i < graphics->texture_pool.num; i++) {
+		struct gs_texture_pool_bucket *bucket =
+			graphics->texture_pool.array + i;
+
+		/* entries are pushed in release order, so the first entry of
+		 * each bucket is always its oldest */
+		if (bucket->idle.num &&
+		    bucket->idle.array[0].last_used < oldest) {
+			oldest = bucket->idle.array[0].last_used;
+			oldest_bucket = bucket;
+		}
+	}
+
+	if (!oldest_bucket)
+		return false;
+
+	free_idle_entry(graphics, oldest_bucket, 0);
+	return true;
+}
+
+void gs_texture_pool_tick(void)
+{
+	graphics_t *graphics = gs_get_context();
+	uint64_t frame;
+
+	if (!pool_valid(graphics, "gs_texture_pool_tick"))
+		return;
+
+	frame = ++graphics->texture_pool_frame;
+
+	for (size_t i = graphics->texture_pool.num; i > 0; i--) {
+		struct gs_texture_pool_bucket *bucket =
+			graphics->texture_pool.array + (i - 1);
+
+		while (bucket->idle.num &&
+		       frame - bucket->idle.array[0].last_used >
+		       graphics->texture_pool_max_idle_frames)
+			free_idle_entry(graphics, bucket, 0);
+
+		if (!bucket->idle.num) {
+			da_free(bucket->idle);
+			da_erase(graphics->texture_pool, i - 1);
+		}
+	}
+
+	while (graphics->texture_pool_idle_bytes >
+	       graphics->texture_pool_max_idle_bytes)
+		if (!free_oldest_entry(graphics))
+			break;
+}
+
+void gs_texture_pool_set_limits(uint32_t max_idle_frames,
+		uint64_t max_idle_bytes)
+{
+	graphics_t *graphics = gs_get_context();
+
+	if (!pool_valid(graphics, "gs_texture_pool_set_limits"))
+		return;
+
+	graphics->texture_pool_max_idle_frames = max_idle_frames;
+	graphics->texture_pool_max_idle_bytes  = max_idle_bytes;
+}
+
+void gs_texture_pool_get_stats(struct gs_texture_pool_stats *stats)
+{
+	graphics_t *graphics = gs_get_context();
+
+	if (!stats)
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (!pool_valid(graphics, "gs_texture_pool_get_stats"))
+		return;
+
+	stats->used_bytes    = graphics->texture_pool_used_bytes;
+	stats->idle_bytes    = graphics->texture_pool_idle_bytes;
+	stats->used_textures = graphics->texture_pool_used_count;
+	stats->idle_textures = graphics->texture_pool_idle_count;
+}
+
+void gs_texture_pool_init(graphics_t *graphics)
+{
+	graphics->texture_pool_max_idle_frames = DEFAULT_MAX_IDLE_FRAMES;
+	graphics->texture_pool_max_idle_bytes  = DEFAULT_MAX_IDLE_BYTES;
+}
+
+void gs_texture_pool_free(graphics_t *graphics)
+{
+	for (size_t i = 0; i < graphics->texture_pool.num; i++) {
+		struct gs_texture_pool_bucket *bucket =
+			graphics->texture_pool.array + i;
+
+		for (size_t j = 0; j < bucket->idle.num; j++)
+			graphics->exports.gs_texture_destroy(
+					bucket->idle.array[j].tex);
+		da_free(bucket->idle);
+	}
+
+	da_free(graphics->texture_pool);
+	graphics->texture_pool_idle_bytes = 0;
+	graphics->texture_pool_idle_count = 0;
+}
@@ -340,6 +340,9 @@ bool video_output_connect(video_t *video,
 
 	pthread_mutex_lock(&video->input_mutex);
 
+	if (video->stop)
+		goto fail;
+
 	if (video->inputs.num == 0) {
 		video->skipped_frames = 0;
 		video->total_frames = 0;
@@ -370,6 +373,7 @@ bool video_output_connect(video_t *video,
 			da_push_back(video->inputs, &input);
 	}
 
+fail:
 	pthread_mutex_unlock(&video->input_mutex);
 
 	return success;
@@ -486,6 +490,25 @@ void video_output_stop(video_t *video)
 	}
 }
 
+bool video_output_stop_inactive(video_t *video)
+{
+	bool inactive;
+
+	if (!video)
+		return false;
+
+	/* set under the input mutex so nothing can connect in between */
+	pthread_mutex_lock(&video->input_mutex);
+	inactive = video->inputs.num == 0;
+	if (inactive)
+		video->stop = true;
+	pthread_mutex_unlock(&video->input_mutex);
+
+	if (inactive)
+		video_output_stop(video);
+	return inactive;
+}
+
 bool video_output_stopped(video_t *video)
 {
 	if (!video)
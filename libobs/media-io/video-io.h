@@ -170,6 +170,10 @@ EXPORT bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 EXPORT void video_output_unlock_frame(video_t *video);
 EXPORT uint64_t video_output_get_frame_time(const video_t *video);
 EXPORT void video_output_stop(video_t *video);
+
+/* stops the output unless something is connected to it, returns false if it
+ * is still active.  nothing can connect to a stopped output */
+EXPORT bool video_output_stop_inactive(video_t *video);
 EXPORT bool video_output_stopped(video_t *video);
 
 EXPORT enum video_format video_output_get_format(const video_t *video);
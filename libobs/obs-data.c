@@ -20,18 +20,23 @@
 #include "util/dstr.h"
 #include "util/darray.h"
 #include "util/platform.h"
+#include "util/array-serializer.h"
+#include "util/file-serializer.h"
 #include "graphics/vec2.h"
 #include "graphics/vec3.h"
 #include "graphics/vec4.h"
 #include "graphics/quat.h"
 #include "obs-data.h"
 
-#include <jansson.h>
+#include <errno.h>
+#include <math.h>
 
 struct obs_data_item {
 	volatile long        ref;
 	struct obs_data      *parent;
 	struct obs_data_item *next;
+	struct obs_data_item **prev_next;
+	uint32_t             name_hash;
 	enum obs_data_type   type;
 	size_t               name_len;
 	size_t               data_len;
@@ -46,11 +51,28 @@ struct obs_data {
 	volatile long        ref;
 	char                 *json;
 	struct obs_data_item *first_item;
+	struct obs_data_item *last_item;
+
+	/* items are kept in a sorted list.  once an object gets large enough,
+	 * the items are also indexed in an open addressing hash table (linear
+	 * probing) to avoid walking the list on every lookup, and new items
+	 * are appended to the list instead, which is only sorted again when
+	 * the object is iterated */
+	struct obs_data_item **table;
+	size_t               table_size;
+	size_t               num_items;
+	bool                 unsorted;
+
+	/* incremented on every change, including changes to the objects and
+	 * arrays in it, which count towards their parent */
+	volatile long        changes;
+	struct obs_data      *parent;
 };
 
 struct obs_data_array {
 	volatile long        ref;
 	DARRAY(obs_data_t*)   objects;
+	struct obs_data      *parent;
 };
 
 struct obs_data_number {
@@ -88,6 +110,195 @@ static inline char *get_item_name(struct obs_data_item *item)
 	return (char*)item + sizeof(struct obs_data_item);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Item hash index */
+
+#define HASH_THRESHOLD    16
+#define HASH_INITIAL_SIZE 64
+
+static inline uint32_t get_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/* the hash is passed separately so the slot of an item that was already
+ * reallocated can still be found by its old pointer */
+static inline size_t hash_find_slot(struct obs_data *data,
+		const struct obs_data_item *item, uint32_t name_hash)
+{
+	size_t mask = data->table_size - 1;
+	size_t idx = name_hash & mask;
+
+	while (data->table[idx]) {
+		if (data->table[idx] == item)
+			return idx;
+		idx = (idx + 1) & mask;
+	}
+
+	return (size_t)-1;
+}
+
+static inline void hash_insert(struct obs_data *data,
+		struct obs_data_item *item)
+{
+	size_t mask = data->table_size - 1;
+	size_t idx = item->name_hash & mask;
+
+	while (data->table[idx])
+		idx = (idx + 1) & mask;
+
+	data->table[idx] = item;
+}
+
+static void hash_rebuild(struct obs_data *data, size_t size)
+{
+	struct obs_data_item *item = data->first_item;
+
+	bfree(data->table);
+	data->table = bzalloc(sizeof(struct obs_data_item*) * size);
+	data->table_size = size;
+
+	while (item) {
+		hash_insert(data, item);
+		item = item->next;
+	}
+}
+
+/* called after the item has been linked into the list */
+static void hash_add_item(struct obs_data *data, struct obs_data_item *item)
+{
+	data->num_items++;
+
+	if (data->table) {
+		if (data->num_items * 2 > data->table_size)
+			hash_rebuild(data, data->table_size * 2);
+		else
+			hash_insert(data, item);
+
+	} else if (data->num_items > HASH_THRESHOLD) {
+		hash_rebuild(data, HASH_INITIAL_SIZE);
+	}
+}
+
+static void hash_remove_item(struct obs_data *data, struct obs_data_item *item)
+{
+	size_t mask, i, j;
+
+	data->num_items--;
+
+	if (!data->table)
+		return;
+
+	i = hash_find_slot(data, item, item->name_hash);
+	if (i == (size_t)-1)
+		return;
+
+	mask = data->table_size - 1;
+	data->table[i] = NULL;
+
+	/* shift back any following entries that would otherwise become
+	 * unreachable, so no tombstones are needed */
+	for (j = (i + 1) & mask; data->table[j]; j = (j + 1) & mask) {
+		size_t home = data->table[j]->name_hash & mask;
+		bool move = (i <= j) ?
+			(home <= i || home > j) :
+			(home <= i && home > j);
+
+		if (move) {
+			data->table[i] = data->table[j];
+			data->table[j] = NULL;
+			i = j;
+		}
+	}
+}
+
+static void hash_replace_item(struct obs_data *data,
+		struct obs_data_item *old_ptr, struct obs_data_item *new_ptr)
+{
+	size_t idx;
+
+	if (data->last_item == old_ptr)
+		data->last_item = new_ptr;
+
+	if (!data->table)
+		return;
+
+	/* old_ptr has already been freed, it's only compared as a pointer */
+	idx = hash_find_slot(data, old_ptr, new_ptr->name_hash);
+	if (idx != (size_t)-1)
+		data->table[idx] = new_ptr;
+}
+
+static struct obs_data_item *merge_items(struct obs_data_item *a,
+		struct obs_data_item *b)
+{
+	struct obs_data_item *head = NULL;
+	struct obs_data_item **tail = &head;
+
+	while (a && b) {
+		if (strcmp(get_item_name(a), get_item_name(b)) < 0) {
+			*tail = a;
+			a = a->next;
+		} else {
+			*tail = b;
+			b = b->next;
+		}
+
+		tail = &(*tail)->next;
+	}
+
+	*tail = a ? a : b;
+	return head;
+}
+
+/* bottom-up merge sort, bins[i] holds a sorted run of 2^i items */
+static void sort_items(struct obs_data *data)
+{
+	struct obs_data_item *bins[64] = {NULL};
+	struct obs_data_item *item = data->first_item;
+	struct obs_data_item **prev_next = &data->first_item;
+	size_t i;
+
+	if (!data->unsorted)
+		return;
+
+	while (item) {
+		struct obs_data_item *next = item->next;
+
+		item->next = NULL;
+		for (i = 0; bins[i]; i++) {
+			item = merge_items(bins[i], item);
+			bins[i] = NULL;
+		}
+
+		bins[i] = item;
+		item = next;
+	}
+
+	for (i = 0; i < 64; i++) {
+		if (bins[i])
+			item = merge_items(bins[i], item);
+	}
+
+	data->first_item = item;
+	data->last_item = NULL;
+
+	for (; item; item = item->next) {
+		item->prev_next = prev_next;
+		prev_next = &item->next;
+		data->last_item = item;
+	}
+
+	data->unsorted = false;
+}
+
 static inline void *get_data_ptr(obs_data_item_t *item)
 {
 	return (uint8_t*)get_item_name(item) + item->name_len;
@@ -183,11 +394,88 @@ static inline obs_data_array_t *get_item_autoselect_array(
 	return *(obs_data_array_t**)get_autoselect_data_ptr(item);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Change tracking
+ *
+ *   objects and arrays point back to the object they were last stored in, so
+ * a change anywhere in a tree counts as a change of its root and nothing has
+ * to walk the tree to find out whether it changed.  an object stored in
+ * several places only counts towards the last one. */
+
+static inline void data_changed(struct obs_data *data)
+{
+	for (; data; data = data->parent)
+		os_atomic_inc_long(&data->changes);
+}
+
+static void data_adopt(struct obs_data *parent, struct obs_data *child)
+{
+	if (!child)
+		return;
+
+	/* an object stored inside itself must not loop forever */
+	for (struct obs_data *p = parent; p; p = p->parent) {
+		if (p == child)
+			return;
+	}
+
+	child->parent = parent;
+}
+
+static inline void data_disown(struct obs_data *parent,
+		struct obs_data *child)
+{
+	if (child && child->parent == parent)
+		child->parent = NULL;
+}
+
+static void array_adopt(struct obs_data *parent, struct obs_data_array *array)
+{
+	if (!array)
+		return;
+
+	array->parent = parent;
+	for (size_t i = 0; i < array->objects.num; i++)
+		data_adopt(parent, array->objects.array[i]);
+}
+
+static void array_disown(struct obs_data *parent,
+		struct obs_data_array *array)
+{
+	if (!array || array->parent != parent)
+		return;
+
+	array->parent = NULL;
+	for (size_t i = 0; i < array->objects.num; i++)
+		data_disown(parent, array->objects.array[i]);
+}
+
+static inline void item_data_adopt(struct obs_data_item *item)
+{
+	if (item->type == OBS_DATA_OBJECT)
+		data_adopt(item->parent, get_item_obj(item));
+	else if (item->type == OBS_DATA_ARRAY)
+		array_adopt(item->parent, get_item_array(item));
+}
+
+static inline void item_data_disown(struct obs_data_item *item)
+{
+	if (!obs_data_item_has_user_value(item))
+		return;
+
+	if (item->type == OBS_DATA_OBJECT)
+		data_disown(item->parent, get_item_obj(item));
+	else if (item->type == OBS_DATA_ARRAY)
+		array_disown(item->parent, get_item_array(item));
+}
+
 static inline void item_data_release(struct obs_data_item *item)
 {
 	if (!obs_data_item_has_user_value(item))
 		return;
 
+	item_data_disown(item);
+
 	if (item->type == OBS_DATA_OBJECT) {
 		obs_data_t *obj = get_item_obj(item);
 		obs_data_release(obj);
@@ -276,10 +564,11 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 
 	item = bzalloc(total_size);
 
-	item->capacity = total_size;
-	item->type     = type;
-	item->name_len = name_size;
-	item->ref      = 1;
+	item->capacity  = total_size;
+	item->type      = type;
+	item->name_len  = name_size;
+	item->name_hash = get_name_hash(name);
+	item->ref       = 1;
 
 	if (default_data) {
 		item->default_len = size;
@@ -300,45 +589,55 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 	return item;
 }
 
-static struct obs_data_item **get_item_prev_next(struct obs_data *data,
-		struct obs_data_item *current)
+static inline void obs_data_item_link(struct obs_data_item *item,
+		struct obs_data_item **prev_next)
 {
-	if (!current || !data)
-		return NULL;
-
-	struct obs_data_item **prev_next = &data->first_item;
-	struct obs_data_item *item       = data->first_item;
-
-	while (item) {
-		if (item == current)
-			return prev_next;
-
-		prev_next = &item->next;
-		item      = item->next;
-	}
+	item->prev_next = prev_next;
+	item->next      = *prev_next;
+	*prev_next      = item;
 
-	return NULL;
+	if (item->next)
+		item->next->prev_next = &item->next;
 }
 
 static inline void obs_data_item_detach(struct obs_data_item *item)
 {
-	struct obs_data_item **prev_next = get_item_prev_next(item->parent,
-			item);
+	struct obs_data_item **prev_next = item->prev_next;
 
 	if (prev_next) {
+		struct obs_data *data = item->parent;
+
+		data_changed(data);
+
+		if (data->last_item == item)
+			data->last_item = (prev_next == &data->first_item) ?
+				NULL :
+				(struct obs_data_item*)((uint8_t*)prev_next -
+					offsetof(struct obs_data_item, next));
+
 		*prev_next = item->next;
-		item->next = NULL;
+		if (item->next)
+			item->next->prev_next = prev_next;
+
+		item->next      = NULL;
+		item->prev_next = NULL;
+		hash_remove_item(data, item);
+
+		item_data_disown(item);
 	}
 }
 
+/* called after brealloc moved the item, old_ptr is no longer valid */
 static inline void obs_data_item_reattach(struct obs_data_item *old_ptr,
 		struct obs_data_item *new_ptr)
 {
-	struct obs_data_item **prev_next = get_item_prev_next(new_ptr->parent,
-			old_ptr);
+	if (new_ptr->prev_next) {
+		*new_ptr->prev_next = new_ptr;
+		if (new_ptr->next)
+			new_ptr->next->prev_next = &new_ptr->next;
 
-	if (prev_next)
-		*prev_next = new_ptr;
+		hash_replace_item(new_ptr->parent, old_ptr, new_ptr);
+	}
 }
 
 static struct obs_data_item *obs_data_item_ensure_capacity(
@@ -353,270 +652,1647 @@ static struct obs_data_item *obs_data_item_ensure_capacity(
 	new_item = brealloc(item, new_size);
 	new_item->capacity = new_size;
 
-	obs_data_item_reattach(item, new_item);
-	return new_item;
+	obs_data_item_reattach(item, new_item);
+	return new_item;
+}
+
+static inline void obs_data_item_destroy(struct obs_data_item *item)
+{
+	/* detaching disowns the object or array, which has to happen while
+	 * it's still alive */
+	obs_data_item_detach(item);
+	item_data_release(item);
+	item_default_data_release(item);
+	item_autoselect_data_release(item);
+	bfree(item);
+}
+
+static inline void move_data(obs_data_item_t *old_item, void *old_data,
+		obs_data_item_t *item, void *data, size_t len)
+{
+	ptrdiff_t old_offset = (uint8_t*)old_data - (uint8_t*)old_item;
+	ptrdiff_t new_offset = (uint8_t*)data - (uint8_t*)item;
+
+	if (!old_data)
+		return;
+
+	memmove((uint8_t*)item + new_offset, (uint8_t*)item + old_offset, len);
+}
+
+static inline void obs_data_item_setdata(
+		struct obs_data_item **p_item, const void *data, size_t size,
+		enum obs_data_type type)
+{
+	if (!p_item || !*p_item)
+		return;
+
+	struct obs_data_item *item = *p_item;
+	ptrdiff_t old_default_data_pos =
+		(uint8_t*)get_default_data_ptr(item) - (uint8_t*)item;
+	item_data_release(item);
+
+	item->data_size = size;
+	item->type      = type;
+	item->data_len  = (item->default_size || item->autoselect_size) ? 
+		get_align_size(size) : size;
+	item = obs_data_item_ensure_capacity(item);
+
+	if (item->default_size || item->autoselect_size)
+		memmove(get_default_data_ptr(item),
+				(uint8_t*)item + old_default_data_pos,
+				item->default_len + item->autoselect_size);
+
+	if (size) {
+		memcpy(get_item_data(item), data, size);
+		item_data_addref(item);
+	}
+
+	*p_item = item;
+}
+
+static inline void obs_data_item_set_default_data(
+		struct obs_data_item **p_item, const void *data, size_t size,
+		enum obs_data_type type)
+{
+	if (!p_item || !*p_item)
+		return;
+
+	struct obs_data_item *item = *p_item;
+	void *old_autoselect_data = get_autoselect_data_ptr(item);
+	item_default_data_release(item);
+
+	item->type         = type;
+	item->default_size = size;
+	item->default_len  = item->autoselect_size ?
+				get_align_size(size) : size;
+	item->data_len     = item->data_size ?
+				get_align_size(item->data_size) : 0;
+	item = obs_data_item_ensure_capacity(item);
+
+	if (item->autoselect_size)
+		move_data(*p_item, old_autoselect_data, item,
+				get_autoselect_data_ptr(item),
+				item->autoselect_size);
+
+	if (size) {
+		memcpy(get_item_default_data(item), data, size);
+		item_default_data_addref(item);
+	}
+
+	*p_item = item;
+}
+
+static inline void obs_data_item_set_autoselect_data(
+		struct obs_data_item **p_item, const void *data, size_t size,
+		enum obs_data_type type)
+{
+	if (!p_item || !*p_item)
+		return;
+
+	struct obs_data_item *item = *p_item;
+	item_autoselect_data_release(item);
+
+	item->autoselect_size = size;
+	item->type            = type;
+	item->data_len        = item->data_size ?
+					get_align_size(item->data_size) : 0;
+	item->default_len     = item->default_size ?
+					get_align_size(item->default_size) : 0;
+	item = obs_data_item_ensure_capacity(item);
+
+	if (size) {
+		memcpy(get_item_autoselect_data(item), data, size);
+		item_autoselect_data_addref(item);
+	}
+
+	*p_item = item;
+}
+
+/* ------------------------------------------------------------------------- */
+/* JSON writer
+ *
+ *   Writes JSON straight from the data items rather than building a jansson
+ * tree first.  The output is identical to what json_dumps produced with
+ * JSON_PRESERVE_ORDER | JSON_INDENT(4). */
+
+#define JSON_BUFFER_SIZE 65536
+#define JSON_INDENT_SIZE 4
+#define JSON_MAX_DEPTH   2048
+
+struct json_writer {
+	struct serializer *s;
+	char              *buf;
+	size_t            size;
+	bool              failed;
+};
+
+static void json_writer_flush(struct json_writer *w)
+{
+	if (w->size && !w->failed)
+		w->failed = s_write(w->s, w->buf, w->size) != w->size;
+	w->size = 0;
+}
+
+static void json_write(struct json_writer *w, const char *str, size_t len)
+{
+	if (w->size + len > JSON_BUFFER_SIZE)
+		json_writer_flush(w);
+
+	if (len > JSON_BUFFER_SIZE) {
+		if (!w->failed)
+			w->failed = s_write(w->s, str, len) != len;
+		return;
+	}
+
+	memcpy(w->buf + w->size, str, len);
+	w->size += len;
+}
+
+static inline void json_write_ch(struct json_writer *w, char ch)
+{
+	if (w->size == JSON_BUFFER_SIZE)
+		json_writer_flush(w);
+	w->buf[w->size++] = ch;
+}
+
+static void json_write_indent(struct json_writer *w, int depth)
+{
+	json_write_ch(w, '\n');
+	for (int i = 0; i < depth * JSON_INDENT_SIZE; i++)
+		json_write_ch(w, ' ');
+}
+
+static void json_write_string(struct json_writer *w, const char *str)
+{
+	const char *start = str;
+
+	json_write_ch(w, '"');
+
+	for (; *str; str++) {
+		uint8_t ch = (uint8_t)*str;
+		char seq[8];
+		const char *esc;
+
+		if (ch >= 0x20 && ch != '"' && ch != '\\')
+			continue;
+
+		json_write(w, start, str - start);
+		start = str + 1;
+
+		switch (ch) {
+		case '"':  esc = "\\\""; break;
+		case '\\': esc = "\\\\"; break;
+		case '\b': esc = "\\b"; break;
+		case '\f': esc = "\\f"; break;
+		case '\n': esc = "\\n"; break;
+		case '\r': esc = "\\r"; break;
+		case '\t': esc = "\\t"; break;
+		default:
+			snprintf(seq, sizeof(seq), "\\u%04X", (unsigned int)ch);
+			esc = seq;
+		}
+
+		json_write(w, esc, strlen(esc));
+	}
+
+	json_write(w, start, str - start);
+	json_write_ch(w, '"');
+}
+
+static void json_write_obj(struct json_writer *w, obs_data_t *data,
+		int depth);
+
+static void json_write_array(struct json_writer *w, obs_data_array_t *array,
+		int depth)
+{
+	size_t count = obs_data_array_count(array);
+
+	json_write_ch(w, '[');
+	if (!count) {
+		json_write_ch(w, ']');
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *obj = obs_data_array_item(array, i);
+
+		if (i)
+			json_write_ch(w, ',');
+		json_write_indent(w, depth + 1);
+		json_write_obj(w, obj, depth + 1);
+
+		obs_data_release(obj);
+	}
+
+	json_write_indent(w, depth);
+	json_write_ch(w, ']');
+}
+
+static bool json_write_item(struct json_writer *w, obs_data_item_t *item,
+		bool first, int depth)
+{
+	enum obs_data_type type = obs_data_item_gettype(item);
+	char num[64];
+	int num_len = 0;
+
+	if (!obs_data_item_has_user_value(item))
+		return false;
+
+	if (type == OBS_DATA_NUMBER) {
+		if (obs_data_item_numtype(item) == OBS_DATA_NUM_INT) {
+			num_len = snprintf(num, sizeof(num), "%lld",
+					obs_data_item_get_int(item));
+		} else {
+			double val = obs_data_item_get_double(item);
+
+			/* jansson can't represent these, the item was
+			 * always left out */
+			if (!isfinite(val))
+				return false;
+			num_len = os_dtostr(val, num, sizeof(num));
+		}
+
+		if (num_len <= 0)
+			return false;
+
+	} else if (type != OBS_DATA_STRING && type != OBS_DATA_BOOLEAN &&
+	           type != OBS_DATA_OBJECT && type != OBS_DATA_ARRAY) {
+		return false;
+	}
+
+	if (!first)
+		json_write_ch(w, ',');
+	json_write_indent(w, depth + 1);
+	json_write_string(w, get_item_name(item));
+	json_write(w, ": ", 2);
+
+	if (type == OBS_DATA_STRING) {
+		json_write_string(w, obs_data_item_get_string(item));
+
+	} else if (type == OBS_DATA_NUMBER) {
+		json_write(w, num, num_len);
+
+	} else if (type == OBS_DATA_BOOLEAN) {
+		if (obs_data_item_get_bool(item))
+			json_write(w, "true", 4);
+		else
+			json_write(w, "false", 5);
+
+	} else if (type == OBS_DATA_OBJECT) {
+		obs_data_t *obj = obs_data_item_get_obj(item);
+		json_write_obj(w, obj, depth + 1);
+		obs_data_release(obj);
+
+	} else if (type == OBS_DATA_ARRAY) {
+		obs_data_array_t *array = obs_data_item_get_array(item);
+		json_write_array(w, array, depth + 1);
+		obs_data_array_release(array);
+	}
+
+	return true;
+}
+
+static void json_write_obj(struct json_writer *w, obs_data_t *data,
+		int depth)
+{
+	obs_data_item_t *item = NULL;
+	bool first = true;
+
+	json_write_ch(w, '{');
+
+	for (item = obs_data_first(data); item; obs_data_item_next(&item)) {
+		if (json_write_item(w, item, first, depth))
+			first = false;
+	}
+
+	if (!first)
+		json_write_indent(w, depth);
+	json_write_ch(w, '}');
+}
+
+static bool obs_data_write_json(obs_data_t *data, struct serializer *s)
+{
+	struct json_writer w = {0};
+
+	w.s   = s;
+	w.buf = bmalloc(JSON_BUFFER_SIZE);
+
+	json_write_obj(&w, data, 0);
+	json_writer_flush(&w);
+
+	bfree(w.buf);
+	return !w.failed;
+}
+
+/* ------------------------------------------------------------------------- */
+/* JSON reader
+ *
+ *   Parses JSON and creates the data objects as it goes rather than loading
+ * a jansson tree first, so that files can be read in small chunks.  Accepts
+ * the same input the jansson based loader did (an object or an array at the
+ * root, duplicate keys rejected), and arrays keep only their objects. */
+
+struct json_reader {
+	struct serializer *s;
+	char              *buf;
+	const char        *cur;
+	const char        *end;
+	int               line;
+	int               depth;
+	DARRAY(char)      str;
+	bmem_arena_t      *arena; /* object keys */
+	char              error[128];
+};
+
+static bool json_reader_fill(struct json_reader *r)
+{
+	size_t size;
+
+	if (!r->s)
+		return false;
+
+	size = s_read(r->s, r->buf, JSON_BUFFER_SIZE);
+	if (!size)
+		return false;
+
+	r->cur = r->buf;
+	r->end = r->buf + size;
+	return true;
+}
+
+static inline int json_peek(struct json_reader *r)
+{
+	if (r->cur == r->end && !json_reader_fill(r))
+		return EOF;
+	return (uint8_t)*r->cur;
+}
+
+static inline int json_next(struct json_reader *r)
+{
+	int ch = json_peek(r);
+	if (ch != EOF) {
+		r->cur++;
+		if (ch == '\n')
+			r->line++;
+	}
+	return ch;
+}
+
+static bool json_error(struct json_reader *r, const char *msg)
+{
+	if (!*r->error)
+		snprintf(r->error, sizeof(r->error), "%s", msg);
+	return false;
+}
+
+static int json_skip_whitespace(struct json_reader *r)
+{
+	int ch = json_peek(r);
+
+	while (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+		json_next(r);
+		ch = json_peek(r);
+	}
+
+	return ch;
+}
+
+static bool json_expect_literal(struct json_reader *r, const char *literal)
+{
+	for (; *literal; literal++) {
+		if (json_next(r) != (uint8_t)*literal)
+			return json_error(r, "invalid token");
+	}
+
+	return true;
+}
+
+static int json_read_hex4(struct json_reader *r)
+{
+	int val = 0;
+
+	for (int i = 0; i < 4; i++) {
+		int ch = json_next(r);
+
+		val <<= 4;
+		if (ch >= '0' && ch <= '9')
+			val |= ch - '0';
+		else if (ch >= 'a' && ch <= 'f')
+			val |= ch - 'a' + 10;
+		else if (ch >= 'A' && ch <= 'F')
+			val |= ch - 'A' + 10;
+		else
+			return -1;
+	}
+
+	return val;
+}
+
+static void json_append_utf8(struct json_reader *r, uint32_t cp)
+{
+	char seq[4];
+	size_t len;
+
+	if (cp < 0x80) {
+		seq[0] = (char)cp;
+		len = 1;
+	} else if (cp < 0x800) {
+		seq[0] = (char)(0xC0 | (cp >> 6));
+		seq[1] = (char)(0x80 | (cp & 0x3F));
+		len = 2;
+	} else if (cp < 0x10000) {
+		seq[0] = (char)(0xE0 | (cp >> 12));
+		seq[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		seq[2] = (char)(0x80 | (cp & 0x3F));
+		len = 3;
+	} else {
+		seq[0] = (char)(0xF0 | (cp >> 18));
+		seq[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+		seq[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		seq[3] = (char)(0x80 | (cp & 0x3F));
+		len = 4;
+	}
+
+	da_push_back_array(r->str, seq, len);
+}
+
+static bool json_read_escape(struct json_reader *r)
+{
+	int ch = json_next(r);
+	char out;
+	int cp;
+
+	switch (ch) {
+	case '"':  out = '"'; break;
+	case '\\': out = '\\'; break;
+	case '/':  out = '/'; break;
+	case 'b':  out = '\b'; break;
+	case 'f':  out = '\f'; break;
+	case 'n':  out = '\n'; break;
+	case 'r':  out = '\r'; break;
+	case 't':  out = '\t'; break;
+	case 'u':  out = 0; break;
+	default:
+		return json_error(r, "invalid escape");
+	}
+
+	if (out) {
+		da_push_back(r->str, &out);
+		return true;
+	}
+
+	cp = json_read_hex4(r);
+	if (cp < 0)
+		return json_error(r, "invalid escape");
+	if (cp == 0)
+		return json_error(r, "\\u0000 is not allowed");
+
+	if (cp >= 0xD800 && cp <= 0xDBFF) {
+		int low;
+
+		if (json_next(r) != '\\' || json_next(r) != 'u')
+			return json_error(r, "invalid Unicode surrogate pair");
+
+		low = json_read_hex4(r);
+		if (low < 0xDC00 || low > 0xDFFF)
+			return json_error(r, "invalid Unicode surrogate pair");
+
+		cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+
+	} else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+		return json_error(r, "invalid Unicode surrogate pair");
+	}
+
+	json_append_utf8(r, (uint32_t)cp);
+	return true;
+}
+
+/* reads a string into r->str, the opening quote has already been read */
+static bool json_read_string(struct json_reader *r)
+{
+	char out;
+
+	da_resize(r->str, 0);
+
+	for (;;) {
+		int ch = json_next(r);
+		int cont = 0;
+
+		if (ch == '"')
+			break;
+		if (ch == EOF)
+			return json_error(r, "premature end of input");
+		if (ch < 0x20)
+			return json_error(r, "control character in string");
+
+		if (ch == '\\') {
+			if (!json_read_escape(r))
+				return false;
+			continue;
+		}
+
+		if (ch >= 0x80) {
+			if (ch >= 0xC2 && ch <= 0xDF)
+				cont = 1;
+			else if (ch >= 0xE0 && ch <= 0xEF)
+				cont = 2;
+			else if (ch >= 0xF0 && ch <= 0xF4)
+				cont = 3;
+			else
+				return json_error(r, "invalid UTF-8");
+		}
+
+		out = (char)ch;
+		da_push_back(r->str, &out);
+
+		while (cont--) {
+			ch = json_next(r);
+			if (ch < 0x80 || ch > 0xBF)
+				return json_error(r, "invalid UTF-8");
+			out = (char)ch;
+			da_push_back(r->str, &out);
+		}
+	}
+
+	out = 0;
+	da_push_back(r->str, &out);
+	return true;
+}
+
+static inline bool is_digit(int ch)
+{
+	return ch >= '0' && ch <= '9';
+}
+
+static bool json_read_number(struct json_reader *r, obs_data_t *data,
+		const char *key)
+{
+	char num[64];
+	size_t len = 0;
+	bool real = false;
+	int ch;
+
+#define NUM_NEXT() \
+	do { \
+		if (len == sizeof(num) - 1) \
+			return json_error(r, "number too long"); \
+		num[len++] = (char)json_next(r); \
+		ch = json_peek(r); \
+	} while (false)
+
+	ch = json_peek(r);
+	if (ch == '-')
+		NUM_NEXT();
+
+	if (ch == '0') {
+		NUM_NEXT();
+	} else if (is_digit(ch)) {
+		while (is_digit(ch))
+			NUM_NEXT();
+	} else {
+		return json_error(r, "invalid token");
+	}
+
+	if (ch == '.') {
+		real = true;
+		NUM_NEXT();
+		if (!is_digit(ch))
+			return json_error(r, "invalid token");
+		while (is_digit(ch))
+			NUM_NEXT();
+	}
+
+	if (ch == 'e' || ch == 'E') {
+		real = true;
+		NUM_NEXT();
+		if (ch == '+' || ch == '-')
+			NUM_NEXT();
+		if (!is_digit(ch))
+			return json_error(r, "invalid token");
+		while (is_digit(ch))
+			NUM_NEXT();
+	}
+
+#undef NUM_NEXT
+
+	num[len] = 0;
+
+	if (real) {
+		double val = os_strtod(num);
+		if (!isfinite(val))
+			return json_error(r, "real number overflow");
+		if (data)
+			obs_data_set_double(data, key, val);
+
+	} else {
+		long long val;
+
+		errno = 0;
+		val = strtoll(num, NULL, 10);
+		if (errno == ERANGE)
+			return json_error(r, "too big integer");
+		if (data)
+			obs_data_set_int(data, key, val);
+	}
+
+	return true;
+}
+
+static bool json_read_value(struct json_reader *r, obs_data_t *data,
+		const char *key);
+
+/* the opening brace has already been read */
+static bool json_read_object(struct json_reader *r, obs_data_t *data)
+{
+	bmem_arena_mark_t mark = bmem_arena_mark(r->arena);
+	const char *key;
+	bool success = false;
+	int ch;
+
+	if (++r->depth > JSON_MAX_DEPTH) {
+		json_error(r, "maximum parsing depth reached");
+		goto exit;
+	}
+
+	ch = json_skip_whitespace(r);
+	if (ch == '}') {
+		json_next(r);
+		success = true;
+		goto exit;
+	}
+
+	for (;;) {
+		if (json_next(r) != '"') {
+			json_error(r, "string or '}' expected");
+			goto exit;
+		}
+		if (!json_read_string(r))
+			goto exit;
+
+		key = bmem_arena_strdup_n(r->arena, r->str.array,
+				r->str.num - 1);
+		if (obs_data_has_user_value(data, key)) {
+			json_error(r, "duplicate object key");
+			goto exit;
+		}
+
+		if (json_skip_whitespace(r) != ':') {
+			json_error(r, "':' expected");
+			goto exit;
+		}
+		json_next(r);
+
+		if (!json_read_value(r, data, key))
+			goto exit;
+
+		/* the item has its own copy of the key, so the arena only ever
+		 * holds the keys of the objects that are still being read */
+		bmem_arena_release(r->arena, mark);
+
+		ch = json_skip_whitespace(r);
+		json_next(r);
+
+		if (ch == '}')
+			break;
+		if (ch != ',') {
+			json_error(r, "'}' expected");
+			goto exit;
+		}
+
+		json_skip_whitespace(r);
+	}
+
+	success = true;
+
+exit:
+	bmem_arena_release(r->arena, mark);
+	r->depth--;
+	return success;
+}
+
+/* the opening bracket has already been read, array may be NULL */
+static bool json_read_array(struct json_reader *r, obs_data_array_t *array)
+{
+	bool success = false;
+	int ch;
+
+	if (++r->depth > JSON_MAX_DEPTH) {
+		json_error(r, "maximum parsing depth reached");
+		goto exit;
+	}
+
+	ch = json_skip_whitespace(r);
+	if (ch == ']') {
+		json_next(r);
+		success = true;
+		goto exit;
+	}
+
+	for (;;) {
+		ch = json_skip_whitespace(r);
+
+		if (ch == '{') {
+			obs_data_t *obj = obs_data_create();
+
+			json_next(r);
+			success = json_read_object(r, obj);
+			if (success && array)
+				obs_data_array_push_back(array, obj);
+			obs_data_release(obj);
+
+			if (!success)
+				goto exit;
+			success = false;
+
+		} else if (!json_read_value(r, NULL, NULL)) {
+			goto exit;
+		}
+
+		ch = json_skip_whitespace(r);
+		json_next(r);
+
+		if (ch == ']')
+			break;
+		if (ch != ',') {
+			json_error(r, "']' expected");
+			goto exit;
+		}
+	}
+
+	success = true;
+
+exit:
+	r->depth--;
+	return success;
+}
+
+/* if data is NULL the value is parsed and then discarded */
+static bool json_read_value(struct json_reader *r, obs_data_t *data,
+		const char *key)
+{
+	int ch = json_skip_whitespace(r);
+
+	if (ch == '{') {
+		obs_data_t *obj = obs_data_create();
+		bool success;
+
+		json_next(r);
+		success = json_read_object(r, obj);
+		if (success && data)
+			obs_data_set_obj(data, key, obj);
+		obs_data_release(obj);
+		return success;
+
+	} else if (ch == '[') {
+		obs_data_array_t *array = obs_data_array_create();
+		bool success;
+
+		json_next(r);
+		success = json_read_array(r, array);
+		if (success && data)
+			obs_data_set_array(data, key, array);
+		obs_data_array_release(array);
+		return success;
+
+	} else if (ch == '"') {
+		json_next(r);
+		if (!json_read_string(r))
+			return false;
+		if (data)
+			obs_data_set_string(data, key, r->str.array);
+		return true;
+
+	} else if (ch == 't') {
+		if (!json_expect_literal(r, "true"))
+			return false;
+		if (data)
+			obs_data_set_bool(data, key, true);
+		return true;
+
+	} else if (ch == 'f') {
+		if (!json_expect_literal(r, "false"))
+			return false;
+		if (data)
+			obs_data_set_bool(data, key, false);
+		return true;
+
+	} else if (ch == 'n') {
+		return json_expect_literal(r, "null");
+
+	} else if (ch == '-' || is_digit(ch)) {
+		return json_read_number(r, data, key);
+	}
+
+	return json_error(r, ch == EOF ?
+			"premature end of input" : "invalid token");
+}
+
+static obs_data_t *obs_data_read_json(struct json_reader *r, const char *func)
+{
+	obs_data_t *data = obs_data_create();
+	bool success = false;
+	int ch;
+
+	r->line  = 1;
+	r->arena = bmem_arena_create(0);
+
+	/* skip the UTF-8 byte order mark if present */
+	if (json_peek(r) == 0xEF) {
+		if (!json_expect_literal(r, "\xEF\xBB\xBF"))
+			goto exit;
+	}
+
+	ch = json_skip_whitespace(r);
+	json_next(r);
+
+	if (ch == '{') {
+		success = json_read_object(r, data);
+	} else if (ch == '[') {
+		/* root arrays are valid json, but can't contain any data */
+		success = json_read_array(r, NULL);
+	} else {
+		json_error(r, "'[' or '{' expected");
+	}
+
+	if (success && json_skip_whitespace(r) != EOF)
+		success = json_error(r, "end of file expected");
+
+exit:
+	if (!success) {
+		blog(LOG_ERROR, "obs-data.c: [%s] "
+		                "Failed reading json string (%d): %s",
+		                func, r->line, r->error);
+		obs_data_release(data);
+		data = NULL;
+	}
+
+	bmem_arena_destroy(r->arena);
+	da_free(r->str);
+	return data;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Binary container
+ *
+ *   A compact alternative to JSON.  All values are little endian:
+ *
+ *   header:  "OBSD", u32 version, u32 string count, u32 index count,
+ *            u64 string table offset, u64 index offset
+ *   object:  u32 item count, then per item: u32 key, u8 type, value
+ *   values:  string:  u32 length, bytes, 0
+ *            int:     i64
+ *            double:  f64
+ *            bool:    (no payload, stored in the type)
+ *            object:  u32 size, object
+ *            array:   u32 size, u32 count, then per object: u32 size, object
+ *   strings: u32 length, bytes, 0 (keys are stored here once and referred to
+ *            by their index)
+ *   index:   per top level item: u32 key, u64 offset, u64 size
+ *
+ *   Object and array sizes allow skipping over values, and the top level
+ *   index allows reading a single top level item without loading the rest of
+ *   the file. */
+
+#define BIN_MAGIC       "OBSD"
+#define BIN_VERSION     1
+#define BIN_HEADER_SIZE 32
+#define BIN_INDEX_SIZE  20
+
+enum bin_type {
+	BIN_STRING = 1,
+	BIN_INT,
+	BIN_DOUBLE,
+	BIN_TRUE,
+	BIN_FALSE,
+	BIN_OBJECT,
+	BIN_ARRAY
+};
+
+struct bin_index_entry {
+	uint32_t key;
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct bin_writer {
+	DARRAY(uint8_t)                bytes;
+	DARRAY(const char*)            strings;
+	DARRAY(struct bin_index_entry) index;
+	uint32_t                       *table;
+	size_t                         table_size;
+};
+
+static inline void bin_w8(struct bin_writer *w, uint8_t val)
+{
+	da_push_back(w->bytes, &val);
+}
+
+static inline void bin_w32(struct bin_writer *w, uint32_t val)
+{
+	uint8_t buf[4];
+	for (size_t i = 0; i < 4; i++)
+		buf[i] = (uint8_t)(val >> (i * 8));
+	da_push_back_array(w->bytes, buf, 4);
+}
+
+static inline void bin_w64(struct bin_writer *w, uint64_t val)
+{
+	uint8_t buf[8];
+	for (size_t i = 0; i < 8; i++)
+		buf[i] = (uint8_t)(val >> (i * 8));
+	da_push_back_array(w->bytes, buf, 8);
+}
+
+static inline void bin_patch32(struct bin_writer *w, size_t pos, uint32_t val)
+{
+	for (size_t i = 0; i < 4; i++)
+		w->bytes.array[pos + i] = (uint8_t)(val >> (i * 8));
+}
+
+static inline void bin_patch64(struct bin_writer *w, size_t pos, uint64_t val)
+{
+	for (size_t i = 0; i < 8; i++)
+		w->bytes.array[pos + i] = (uint8_t)(val >> (i * 8));
+}
+
+static void bin_write_str(struct bin_writer *w, const char *str)
+{
+	size_t len = strlen(str);
+
+	bin_w32(w, (uint32_t)len);
+	da_push_back_array(w->bytes, str, len + 1);
+}
+
+/* table maps name hashes to string indices + 1, the strings point to item
+ * names, which stay valid while the data is being written */
+static void bin_rebuild_table(struct bin_writer *w, size_t size)
+{
+	bfree(w->table);
+	w->table = bzalloc(sizeof(uint32_t) * size);
+	w->table_size = size;
+
+	for (size_t i = 0; i < w->strings.num; i++) {
+		size_t idx = get_name_hash(w->strings.array[i]) & (size - 1);
+
+		while (w->table[idx])
+			idx = (idx + 1) & (size - 1);
+		w->table[idx] = (uint32_t)i + 1;
+	}
+}
+
+static uint32_t bin_get_key(struct bin_writer *w, const char *name)
+{
+	size_t mask = w->table_size - 1;
+	size_t idx = get_name_hash(name) & mask;
+	uint32_t key;
+
+	while (w->table[idx]) {
+		key = w->table[idx] - 1;
+		if (strcmp(w->strings.array[key], name) == 0)
+			return key;
+		idx = (idx + 1) & mask;
+	}
+
+	key = (uint32_t)w->strings.num;
+	da_push_back(w->strings, &name);
+	w->table[idx] = key + 1;
+
+	if (w->strings.num * 2 > w->table_size)
+		bin_rebuild_table(w, w->table_size * 2);
+
+	return key;
+}
+
+static void bin_write_obj(struct bin_writer *w, obs_data_t *data,
+		bool top_level);
+
+static void bin_write_sized_obj(struct bin_writer *w, obs_data_t *data)
+{
+	size_t size_pos = w->bytes.num;
+
+	bin_w32(w, 0);
+	bin_write_obj(w, data, false);
+	bin_patch32(w, size_pos, (uint32_t)(w->bytes.num - size_pos - 4));
+}
+
+static void bin_write_array(struct bin_writer *w, obs_data_array_t *array)
+{
+	size_t count = obs_data_array_count(array);
+	size_t size_pos = w->bytes.num;
+
+	bin_w32(w, 0);
+	bin_w32(w, (uint32_t)count);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *obj = obs_data_array_item(array, i);
+		bin_write_sized_obj(w, obj);
+		obs_data_release(obj);
+	}
+
+	bin_patch32(w, size_pos, (uint32_t)(w->bytes.num - size_pos - 4));
+}
+
+static bool bin_write_item(struct bin_writer *w, obs_data_item_t *item)
+{
+	enum obs_data_type type = obs_data_item_gettype(item);
+
+	if (!obs_data_item_has_user_value(item))
+		return false;
+
+	bin_w32(w, bin_get_key(w, get_item_name(item)));
+
+	if (type == OBS_DATA_STRING) {
+		bin_w8(w, BIN_STRING);
+		bin_write_str(w, obs_data_item_get_string(item));
+
+	} else if (type == OBS_DATA_NUMBER &&
+	           obs_data_item_numtype(item) == OBS_DATA_NUM_INT) {
+		bin_w8(w, BIN_INT);
+		bin_w64(w, (uint64_t)obs_data_item_get_int(item));
+
+	} else if (type == OBS_DATA_NUMBER) {
+		double val = obs_data_item_get_double(item);
+		uint64_t bits;
+
+		memcpy(&bits, &val, sizeof(bits));
+		bin_w8(w, BIN_DOUBLE);
+		bin_w64(w, bits);
+
+	} else if (type == OBS_DATA_BOOLEAN) {
+		bin_w8(w, obs_data_item_get_bool(item) ? BIN_TRUE : BIN_FALSE);
+
+	} else if (type == OBS_DATA_OBJECT) {
+		obs_data_t *obj = obs_data_item_get_obj(item);
+		bin_w8(w, BIN_OBJECT);
+		bin_write_sized_obj(w, obj);
+		obs_data_release(obj);
+
+	} else if (type == OBS_DATA_ARRAY) {
+		obs_data_array_t *array = obs_data_item_get_array(item);
+		bin_w8(w, BIN_ARRAY);
+		bin_write_array(w, array);
+		obs_data_array_release(array);
+
+	} else {
+		/* remove the key again */
+		w->bytes.num -= 4;
+		return false;
+	}
+
+	return true;
+}
+
+static void bin_write_obj(struct bin_writer *w, obs_data_t *data,
+		bool top_level)
+{
+	obs_data_item_t *item = NULL;
+	size_t count_pos = w->bytes.num;
+	uint32_t count = 0;
+
+	bin_w32(w, 0);
+
+	for (item = obs_data_first(data); item; obs_data_item_next(&item)) {
+		size_t offset = w->bytes.num;
+
+		if (!bin_write_item(w, item))
+			continue;
+
+		if (top_level) {
+			struct bin_index_entry *entry =
+				da_push_back_new(w->index);
+
+			/* the key is the first thing written for the item */
+			entry->key = w->bytes.array[offset] |
+				(uint32_t)w->bytes.array[offset + 1] << 8 |
+				(uint32_t)w->bytes.array[offset + 2] << 16 |
+				(uint32_t)w->bytes.array[offset + 3] << 24;
+			entry->offset = offset;
+			entry->size   = w->bytes.num - offset;
+		}
+
+		count++;
+	}
+
+	bin_patch32(w, count_pos, count);
+}
+
+static bool obs_data_write_binary(obs_data_t *data, struct serializer *s)
+{
+	struct bin_writer w = {0};
+	size_t strings_offset;
+	size_t index_offset;
+	bool success;
+
+	bin_rebuild_table(&w, 256);
+
+	da_push_back_array(w.bytes, BIN_MAGIC, 4);
+	bin_w32(&w, BIN_VERSION);
+	bin_w32(&w, 0);
+	bin_w32(&w, 0);
+	bin_w64(&w, 0);
+	bin_w64(&w, 0);
+
+	bin_write_obj(&w, data, true);
+
+	strings_offset = w.bytes.num;
+	for (size_t i = 0; i < w.strings.num; i++)
+		bin_write_str(&w, w.strings.array[i]);
+
+	index_offset = w.bytes.num;
+	for (size_t i = 0; i < w.index.num; i++) {
+		bin_w32(&w, w.index.array[i].key);
+		bin_w64(&w, w.index.array[i].offset);
+		bin_w64(&w, w.index.array[i].size);
+	}
+
+	bin_patch32(&w, 8,  (uint32_t)w.strings.num);
+	bin_patch32(&w, 12, (uint32_t)w.index.num);
+	bin_patch64(&w, 16, strings_offset);
+	bin_patch64(&w, 24, index_offset);
+
+	success = s_write(s, w.bytes.array, w.bytes.num) == w.bytes.num;
+
+	da_free(w.bytes);
+	da_free(w.strings);
+	da_free(w.index);
+	bfree(w.table);
+	return success;
+}
+
+struct bin_reader {
+	const uint8_t *data;
+	size_t        size;
+	size_t        pos;
+	const char    **strings;
+	size_t        num_strings;
+	int           depth;
+	const char    *error;
+};
+
+static bool bin_error(struct bin_reader *r, const char *error)
+{
+	if (!r->error)
+		r->error = error;
+	return false;
+}
+
+static inline bool bin_check(struct bin_reader *r, size_t size)
+{
+	if (r->size - r->pos < size)
+		return bin_error(r, "unexpected end of data");
+	return true;
+}
+
+static inline uint8_t bin_r8(struct bin_reader *r)
+{
+	return r->data[r->pos++];
+}
+
+static inline uint32_t bin_r32(struct bin_reader *r)
+{
+	uint32_t val = 0;
+	for (size_t i = 0; i < 4; i++)
+		val |= (uint32_t)r->data[r->pos++] << (i * 8);
+	return val;
 }
 
-static inline void obs_data_item_destroy(struct obs_data_item *item)
+static inline uint64_t bin_r64(struct bin_reader *r)
 {
-	item_data_release(item);
-	item_default_data_release(item);
-	item_autoselect_data_release(item);
-	obs_data_item_detach(item);
-	bfree(item);
+	uint64_t val = 0;
+	for (size_t i = 0; i < 8; i++)
+		val |= (uint64_t)r->data[r->pos++] << (i * 8);
+	return val;
 }
 
-static inline void move_data(obs_data_item_t *old_item, void *old_data,
-		obs_data_item_t *item, void *data, size_t len)
+static const char *bin_read_str(struct bin_reader *r)
 {
-	ptrdiff_t old_offset = (uint8_t*)old_data - (uint8_t*)old_item;
-	ptrdiff_t new_offset = (uint8_t*)data - (uint8_t*)item;
+	const char *str;
+	uint32_t len;
 
-	if (!old_data)
-		return;
+	if (!bin_check(r, 4))
+		return NULL;
 
-	memmove((uint8_t*)item + new_offset, (uint8_t*)item + old_offset, len);
+	len = bin_r32(r);
+	if (!bin_check(r, (size_t)len + 1))
+		return NULL;
+
+	str = (const char*)r->data + r->pos;
+	r->pos += (size_t)len + 1;
+
+	if (str[len] != 0) {
+		bin_error(r, "invalid string");
+		return NULL;
+	}
+
+	return str;
 }
 
-static inline void obs_data_item_setdata(
-		struct obs_data_item **p_item, const void *data, size_t size,
-		enum obs_data_type type)
+static bool bin_read_obj(struct bin_reader *r, obs_data_t *data);
+
+/* reads a size prefixed object and makes sure it used up exactly its size */
+static obs_data_t *bin_read_sized_obj(struct bin_reader *r)
 {
-	if (!p_item || !*p_item)
-		return;
+	obs_data_t *obj;
+	size_t end;
+	uint32_t size;
 
-	struct obs_data_item *item = *p_item;
-	ptrdiff_t old_default_data_pos =
-		(uint8_t*)get_default_data_ptr(item) - (uint8_t*)item;
-	item_data_release(item);
+	if (!bin_check(r, 4))
+		return NULL;
 
-	item->data_size = size;
-	item->type      = type;
-	item->data_len  = (item->default_size || item->autoselect_size) ? 
-		get_align_size(size) : size;
-	item = obs_data_item_ensure_capacity(item);
+	size = bin_r32(r);
+	if (!bin_check(r, size))
+		return NULL;
 
-	if (item->default_size || item->autoselect_size)
-		memmove(get_default_data_ptr(item),
-				(uint8_t*)item + old_default_data_pos,
-				item->default_len + item->autoselect_size);
+	end = r->pos + size;
+	obj = obs_data_create();
 
-	if (size) {
-		memcpy(get_item_data(item), data, size);
-		item_data_addref(item);
+	if (!bin_read_obj(r, obj) || r->pos != end) {
+		bin_error(r, "invalid object size");
+		obs_data_release(obj);
+		return NULL;
 	}
 
-	*p_item = item;
+	return obj;
 }
 
-static inline void obs_data_item_set_default_data(
-		struct obs_data_item **p_item, const void *data, size_t size,
-		enum obs_data_type type)
+static bool bin_read_array(struct bin_reader *r, obs_data_t *data,
+		const char *key)
 {
-	if (!p_item || !*p_item)
-		return;
+	obs_data_array_t *array;
+	uint32_t size, count;
+	size_t end;
 
-	struct obs_data_item *item = *p_item;
-	void *old_autoselect_data = get_autoselect_data_ptr(item);
-	item_default_data_release(item);
+	if (!bin_check(r, 8))
+		return false;
 
-	item->type         = type;
-	item->default_size = size;
-	item->default_len  = item->autoselect_size ?
-				get_align_size(size) : size;
-	item->data_len     = item->data_size ?
-				get_align_size(item->data_size) : 0;
-	item = obs_data_item_ensure_capacity(item);
+	size  = bin_r32(r);
+	end   = r->pos + size;
+	count = bin_r32(r);
 
-	if (item->autoselect_size)
-		move_data(*p_item, old_autoselect_data, item,
-				get_autoselect_data_ptr(item),
-				item->autoselect_size);
+	if (size < 4 || end > r->size)
+		return bin_error(r, "invalid array size");
 
-	if (size) {
-		memcpy(get_item_default_data(item), data, size);
-		item_default_data_addref(item);
+	array = obs_data_array_create();
+
+	for (uint32_t i = 0; i < count; i++) {
+		obs_data_t *obj = bin_read_sized_obj(r);
+		if (!obj) {
+			obs_data_array_release(array);
+			return false;
+		}
+
+		obs_data_array_push_back(array, obj);
+		obs_data_release(obj);
 	}
 
-	*p_item = item;
+	if (r->pos != end) {
+		obs_data_array_release(array);
+		return bin_error(r, "invalid array size");
+	}
+
+	obs_data_set_array(data, key, array);
+	obs_data_array_release(array);
+	return true;
 }
 
-static inline void obs_data_item_set_autoselect_data(
-		struct obs_data_item **p_item, const void *data, size_t size,
-		enum obs_data_type type)
+static bool bin_read_item(struct bin_reader *r, obs_data_t *data)
 {
-	if (!p_item || !*p_item)
-		return;
+	const char *key;
+	uint32_t key_idx;
+	uint8_t type;
 
-	struct obs_data_item *item = *p_item;
-	item_autoselect_data_release(item);
+	if (!bin_check(r, 5))
+		return false;
 
-	item->autoselect_size = size;
-	item->type            = type;
-	item->data_len        = item->data_size ?
-					get_align_size(item->data_size) : 0;
-	item->default_len     = item->default_size ?
-					get_align_size(item->default_size) : 0;
-	item = obs_data_item_ensure_capacity(item);
+	key_idx = bin_r32(r);
+	type    = bin_r8(r);
 
-	if (size) {
-		memcpy(get_item_autoselect_data(item), data, size);
-		item_autoselect_data_addref(item);
+	if (key_idx >= r->num_strings)
+		return bin_error(r, "invalid key");
+	key = r->strings[key_idx];
+
+	switch (type) {
+	case BIN_STRING: {
+		const char *str = bin_read_str(r);
+		if (!str)
+			return false;
+		obs_data_set_string(data, key, str);
+		return true;
+	}
+	case BIN_INT:
+		if (!bin_check(r, 8))
+			return false;
+		obs_data_set_int(data, key, (long long)bin_r64(r));
+		return true;
+
+	case BIN_DOUBLE: {
+		uint64_t bits;
+		double val;
+
+		if (!bin_check(r, 8))
+			return false;
+		bits = bin_r64(r);
+		memcpy(&val, &bits, sizeof(val));
+		obs_data_set_double(data, key, val);
+		return true;
+	}
+	case BIN_TRUE:
+	case BIN_FALSE:
+		obs_data_set_bool(data, key, type == BIN_TRUE);
+		return true;
+
+	case BIN_OBJECT: {
+		obs_data_t *obj = bin_read_sized_obj(r);
+		if (!obj)
+			return false;
+		obs_data_set_obj(data, key, obj);
+		obs_data_release(obj);
+		return true;
+	}
+	case BIN_ARRAY:
+		return bin_read_array(r, data, key);
 	}
 
-	*p_item = item;
+	return bin_error(r, "invalid type");
 }
 
-/* ------------------------------------------------------------------------- */
-
-static void obs_data_add_json_item(obs_data_t *data, const char *key,
-		json_t *json);
-
-static inline void obs_data_add_json_object_data(obs_data_t *data, json_t *jobj)
+static bool bin_read_obj(struct bin_reader *r, obs_data_t *data)
 {
-	const char *item_key;
-	json_t *jitem;
+	uint32_t count;
+	bool success = true;
 
-	json_object_foreach (jobj, item_key, jitem) {
-		obs_data_add_json_item(data, item_key, jitem);
+	if (!bin_check(r, 4))
+		return false;
+	if (++r->depth > JSON_MAX_DEPTH) {
+		r->depth--;
+		return bin_error(r, "maximum depth reached");
 	}
+
+	count = bin_r32(r);
+	for (uint32_t i = 0; success && i < count; i++)
+		success = bin_read_item(r, data);
+
+	r->depth--;
+	return success;
 }
 
-static inline void obs_data_add_json_object(obs_data_t *data, const char *key,
-		json_t *jobj)
+struct bin_header {
+	uint32_t string_count;
+	uint32_t index_count;
+	uint64_t strings_offset;
+	uint64_t index_offset;
+};
+
+static bool bin_read_header(struct bin_reader *r, struct bin_header *header)
 {
-	obs_data_t *sub_obj = obs_data_create();
+	if (!bin_check(r, BIN_HEADER_SIZE) ||
+	    memcmp(r->data, BIN_MAGIC, 4) != 0)
+		return bin_error(r, "not a binary data file");
 
-	obs_data_add_json_object_data(sub_obj, jobj);
-	obs_data_set_obj(data, key, sub_obj);
-	obs_data_release(sub_obj);
+	r->pos = 4;
+	if (bin_r32(r) != BIN_VERSION)
+		return bin_error(r, "unsupported version");
+
+	header->string_count   = bin_r32(r);
+	header->index_count    = bin_r32(r);
+	header->strings_offset = bin_r64(r);
+	header->index_offset   = bin_r64(r);
+	return true;
 }
 
-static void obs_data_add_json_array(obs_data_t *data, const char *key,
-		json_t *jarray)
+/* reads the string table, pos is the position of the table within r->data */
+static bool bin_read_strings(struct bin_reader *r, size_t pos,
+		uint32_t count)
 {
-	obs_data_array_t *array = obs_data_array_create();
-	size_t idx;
-	json_t *jitem;
+	size_t old_pos = r->pos;
 
-	json_array_foreach (jarray, idx, jitem) {
-		obs_data_t *item;
+	if (pos > r->size || count > (r->size - pos) / 5)
+		return bin_error(r, "invalid string table");
 
-		if (!json_is_object(jitem))
-			continue;
+	r->pos = pos;
+	r->strings = bmalloc(sizeof(const char*) * (count ? count : 1));
+	r->num_strings = 0;
 
-		item = obs_data_create();
-		obs_data_add_json_object_data(item, jitem);
-		obs_data_array_push_back(array, item);
-		obs_data_release(item);
+	for (uint32_t i = 0; i < count; i++) {
+		const char *str = bin_read_str(r);
+		if (!str)
+			return false;
+		r->strings[r->num_strings++] = str;
 	}
 
-	obs_data_set_array(data, key, array);
-	obs_data_array_release(array);
+	r->pos = old_pos;
+	return true;
 }
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key,
-		json_t *json)
+obs_data_t *obs_data_create_from_binary(const void *buf, size_t size)
 {
-	if (json_is_object(json))
-		obs_data_add_json_object(data, key, json);
-	else if (json_is_array(json))
-		obs_data_add_json_array(data, key, json);
-	else if (json_is_string(json))
-		obs_data_set_string(data, key, json_string_value(json));
-	else if (json_is_integer(json))
-		obs_data_set_int(data, key, json_integer_value(json));
-	else if (json_is_real(json))
-		obs_data_set_double(data, key, json_real_value(json));
-	else if (json_is_true(json))
-		obs_data_set_bool(data, key, true);
-	else if (json_is_false(json))
-		obs_data_set_bool(data, key, false);
-}
+	struct bin_reader r = {0};
+	struct bin_header header;
+	obs_data_t *data = obs_data_create();
 
-/* ------------------------------------------------------------------------- */
+	r.data = buf;
+	r.size = buf ? size : 0;
+
+	if (!bin_read_header(&r, &header))
+		goto fail;
+	if (header.strings_offset < BIN_HEADER_SIZE ||
+	    header.strings_offset > size)
+		goto fail;
+	if (!bin_read_strings(&r, (size_t)header.strings_offset,
+				header.string_count))
+		goto fail;
+
+	/* the values end where the string table starts */
+	r.size = (size_t)header.strings_offset;
+	r.pos = BIN_HEADER_SIZE;
+
+	if (!bin_read_obj(&r, data) || r.pos != r.size) {
+		bin_error(&r, "invalid object size");
+		goto fail;
+	}
 
-static inline void set_json_string(json_t *json, const char *name,
-		obs_data_item_t *item)
-{
-	const char *val = obs_data_item_get_string(item);
-	json_object_set_new(json, name, json_string(val));
+	bfree((void*)r.strings);
+	return data;
+
+fail:
+	blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_binary] "
+	                "Failed reading binary data: %s",
+	                r.error ? r.error : "invalid header");
+	bfree((void*)r.strings);
+	obs_data_release(data);
+	return NULL;
 }
 
-static inline void set_json_number(json_t *json, const char *name,
-		obs_data_item_t *item)
+static uint8_t *read_binary_file(struct serializer *s, size_t *size)
 {
-	enum obs_data_number_type type = obs_data_item_numtype(item);
+	int64_t file_size = serializer_seek(s, 0, SERIALIZE_SEEK_END);
+	uint8_t *buf;
 
-	if (type == OBS_DATA_NUM_INT) {
-		long long val = obs_data_item_get_int(item);
-		json_object_set_new(json, name, json_integer(val));
-	} else {
-		double val = obs_data_item_get_double(item);
-		json_object_set_new(json, name, json_real(val));
+	if (file_size <= 0 || (uint64_t)file_size > SIZE_MAX)
+		return NULL;
+
+	serializer_seek(s, 0, SERIALIZE_SEEK_START);
+
+	buf = bmalloc((size_t)file_size);
+	if (s_read(s, buf, (size_t)file_size) != (size_t)file_size) {
+		bfree(buf);
+		return NULL;
 	}
+
+	*size = (size_t)file_size;
+	return buf;
 }
 
-static inline void set_json_bool(json_t *json, const char *name,
-		obs_data_item_t *item)
+obs_data_t *obs_data_create_from_binary_file(const char *file)
 {
-	bool val = obs_data_item_get_bool(item);
-	json_object_set_new(json, name, val ? json_true() : json_false());
-}
+	struct serializer s;
+	obs_data_t *data = NULL;
+	uint8_t *buf;
+	size_t size;
 
-static json_t *obs_data_to_json(obs_data_t *data);
+	if (!file || !file_input_serializer_init(&s, file))
+		return NULL;
 
-static inline void set_json_obj(json_t *json, const char *name,
-		obs_data_item_t *item)
-{
-	obs_data_t *obj = obs_data_item_get_obj(item);
-	json_object_set_new(json, name, obs_data_to_json(obj));
-	obs_data_release(obj);
+	buf = read_binary_file(&s, &size);
+	file_input_serializer_free(&s);
+
+	if (buf) {
+		data = obs_data_create_from_binary(buf, size);
+		bfree(buf);
+	}
+
+	return data;
 }
 
-static inline void set_json_array(json_t *json, const char *name,
-		obs_data_item_t *item)
+/* reads count bytes at offset of the file into a new buffer */
+static uint8_t *read_binary_range(struct serializer *s, uint64_t offset,
+		uint64_t count)
 {
-	json_t           *jarray = json_array();
-	obs_data_array_t *array   = obs_data_item_get_array(item);
-	size_t           count   = obs_data_array_count(array);
+	uint8_t *buf;
+
+	if (count > SIZE_MAX || serializer_seek(s, (int64_t)offset,
+				SERIALIZE_SEEK_START) != (int64_t)offset)
+		return NULL;
 
-	for (size_t idx = 0; idx < count; idx++) {
-		obs_data_t *sub_item = obs_data_array_item(array, idx);
-		json_t     *jitem   = obs_data_to_json(sub_item);
-		json_array_append_new(jarray, jitem);
-		obs_data_release(sub_item);
+	buf = bmalloc(count ? (size_t)count : 1);
+	if (s_read(s, buf, (size_t)count) != (size_t)count) {
+		bfree(buf);
+		return NULL;
 	}
 
-	json_object_set_new(json, name, jarray);
-	obs_data_array_release(array);
+	return buf;
 }
 
-static json_t *obs_data_to_json(obs_data_t *data)
+obs_data_t *obs_data_create_from_binary_file_item(const char *file,
+		const char *name)
 {
-	json_t *json = json_object();
-	obs_data_item_t *item = NULL;
+	struct bin_reader r = {0};
+	struct bin_header header;
+	struct serializer s;
+	uint8_t header_data[BIN_HEADER_SIZE];
+	uint8_t *strings = NULL;
+	uint8_t *index = NULL;
+	uint8_t *item = NULL;
+	obs_data_t *data = NULL;
+	int64_t file_size;
+	uint32_t key = UINT32_MAX;
+	bool found = false;
 
-	for (item = obs_data_first(data); item; obs_data_item_next(&item)) {
-		enum obs_data_type type = obs_data_item_gettype(item);
-		const char *name        = get_item_name(item);
+	if (!file || !name || !file_input_serializer_init(&s, file))
+		return NULL;
+
+	file_size = serializer_seek(&s, 0, SERIALIZE_SEEK_END);
+	serializer_seek(&s, 0, SERIALIZE_SEEK_START);
+
+	r.data = header_data;
+	r.size = s_read(&s, header_data, BIN_HEADER_SIZE);
+	if (!bin_read_header(&r, &header))
+		goto exit;
+
+	if (header.strings_offset > header.index_offset ||
+	    header.index_offset > (uint64_t)file_size ||
+	    (uint64_t)header.index_count * BIN_INDEX_SIZE >
+	    (uint64_t)file_size - header.index_offset) {
+		bin_error(&r, "invalid index");
+		goto exit;
+	}
 
-		if (!obs_data_item_has_user_value(item))
+	/* only the string table, the index and the item itself are read */
+	strings = read_binary_range(&s, header.strings_offset,
+			header.index_offset - header.strings_offset);
+	index = read_binary_range(&s, header.index_offset,
+			(uint64_t)header.index_count * BIN_INDEX_SIZE);
+	if (!strings || !index) {
+		bin_error(&r, "unexpected end of data");
+		goto exit;
+	}
+
+	r.data = strings;
+	r.size = (size_t)(header.index_offset - header.strings_offset);
+	if (!bin_read_strings(&r, 0, header.string_count))
+		goto exit;
+
+	for (uint32_t i = 0; i < r.num_strings; i++) {
+		if (strcmp(r.strings[i], name) == 0) {
+			key = i;
+			break;
+		}
+	}
+
+	data = obs_data_create();
+
+	for (uint32_t i = 0; i < header.index_count; i++) {
+		struct bin_reader index_r = {0};
+		uint64_t offset, size;
+
+		index_r.data = index;
+		index_r.size = header.index_count * BIN_INDEX_SIZE;
+		index_r.pos  = i * BIN_INDEX_SIZE;
+
+		if (bin_r32(&index_r) != key)
 			continue;
 
-		if (type == OBS_DATA_STRING)
-			set_json_string(json, name, item);
-		else if (type == OBS_DATA_NUMBER)
-			set_json_number(json, name, item);
-		else if (type == OBS_DATA_BOOLEAN)
-			set_json_bool(json, name, item);
-		else if (type == OBS_DATA_OBJECT)
-			set_json_obj(json, name, item);
-		else if (type == OBS_DATA_ARRAY)
-			set_json_array(json, name, item);
+		found = true;
+		offset = bin_r64(&index_r);
+		size   = bin_r64(&index_r);
+
+		if (offset < BIN_HEADER_SIZE ||
+		    offset > header.strings_offset ||
+		    size > header.strings_offset - offset) {
+			bin_error(&r, "invalid index");
+			break;
+		}
+
+		item = read_binary_range(&s, offset, size);
+		if (!item) {
+			bin_error(&r, "unexpected end of data");
+			break;
+		}
+
+		r.data = item;
+		r.size = (size_t)size;
+		r.pos  = 0;
+		if (!bin_read_item(&r, data) || r.pos != r.size)
+			bin_error(&r, "invalid item size");
+		break;
+	}
+
+exit:
+	if (r.error)
+		blog(LOG_ERROR, "obs-data.c: "
+		                "[obs_data_create_from_binary_file_item] "
+		                "Failed reading '%s': %s", name, r.error);
+	if (r.error || !found) {
+		obs_data_release(data);
+		data = NULL;
 	}
 
-	return json;
+	file_input_serializer_free(&s);
+	bfree((void*)r.strings);
+	bfree(strings);
+	bfree(index);
+	bfree(item);
+	return data;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -631,35 +2307,33 @@ obs_data_t *obs_data_create()
 
 obs_data_t *obs_data_create_from_json(const char *json_string)
 {
-	obs_data_t *data = obs_data_create();
+	struct json_reader r = {0};
 
-	json_error_t error;
-	json_t *root = json_loads(json_string, JSON_REJECT_DUPLICATES, &error);
+	if (!json_string)
+		json_string = "";
 
-	if (root) {
-		obs_data_add_json_object_data(data, root);
-		json_decref(root);
-	} else {
-		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_json] "
-		                "Failed reading json string (%d): %s",
-		                error.line, error.text);
-		obs_data_release(data);
-		data = NULL;
-	}
+	r.cur = json_string;
+	r.end = json_string + strlen(json_string);
 
-	return data;
+	return obs_data_read_json(&r, "obs_data_create_from_json");
 }
 
 obs_data_t *obs_data_create_from_json_file(const char *json_file)
 {
-	char *file_data = os_quick_read_utf8_file(json_file);
-	obs_data_t *data = NULL;
+	struct json_reader r = {0};
+	struct serializer s;
+	obs_data_t *data;
 
-	if (file_data) {
-		data = obs_data_create_from_json(file_data);
-		bfree(file_data);
-	}
+	if (!json_file || !file_input_serializer_init(&s, json_file))
+		return NULL;
+
+	r.s   = &s;
+	r.buf = bmalloc(JSON_BUFFER_SIZE);
 
+	data = obs_data_read_json(&r, "obs_data_create_from_json_file");
+
+	bfree(r.buf);
+	file_input_serializer_free(&s);
 	return data;
 }
 
@@ -705,12 +2379,13 @@ static inline void obs_data_destroy(struct obs_data *data)
 
 	while (item) {
 		struct obs_data_item *next = item->next;
+		item_data_disown(item);
 		obs_data_item_release(&item);
 		item = next;
 	}
 
-	/* NOTE: don't use bfree for json text, allocated by json */
-	free(data->json);
+	bfree(data->json);
+	bfree(data->table);
 	bfree(data);
 }
 
@@ -724,49 +2399,154 @@ void obs_data_release(obs_data_t *data)
 
 const char *obs_data_get_json(obs_data_t *data)
 {
+	struct array_output_data out;
+	struct serializer s;
+
 	if (!data) return NULL;
 
-	/* NOTE: don't use libobs bfree for json text */
-	free(data->json);
+	bfree(data->json);
 	data->json = NULL;
 
-	json_t *root = obs_data_to_json(data);
-	data->json = json_dumps(root, JSON_PRESERVE_ORDER | JSON_INDENT(4));
-	json_decref(root);
+	array_output_serializer_init(&s, &out);
+	obs_data_write_json(data, &s);
+	s_w8(&s, 0);
 
+	/* the text is kept by the object, so take over the array */
+	data->json = (char*)out.bytes.array;
 	return data->json;
 }
 
-bool obs_data_save_json(obs_data_t *data, const char *file)
+typedef bool (*write_data_t)(obs_data_t *data, struct serializer *s);
+
+static size_t file_write(void *param, const void *data, size_t size)
+{
+	return fwrite(data, 1, size, param);
+}
+
+/* unlike the file output serializer this also fails when the data couldn't
+ * be flushed to the file, which is where a full disk usually shows up */
+static bool write_file(obs_data_t *data, const char *file, write_data_t write)
+{
+	struct serializer s = {0};
+	FILE *f = os_fopen(file, "wb");
+	bool success;
+
+	if (!f)
+		return false;
+
+	s.data  = f;
+	s.write = file_write;
+
+	success = write(data, &s);
+	if (fflush(f) != 0)
+		success = false;
+	if (fclose(f) != 0)
+		success = false;
+
+	if (!success)
+		blog(LOG_ERROR, "obs-data.c: Failed to write '%s'", file);
+	return success;
+}
+
+static bool save_file(obs_data_t *data, const char *file, write_data_t write)
+{
+	if (!data || !file)
+		return false;
+
+	return write_file(data, file, write);
+}
+
+static bool save_file_safe(obs_data_t *data, const char *file,
+		const char *temp_ext, const char *backup_ext,
+		write_data_t write, const char *func)
 {
-	const char *json = obs_data_get_json(data);
+	struct dstr backup_path = {0};
+	struct dstr temp_path = {0};
+	bool success = false;
 
-	if (json && *json) {
-		return os_quick_write_utf8_file(file, json, strlen(json),
-				false);
+	if (!data || !file)
+		return false;
+
+	if (!temp_ext || !*temp_ext) {
+		blog(LOG_ERROR, "obs-data.c: [%s] "
+		                "invalid temporary extension specified", func);
+		return false;
 	}
 
-	return false;
+	dstr_copy(&temp_path, file);
+	if (*temp_ext != '.')
+		dstr_cat(&temp_path, ".");
+	dstr_cat(&temp_path, temp_ext);
+
+	/* the original is only replaced once the new file is complete */
+	if (!write_file(data, temp_path.array, write)) {
+		os_unlink(temp_path.array);
+		goto cleanup;
+	}
+
+	if (backup_ext && *backup_ext) {
+		dstr_copy(&backup_path, file);
+		if (*backup_ext != '.')
+			dstr_cat(&backup_path, ".");
+		dstr_cat(&backup_path, backup_ext);
+	}
+
+	success = os_safe_replace(file, temp_path.array,
+			backup_path.array) == 0;
+
+cleanup:
+	dstr_free(&backup_path);
+	dstr_free(&temp_path);
+	return success;
+}
+
+bool obs_data_save_json(obs_data_t *data, const char *file)
+{
+	return save_file(data, file, obs_data_write_json);
 }
 
 bool obs_data_save_json_safe(obs_data_t *data, const char *file,
 		const char *temp_ext, const char *backup_ext)
 {
-	const char *json = obs_data_get_json(data);
+	return save_file_safe(data, file, temp_ext, backup_ext,
+			obs_data_write_json, "obs_data_save_json_safe");
+}
 
-	if (json && *json) {
-		return os_quick_write_utf8_file_safe(file, json, strlen(json),
-				false, temp_ext, backup_ext);
-	}
+bool obs_data_save_binary(obs_data_t *data, const char *file)
+{
+	return save_file(data, file, obs_data_write_binary);
+}
 
-	return false;
+bool obs_data_save_binary_safe(obs_data_t *data, const char *file,
+		const char *temp_ext, const char *backup_ext)
+{
+	return save_file_safe(data, file, temp_ext, backup_ext,
+			obs_data_write_binary, "obs_data_save_binary_safe");
 }
 
 static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 {
 	if (!data) return NULL;
 
-	struct obs_data_item *item = data->first_item;
+	struct obs_data_item *item;
+
+	if (data->table) {
+		uint32_t hash = get_name_hash(name);
+		size_t mask = data->table_size - 1;
+		size_t idx = hash & mask;
+
+		while ((item = data->table[idx]) != NULL) {
+			if (item->name_hash == hash &&
+			    strcmp(get_item_name(item), name) == 0)
+				return item;
+
+			idx = (idx + 1) & mask;
+		}
+
+		return NULL;
+	}
+
+	item = data->first_item;
 
 	while (item) {
 		if (strcmp(get_item_name(item), name) == 0)
@@ -785,9 +2565,33 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 {
 	obs_data_item_t *new_item = NULL;
 
+	data_changed(data ? data : (item && *item ? (*item)->parent : NULL));
+
 	if ((!item || (item && !*item)) && data) {
 		new_item = obs_data_item_create(name, ptr, size, type,
 				default_data, autoselect_data);
+		new_item->parent = data;
+		if (!default_data && !autoselect_data)
+			item_data_adopt(new_item);
+
+		/* items are often added in sorted order (applying or loading
+		 * data), so check the end of the list first.  hashed objects
+		 * don't need the order for lookups and are sorted when they're
+		 * iterated */
+		if (data->last_item) {
+			int cmp = strcmp(get_item_name(data->last_item), name);
+
+			if (cmp < 0 || data->table) {
+				if (cmp > 0)
+					data->unsorted = true;
+
+				obs_data_item_link(new_item,
+						&data->last_item->next);
+				data->last_item = new_item;
+				hash_add_item(data, new_item);
+				return;
+			}
+		}
 
 		obs_data_item_t *prev = obs_data_first(data);
 		obs_data_item_t *next = obs_data_first(data);
@@ -798,28 +2602,26 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 				break;
 		}
 
-		new_item->parent = data;
-		if (prev && strcmp(get_item_name(prev), name) < 0) {
-			prev->next     = new_item;
-			new_item->next = next;
-
-		} else {
-			data->first_item = new_item;
-			new_item->next   = prev;
-		}
+		if (prev && strcmp(get_item_name(prev), name) < 0)
+			obs_data_item_link(new_item, &prev->next);
+		else
+			obs_data_item_link(new_item, &data->first_item);
 
-		if (!prev)
-			data->first_item = new_item;
+		if (!new_item->next)
+			data->last_item = new_item;
 
 		obs_data_item_release(&prev);
 		obs_data_item_release(&next);
 
+		hash_add_item(data, new_item);
+
 	} else if (default_data) {
 		obs_data_item_set_default_data(item, ptr, size, type);
 	} else if (autoselect_data) {
 		obs_data_item_set_autoselect_data(item, ptr, size, type);
 	} else {
 		obs_data_item_setdata(item, ptr, size, type);
+		item_data_adopt(*item);
 	}
 }
 
@@ -966,18 +2768,24 @@ static inline void clear_item(struct obs_data_item *item)
 	void *ptr = get_item_data(item);
 	size_t size;
 
+	data_changed(item->parent);
+
 	if (item->data_len) {
 		if (item->type == OBS_DATA_OBJECT) {
 			obs_data_t **obj = item->data_size ? ptr : NULL;
 
-			if (obj && *obj)
+			if (obj && *obj) {
+				data_disown(item->parent, *obj);
 				obs_data_release(*obj);
+			}
 
 		} else if (item->type == OBS_DATA_ARRAY) {
 			obs_data_array_t **array = item->data_size ? ptr : NULL;
 
-			if (array && *array)
+			if (array && *array) {
+				array_disown(item->parent, *array);
 				obs_data_array_release(*array);
+			}
 		}
 
 		size = item->default_len + item->autoselect_size;
@@ -1307,6 +3115,8 @@ size_t obs_data_array_push_back(obs_data_array_t *array, obs_data_t *obj)
 		return 0;
 
 	os_atomic_inc_long(&obj->ref);
+	data_adopt(array->parent, obj);
+	data_changed(array->parent);
 	return da_push_back(array->objects, &obj);
 }
 
@@ -1316,17 +3126,26 @@ void obs_data_array_insert(obs_data_array_t *array, size_t idx, obs_data_t *obj)
 		return;
 
 	os_atomic_inc_long(&obj->ref);
+	data_adopt(array->parent, obj);
+	data_changed(array->parent);
 	da_insert(array->objects, idx, &obj);
 }
 
 void obs_data_array_erase(obs_data_array_t *array, size_t idx)
 {
 	if (array) {
+		data_disown(array->parent, array->objects.array[idx]);
 		obs_data_release(array->objects.array[idx]);
 		da_erase(array->objects, idx);
+		data_changed(array->parent);
 	}
 }
 
+long obs_data_get_changes(obs_data_t *data)
+{
+	return data ? os_atomic_load_long(&data->changes) : 0;
+}
+
 /* ------------------------------------------------------------------------- */
 /* Item status inspection */
 
@@ -1383,6 +3202,8 @@ void obs_data_item_unset_user_value(obs_data_item_t *item)
 	if (!item || !item->data_size)
 		return;
 
+	data_changed(item->parent);
+
 	void *old_non_user_data = get_default_data_ptr(item);
 
 	item_data_release(item);
@@ -1400,6 +3221,8 @@ void obs_data_item_unset_default_value(obs_data_item_t *item)
 	if (!item || !item->default_size)
 		return;
 
+	data_changed(item->parent);
+
 	void *old_autoselect_data = get_autoselect_data_ptr(item);
 
 	item_default_data_release(item);
@@ -1417,6 +3240,8 @@ void obs_data_item_unset_autoselect_value(obs_data_item_t *item)
 	if (!item || !item->autoselect_size)
 		return;
 
+	data_changed(item->parent);
+
 	item_autoselect_data_release(item);
 	item->autoselect_size = 0;
 }
@@ -1429,6 +3254,8 @@ obs_data_item_t *obs_data_first(obs_data_t *data)
 	if (!data)
 		return NULL;
 
+	sort_items(data);
+
 	if (data->first_item)
 		os_atomic_inc_long(&data->first_item->ref);
 	return data->first_item;
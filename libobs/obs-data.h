@@ -74,6 +74,20 @@ EXPORT bool obs_data_save_json(obs_data_t *data, const char *file);
 EXPORT bool obs_data_save_json_safe(obs_data_t *data, const char *file,
 		const char *temp_ext, const char *backup_ext);
 
+/*
+ * Binary container functions
+ * A compact alternative to JSON that stores the same data.
+ * obs_data_create_from_binary_file_item only reads a single top level item
+ * from the file and returns it in a new object, or NULL if it doesn't exist.
+ */
+EXPORT obs_data_t *obs_data_create_from_binary(const void *buf, size_t size);
+EXPORT obs_data_t *obs_data_create_from_binary_file(const char *file);
+EXPORT obs_data_t *obs_data_create_from_binary_file_item(const char *file,
+		const char *name);
+EXPORT bool obs_data_save_binary(obs_data_t *data, const char *file);
+EXPORT bool obs_data_save_binary_safe(obs_data_t *data, const char *file,
+		const char *temp_ext, const char *backup_ext);
+
 EXPORT void obs_data_apply(obs_data_t *target, obs_data_t *apply_data);
 
 EXPORT void obs_data_erase(obs_data_t *data, const char *name);
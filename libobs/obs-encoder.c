@@ -15,9 +15,16 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <inttypes.h>
 #include "obs.h"
 #include "obs-internal.h"
 
+#if BUILD_CAPTIONS
+#include "obs-avc.h"
+#include <caption/caption.h>
+#include <caption/avc.h>
+#endif
+
 #define encoder_active(encoder) \
 	os_atomic_load_bool(&encoder->active)
 #define set_encoder_active(encoder, val) \
@@ -49,6 +56,8 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 	pthread_mutex_init_value(&encoder->init_mutex);
 	pthread_mutex_init_value(&encoder->callbacks_mutex);
 	pthread_mutex_init_value(&encoder->outputs_mutex);
+	pthread_mutex_init_value(&encoder->queue_mutex);
+	pthread_mutex_init_value(&encoder->caption_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -63,6 +72,10 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 		return false;
 	if (pthread_mutex_init(&encoder->outputs_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&encoder->queue_mutex, NULL) != 0)
+		return false;
+	if (pthread_mutex_init(&encoder->caption_mutex, NULL) != 0)
+		return false;
 
 	if (encoder->info.get_defaults)
 		encoder->info.get_defaults(encoder->context.settings);
@@ -75,14 +88,18 @@ static struct obs_encoder *create_encoder(const char *id,
 		obs_data_t *settings, size_t mixer_idx, obs_data_t *hotkey_data)
 {
 	struct obs_encoder *encoder;
-	struct obs_encoder_info *ei = find_encoder(id);
+	struct obs_encoder_info *ei;
 	bool success;
 
+	obs_load_deferred_module(OBS_OBJ_TYPE_ENCODER, id);
+	ei = find_encoder(id);
+
 	if (ei && ei->type != type)
 		return NULL;
 
 	encoder = bzalloc(sizeof(struct obs_encoder));
-	encoder->mixer_idx = mixer_idx;
+	encoder->mixer_idx  = mixer_idx;
+	encoder->queue_size = DEFAULT_ENCODER_QUEUE_SIZE;
 
 	if (!ei) {
 		blog(LOG_ERROR, "Encoder ID '%s' not found", id);
@@ -130,6 +147,10 @@ obs_encoder_t *obs_audio_encoder_create(const char *id, const char *name,
 
 static void receive_video(void *param, struct video_data *frame);
 static void receive_audio(void *param, size_t mix_idx, struct audio_data *data);
+static bool start_encode_thread(struct obs_encoder *encoder);
+static void stop_encode_thread(struct obs_encoder *encoder);
+static void wait_for_audio_encode_pool(struct obs_encoder *encoder);
+static void flush_encoder(struct obs_encoder *encoder);
 
 static inline void get_audio_info(const struct obs_encoder *encoder,
 		struct audio_convert_info *info)
@@ -189,6 +210,11 @@ static void add_connection(struct obs_encoder *encoder)
 		struct video_scale_info info = {0};
 		get_video_info(encoder, &info);
 
+		if (encoder->threaded) {
+			encoder->queue_info = info;
+			start_encode_thread(encoder);
+		}
+
 		video_output_connect(encoder->media, &info, receive_video,
 			encoder);
 	}
@@ -196,16 +222,38 @@ static void add_connection(struct obs_encoder *encoder)
 	set_encoder_active(encoder, true);
 }
 
-static void remove_connection(struct obs_encoder *encoder)
+static void free_captions(struct obs_encoder *encoder)
 {
-	if (encoder->info.type == OBS_ENCODER_AUDIO)
+	pthread_mutex_lock(&encoder->caption_mutex);
+
+	while (encoder->caption_head) {
+		encoder->caption_tail = encoder->caption_head->next;
+		bfree(encoder->caption_head);
+		encoder->caption_head = encoder->caption_tail;
+	}
+
+	encoder->caption_timestamp = 0;
+	os_atomic_set_long(&encoder->caption_count, 0);
+	pthread_mutex_unlock(&encoder->caption_mutex);
+
+	da_free(encoder->caption_sei);
+}
+
+static void remove_connection(struct obs_encoder *encoder, bool flush)
+{
+	if (encoder->info.type == OBS_ENCODER_AUDIO) {
 		audio_output_disconnect(encoder->media, encoder->mixer_idx,
 				receive_audio, encoder);
-	else
+		wait_for_audio_encode_pool(encoder);
+	} else
 		video_output_disconnect(encoder->media, receive_video,
 				encoder);
 
+	stop_encode_thread(encoder);
+	if (flush)
+		flush_encoder(encoder);
 	obs_encoder_shutdown(encoder);
+	free_captions(encoder);
 	set_encoder_active(encoder, false);
 }
 
@@ -214,8 +262,12 @@ static inline void free_audio_buffers(struct obs_encoder *encoder)
 	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
 		circlebuf_free(&encoder->audio_input_buffer[i]);
 		bfree(encoder->audio_output_buffer[i]);
+		bfree(encoder->audio_retired_buffer[i]);
 		encoder->audio_output_buffer[i] = NULL;
+		encoder->audio_retired_buffer[i] = NULL;
 	}
+
+	encoder->audio_in_place = false;
 }
 
 static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
@@ -232,6 +284,8 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		blog(LOG_DEBUG, "encoder '%s' destroyed", encoder->context.name);
 
 		free_audio_buffers(encoder);
+		stop_encode_thread(encoder);
+		free_captions(encoder);
 
 		if (encoder->context.data)
 			encoder->info.destroy(encoder->context.data);
@@ -239,6 +293,8 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		pthread_mutex_destroy(&encoder->init_mutex);
 		pthread_mutex_destroy(&encoder->callbacks_mutex);
 		pthread_mutex_destroy(&encoder->outputs_mutex);
+		pthread_mutex_destroy(&encoder->queue_mutex);
+		pthread_mutex_destroy(&encoder->caption_mutex);
 		obs_context_data_free(&encoder->context);
 		if (encoder->owns_info_id)
 			bfree((void*)encoder->info.id);
@@ -291,12 +347,16 @@ static inline obs_data_t *get_defaults(const struct obs_encoder_info *info)
 
 obs_data_t *obs_encoder_defaults(const char *id)
 {
+	obs_load_deferred_module(OBS_OBJ_TYPE_ENCODER, id);
+
 	const struct obs_encoder_info *info = find_encoder(id);
 	return (info) ? get_defaults(info) : NULL;
 }
 
 obs_properties_t *obs_get_encoder_properties(const char *id)
 {
+	obs_load_deferred_module(OBS_OBJ_TYPE_ENCODER, id);
+
 	const struct obs_encoder_info *ei = find_encoder(id);
 	if (ei && ei->get_properties) {
 		obs_data_t       *defaults = get_defaults(ei);
@@ -497,14 +557,23 @@ static inline bool obs_encoder_stop_internal(obs_encoder_t *encoder,
 
 	idx = get_callback_idx(encoder, new_packet, param);
 	if (idx != DARRAY_INVALID) {
-		da_erase(encoder->callbacks, idx);
-		last = (encoder->callbacks.num == 0);
+		last = (encoder->callbacks.num == 1);
+		if (!last)
+			da_erase(encoder->callbacks, idx);
 	}
 
 	pthread_mutex_unlock(&encoder->callbacks_mutex);
 
 	if (last) {
-		remove_connection(encoder);
+		/* the last callback is only removed once the connection has
+		 * been removed, so that queued frames and packets that are
+		 * still in the encoder's pipeline can be delivered to it */
+		remove_connection(encoder, true);
+
+		pthread_mutex_lock(&encoder->callbacks_mutex);
+		da_free(encoder->callbacks);
+		pthread_mutex_unlock(&encoder->callbacks_mutex);
+
 		encoder->initialized = false;
 
 		if (encoder->destroy_on_stop) {
@@ -721,6 +790,7 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 		struct encoder_callback *cb, struct encoder_packet *packet)
 {
 	struct encoder_packet first_packet;
+	struct encoder_packet sei_packet;
 	DARRAY(uint8_t)       data;
 	uint8_t               *sei;
 	size_t                size;
@@ -740,14 +810,18 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 	da_push_back_array(data, sei, size);
 	da_push_back_array(data, packet->data, packet->size);
 
-	first_packet      = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
+	sei_packet      = *packet;
+	sei_packet.data = data.array;
+	sei_packet.size = data.num;
+
+	/* packets handed to outputs are always referenced instances */
+	obs_encoder_packet_create_instance(&first_packet, &sei_packet);
+	da_free(data);
 
 	cb->new_packet(cb->param, &first_packet);
 	cb->sent_first_packet = true;
 
-	da_free(data);
+	obs_encoder_packet_release(&first_packet);
 }
 
 static inline void send_packet(struct obs_encoder *encoder,
@@ -765,11 +839,251 @@ static void full_stop(struct obs_encoder *encoder)
 	if (encoder) {
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 		da_free(encoder->callbacks);
-		remove_connection(encoder);
+		remove_connection(encoder, false);
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
 	}
 }
 
+static inline void init_packet(struct obs_encoder *encoder,
+		struct encoder_packet *pkt)
+{
+	memset(pkt, 0, sizeof(*pkt));
+	pkt->timebase_num = encoder->timebase_num;
+	pkt->timebase_den = encoder->timebase_den;
+	pkt->encoder      = encoder;
+}
+
+static inline bool encoder_submit(struct obs_encoder *encoder,
+		struct encoder_frame *frame)
+{
+	if (encoder->info.encode_submit)
+		return encoder->info.encode_submit(encoder->context.data,
+				frame);
+
+	/* legacy encoders return at most one packet per frame, which is held
+	 * until it is received */
+	init_packet(encoder, &encoder->legacy_packet);
+	encoder->legacy_received = false;
+
+	return encoder->info.encode(encoder->context.data, frame,
+			&encoder->legacy_packet, &encoder->legacy_received);
+}
+
+static inline bool encoder_receive(struct obs_encoder *encoder,
+		struct encoder_packet *pkt, bool *received)
+{
+	if (encoder->info.encode_receive)
+		return encoder->info.encode_receive(encoder->context.data,
+				pkt, received);
+
+	*received = encoder->legacy_received;
+	if (*received)
+		*pkt = encoder->legacy_packet;
+
+	encoder->legacy_received = false;
+	return true;
+}
+
+#if BUILD_CAPTIONS
+/* copies the packet in to a new reference counted packet like
+ * obs_encoder_packet_create_instance, inserting the caption SEI in front of
+ * the first slice on the way so the payload is still only copied once */
+static void create_captioned_instance(struct encoder_packet *dst,
+		const struct encoder_packet *src, const uint8_t *sei,
+		size_t sei_size)
+{
+	const uint8_t *end = src->data + src->size;
+	const uint8_t *nal = obs_avc_find_startcode(src->data, end);
+	size_t offset = src->size;
+	uint8_t *data;
+	long *p_refs;
+
+	while (nal < end) {
+		const uint8_t *nal_data = nal;
+		int type;
+
+		while (nal_data < end && !*(nal_data++));
+		if (nal_data == end)
+			break;
+
+		type = nal_data[0] & 0x1F;
+		if (type == OBS_NAL_SLICE || type == OBS_NAL_SLICE_IDR) {
+			offset = (size_t)(nal - src->data);
+			break;
+		}
+
+		nal = obs_avc_find_startcode(nal_data, end);
+	}
+
+	p_refs = bmalloc(sizeof(long) + src->size + sei_size);
+	*p_refs = 1;
+	data = (uint8_t*)(p_refs + 1);
+
+	memcpy(data, src->data, offset);
+	memcpy(data + offset, sei, sei_size);
+	memcpy(data + offset + sei_size, src->data + offset,
+			src->size - offset);
+
+	*dst = *src;
+	dst->data = data;
+	dst->size = src->size + sei_size;
+}
+#endif
+
+static void send_received_packet(struct obs_encoder *encoder,
+		struct encoder_packet *pkt)
+{
+	struct encoder_packet shared;
+
+	if (!encoder->first_received) {
+		encoder->offset_usec = packet_dts_usec(pkt);
+		encoder->first_received = true;
+	}
+
+	/* we use system time here to ensure sync with other encoders,
+	 * you do not want to use relative timestamps here */
+	pkt->dts_usec = encoder->start_ts / 1000 +
+		packet_dts_usec(pkt) - encoder->offset_usec;
+	pkt->sys_dts_usec = pkt->dts_usec;
+
+	/* the encoder's data is copied once into a reference counted packet
+	 * that every output shares, outputs only take references to it */
+#if BUILD_CAPTIONS
+	if (encoder->caption_sei.num && pkt->priority <= 1) {
+		create_captioned_instance(&shared, pkt,
+				encoder->caption_sei.array,
+				encoder->caption_sei.num);
+		da_resize(encoder->caption_sei, 0);
+	} else {
+		obs_encoder_packet_create_instance(&shared, pkt);
+	}
+#else
+	obs_encoder_packet_create_instance(&shared, pkt);
+#endif
+
+	pthread_mutex_lock(&encoder->callbacks_mutex);
+
+	for (size_t i = encoder->callbacks.num; i > 0; i--) {
+		struct encoder_callback *cb;
+		cb = encoder->callbacks.array+(i-1);
+		send_packet(encoder, cb, &shared);
+	}
+
+	pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+	obs_encoder_packet_release(&shared);
+}
+
+/* sends out every packet the encoder currently has available */
+static bool receive_packets(struct obs_encoder *encoder)
+{
+	for (;;) {
+		struct encoder_packet pkt;
+		bool received = false;
+
+		init_packet(encoder, &pkt);
+
+		if (!encoder_receive(encoder, &pkt, &received))
+			return false;
+		if (!received)
+			return true;
+
+		send_received_packet(encoder, &pkt);
+	}
+}
+
+static void flush_encoder(struct obs_encoder *encoder)
+{
+	if (!encoder->info.flush || !encoder->context.data)
+		return;
+
+	if (!encoder->info.flush(encoder->context.data) ||
+	    !receive_packets(encoder))
+		blog(LOG_WARNING, "Error flushing encoder '%s'",
+				encoder->context.name);
+}
+
+#if BUILD_CAPTIONS
+#define CAPTION_INTERVAL 2.0
+
+static const uint8_t nal_start[4] = {0, 0, 0, 1};
+
+/* turns the next line of caption text in to SEI once it's due.  encoders
+ * with OBS_ENCODER_CAP_SEI get the SEI messages with the frame and true is
+ * returned (sei is freed after encoding), for other encoders the SEI NAL is
+ * rendered in to caption_sei to be inserted in to the next packet */
+static bool prepare_caption(struct obs_encoder *encoder,
+		struct encoder_frame *frame, sei_t *sei,
+		struct encoder_sei **messages)
+{
+	DARRAY(struct encoder_sei) msgs;
+	struct caption_text *next;
+	double frame_timestamp;
+	caption_frame_t cf;
+	size_t size;
+
+	if (encoder->info.type != OBS_ENCODER_VIDEO || encoder->caption_sei.num)
+		return false;
+
+	frame_timestamp = (double)(frame->pts * encoder->timebase_num) /
+		(double)encoder->timebase_den;
+
+	pthread_mutex_lock(&encoder->caption_mutex);
+
+	/* TODO if encoder->caption_timestamp is more than 5 seconds old,
+	 * send empty frame */
+	if (!encoder->caption_head ||
+	    encoder->caption_timestamp > frame_timestamp) {
+		pthread_mutex_unlock(&encoder->caption_mutex);
+		return false;
+	}
+
+	blog(LOG_INFO, "Sending caption: %f \"%s\"", frame_timestamp,
+			&encoder->caption_head->text[0]);
+
+	caption_frame_init(&cf);
+	caption_frame_from_text(&cf, &encoder->caption_head->text[0]);
+
+	next = encoder->caption_head->next;
+	bfree(encoder->caption_head);
+	encoder->caption_head = next;
+	os_atomic_dec_long(&encoder->caption_count);
+	encoder->caption_timestamp = frame_timestamp + CAPTION_INTERVAL;
+
+	pthread_mutex_unlock(&encoder->caption_mutex);
+
+	sei_init(sei);
+	sei_from_caption_frame(sei, &cf);
+
+	if ((encoder->info.caps & OBS_ENCODER_CAP_SEI) != 0) {
+		da_init(msgs);
+
+		for (sei_message_t *msg = sei_message_head(sei); msg;
+				msg = sei_message_next(msg)) {
+			struct encoder_sei *message = da_push_back_new(msgs);
+			message->type = (int)sei_message_type(msg);
+			message->data = sei_message_data(msg);
+			message->size = sei_message_size(msg);
+		}
+
+		frame->sei     = msgs.array;
+		frame->num_sei = msgs.num;
+		*messages      = msgs.array;
+		return true;
+	}
+
+	size = sei_render_size(sei);
+	da_resize(encoder->caption_sei, sizeof(nal_start) + size);
+	memcpy(encoder->caption_sei.array, nal_start, sizeof(nal_start));
+
+	size = sei_render(sei, encoder->caption_sei.array + sizeof(nal_start));
+	da_resize(encoder->caption_sei, sizeof(nal_start) + size);
+
+	sei_free(sei);
+	return false;
+}
+#endif
+
 static const char *do_encode_name = "do_encode";
 static inline void do_encode(struct obs_encoder *encoder,
 		struct encoder_frame *frame)
@@ -780,52 +1094,334 @@ static inline void do_encode(struct obs_encoder *encoder,
 			profile_store_name(obs_get_profiler_name_store(),
 					"encode(%s)", encoder->context.name);
 
-	struct encoder_packet pkt = {0};
-	bool received = false;
 	bool success;
 
-	pkt.timebase_num = encoder->timebase_num;
-	pkt.timebase_den = encoder->timebase_den;
-	pkt.encoder = encoder;
+#if BUILD_CAPTIONS
+	struct encoder_sei *sei_messages = NULL;
+	sei_t sei;
+
+	bool has_sei = os_atomic_load_long(&encoder->caption_count) &&
+		prepare_caption(encoder, frame, &sei, &sei_messages);
+#endif
 
 	profile_start(encoder->profile_encoder_encode_name);
-	success = encoder->info.encode(encoder->context.data, frame, &pkt,
-			&received);
+	success = encoder_submit(encoder, frame);
 	profile_end(encoder->profile_encoder_encode_name);
+
+#if BUILD_CAPTIONS
+	if (has_sei) {
+		frame->sei     = NULL;
+		frame->num_sei = 0;
+		bfree(sei_messages);
+		sei_free(&sei);
+	}
+#endif
+
+	if (success)
+		success = receive_packets(encoder);
+
 	if (!success) {
+		/* make sure the video thread doesn't keep waiting for a queue
+		 * that is no longer going to be processed */
+		if (encoder->encode_thread_active)
+			os_atomic_set_bool(&encoder->encode_thread_stop, true);
+
 		full_stop(encoder);
 		blog(LOG_ERROR, "Error encoding with encoder '%s'",
 				encoder->context.name);
-		goto error;
 	}
 
-	if (received) {
-		if (!encoder->first_received) {
-			encoder->offset_usec = packet_dts_usec(&pkt);
-			encoder->first_received = true;
+	profile_end(do_encode_name);
+}
+
+/* ------------------------------------------------------------------------- */
+/* threaded video encoding */
+
+/* the time a frame spent in the queue is recorded under the number of frames
+ * that were queued when it was taken out, so the profiler shows how deep the
+ * queue gets as well as how long frames wait */
+static const char *queue_wait_names[MAX_ENCODER_QUEUE_SIZE] = {
+	"queue_wait(1 queued)",
+	"queue_wait(2 queued)",
+	"queue_wait(3 queued)",
+	"queue_wait(4 queued)",
+	"queue_wait(5 queued)",
+	"queue_wait(6 queued)",
+	"queue_wait(7 queued)",
+	"queue_wait(8 queued)",
+};
+
+static const char *encode_latency_name = "encode_latency";
+
+static void *encode_thread(void *data)
+{
+	struct obs_encoder *encoder = data;
+
+	os_set_thread_name("obs-encoder: encode thread");
+
+	while (os_sem_wait(encoder->encode_sem) == 0) {
+		struct encoder_queued_frame *queued = NULL;
+		struct encoder_frame enc_frame;
+		size_t queued_frames;
+		uint64_t latency;
+
+		/* the encoder has been shut down after an encoding error */
+		if (!encoder->context.data)
+			break;
+
+		pthread_mutex_lock(&encoder->queue_mutex);
+		queued_frames = encoder->queue_num;
+		if (queued_frames)
+			queued = &encoder->queue[encoder->queue_first];
+		pthread_mutex_unlock(&encoder->queue_mutex);
+
+		/* on stop, remaining frames are encoded before exiting */
+		if (!queued) {
+			if (os_atomic_load_bool(&encoder->encode_thread_stop))
+				break;
+			continue;
 		}
 
-		/* we use system time here to ensure sync with other encoders,
-		 * you do not want to use relative timestamps here */
-		pkt.dts_usec = encoder->start_ts / 1000 +
-			packet_dts_usec(&pkt) - encoder->offset_usec;
-		pkt.sys_dts_usec = pkt.dts_usec;
+		memset(&enc_frame, 0, sizeof(enc_frame));
 
-		pthread_mutex_lock(&encoder->callbacks_mutex);
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			enc_frame.data[i]     = queued->frame.data[i];
+			enc_frame.linesize[i] = queued->frame.linesize[i];
+		}
+
+		enc_frame.frames = 1;
+		enc_frame.pts    = queued->pts;
+
+		profile_start(encoder->profile_encode_thread_name);
+
+		profile_record_time(queue_wait_names[queued_frames - 1],
+				os_gettime_ns() - queued->queued_ts);
+		do_encode(encoder, &enc_frame);
+
+		latency = os_gettime_ns() - queued->queued_ts;
+		profile_record_time(encode_latency_name, latency);
+
+		profile_end(encoder->profile_encode_thread_name);
+		profile_reenable_thread();
+
+		pthread_mutex_lock(&encoder->queue_mutex);
+
+		if (++encoder->queue_first == encoder->queue_size)
+			encoder->queue_first = 0;
+		encoder->queue_num--;
+
+		encoder->queue_stats.encoded++;
+		encoder->queue_stats.total_latency += latency;
+		if (latency > encoder->queue_stats.max_latency)
+			encoder->queue_stats.max_latency = latency;
+
+		pthread_mutex_unlock(&encoder->queue_mutex);
+
+		os_event_signal(encoder->queue_event);
+	}
+
+	return NULL;
+}
+
+static void free_encode_queue(struct obs_encoder *encoder)
+{
+	for (size_t i = 0; i < MAX_ENCODER_QUEUE_SIZE; i++)
+		video_frame_free(&encoder->queue[i].frame);
+
+	os_sem_destroy(encoder->encode_sem);
+	os_event_destroy(encoder->queue_event);
+	encoder->encode_sem  = NULL;
+	encoder->queue_event = NULL;
+	encoder->queue_first = 0;
+	encoder->queue_num   = 0;
+}
+
+static bool start_encode_thread(struct obs_encoder *encoder)
+{
+	/* joins the thread if it stopped itself after an encoding error */
+	stop_encode_thread(encoder);
+
+	memset(&encoder->queue_stats, 0, sizeof(encoder->queue_stats));
+	encoder->encode_thread_stop = false;
+
+	if (!encoder->profile_encode_thread_name)
+		encoder->profile_encode_thread_name =
+			profile_store_name(obs_get_profiler_name_store(),
+					"encode_thread(%s)",
+					encoder->context.name);
+
+	if (os_sem_init(&encoder->encode_sem, 0) != 0)
+		goto fail;
+	if (os_event_init(&encoder->queue_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	for (size_t i = 0; i < encoder->queue_size; i++)
+		video_frame_init(&encoder->queue[i].frame,
+				encoder->queue_info.format,
+				encoder->queue_info.width,
+				encoder->queue_info.height);
+
+	if (pthread_create(&encoder->encode_thread, NULL, encode_thread,
+				encoder) != 0)
+		goto fail;
+
+	encoder->encode_thread_active = true;
+	return true;
+
+fail:
+	blog(LOG_WARNING, "encoder '%s': Failed to create encoder thread, "
+	                  "encoding on the video thread instead",
+	                  encoder->context.name);
+	free_encode_queue(encoder);
+	return false;
+}
+
+static void log_queue_stats(struct obs_encoder *encoder)
+{
+	struct obs_encoder_queue_stats *stats = &encoder->queue_stats;
+	double avg_latency = 0.0;
+
+	if (!stats->encoded && !stats->dropped)
+		return;
+
+	if (stats->encoded)
+		avg_latency = (double)stats->total_latency /
+			(double)stats->encoded / 1000000.0;
+
+	blog(LOG_INFO, "encoder '%s': %"PRIu32" frames encoded on the encoder "
+	               "thread, %"PRIu32" dropped, latency %.2f ms average, "
+	               "%.2f ms max, queued frames %"PRIu32" max",
+	               encoder->context.name,
+	               stats->encoded, stats->dropped, avg_latency,
+	               (double)stats->max_latency / 1000000.0,
+	               stats->max_queued);
+}
+
+static void stop_encode_thread(struct obs_encoder *encoder)
+{
+	if (!encoder->encode_thread_active)
+		return;
+
+	os_atomic_set_bool(&encoder->encode_thread_stop, true);
+	os_sem_post(encoder->encode_sem);
+
+	/* after an encoding error the encoder is stopped from its own thread,
+	 * the thread is joined on the next start or when destroyed */
+	if (pthread_equal(pthread_self(), encoder->encode_thread))
+		return;
+
+	pthread_join(encoder->encode_thread, NULL);
+	encoder->encode_thread_active = false;
+
+	log_queue_stats(encoder);
+	free_encode_queue(encoder);
+}
+
+static bool queue_video_frame(struct obs_encoder *encoder,
+		struct video_data *frame, int64_t pts)
+{
+	struct encoder_queued_frame *queued;
+	struct video_frame src;
+	size_t idx;
 
-		for (size_t i = encoder->callbacks.num; i > 0; i--) {
-			struct encoder_callback *cb;
-			cb = encoder->callbacks.array+(i-1);
-			send_packet(encoder, cb, &pkt);
+	pthread_mutex_lock(&encoder->queue_mutex);
+
+	while (encoder->queue_num == encoder->queue_size) {
+		if (encoder->queue_policy == OBS_ENCODER_QUEUE_DROP ||
+		    os_atomic_load_bool(&encoder->encode_thread_stop)) {
+			encoder->queue_stats.dropped++;
+			pthread_mutex_unlock(&encoder->queue_mutex);
+			return false;
 		}
 
-		pthread_mutex_unlock(&encoder->callbacks_mutex);
+		pthread_mutex_unlock(&encoder->queue_mutex);
+		os_event_timedwait(encoder->queue_event, 10);
+		pthread_mutex_lock(&encoder->queue_mutex);
 	}
 
-error:
-	profile_end(do_encode_name);
+	idx = (encoder->queue_first + encoder->queue_num) % encoder->queue_size;
+	queued = &encoder->queue[idx];
+
+	pthread_mutex_unlock(&encoder->queue_mutex);
+
+	/* the slot isn't visible to the encoder thread until queue_num is
+	 * incremented, so it can be filled without holding the mutex */
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		src.data[i]     = frame->data[i];
+		src.linesize[i] = frame->linesize[i];
+	}
+
+	video_frame_copy(&queued->frame, &src, encoder->queue_info.format,
+			encoder->queue_info.height);
+	queued->pts       = pts;
+	queued->queued_ts = os_gettime_ns();
+
+	pthread_mutex_lock(&encoder->queue_mutex);
+	if (++encoder->queue_num > encoder->queue_stats.max_queued)
+		encoder->queue_stats.max_queued =
+			(uint32_t)encoder->queue_num;
+	pthread_mutex_unlock(&encoder->queue_mutex);
+
+	os_sem_post(encoder->encode_sem);
+	return true;
 }
 
+void obs_encoder_set_threaded(obs_encoder_t *encoder, bool threaded,
+		size_t max_frames, enum obs_encoder_queue_policy policy)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_set_threaded"))
+		return;
+
+	if (encoder->info.type != OBS_ENCODER_VIDEO) {
+		blog(LOG_WARNING, "obs_encoder_set_threaded: "
+		                  "encoder '%s' is not a video encoder",
+		                  obs_encoder_get_name(encoder));
+		return;
+	}
+	if (encoder_active(encoder)) {
+		blog(LOG_WARNING, "encoder '%s': Cannot change threading "
+		                  "while the encoder is active",
+		                  obs_encoder_get_name(encoder));
+		return;
+	}
+
+	if (!max_frames)
+		max_frames = DEFAULT_ENCODER_QUEUE_SIZE;
+	if (max_frames > MAX_ENCODER_QUEUE_SIZE)
+		max_frames = MAX_ENCODER_QUEUE_SIZE;
+
+	encoder->threaded     = threaded;
+	encoder->queue_size   = max_frames;
+	encoder->queue_policy = policy;
+}
+
+bool obs_encoder_threaded(const obs_encoder_t *encoder)
+{
+	return obs_encoder_valid(encoder, "obs_encoder_threaded") ?
+		encoder->threaded : false;
+}
+
+bool obs_encoder_get_queue_stats(const obs_encoder_t *encoder,
+		struct obs_encoder_queue_stats *stats)
+{
+	struct obs_encoder *enc = (struct obs_encoder*)encoder;
+
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_queue_stats"))
+		return false;
+	if (!obs_ptr_valid(stats, "obs_encoder_get_queue_stats"))
+		return false;
+	if (!encoder->threaded)
+		return false;
+
+	pthread_mutex_lock(&enc->queue_mutex);
+	*stats = encoder->queue_stats;
+	stats->queued = (uint32_t)encoder->queue_num;
+	pthread_mutex_unlock(&enc->queue_mutex);
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static const char *receive_video_name = "receive_video";
 static void receive_video(void *param, struct video_data *frame)
 {
@@ -855,7 +1451,11 @@ static void receive_video(void *param, struct video_data *frame)
 	enc_frame.frames = 1;
 	enc_frame.pts    = encoder->cur_pts;
 
-	do_encode(encoder, &enc_frame);
+	/* dropped frames still advance the pts to keep the timing intact */
+	if (encoder->encode_thread_active)
+		queue_video_frame(encoder, frame, encoder->cur_pts);
+	else
+		do_encode(encoder, &enc_frame);
 
 	encoder->cur_pts += encoder->timebase_num;
 
@@ -869,16 +1469,56 @@ static void clear_audio(struct obs_encoder *encoder)
 		circlebuf_free(&encoder->audio_input_buffer[i]);
 }
 
+/* number of frames the input buffers are initially sized for.  keeping the
+ * capacity a whole number of frames means frames rarely straddle the end of
+ * the buffer, so they can usually be encoded in place */
+#define AUDIO_BUFFER_FRAMES 4
+
+/* the front frame may currently be encoded in place (audio_in_place), so the
+ * buffer must not be reallocated under it.  instead, the data is moved to a
+ * new buffer and the old one is kept alive until the frame is released */
+static void grow_audio_buffer(struct obs_encoder *encoder, size_t plane,
+		size_t size)
+{
+	struct circlebuf *buf = &encoder->audio_input_buffer[plane];
+	size_t capacity = buf->capacity * 2;
+	uint8_t *data;
+
+	if (capacity < buf->size + size)
+		capacity = buf->size + size;
+
+	data = bmalloc(capacity);
+	circlebuf_peek_front(buf, data, buf->size);
+
+	encoder->audio_retired_buffer[plane] = buf->data;
+	buf->data      = data;
+	buf->start_pos = 0;
+	buf->end_pos   = buf->size;
+	buf->capacity  = capacity;
+}
+
 static inline void push_back_audio(struct obs_encoder *encoder,
 		struct audio_data *data, size_t size, size_t offset_size)
 {
+	if (size <= offset_size)
+		return;
+
 	size -= offset_size;
 
 	/* push in to the circular buffer */
-	if (size)
-		for (size_t i = 0; i < encoder->planes; i++)
-			circlebuf_push_back(&encoder->audio_input_buffer[i],
-					data->data[i] + offset_size, size);
+	for (size_t i = 0; i < encoder->planes; i++) {
+		struct circlebuf *buf = &encoder->audio_input_buffer[i];
+
+		if (!buf->capacity)
+			circlebuf_reserve(buf, encoder->framesize_bytes *
+					AUDIO_BUFFER_FRAMES);
+		else if (encoder->audio_in_place &&
+		         !encoder->audio_retired_buffer[i] &&
+		         buf->size + size > buf->capacity)
+			grow_audio_buffer(encoder, i, size);
+
+		circlebuf_push_back(buf, data->data[i] + offset_size, size);
+	}
 }
 
 static inline size_t calc_offset_size(struct obs_encoder *encoder,
@@ -893,23 +1533,20 @@ static inline size_t calc_offset_size(struct obs_encoder *encoder,
 static void start_from_buffer(struct obs_encoder *encoder, uint64_t v_start_ts)
 {
 	size_t size = encoder->audio_input_buffer[0].size;
-	struct audio_data audio = {0};
 	size_t offset_size = 0;
 
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-		audio.data[i] = encoder->audio_input_buffer[i].data;
-		memset(&encoder->audio_input_buffer[i], 0,
-				sizeof(struct circlebuf));
-	}
-
 	if (encoder->first_raw_ts < v_start_ts)
 		offset_size = calc_offset_size(encoder, v_start_ts,
 				encoder->first_raw_ts);
 
-	push_back_audio(encoder, &audio, size, offset_size);
-
-	for (size_t i = 0; i < MAX_AV_PLANES; i++)
-		bfree(audio.data[i]);
+	/* drop the audio from before the video start in place */
+	if (offset_size >= size) {
+		clear_audio(encoder);
+	} else if (offset_size) {
+		for (size_t i = 0; i < encoder->planes; i++)
+			circlebuf_pop_front(&encoder->audio_input_buffer[i],
+					NULL, offset_size);
+	}
 }
 
 static const char *buffer_audio_name = "buffer_audio";
@@ -965,35 +1602,276 @@ fail:
 	return success;
 }
 
-static void send_audio_data(struct obs_encoder *encoder)
+static inline bool audio_frame_ready(const struct obs_encoder *encoder)
+{
+	return encoder->context.data &&
+		encoder->audio_input_buffer[0].size >= encoder->framesize_bytes;
+}
+
+static inline bool audio_frame_contiguous(const struct obs_encoder *encoder)
+{
+	for (size_t i = 0; i < encoder->planes; i++) {
+		const struct circlebuf *buf = &encoder->audio_input_buffer[i];
+		if (buf->start_pos + encoder->framesize_bytes > buf->capacity)
+			return false;
+	}
+
+	return true;
+}
+
+/* pops the frame that was encoded in place.  the buffers may have been
+ * reset in the meantime if the encoder failed */
+static void release_audio_frame(struct obs_encoder *encoder)
+{
+	pthread_mutex_lock(&encoder->queue_mutex);
+
+	if (encoder->audio_in_place) {
+		for (size_t i = 0; i < encoder->planes; i++) {
+			circlebuf_pop_front(&encoder->audio_input_buffer[i],
+					NULL, encoder->framesize_bytes);
+
+			bfree(encoder->audio_retired_buffer[i]);
+			encoder->audio_retired_buffer[i] = NULL;
+		}
+
+		encoder->audio_in_place = false;
+	}
+
+	pthread_mutex_unlock(&encoder->queue_mutex);
+}
+
+/* encodes the next complete frame of buffered audio, if there is one.  the
+ * pts is only advanced here, in frame order, so it stays sample-exact no
+ * matter which thread ends up encoding the frame.
+ *
+ * if the frame is contiguous in every plane it is encoded straight out of
+ * the input buffers and only popped afterwards, otherwise it wraps around
+ * and is copied out in to audio_output_buffer first */
+static bool send_audio_data(struct obs_encoder *encoder)
 {
 	struct encoder_frame  enc_frame;
+	bool                  ready;
+	bool                  in_place = false;
 
 	memset(&enc_frame, 0, sizeof(struct encoder_frame));
 
-	for (size_t i = 0; i < encoder->planes; i++) {
-		circlebuf_pop_front(&encoder->audio_input_buffer[i],
-				encoder->audio_output_buffer[i],
-				encoder->framesize_bytes);
+	pthread_mutex_lock(&encoder->queue_mutex);
+
+	ready = audio_frame_ready(encoder);
+	if (ready) {
+		in_place = audio_frame_contiguous(encoder);
+
+		for (size_t i = 0; i < encoder->planes; i++) {
+			struct circlebuf *buf = &encoder->audio_input_buffer[i];
 
-		enc_frame.data[i]     = encoder->audio_output_buffer[i];
-		enc_frame.linesize[i] = (uint32_t)encoder->framesize_bytes;
+			if (in_place) {
+				enc_frame.data[i] = circlebuf_data(buf, 0);
+			} else {
+				circlebuf_pop_front(buf,
+						encoder->audio_output_buffer[i],
+						encoder->framesize_bytes);
+				enc_frame.data[i] =
+					encoder->audio_output_buffer[i];
+			}
+
+			enc_frame.linesize[i] =
+				(uint32_t)encoder->framesize_bytes;
+		}
+
+		encoder->audio_in_place = in_place;
 	}
 
+	pthread_mutex_unlock(&encoder->queue_mutex);
+
+	if (!ready)
+		return false;
+
 	enc_frame.frames = (uint32_t)encoder->framesize;
 	enc_frame.pts    = encoder->cur_pts;
 
 	do_encode(encoder, &enc_frame);
 
 	encoder->cur_pts += encoder->framesize;
+
+	if (in_place)
+		release_audio_frame(encoder);
+
+	return true;
 }
 
+/* ------------------------------------------------------------------------- */
+/* audio encode pool */
+
+#define MAX_AUDIO_ENCODE_THREADS 4
+
+static void encode_scheduled_audio(struct obs_audio_encode_pool *pool,
+		struct obs_encoder *encoder)
+{
+	bool ready;
+
+	if (!encoder->profile_encode_thread_name)
+		encoder->profile_encode_thread_name =
+			profile_store_name(obs_get_profiler_name_store(),
+					"encode_thread(%s)",
+					encoder->context.name);
+
+	for (;;) {
+		profile_start(encoder->profile_encode_thread_name);
+		while (send_audio_data(encoder));
+		profile_end(encoder->profile_encode_thread_name);
+		profile_reenable_thread();
+
+		/* audio that was buffered while encoding is picked up here
+		 * rather than rescheduling, the encoder can no longer be
+		 * touched once it is unscheduled as it may be stopped */
+		pthread_mutex_lock(&pool->mutex);
+		pthread_mutex_lock(&encoder->queue_mutex);
+		ready = audio_frame_ready(encoder);
+		pthread_mutex_unlock(&encoder->queue_mutex);
+
+		if (!ready)
+			encoder->pool_scheduled = false;
+		pthread_mutex_unlock(&pool->mutex);
+
+		if (!ready)
+			break;
+	}
+
+	os_event_signal(pool->idle_event);
+}
+
+static void *audio_encode_thread(void *data)
+{
+	struct obs_audio_encode_pool *pool = data;
+
+	os_set_thread_name("libobs: audio encode thread");
+
+	while (os_sem_wait(pool->sem) == 0) {
+		struct obs_encoder *encoder = NULL;
+
+		if (os_atomic_load_bool(&pool->stop))
+			break;
+
+		pthread_mutex_lock(&pool->mutex);
+		if (pool->ready.size) {
+			circlebuf_pop_front(&pool->ready, &encoder,
+					sizeof(encoder));
+			encoder->pool_thread = pthread_self();
+		}
+		pthread_mutex_unlock(&pool->mutex);
+
+		if (encoder)
+			encode_scheduled_audio(pool, encoder);
+	}
+
+	return NULL;
+}
+
+static void schedule_audio_encode(struct obs_encoder *encoder)
+{
+	struct obs_audio_encode_pool *pool = &obs->audio_encode_pool;
+	bool schedule;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	schedule = !encoder->pool_scheduled;
+	if (schedule) {
+		encoder->pool_scheduled = true;
+		circlebuf_push_back(&pool->ready, &encoder, sizeof(encoder));
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (schedule)
+		os_sem_post(pool->sem);
+}
+
+/* waits until the pool has encoded the rest of the encoder's buffered audio,
+ * unless called from the pool thread that is encoding it (on error) */
+static void wait_for_audio_encode_pool(struct obs_encoder *encoder)
+{
+	struct obs_audio_encode_pool *pool = &obs->audio_encode_pool;
+
+	if (!pool->active)
+		return;
+
+	for (;;) {
+		bool busy;
+
+		pthread_mutex_lock(&pool->mutex);
+		busy = encoder->pool_scheduled &&
+			!pthread_equal(encoder->pool_thread, pthread_self());
+		pthread_mutex_unlock(&pool->mutex);
+
+		if (!busy)
+			break;
+
+		os_event_timedwait(pool->idle_event, 10);
+	}
+}
+
+bool obs_init_audio_encode_pool(void)
+{
+	struct obs_audio_encode_pool *pool = &obs->audio_encode_pool;
+	int threads = os_get_physical_cores();
+
+	if (threads < 1)
+		threads = 1;
+	if (threads > MAX_AUDIO_ENCODE_THREADS)
+		threads = MAX_AUDIO_ENCODE_THREADS;
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&pool->sem, 0) != 0)
+		return false;
+	if (os_event_init(&pool->idle_event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+
+	for (int i = 0; i < threads; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, audio_encode_thread,
+					pool) != 0)
+			break;
+
+		da_push_back(pool->threads, &thread);
+	}
+
+	pool->active = pool->threads.num > 0;
+	return pool->active;
+}
+
+void obs_free_audio_encode_pool(void)
+{
+	struct obs_audio_encode_pool *pool = &obs->audio_encode_pool;
+
+	os_atomic_set_bool(&pool->stop, true);
+
+	for (size_t i = 0; i < pool->threads.num; i++)
+		os_sem_post(pool->sem);
+	for (size_t i = 0; i < pool->threads.num; i++)
+		pthread_join(pool->threads.array[i], NULL);
+
+	da_free(pool->threads);
+	circlebuf_free(&pool->ready);
+	os_event_destroy(pool->idle_event);
+	os_sem_destroy(pool->sem);
+	pthread_mutex_destroy(&pool->mutex);
+
+	memset(pool, 0, sizeof(*pool));
+}
+
+/* ------------------------------------------------------------------------- */
+
 static const char *receive_audio_name = "receive_audio";
 static void receive_audio(void *param, size_t mix_idx, struct audio_data *data)
 {
 	profile_start(receive_audio_name);
 
 	struct obs_encoder *encoder = param;
+	bool ready;
+
+	pthread_mutex_lock(&encoder->queue_mutex);
 
 	if (!encoder->first_received) {
 		encoder->first_raw_ts = data->timestamp;
@@ -1001,11 +1879,19 @@ static void receive_audio(void *param, size_t mix_idx, struct audio_data *data)
 		clear_audio(encoder);
 	}
 
-	if (!buffer_audio(encoder, data))
+	ready = buffer_audio(encoder, data) && audio_frame_ready(encoder);
+
+	pthread_mutex_unlock(&encoder->queue_mutex);
+
+	if (!ready)
 		goto end;
 
-	while (encoder->audio_input_buffer[0].size >= encoder->framesize_bytes)
-		send_audio_data(encoder);
+	/* the audio thread only buffers, the frames are encoded on the pool
+	 * unless it couldn't be created */
+	if (obs->audio_encode_pool.active)
+		schedule_audio_encode(encoder);
+	else
+		while (send_audio_data(encoder));
 
 	UNUSED_PARAMETER(mix_idx);
 
@@ -1194,3 +2080,63 @@ uint32_t obs_get_encoder_caps(const char *encoder_id)
 	struct obs_encoder_info *info = find_encoder(encoder_id);
 	return info ? info->caps : 0;
 }
+
+#if BUILD_CAPTIONS
+static struct caption_text *caption_text_new(const char *text, size_t bytes,
+		struct caption_text *tail, struct caption_text **head)
+{
+	struct caption_text *next = bzalloc(sizeof(struct caption_text));
+	snprintf(&next->text[0], CAPTION_LINE_BYTES + 1, "%.*s", (int)bytes,
+			text);
+
+	if (!*head) {
+		*head = next;
+	} else {
+		tail->next = next;
+	}
+
+	return next;
+}
+
+void obs_encoder_add_caption_text(obs_encoder_t *encoder, const char *text)
+{
+	/* captions are sent as h264 SEI */
+	if (encoder->info.type != OBS_ENCODER_VIDEO ||
+	    !encoder->info.codec || strcmp(encoder->info.codec, "h264") != 0)
+		return;
+
+	// split text into 32 character strings
+	int size = (int)strlen(text);
+	int r;
+	size_t char_count;
+	size_t line_length = 0;
+	size_t trimmed_length = 0;
+
+	blog(LOG_DEBUG, "Caption text: %s", text);
+
+	pthread_mutex_lock(&encoder->caption_mutex);
+
+	for (r = 0 ; 0 < size && CAPTION_LINE_CHARS > r; ++r) {
+		line_length = utf8_line_length(text);
+		trimmed_length = utf8_trimmed_length(text, line_length);
+		char_count = utf8_char_count(text, trimmed_length);
+
+		if (SCREEN_COLS < char_count) {
+			char_count = utf8_wrap_length(text, CAPTION_LINE_CHARS);
+			line_length = utf8_string_length(text, char_count + 1);
+		}
+
+		encoder->caption_tail = caption_text_new(
+				text,
+				line_length,
+				encoder->caption_tail,
+				&encoder->caption_head);
+		os_atomic_inc_long(&encoder->caption_count);
+
+		text += line_length;
+		size -= (int)line_length;
+	}
+
+	pthread_mutex_unlock(&encoder->caption_mutex);
+}
+#endif
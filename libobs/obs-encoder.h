@@ -30,6 +30,8 @@ extern "C" {
 #endif
 
 #define OBS_ENCODER_CAP_DEPRECATED             (1<<0)
+#define OBS_ENCODER_CAP_DYN_BITRATE            (1<<1)
+#define OBS_ENCODER_CAP_SEI                    (1<<2)
 
 /** Specifies the encoder type */
 enum obs_encoder_type {
@@ -84,6 +86,13 @@ struct encoder_packet {
 	obs_encoder_t         *encoder;
 };
 
+/** SEI message to be inserted in to an encoded frame */
+struct encoder_sei {
+	int                   type;         /**< SEI payload type */
+	const uint8_t         *data;        /**< Payload data */
+	size_t                size;         /**< Payload size */
+};
+
 /** Encoder input frame */
 struct encoder_frame {
 	/** Data for the frame/audio */
@@ -97,6 +106,49 @@ struct encoder_frame {
 
 	/** Presentation timestamp */
 	int64_t               pts;
+
+	/**
+	 * SEI messages to insert in to this frame (h264 video, such as
+	 * captions).  Only set for encoders with OBS_ENCODER_CAP_SEI, the
+	 * data is only valid until the encode call returns.
+	 */
+	const struct encoder_sei *sei;
+
+	/** Number of SEI messages */
+	size_t                num_sei;
+};
+
+/** Policy applied when the frame queue of a threaded video encoder is full */
+enum obs_encoder_queue_policy {
+	/**
+	 * Wait for the encoder to catch up.  The video output falls behind
+	 * and skips frames, the same as when encoding on the video thread.
+	 */
+	OBS_ENCODER_QUEUE_BLOCK,
+
+	/** Drop the new frame (counted as a dropped frame of the output) */
+	OBS_ENCODER_QUEUE_DROP,
+};
+
+/** Frame queue statistics of a threaded video encoder */
+struct obs_encoder_queue_stats {
+	/** Frames currently waiting to be encoded */
+	uint32_t              queued;
+
+	/** Highest number of frames that were waiting at once */
+	uint32_t              max_queued;
+
+	/** Frames that have been encoded on the encoder thread */
+	uint32_t              encoded;
+
+	/** Frames dropped because the queue was full */
+	uint32_t              dropped;
+
+	/** Total time from queueing a frame to finishing encoding it (ns) */
+	uint64_t              total_latency;
+
+	/** Highest time from queueing a frame to finishing encoding it (ns) */
+	uint64_t              max_latency;
 };
 
 /**
@@ -149,7 +201,8 @@ struct obs_encoder_info {
 
 	/**
 	 * Encodes frame(s), and outputs encoded packets as they become
-	 * available.
+	 * available.  Not required if encode_submit and encode_receive are
+	 * implemented.
 	 *
 	 * @param       data             Data associated with this encoder
 	 *                               context
@@ -234,6 +287,46 @@ struct obs_encoder_info {
 	void (*free_type_data)(void *type_data);
 
 	uint32_t caps;
+
+	/* ----------------------------------------------------------------- */
+	/* Asynchronous encoding (optional, replaces encode) */
+
+	/**
+	 * Submits a frame to an encoder that pipelines frames internally and
+	 * may output any number of packets per frame.  If implemented,
+	 * encode_receive must be implemented as well, and encode is not used.
+	 * After each submitted frame, encode_receive is called until it
+	 * returns no packet.
+	 *
+	 * @param  data   Data associated with this encoder context
+	 * @param  frame  Raw audio/video data to encode
+	 * @return        true if successful, false otherwise
+	 */
+	bool (*encode_submit)(void *data, struct encoder_frame *frame);
+
+	/**
+	 * Receives the next encoded packet, if one is available.  The packet
+	 * data must remain valid until the next call.
+	 *
+	 * @param       data             Data associated with this encoder
+	 *                               context
+	 * @param[out]  packet           Encoder packet output, if any
+	 * @param[out]  received_packet  Set to true if a packet was received,
+	 *                               false otherwise
+	 * @return                       true if successful, false otherwise
+	 */
+	bool (*encode_receive)(void *data, struct encoder_packet *packet,
+			bool *received_packet);
+
+	/**
+	 * Signals that no more frames will be submitted.  Called when the
+	 * encoder is stopped, after which encode_receive is called until it
+	 * returns no packet so that delayed packets are still delivered.
+	 *
+	 * @param  data  Data associated with this encoder context
+	 * @return       true if successful, false otherwise
+	 */
+	bool (*flush)(void *data);
 };
 
 EXPORT void obs_register_encoder_s(const struct obs_encoder_info *info,
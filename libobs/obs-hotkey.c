@@ -90,6 +90,17 @@ static void hotkey_signal(const char *signal, obs_hotkey_t *hotkey)
 	calldata_free(&data);
 }
 
+static void bindings_changed(obs_hotkey_t *hotkey)
+{
+	/* source hotkeys are saved with the source */
+	if (hotkey->registerer_type == OBS_HOTKEY_REGISTERER_SOURCE) {
+		obs_weak_source_t *weak = hotkey->registerer;
+		obs_source_dirty(weak->source);
+	}
+
+	hotkey_signal("hotkey_bindings_changed", hotkey);
+}
+
 static inline void fixup_pointers(void);
 static inline void load_bindings(obs_hotkey_t *hotkey, obs_data_array_t *data);
 
@@ -620,7 +631,7 @@ static inline void load_bindings(obs_hotkey_t *hotkey, obs_data_array_t *data)
 		obs_data_release(item);
 	}
 
-	hotkey_signal("hotkey_bindings_changed", hotkey);
+	bindings_changed(hotkey);
 }
 
 static inline void remove_bindings(obs_hotkey_id id);
@@ -639,7 +650,7 @@ void obs_hotkey_load_bindings(obs_hotkey_id id,
 		for (size_t i = 0; i < num; i++)
 			create_binding(hotkey, combinations[i]);
 
-		hotkey_signal("hotkey_bindings_changed", hotkey);
+		bindings_changed(hotkey);
 	}
 	unlock();
 }
@@ -32,6 +32,7 @@
 
 #include "media-io/audio-resampler.h"
 #include "media-io/video-io.h"
+#include "media-io/video-frame.h"
 #include "media-io/audio-io.h"
 
 #include "obs.h"
@@ -83,6 +84,7 @@ struct obs_module {
 	bool        (*load)(void);
 	void        (*unload)(void);
 	void        (*post_load)(void);
+	void        (*deferred_load)(void);
 	void        (*set_locale)(const char *locale);
 	void        (*free_locale)(void);
 	uint32_t    (*ver)(void);
@@ -91,11 +93,28 @@ struct obs_module {
 	const char *(*description)(void);
 	const char *(*author)(void);
 
+	/* held while deferred_load runs, other threads that need one of the
+	 * module's types wait on it.  recursive, deferred_load may create
+	 * objects of the module's own types */
+	bool            deferred_started;
+	pthread_mutex_t deferred_mutex;
+
 	struct obs_module *next;
 };
 
 extern void free_module(struct obs_module *mod);
 
+/* types registered by modules with an obs_module_deferred_load export */
+struct obs_deferred_type {
+	enum obs_obj_type               type;
+	const char                      *id;
+	struct obs_module               *module;
+};
+
+/* runs the deferred initialization of the module that registered the type,
+ * if it hasn't been run yet */
+extern void obs_load_deferred_module(enum obs_obj_type type, const char *id);
+
 struct obs_module_path {
 	char *bin;
 	char *data;
@@ -220,17 +239,44 @@ struct obs_vframe_info {
 	int count;
 };
 
-struct obs_core_video {
-	graphics_t                      *graphics;
+/* a video output derived from the main rendered frame, scaled and converted
+ * on the GPU and staged/downloaded separately for its own video output */
+struct obs_video_rendition {
+	video_t                         *video;
 	gs_stagesurf_t                  *copy_surfaces[NUM_TEXTURES];
-	gs_texture_t                    *render_textures[NUM_TEXTURES];
 	gs_texture_t                    *output_textures[NUM_TEXTURES];
 	gs_texture_t                    *convert_textures[NUM_TEXTURES];
-	bool                            textures_rendered[NUM_TEXTURES];
 	bool                            textures_output[NUM_TEXTURES];
 	bool                            textures_copied[NUM_TEXTURES];
 	bool                            textures_converted[NUM_TEXTURES];
 	struct circlebuf                vframe_info_buffer;
+	gs_stagesurf_t                  *mapped_surface;
+
+	/* downloaded while in the graphics context, output after leaving it */
+	struct video_data               frame;
+	bool                            frame_ready;
+
+	/* set after the first frame rendered while this rendition existed,
+	 * so that its frames line up with the timestamps it receives */
+	bool                            started;
+
+	bool                            gpu_conversion;
+	const char                      *conversion_tech;
+	uint32_t                        conversion_height;
+	uint32_t                        plane_offsets[3];
+	uint32_t                        plane_sizes[3];
+	uint32_t                        plane_linewidth[3];
+
+	uint32_t                        output_width;
+	uint32_t                        output_height;
+	enum obs_scale_type             scale_type;
+};
+
+struct obs_core_video {
+	graphics_t                      *graphics;
+	gs_texture_t                    *render_textures[NUM_TEXTURES];
+	bool                            textures_rendered[NUM_TEXTURES];
+	struct obs_video_rendition      main_rendition;
 	gs_effect_t                     *default_effect;
 	gs_effect_t                     *default_rect_effect;
 	gs_effect_t                     *opaque_effect;
@@ -241,7 +287,6 @@ struct obs_core_video {
 	gs_effect_t                     *bilinear_lowres_effect;
 	gs_effect_t                     *premultiplied_alpha_effect;
 	gs_samplerstate_t               *point_sampler;
-	gs_stagesurf_t                  *mapped_surface;
 	int                             cur_texture;
 
 	uint64_t                        video_time;
@@ -253,19 +298,22 @@ struct obs_core_video {
 	uint32_t                        lagged_frames;
 	bool                            thread_initialized;
 
-	bool                            gpu_conversion;
-	const char                      *conversion_tech;
-	uint32_t                        conversion_height;
-	uint32_t                        plane_offsets[3];
-	uint32_t                        plane_sizes[3];
-	uint32_t                        plane_linewidth[3];
+	/* copied from the graphics thread once per frame */
+	pthread_mutex_t                 texture_pool_mutex;
+	struct gs_texture_pool_stats    texture_pool_stats;
+
+	/* additional renditions, rendered after the main rendition.  the
+	 * video thread works on a copy of the list taken at the start of each
+	 * frame, and frees removed renditions once that copy no longer refers
+	 * to them */
+	pthread_mutex_t                 renditions_mutex;
+	DARRAY(struct obs_video_rendition*) renditions;
+	DARRAY(struct obs_video_rendition*) removed_renditions;
+	DARRAY(struct obs_video_rendition*) frame_renditions;
 
-	uint32_t                        output_width;
-	uint32_t                        output_height;
 	uint32_t                        base_width;
 	uint32_t                        base_height;
 	float                           color_matrix[16];
-	enum obs_scale_type             scale_type;
 
 	gs_texture_t                    *transparent_texture;
 
@@ -302,6 +350,26 @@ struct obs_core_audio {
 	char                            *monitoring_device_id;
 };
 
+/* threads shared by all audio encoders, so the audio thread only has to mix
+ * and buffer audio while the encoding happens in parallel */
+struct obs_audio_encode_pool {
+	DARRAY(pthread_t)               threads;
+	pthread_mutex_t                 mutex;
+	os_sem_t                        *sem;
+	os_event_t                      *idle_event;
+	struct circlebuf                ready; /* struct obs_encoder * */
+	volatile bool                   stop;
+	bool                            active;
+};
+
+/* hash index of the public contexts of one type by name */
+struct obs_context_index {
+	struct obs_context_data         **buckets;
+	size_t                          num_buckets;
+	size_t                          count;
+	pthread_rwlock_t                rwlock;
+};
+
 /* user sources, output channels, and displays */
 struct obs_core_data {
 	struct obs_source               *first_source;
@@ -317,6 +385,10 @@ struct obs_core_data {
 	pthread_mutex_t                 encoders_mutex;
 	pthread_mutex_t                 services_mutex;
 	pthread_mutex_t                 audio_sources_mutex;
+	struct obs_context_index        source_index;
+	struct obs_context_index        output_index;
+	struct obs_context_index        encoder_index;
+	struct obs_context_index        service_index;
 	pthread_mutex_t                 draw_callbacks_mutex;
 	DARRAY(struct draw_callback)    draw_callbacks;
 
@@ -366,6 +438,11 @@ struct obs_core {
 	struct obs_module               *first_module;
 	DARRAY(struct obs_module_path)  module_paths;
 
+	struct obs_module               *loading_module;
+	DARRAY(struct obs_deferred_type) deferred_types;
+	volatile long                   deferred_count;
+	pthread_mutex_t                 deferred_mutex;
+
 	DARRAY(struct obs_source_info)  source_types;
 	DARRAY(struct obs_source_info)  input_types;
 	DARRAY(struct obs_source_info)  filter_types;
@@ -390,11 +467,13 @@ struct obs_core {
 	struct obs_core_audio           audio;
 	struct obs_core_data            data;
 	struct obs_core_hotkeys         hotkeys;
+	struct obs_audio_encode_pool    audio_encode_pool;
 };
 
 extern struct obs_core *obs;
 
 extern void *obs_video_thread(void *param);
+extern void obs_free_video_rendition(struct obs_video_rendition *r);
 
 extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
 
@@ -425,6 +504,11 @@ struct obs_context_data {
 	struct obs_context_data         *next;
 	struct obs_context_data         **prev_next;
 
+	/* name index, see struct obs_context_index */
+	struct obs_context_index        *index;
+	struct obs_context_data         *hash_next;
+	uint32_t                        name_hash;
+
 	bool                            private;
 };
 
@@ -496,6 +580,14 @@ struct async_frame {
 	bool used;
 };
 
+/* frame lent to libobs with obs_source_lend_video, the data belongs to the
+ * source and goes back to it through the release callback */
+struct async_lent_frame {
+	struct obs_source_frame *frame;
+	void (*release)(void *param);
+	void *param;
+};
+
 enum audio_action_type {
 	AUDIO_ACTION_VOL,
 	AUDIO_ACTION_MUTE,
@@ -554,6 +646,9 @@ struct obs_source {
 	/* used to temporarily disable sources if needed */
 	bool                            enabled;
 
+	/* averaged time spent in the video tick of the source */
+	uint64_t                        tick_time_ns;
+
 	/* timing (if video is present, is based upon video) */
 	volatile bool                   timing_set;
 	volatile uint64_t               timing_adjust;
@@ -614,6 +709,8 @@ struct obs_source {
 	struct obs_source_frame         *async_preload_frame;
 	DARRAY(struct async_frame)      async_cache;
 	DARRAY(struct obs_source_frame*)async_frames;
+	DARRAY(struct async_lent_frame) async_lent;
+	bool                            async_lend_closed;
 	pthread_mutex_t                 async_mutex;
 	uint32_t                        async_width;
 	uint32_t                        async_height;
@@ -683,6 +780,14 @@ struct obs_source {
 	enum obs_monitoring_type        monitoring_type;
 
 	obs_data_t                      *private_settings;
+
+	/* incremented whenever something stored by obs_save_source changes
+	 * other than the settings, which count their own changes, so
+	 * unchanged sources can reuse the data from the previous save */
+	volatile long                   save_generation;
+	uint64_t                        saved_version;
+	long                            saved_data_changes;
+	obs_data_t                      *saved_data;
 };
 
 extern const struct obs_source_info *get_source_info(const char *id);
@@ -690,9 +795,34 @@ extern bool obs_source_init_context(struct obs_source *source,
 		obs_data_t *settings, const char *name,
 		obs_data_t *hotkey_data, bool private);
 
+/* source creation split in two so the create callback can be run elsewhere
+ * (used when loading sources in parallel).  deferred sources aren't visible
+ * to anything else until they are published by obs_source_create_finish */
+extern obs_source_t *obs_source_create_deferred(const char *id,
+		const char *name, obs_data_t *settings,
+		obs_data_t *hotkey_data);
+extern void *obs_source_create_data(obs_source_t *source);
+extern void obs_source_create_finish(obs_source_t *source, void *data,
+		bool publish);
+
 extern void obs_source_save(obs_source_t *source);
 extern void obs_source_load(obs_source_t *source);
 
+/* changes whenever the data or any object or array stored in it is
+ * modified, without walking them */
+extern long obs_data_get_changes(obs_data_t *data);
+
+static inline void obs_source_dirty(obs_source_t *source)
+{
+	if (!source)
+		return;
+
+	os_atomic_inc_long(&source->save_generation);
+}
+
+/* marks all scenes dirty, they save the names of the sources they contain */
+extern void obs_scenes_dirty(void);
+
 extern bool obs_transition_init(obs_source_t *transition);
 extern void obs_transition_free(obs_source_t *transition);
 extern void obs_transition_tick(obs_source_t *transition);
@@ -790,8 +920,13 @@ struct delay_data {
 	enum delay_msg msg;
 	uint64_t ts;
 	struct encoder_packet packet;
+	bool to_spool;
+	bool spooled;
 };
 
+struct delay_spool;
+struct delay_thread;
+
 typedef void (*encoded_callback_t)(void *data, struct encoder_packet *packet);
 
 struct obs_weak_output {
@@ -859,11 +994,6 @@ struct obs_output {
 	struct video_scale_info         video_conversion;
 	struct audio_convert_info       audio_conversion;
 
-	pthread_mutex_t                 caption_mutex;
-	double                          caption_timestamp;
-	struct caption_text             *caption_head;
-	struct caption_text             *caption_tail;
-
 	bool                            valid;
 
 	uint64_t                        active_delay_ns;
@@ -876,6 +1006,29 @@ struct obs_output {
 	volatile long                   delay_restart_refs;
 	volatile bool                   delay_active;
 	volatile bool                   delay_capturing;
+	struct delay_thread             *delay_thread;
+	os_event_t                      *delay_event;
+	size_t                          delay_mem_bytes;
+	char                            *delay_spool_dir;
+	uint64_t                        delay_max_memory;
+	uint64_t                        delay_spool_size;
+	struct delay_spool              *delay_spool;
+	size_t                          delay_spool_next;
+
+	bool                            dbr_enabled;
+	uint32_t                        dbr_min_kbps;
+	uint32_t                        dbr_max_kbps;
+	bool                            dbr_active;
+	uint32_t                        dbr_orig_kbps;
+	uint32_t                        dbr_audio_kbps;
+	uint32_t                        dbr_cur_min_kbps;
+	uint32_t                        dbr_cur_max_kbps;
+	volatile long                   dbr_cur_kbps;
+	uint64_t                        dbr_last_check_ns;
+	uint64_t                        dbr_last_change_ns;
+	uint64_t                        dbr_last_congested_ns;
+	uint64_t                        dbr_last_bytes;
+	int                             dbr_last_drops;
 
 	char                            *last_error_message;
 };
@@ -891,8 +1044,12 @@ static inline void do_output_signal(struct obs_output *output,
 
 extern void process_delay(void *data, struct encoder_packet *packet);
 extern void obs_output_cleanup_delay(obs_output_t *output);
+extern void obs_output_delay_init(obs_output_t *output);
 extern bool obs_output_delay_start(obs_output_t *output);
 extern void obs_output_delay_stop(obs_output_t *output);
+extern void obs_output_dbr_start(obs_output_t *output);
+extern void obs_output_dbr_stop(obs_output_t *output);
+extern void obs_output_dbr_update(obs_output_t *output);
 extern bool obs_output_actual_start(obs_output_t *output);
 extern void obs_output_actual_stop(obs_output_t *output, bool force,
 		uint64_t ts);
@@ -921,6 +1078,15 @@ struct encoder_callback {
 	void *param;
 };
 
+#define MAX_ENCODER_QUEUE_SIZE     8
+#define DEFAULT_ENCODER_QUEUE_SIZE 3
+
+struct encoder_queued_frame {
+	struct video_frame              frame;
+	int64_t                         pts;
+	uint64_t                        queued_ts;
+};
+
 struct obs_encoder {
 	struct obs_context_data         context;
 	struct obs_encoder_info         info;
@@ -954,6 +1120,13 @@ struct obs_encoder {
 	struct circlebuf                audio_input_buffer[MAX_AV_PLANES];
 	uint8_t                         *audio_output_buffer[MAX_AV_PLANES];
 
+	/* audio_in_place: the front frame of audio_input_buffer is being
+	 * encoded directly out of the buffer.  if the buffer has to grow in
+	 * the meantime, the old data is kept in audio_retired_buffer until
+	 * the frame is done */
+	bool                            audio_in_place;
+	uint8_t                         *audio_retired_buffer[MAX_AV_PLANES];
+
 	/* if a video encoder is paired with an audio encoder, make it start
 	 * up at the specific timestamp.  if this is the audio encoder,
 	 * wait_for_video makes it wait until it's ready to sync up with
@@ -977,10 +1150,61 @@ struct obs_encoder {
 	DARRAY(struct encoder_callback) callbacks;
 
 	const char                      *profile_encoder_encode_name;
+
+	/* packet held for encoders that only implement the legacy encode
+	 * callback, until it is received */
+	struct encoder_packet           legacy_packet;
+	bool                            legacy_received;
+
+	/* threaded video encoding: frames are copied in to the queue on the
+	 * video output thread and encoded on the encoder's own thread */
+	bool                            threaded;
+	size_t                          queue_size;
+	enum obs_encoder_queue_policy   queue_policy;
+
+	pthread_t                       encode_thread;
+	bool                            encode_thread_active;
+	volatile bool                   encode_thread_stop;
+	os_sem_t                        *encode_sem;
+	os_event_t                      *queue_event;
+
+	pthread_mutex_t                 queue_mutex;
+	struct encoder_queued_frame     queue[MAX_ENCODER_QUEUE_SIZE];
+	size_t                          queue_first;
+	size_t                          queue_num;
+	struct video_scale_info         queue_info;
+	struct obs_encoder_queue_stats  queue_stats;
+
+	const char                      *profile_encode_thread_name;
+
+	/* audio encoding on the audio encode pool: audio_input_buffer is
+	 * filled by the audio thread under queue_mutex, and the encoder is
+	 * scheduled on the pool whenever a full frame is available */
+	bool                            pool_scheduled;
+	pthread_t                       pool_thread;
+
+	/* caption text queued by outputs, turned in to SEI at most every two
+	 * seconds as frames are encoded.  caption_sei holds a rendered SEI NAL
+	 * that is waiting to be inserted in to the next packet, for encoders
+	 * that can't insert SEI themselves.  caption_count is the number of
+	 * queued lines, so the encode path can skip the mutex when there are
+	 * none */
+	pthread_mutex_t                 caption_mutex;
+	double                          caption_timestamp;
+	struct caption_text             *caption_head;
+	struct caption_text             *caption_tail;
+	volatile long                   caption_count;
+	DARRAY(uint8_t)                 caption_sei;
 };
 
 extern struct obs_encoder_info *find_encoder(const char *id);
 
+extern void obs_encoder_add_caption_text(obs_encoder_t *encoder,
+		const char *text);
+
+extern bool obs_init_audio_encode_pool(void);
+extern void obs_free_audio_encode_pool(void);
+
 extern bool obs_encoder_initialize(obs_encoder_t *encoder);
 extern void obs_encoder_shutdown(obs_encoder_t *encoder);
 
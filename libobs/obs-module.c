@@ -49,6 +49,7 @@ static int load_module_exports(struct obs_module *mod, const char *path)
 	/* optional exports */
 	mod->unload      = os_dlsym(mod->module, "obs_module_unload");
 	mod->post_load   = os_dlsym(mod->module, "obs_module_post_load");
+	mod->deferred_load = os_dlsym(mod->module, "obs_module_deferred_load");
 	mod->set_locale  = os_dlsym(mod->module, "obs_module_set_locale");
 	mod->free_locale = os_dlsym(mod->module, "obs_module_free_locale");
 	mod->name        = os_dlsym(mod->module, "obs_module_name");
@@ -76,17 +77,27 @@ static inline char *get_module_name(const char *file)
 extern void reset_win32_symbol_paths(void);
 #endif
 
-int obs_open_module(obs_module_t **module, const char *path,
+static bool init_deferred_mutex(struct obs_module *mod)
+{
+	pthread_mutexattr_t attr;
+
+	pthread_mutex_init_value(&mod->deferred_mutex);
+
+	if (pthread_mutexattr_init(&attr) != 0)
+		return false;
+	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
+		return false;
+	return pthread_mutex_init(&mod->deferred_mutex, &attr) == 0;
+}
+
+/* loads the module image, its exports and its locale, but does not add it to
+ * the module list.  safe to call from multiple threads at once. */
+static int open_module_file(obs_module_t **module, const char *path,
 		const char *data_path)
 {
 	struct obs_module mod = {0};
 	int errorcode;
 
-	if (!module || !path || !obs)
-		return MODULE_ERROR;
-
-	blog(LOG_DEBUG, "---------------------------------");
-
 	mod.module = os_dlopen(path);
 	if (!mod.module) {
 		blog(LOG_WARNING, "Module '%s' not found", path);
@@ -102,22 +113,48 @@ int obs_open_module(obs_module_t **module, const char *path,
 	mod.file      = (!mod.file) ? mod.bin_path : (mod.file + 1);
 	mod.mod_name  = get_module_name(mod.file);
 	mod.data_path = bstrdup(data_path);
-	mod.next      = obs->first_module;
 
 	if (mod.file) {
 		blog(LOG_DEBUG, "Loading module: %s", mod.file);
 	}
 
 	*module = bmemdup(&mod, sizeof(mod));
-	obs->first_module = (*module);
 	mod.set_pointer(*module);
 
+	if (mod.deferred_load && !init_deferred_mutex(*module)) {
+		bfree(mod.mod_name);
+		bfree(mod.bin_path);
+		bfree(mod.data_path);
+		bfree(*module);
+		*module = NULL;
+		return MODULE_ERROR;
+	}
+
 	if (mod.set_locale)
 		mod.set_locale(obs->locale);
 
 	return MODULE_SUCCESS;
 }
 
+int obs_open_module(obs_module_t **module, const char *path,
+		const char *data_path)
+{
+	int errorcode;
+
+	if (!module || !path || !obs)
+		return MODULE_ERROR;
+
+	blog(LOG_DEBUG, "---------------------------------");
+
+	errorcode = open_module_file(module, path, data_path);
+	if (errorcode != MODULE_SUCCESS)
+		return errorcode;
+
+	(*module)->next = obs->first_module;
+	obs->first_module = *module;
+	return MODULE_SUCCESS;
+}
+
 bool obs_init_module(obs_module_t *module)
 {
 	if (!module || !obs)
@@ -130,7 +167,10 @@ bool obs_init_module(obs_module_t *module)
 				"obs_init_module(%s)", module->file);
 	profile_start(profile_name);
 
+	obs->loading_module = module;
 	module->loaded = module->load();
+	obs->loading_module = NULL;
+
 	if (!module->loaded)
 		blog(LOG_WARNING, "Failed to initialize module '%s'",
 				module->file);
@@ -222,37 +262,154 @@ void obs_add_module_path(const char *bin, const char *data)
 	da_push_back(obs->module_paths, &omp);
 }
 
-static void load_all_callback(void *param, const struct obs_module_info *info)
+/*
+ *   Loading the module images, resolving their exports and parsing their
+ * locale files doesn't touch any shared state, so that part is done on a few
+ * threads at once.  The system loader serializes the images themselves being
+ * mapped (and on windows os_dlopen does too), so what actually overlaps is
+ * the file lookups, relocations and locale parsing.  The modules are then
+ * initialized one at a time on the calling thread, in the order they were
+ * found, because obs_module_load registers types and is free to call into
+ * anything.
+ */
+
+#define MAX_OPEN_THREADS 8
+
+struct module_open_task {
+	char                   *bin_path;
+	char                   *data_path;
+	struct obs_module      *module;
+	int                    code;
+};
+
+struct module_open_tasks {
+	DARRAY(struct module_open_task) tasks;
+	volatile long                   next;
+};
+
+static void add_open_task(void *param, const struct obs_module_info *info)
 {
-	obs_module_t *module;
+	struct module_open_tasks *open = param;
+	struct module_open_task *task = da_push_back_new(open->tasks);
 
-	int code = obs_open_module(&module, info->bin_path, info->data_path);
-	if (code != MODULE_SUCCESS) {
-		blog(LOG_DEBUG, "Failed to load module file '%s': %d",
-				info->bin_path, code);
-		return;
+	task->bin_path  = bstrdup(info->bin_path);
+	task->data_path = bstrdup(info->data_path);
+	task->code      = MODULE_ERROR;
+}
+
+static const char *open_modules_thread_name = "obs_open_modules_thread";
+
+static void *open_modules_thread(void *param)
+{
+	struct module_open_tasks *open = param;
+
+	os_set_thread_name("libobs: module loader");
+	profile_start(open_modules_thread_name);
+
+	for (;;) {
+		long idx = os_atomic_inc_long(&open->next) - 1;
+		struct module_open_task *task;
+		const char *profile_name;
+		const char *file;
+
+		if ((size_t)idx >= open->tasks.num)
+			break;
+
+		task = open->tasks.array + idx;
+		file = strrchr(task->bin_path, '/');
+		file = file ? file + 1 : task->bin_path;
+
+		profile_name = profile_store_name(obs_get_profiler_name_store(),
+				"obs_open_module(%s)", file);
+		profile_start(profile_name);
+
+		task->code = open_module_file(&task->module, task->bin_path,
+				task->data_path);
+
+		profile_end(profile_name);
+	}
+
+	profile_end(open_modules_thread_name);
+	return NULL;
+}
+
+static void open_modules(struct module_open_tasks *open)
+{
+	pthread_t threads[MAX_OPEN_THREADS];
+	size_t num_threads = (size_t)os_get_logical_cores();
+
+	if (num_threads > MAX_OPEN_THREADS)
+		num_threads = MAX_OPEN_THREADS;
+	if (num_threads > open->tasks.num)
+		num_threads = open->tasks.num;
+
+	for (size_t i = 0; i < num_threads; i++) {
+		if (pthread_create(&threads[i], NULL, open_modules_thread,
+					open) != 0) {
+			num_threads = i;
+			break;
+		}
 	}
 
-	obs_init_module(module);
+	/* open any remaining modules here if threads couldn't be created */
+	if (!num_threads) {
+		open_modules_thread(open);
+		return;
+	}
 
-	UNUSED_PARAMETER(param);
+	for (size_t i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
 }
 
 static const char *obs_load_all_modules_name = "obs_load_all_modules";
+static const char *obs_open_modules_name = "obs_open_modules";
 #ifdef _WIN32
 static const char *reset_win32_symbol_paths_name = "reset_win32_symbol_paths";
 #endif
 
 void obs_load_all_modules(void)
 {
+	struct module_open_tasks open = {0};
+	uint64_t start_time = os_gettime_ns();
+	size_t num_loaded = 0;
+
 	profile_start(obs_load_all_modules_name);
-	obs_find_modules(load_all_callback, NULL);
+
+	obs_find_modules(add_open_task, &open);
+
+	profile_start(obs_open_modules_name);
+	open_modules(&open);
+	profile_end(obs_open_modules_name);
+
+	for (size_t i = 0; i < open.tasks.num; i++) {
+		struct module_open_task *task = open.tasks.array + i;
+
+		if (task->code != MODULE_SUCCESS) {
+			blog(LOG_DEBUG, "Failed to load module file '%s': %d",
+					task->bin_path, task->code);
+		} else {
+			task->module->next = obs->first_module;
+			obs->first_module = task->module;
+
+			if (obs_init_module(task->module))
+				num_loaded++;
+		}
+
+		bfree(task->bin_path);
+		bfree(task->data_path);
+	}
+
+	da_free(open.tasks);
+
 #ifdef _WIN32
 	profile_start(reset_win32_symbol_paths_name);
 	reset_win32_symbol_paths();
 	profile_end(reset_win32_symbol_paths_name);
 #endif
 	profile_end(obs_load_all_modules_name);
+
+	blog(LOG_INFO, "Loaded %d modules in %.1f ms", (int)num_loaded,
+			(double)(os_gettime_ns() - start_time) / 1000000.0);
 }
 
 void obs_post_load_modules(void)
@@ -262,6 +419,99 @@ void obs_post_load_modules(void)
 			mod->post_load();
 }
 
+static void add_deferred_type(enum obs_obj_type type, const char *id)
+{
+	struct obs_module *module = obs->loading_module;
+	struct obs_deferred_type item;
+
+	if (!module || !module->deferred_load)
+		return;
+
+	item.type   = type;
+	item.id     = id;
+	item.module = module;
+
+	pthread_mutex_lock(&obs->deferred_mutex);
+	da_push_back(obs->deferred_types, &item);
+	os_atomic_set_long(&obs->deferred_count,
+			(long)obs->deferred_types.num);
+	pthread_mutex_unlock(&obs->deferred_mutex);
+}
+
+static void run_deferred_load(struct obs_module *module)
+{
+	const char *profile_name;
+
+	profile_name = profile_store_name(obs_get_profiler_name_store(),
+			"obs_module_deferred_load(%s)", module->file);
+	profile_start(profile_name);
+
+	blog(LOG_DEBUG, "Running deferred initialization of module '%s'",
+			module->file);
+	module->deferred_load();
+
+	profile_end(profile_name);
+
+	/* the types stay listed until now, so that other threads wait for
+	 * the module instead of using it half initialized */
+	pthread_mutex_lock(&obs->deferred_mutex);
+
+	for (size_t i = obs->deferred_types.num; i > 0; i--) {
+		if (obs->deferred_types.array[i - 1].module == module)
+			da_erase(obs->deferred_types, i - 1);
+	}
+
+	os_atomic_set_long(&obs->deferred_count,
+			(long)obs->deferred_types.num);
+	pthread_mutex_unlock(&obs->deferred_mutex);
+}
+
+void obs_load_deferred_module(enum obs_obj_type type, const char *id)
+{
+	struct obs_module *module = NULL;
+	bool run = false;
+
+	if (!obs || !id)
+		return;
+
+	/* no module in use defers its initialization, which is the common
+	 * case, so don't touch the lock at all */
+	if (!os_atomic_load_long(&obs->deferred_count))
+		return;
+
+	pthread_mutex_lock(&obs->deferred_mutex);
+
+	for (size_t i = 0; i < obs->deferred_types.num; i++) {
+		struct obs_deferred_type *item = obs->deferred_types.array + i;
+
+		if (item->type == type && strcmp(item->id, id) == 0) {
+			module = item->module;
+			break;
+		}
+	}
+
+	/* the first thread takes the module's lock before the list is
+	 * unlocked, so other threads always find it held until the module is
+	 * initialized */
+	if (module && !module->deferred_started) {
+		module->deferred_started = true;
+		pthread_mutex_lock(&module->deferred_mutex);
+		run = true;
+	}
+
+	pthread_mutex_unlock(&obs->deferred_mutex);
+
+	if (!module)
+		return;
+
+	if (run)
+		run_deferred_load(module);
+	else
+		pthread_mutex_lock(&module->deferred_mutex);
+
+	pthread_mutex_unlock(&module->deferred_mutex);
+}
+
 static inline void make_data_dir(struct dstr *parsed_data_dir,
 		const char *data_dir, const char *name)
 {
@@ -440,6 +690,9 @@ void free_module(struct obs_module *mod)
 		/* os_dlclose(mod->module); */
 	}
 
+	if (mod->deferred_load)
+		pthread_mutex_destroy(&mod->deferred_mutex);
+
 	bfree(mod->mod_name);
 	bfree(mod->bin_path);
 	bfree(mod->data_path);
@@ -635,6 +888,7 @@ void obs_register_source_s(const struct obs_source_info *info, size_t size)
 	if (array)
 		darray_push_back(sizeof(struct obs_source_info), array, &data);
 	da_push_back(obs->source_types, &data);
+	add_deferred_type(OBS_OBJ_TYPE_SOURCE, info->id);
 	return;
 
 error:
@@ -671,6 +925,7 @@ void obs_register_output_s(const struct obs_output_info *info, size_t size)
 #undef CHECK_REQUIRED_VAL_
 
 	REGISTER_OBS_DEF(size, obs_output_info, obs->output_types, info);
+	add_deferred_type(OBS_OBJ_TYPE_OUTPUT, info->id);
 	return;
 
 error:
@@ -690,13 +945,20 @@ void obs_register_encoder_s(const struct obs_encoder_info *info, size_t size)
 	CHECK_REQUIRED_VAL_(info, get_name, obs_register_encoder);
 	CHECK_REQUIRED_VAL_(info, create,   obs_register_encoder);
 	CHECK_REQUIRED_VAL_(info, destroy,  obs_register_encoder);
-	CHECK_REQUIRED_VAL_(info, encode,   obs_register_encoder);
+
+	if (offsetof(struct obs_encoder_info, encode_submit) +
+			sizeof(info->encode_submit) <= size &&
+	    info->encode_submit)
+		CHECK_REQUIRED_VAL_(info, encode_receive, obs_register_encoder);
+	else
+		CHECK_REQUIRED_VAL_(info, encode, obs_register_encoder);
 
 	if (info->type == OBS_ENCODER_AUDIO)
 		CHECK_REQUIRED_VAL_(info, get_frame_size, obs_register_encoder);
 #undef CHECK_REQUIRED_VAL_
 
 	REGISTER_OBS_DEF(size, obs_encoder_info, obs->encoder_types, info);
+	add_deferred_type(OBS_OBJ_TYPE_ENCODER, info->id);
 	return;
 
 error:
@@ -719,6 +981,7 @@ void obs_register_service_s(const struct obs_service_info *info, size_t size)
 #undef CHECK_REQUIRED_VAL_
 
 	REGISTER_OBS_DEF(size, obs_service_info, obs->service_types, info);
+	add_deferred_type(OBS_OBJ_TYPE_SERVICE, info->id);
 	return;
 
 error:
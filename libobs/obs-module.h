@@ -100,6 +100,18 @@ MODULE_EXPORT void obs_module_unload(void);
 /** Optional: Called when all modules have finished loading */
 MODULE_EXPORT void obs_module_post_load(void);
 
+/**
+ * Optional: Called the first time an object of a type registered by the
+ * module is created, or the first time the defaults or properties of one of
+ * those types are requested.
+ *
+ *   Expensive initialization that is only needed once the module is actually
+ * used (device enumeration, loading external libraries, etc) can be done here
+ * instead of in obs_module_load to keep startup fast.  Types must still be
+ * registered in obs_module_load.
+ */
+MODULE_EXPORT void obs_module_deferred_load(void);
+
 /** Called to set the current locale data for the module.  */
 MODULE_EXPORT void obs_module_set_locale(const char *locale);
 
@@ -0,0 +1,308 @@
+/******************************************************************************
+    Copyright (C) 2026 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ *   Dynamic bitrate: rather than waiting for the output to start dropping
+ * frames when the connection can't keep up, the video encoder bitrate is
+ * lowered as soon as the output reports congestion and raised again in small
+ * steps once the connection has been clear for a while.  The controller is
+ * evaluated on the encoder thread as video packets arrive, so encoder updates
+ * are serialized with encoding.  Frame dropping in the output remains as the
+ * last resort once the floor has been reached.
+ */
+
+#include <inttypes.h>
+#include "obs-internal.h"
+
+#define DBR_CHECK_INTERVAL_NS       1000000000ULL
+#define DBR_DECREASE_INTERVAL_NS    2000000000ULL
+#define DBR_RECOVER_DELAY_NS       10000000000ULL
+#define DBR_RECOVER_INTERVAL_NS     5000000000ULL
+
+/* hysteresis: decrease above the first threshold, only recover once below
+ * the second one */
+#define DBR_CONGESTED               0.5f
+#define DBR_CLEAR                   0.1f
+
+#define DBR_DECREASE_FACTOR         0.7
+#define DBR_THROUGHPUT_FACTOR       0.9
+#define DBR_RECOVER_STEP            0.05
+#define DBR_MIN_RECOVER_STEP_KBPS   50
+#define DBR_DEFAULT_FLOOR_DIVISOR   4
+
+static inline uint32_t get_encoder_bitrate(obs_encoder_t *encoder)
+{
+	obs_data_t *settings = obs_encoder_get_settings(encoder);
+	long long bitrate = obs_data_get_int(settings, "bitrate");
+	obs_data_release(settings);
+
+	return bitrate > 0 ? (uint32_t)bitrate : 0;
+}
+
+/* an encoder shared with other outputs (e.g. a recording using the stream
+ * encoder) must not follow this output's connection */
+static bool encoder_shared(obs_encoder_t *encoder)
+{
+	size_t outputs;
+	size_t callbacks;
+
+	pthread_mutex_lock(&encoder->outputs_mutex);
+	outputs = encoder->outputs.num;
+	pthread_mutex_unlock(&encoder->outputs_mutex);
+
+	pthread_mutex_lock(&encoder->callbacks_mutex);
+	callbacks = encoder->callbacks.num;
+	pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+	return outputs > 1 || callbacks > 1;
+}
+
+static void set_bitrate(struct obs_output *output, uint32_t kbps)
+{
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_int(settings, "bitrate", kbps);
+	obs_encoder_update(output->video_encoder, settings);
+	obs_data_release(settings);
+
+	os_atomic_set_long(&output->dbr_cur_kbps, (long)kbps);
+}
+
+static inline uint32_t clamp_bitrate(const struct obs_output *output,
+		double kbps)
+{
+	if (kbps < (double)output->dbr_cur_min_kbps)
+		return output->dbr_cur_min_kbps;
+	if (kbps > (double)output->dbr_cur_max_kbps)
+		return output->dbr_cur_max_kbps;
+	return (uint32_t)kbps;
+}
+
+void obs_output_dbr_start(obs_output_t *output)
+{
+	obs_encoder_t *encoder = output->video_encoder;
+	uint32_t bitrate;
+	uint32_t audio_kbps = 0;
+
+	output->dbr_active = false;
+
+	if (!output->dbr_enabled || !encoder)
+		return;
+
+	if ((encoder->info.caps & OBS_ENCODER_CAP_DYN_BITRATE) == 0) {
+		blog(LOG_INFO, "Output '%s': encoder '%s' does not support "
+		               "changing its bitrate while active, dynamic "
+		               "bitrate disabled",
+		               output->context.name, encoder->context.name);
+		return;
+	}
+
+	if (encoder_shared(encoder)) {
+		blog(LOG_WARNING, "Output '%s': encoder '%s' is shared with "
+		                  "other outputs, dynamic bitrate disabled",
+		                  output->context.name, encoder->context.name);
+		return;
+	}
+
+	if (!output->info.get_congestion && !output->info.get_dropped_frames) {
+		blog(LOG_INFO, "Output '%s': output does not report "
+		               "congestion, dynamic bitrate disabled",
+		               output->context.name);
+		return;
+	}
+
+	/* with delay, the packets being sent were encoded long before the
+	 * congestion that is being measured, so there is nothing to control */
+	if (output->active_delay_ns) {
+		blog(LOG_INFO, "Output '%s': dynamic bitrate is not used with "
+		               "stream delay", output->context.name);
+		return;
+	}
+
+	bitrate = get_encoder_bitrate(encoder);
+	if (!bitrate)
+		return;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		if (output->audio_encoders[i])
+			audio_kbps += get_encoder_bitrate(
+					output->audio_encoders[i]);
+	}
+
+	output->dbr_orig_kbps    = bitrate;
+	output->dbr_audio_kbps   = audio_kbps;
+	output->dbr_cur_max_kbps = output->dbr_max_kbps ?
+		output->dbr_max_kbps : bitrate;
+	output->dbr_cur_min_kbps = output->dbr_min_kbps ?
+		output->dbr_min_kbps :
+		output->dbr_cur_max_kbps / DBR_DEFAULT_FLOOR_DIVISOR;
+
+	if (output->dbr_cur_min_kbps > output->dbr_cur_max_kbps)
+		output->dbr_cur_min_kbps = output->dbr_cur_max_kbps;
+
+	if (bitrate != clamp_bitrate(output, bitrate))
+		set_bitrate(output, clamp_bitrate(output, bitrate));
+	else
+		os_atomic_set_long(&output->dbr_cur_kbps, (long)bitrate);
+
+	output->dbr_last_check_ns     = os_gettime_ns();
+	output->dbr_last_change_ns    = output->dbr_last_check_ns;
+	output->dbr_last_congested_ns = output->dbr_last_check_ns;
+	output->dbr_last_bytes        = obs_output_get_total_bytes(output);
+	output->dbr_last_drops        = obs_output_get_frames_dropped(output);
+	output->dbr_active            = true;
+
+	blog(LOG_INFO, "Output '%s': dynamic bitrate enabled "
+	               "(%"PRIu32"-%"PRIu32" kbps)",
+	               output->context.name,
+	               output->dbr_cur_min_kbps, output->dbr_cur_max_kbps);
+}
+
+void obs_output_dbr_stop(obs_output_t *output)
+{
+	if (!output->dbr_active)
+		return;
+
+	output->dbr_active = false;
+
+	if ((uint32_t)os_atomic_load_long(&output->dbr_cur_kbps) !=
+	    output->dbr_orig_kbps)
+		set_bitrate(output, output->dbr_orig_kbps);
+
+	os_atomic_set_long(&output->dbr_cur_kbps, 0);
+}
+
+void obs_output_dbr_update(obs_output_t *output)
+{
+	uint64_t now = os_gettime_ns();
+	uint64_t elapsed = now - output->dbr_last_check_ns;
+	uint64_t bytes;
+	uint32_t cur_kbps;
+	uint32_t new_kbps;
+	double throughput_kbps;
+	bool congested = false;
+	float congestion;
+	int drops;
+
+	if (!output->dbr_active || elapsed < DBR_CHECK_INTERVAL_NS)
+		return;
+
+	/* another output may have started using the encoder since */
+	if (encoder_shared(output->video_encoder)) {
+		blog(LOG_WARNING, "Output '%s': encoder '%s' is now shared "
+		                  "with other outputs, dynamic bitrate disabled",
+		                  output->context.name,
+		                  output->video_encoder->context.name);
+		obs_output_dbr_stop(output);
+		return;
+	}
+
+	bytes      = obs_output_get_total_bytes(output);
+	drops      = obs_output_get_frames_dropped(output);
+	congestion = obs_output_get_congestion(output);
+	cur_kbps   = (uint32_t)os_atomic_load_long(&output->dbr_cur_kbps);
+
+	throughput_kbps = (double)(bytes - output->dbr_last_bytes) * 8.0 /
+		((double)elapsed / 1000000.0);
+
+	if (congestion >= DBR_CONGESTED || drops > output->dbr_last_drops)
+		congested = true;
+
+	output->dbr_last_check_ns = now;
+	output->dbr_last_bytes    = bytes;
+	output->dbr_last_drops    = drops;
+
+	if (congested) {
+		double target = (double)cur_kbps * DBR_DECREASE_FACTOR;
+		double video_throughput = throughput_kbps *
+			DBR_THROUGHPUT_FACTOR - (double)output->dbr_audio_kbps;
+
+		/* when the connection is measurably slower than the stream,
+		 * drop straight to what it can actually carry */
+		if (bytes && video_throughput > 0.0 && video_throughput < target)
+			target = video_throughput;
+
+		output->dbr_last_congested_ns = now;
+
+		if (now - output->dbr_last_change_ns < DBR_DECREASE_INTERVAL_NS)
+			return;
+
+		new_kbps = clamp_bitrate(output, target);
+		if (new_kbps >= cur_kbps)
+			return;
+
+		set_bitrate(output, new_kbps);
+		output->dbr_last_change_ns = now;
+
+		blog(LOG_INFO, "Output '%s': congestion %.2f, throughput "
+		               "%.0f kbps, lowering video bitrate from "
+		               "%"PRIu32" to %"PRIu32" kbps",
+		               output->context.name, congestion,
+		               throughput_kbps, cur_kbps, new_kbps);
+
+	} else if (congestion > DBR_CLEAR) {
+		output->dbr_last_congested_ns = now;
+
+	} else if (cur_kbps < output->dbr_cur_max_kbps &&
+	           now - output->dbr_last_congested_ns >=
+	           DBR_RECOVER_DELAY_NS &&
+	           now - output->dbr_last_change_ns >=
+	           DBR_RECOVER_INTERVAL_NS) {
+		double step = (double)output->dbr_cur_max_kbps *
+			DBR_RECOVER_STEP;
+		if (step < DBR_MIN_RECOVER_STEP_KBPS)
+			step = DBR_MIN_RECOVER_STEP_KBPS;
+
+		new_kbps = clamp_bitrate(output, (double)cur_kbps + step);
+		set_bitrate(output, new_kbps);
+		output->dbr_last_change_ns = now;
+
+		blog(LOG_DEBUG, "Output '%s': raising video bitrate from "
+		                "%"PRIu32" to %"PRIu32" kbps",
+		                output->context.name, cur_kbps, new_kbps);
+	}
+}
+
+void obs_output_set_dynamic_bitrate(obs_output_t *output, bool enable,
+		uint32_t min_kbps, uint32_t max_kbps)
+{
+	if (!obs_output_valid(output, "obs_output_set_dynamic_bitrate"))
+		return;
+
+	if (enable && ((output->info.flags & OBS_OUTPUT_ENCODED) == 0 ||
+	               (output->info.flags & OBS_OUTPUT_VIDEO) == 0)) {
+		blog(LOG_WARNING, "Output '%s': Tried to enable dynamic "
+		                  "bitrate on an output without encoded video",
+		                  output->context.name);
+		return;
+	}
+
+	output->dbr_enabled  = enable;
+	output->dbr_min_kbps = min_kbps;
+	output->dbr_max_kbps = max_kbps;
+}
+
+bool obs_output_dynamic_bitrate_enabled(const obs_output_t *output)
+{
+	return obs_output_valid(output, "obs_output_dynamic_bitrate_enabled") ?
+		output->dbr_enabled : false;
+}
+
+uint32_t obs_output_get_dynamic_bitrate(const obs_output_t *output)
+{
+	return obs_output_valid(output, "obs_output_get_dynamic_bitrate") ?
+		(uint32_t)os_atomic_load_long(&output->dbr_cur_kbps) : 0;
+}
@@ -16,8 +16,45 @@
 ******************************************************************************/
 
 #include <inttypes.h>
+#include "util/platform.h"
+#include "util/dstr.h"
 #include "obs-internal.h"
 
+/*
+ *   Delayed packets are held in a queue and sent out by a dedicated thread
+ * once they are due.  Packets share the encoder's reference counted data
+ * rather than being copied, and once the queue exceeds its memory budget, new
+ * packet payloads are written to a preallocated ring file on disk and read
+ * back when they are sent.  The ring is written and read in queue order, so
+ * it only has to track where the oldest and newest payloads are.  Both
+ * happen on the delay thread, so a slow disk never holds up encoding.
+ */
+
+/* upper bound for how long the delay thread sleeps, also determines how often
+ * the delay is extended while reconnecting with preserve on */
+#define MAX_DELAY_WAIT_NS 100000000ULL
+
+/* each delay thread has its own stop flag, a thread that stopped its own
+ * output exits on its own while a restart may already have started another */
+struct delay_thread {
+	struct obs_output *output;
+	pthread_t         thread;
+	volatile bool     stop;
+	bool              detached;
+};
+
+/* only used from the delay thread */
+struct delay_spool {
+	FILE            *file;
+	char            *path;
+	uint64_t        size;
+	uint64_t        head;
+	uint64_t        tail;
+	uint64_t        used;
+	DARRAY(uint8_t) read_buf;
+	bool            full_warned;
+};
+
 static inline bool delay_active(const struct obs_output *output)
 {
 	return os_atomic_load_bool(&output->delay_active);
@@ -28,6 +65,158 @@ static inline bool delay_capturing(const struct obs_output *output)
 	return os_atomic_load_bool(&output->delay_capturing);
 }
 
+/* ------------------------------------------------------------------------- */
+/* disk spool */
+
+static void spool_destroy(struct delay_spool *spool)
+{
+	if (!spool)
+		return;
+
+	if (spool->file) {
+		fclose(spool->file);
+		os_unlink(spool->path);
+	}
+
+	da_free(spool->read_buf);
+	bfree(spool->path);
+	bfree(spool);
+}
+
+static struct delay_spool *spool_create(struct obs_output *output)
+{
+	struct delay_spool *spool = bzalloc(sizeof(struct delay_spool));
+	struct dstr path = {0};
+
+	os_mkdirs(output->delay_spool_dir);
+	dstr_printf(&path, "%s/obs-delay-%p.spool", output->delay_spool_dir,
+			output);
+	spool->path = path.array;
+	spool->size = output->delay_spool_size;
+
+	spool->file = os_fopen(spool->path, "w+b");
+	if (!spool->file)
+		goto fail;
+
+	/* allocate the whole ring up front so running out of disk space is
+	 * noticed when the output starts rather than mid-broadcast */
+	if (os_fpreallocate(spool->file, (int64_t)spool->size) != 0)
+		goto fail;
+
+	blog(LOG_INFO, "Output '%s': spooling delayed packets over "
+	               "%"PRIu64" MB of memory to '%s' (%"PRIu64" MB)",
+	               output->context.name,
+	               output->delay_max_memory / (1024 * 1024),
+	               spool->path, spool->size / (1024 * 1024));
+	return spool;
+
+fail:
+	blog(LOG_WARNING, "Output '%s': failed to create delay spool file "
+	                  "'%s', delayed packets will be kept in memory",
+	                  output->context.name,
+	                  spool->path ? spool->path : "");
+	spool_destroy(spool);
+	return NULL;
+}
+
+static bool spool_io(struct delay_spool *spool, uint64_t offset,
+		uint8_t *data, size_t size, bool write)
+{
+	while (size) {
+		uint64_t chunk = spool->size - offset;
+		if (chunk > size)
+			chunk = size;
+
+		if (os_fseeki64(spool->file, (int64_t)offset, SEEK_SET) != 0)
+			return false;
+
+		if (write) {
+			if (fwrite(data, 1, (size_t)chunk, spool->file) !=
+			    (size_t)chunk)
+				return false;
+		} else {
+			if (fread(data, 1, (size_t)chunk, spool->file) !=
+			    (size_t)chunk)
+				return false;
+		}
+
+		data   += chunk;
+		size   -= (size_t)chunk;
+		offset  = 0;
+	}
+
+	return true;
+}
+
+static bool spool_write(struct obs_output *output,
+		struct delay_spool *spool, struct encoder_packet *packet)
+{
+	if (spool->used + packet->size > spool->size) {
+		if (!spool->full_warned) {
+			blog(LOG_WARNING, "Output '%s': delay spool is full, "
+			                  "keeping delayed packets in memory",
+			                  output->context.name);
+			spool->full_warned = true;
+		}
+		return false;
+	}
+
+	if (!spool_io(spool, spool->head, packet->data, packet->size, true)) {
+		blog(LOG_WARNING, "Output '%s': failed to write to delay "
+		                  "spool", output->context.name);
+		return false;
+	}
+
+	spool->head  = (spool->head + packet->size) % spool->size;
+	spool->used += packet->size;
+	return true;
+}
+
+/* advances past a payload without reading it, so the payloads after it are
+ * still read from the right place */
+static void spool_skip(struct delay_spool *spool,
+		const struct encoder_packet *packet)
+{
+	spool->tail  = (spool->tail + packet->size) % spool->size;
+	spool->used -= packet->size;
+	spool->full_warned = false;
+}
+
+static bool spool_read(struct obs_output *output,
+		struct delay_spool *spool, struct encoder_packet *packet)
+{
+	struct encoder_packet spooled = *packet;
+	bool success;
+
+	da_resize(spool->read_buf, packet->size);
+	success = spool_io(spool, spool->tail, spool->read_buf.array,
+			packet->size, false);
+
+	/* always advance, a failed read must not shift later payloads */
+	spool_skip(spool, packet);
+
+	if (success) {
+		spooled.data = spool->read_buf.array;
+		obs_encoder_packet_create_instance(packet, &spooled);
+	}
+
+	if (!success)
+		blog(LOG_WARNING, "Output '%s': failed to read from delay "
+		                  "spool, packet dropped",
+		                  output->context.name);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool should_spool(const struct obs_output *output,
+		const struct encoder_packet *packet)
+{
+	return output->delay_spool &&
+		output->delay_mem_bytes + packet->size >
+		output->delay_max_memory;
+}
+
 static inline void push_packet(struct obs_output *output,
 		struct encoder_packet *packet, uint64_t t)
 {
@@ -35,22 +224,89 @@ static inline void push_packet(struct obs_output *output,
 
 	dd.msg = DELAY_MSG_PACKET;
 	dd.ts  = t;
-	obs_encoder_packet_create_instance(&dd.packet, packet);
+
+	obs_encoder_packet_ref(&dd.packet, packet);
 
 	pthread_mutex_lock(&output->delay_mutex);
+
+	/* the payload is written to the spool later by the delay thread */
+	if (should_spool(output, packet))
+		dd.to_spool = true;
+	else
+		output->delay_mem_bytes += packet->size;
+
 	circlebuf_push_back(&output->delay_data, &dd, sizeof(dd));
 	pthread_mutex_unlock(&output->delay_mutex);
 }
 
+static inline struct delay_data *get_delay_data(struct obs_output *output,
+		size_t offset)
+{
+	/* the queue only ever holds whole entries and grows by doubling, so
+	 * an entry never wraps around the end of the buffer */
+	return circlebuf_data(&output->delay_data, offset);
+}
+
+/* writes the payloads waiting for the spool in queue order.  the disk is only
+ * accessed with the delay mutex unlocked, entries can't move in the meantime
+ * because they're only popped by this thread */
+static void spool_pending(struct obs_output *output)
+{
+	struct delay_spool *spool = output->delay_spool;
+	struct encoder_packet packet;
+	struct delay_data *dd;
+	bool spooled;
+
+	if (!spool)
+		return;
+
+	pthread_mutex_lock(&output->delay_mutex);
+
+	while (output->delay_spool_next < output->delay_data.size) {
+		size_t offset = output->delay_spool_next;
+
+		output->delay_spool_next += sizeof(struct delay_data);
+
+		dd = get_delay_data(output, offset);
+		if (dd->msg != DELAY_MSG_PACKET || !dd->to_spool)
+			continue;
+
+		packet = dd->packet;
+		pthread_mutex_unlock(&output->delay_mutex);
+
+		spooled = spool_write(output, spool, &packet);
+
+		pthread_mutex_lock(&output->delay_mutex);
+
+		dd = get_delay_data(output, offset);
+		dd->to_spool = false;
+
+		if (spooled) {
+			obs_encoder_packet_release(&packet);
+			dd->packet.data = NULL;
+			dd->spooled = true;
+		} else {
+			output->delay_mem_bytes += dd->packet.size;
+		}
+	}
+
+	pthread_mutex_unlock(&output->delay_mutex);
+}
+
 static inline void process_delay_data(struct obs_output *output,
 		struct delay_data *dd)
 {
 	switch (dd->msg) {
 	case DELAY_MSG_PACKET:
-		if (!delay_active(output) || !delay_capturing(output))
+		if (!delay_active(output) || !delay_capturing(output)) {
+			if (dd->spooled)
+				spool_skip(output->delay_spool, &dd->packet);
 			obs_encoder_packet_release(&dd->packet);
-		else
+		} else if (!dd->spooled ||
+		           spool_read(output, output->delay_spool,
+				   &dd->packet)) {
 			output->delay_callback(output, &dd->packet);
+		}
 		break;
 	case DELAY_MSG_START:
 		obs_output_actual_start(output);
@@ -61,10 +317,36 @@ static inline void process_delay_data(struct obs_output *output,
 	}
 }
 
+static void stop_delay_thread(struct obs_output *output)
+{
+	struct delay_thread *dt = output->delay_thread;
+
+	if (!dt)
+		return;
+
+	output->delay_thread = NULL;
+
+	os_atomic_set_bool(&dt->stop, true);
+	os_event_signal(output->delay_event);
+
+	/* the output can end up being stopped from the delay thread itself,
+	 * in which case it exits and frees itself once it sees the stop
+	 * flag */
+	if (pthread_equal(pthread_self(), dt->thread)) {
+		dt->detached = true;
+		pthread_detach(dt->thread);
+	} else {
+		pthread_join(dt->thread, NULL);
+		bfree(dt);
+	}
+}
+
 void obs_output_cleanup_delay(obs_output_t *output)
 {
 	struct delay_data dd;
 
+	stop_delay_thread(output);
+
 	while (output->delay_data.size) {
 		circlebuf_pop_front(&output->delay_data, &dd, sizeof(dd));
 		if (dd.msg == DELAY_MSG_PACKET) {
@@ -72,11 +354,18 @@ void obs_output_cleanup_delay(obs_output_t *output)
 		}
 	}
 
+	spool_destroy(output->delay_spool);
+	output->delay_spool = NULL;
+	output->delay_spool_next = 0;
+	output->delay_mem_bytes = 0;
+
 	output->active_delay_ns = 0;
 	os_atomic_set_long(&output->delay_restart_refs, 0);
 }
 
-static inline bool pop_packet(struct obs_output *output, uint64_t t)
+/* pops the next entry if it is due, otherwise returns how long until it is */
+static inline bool pop_packet(struct obs_output *output, uint64_t t,
+		uint64_t *wait_ns)
 {
 	uint64_t elapsed_time;
 	struct delay_data dd;
@@ -87,6 +376,9 @@ static inline bool pop_packet(struct obs_output *output, uint64_t t)
 
 	preserve = (output->delay_cur_flags & OBS_OUTPUT_DELAY_PRESERVE) != 0;
 
+	if (wait_ns)
+		*wait_ns = MAX_DELAY_WAIT_NS;
+
 	pthread_mutex_lock(&output->delay_mutex);
 
 	if (output->delay_data.size) {
@@ -99,7 +391,17 @@ static inline bool pop_packet(struct obs_output *output, uint64_t t)
 		} else if (elapsed_time > output->active_delay_ns) {
 			circlebuf_pop_front(&output->delay_data, NULL,
 					sizeof(dd));
+			if (output->delay_spool_next >= sizeof(dd))
+				output->delay_spool_next -= sizeof(dd);
+			if (dd.msg == DELAY_MSG_PACKET && !dd.spooled &&
+			    !dd.to_spool)
+				output->delay_mem_bytes -= dd.packet.size;
 			popped = true;
+
+		} else if (wait_ns &&
+		           output->active_delay_ns - elapsed_time <
+		           MAX_DELAY_WAIT_NS) {
+			*wait_ns = output->active_delay_ns - elapsed_time;
 		}
 	}
 
@@ -113,12 +415,64 @@ static inline bool pop_packet(struct obs_output *output, uint64_t t)
 	return popped;
 }
 
+static void *delay_thread(void *data)
+{
+	struct delay_thread *dt = data;
+	struct obs_output *output = dt->output;
+	uint64_t wait_ns;
+
+	os_set_thread_name("libobs: output delay thread");
+
+	while (!os_atomic_load_bool(&dt->stop)) {
+		spool_pending(output);
+
+		if (pop_packet(output, os_gettime_ns(), &wait_ns))
+			continue;
+
+		os_event_timedwait(output->delay_event,
+				(unsigned long)((wait_ns + 999999) / 1000000));
+	}
+
+	if (dt->detached)
+		bfree(dt);
+	return NULL;
+}
+
+void obs_output_delay_init(obs_output_t *output)
+{
+	struct delay_thread *dt = bzalloc(sizeof(struct delay_thread));
+
+	if (output->delay_spool_dir && output->delay_spool_size)
+		output->delay_spool = spool_create(output);
+
+	dt->output = output;
+
+	if (pthread_create(&dt->thread, NULL, delay_thread, dt) != 0) {
+		blog(LOG_WARNING, "Output '%s': failed to create delay "
+		                  "thread, delayed packets will be sent from "
+		                  "the encoder thread",
+		                  output->context.name);
+
+		/* the spool is only written by the delay thread */
+		spool_destroy(output->delay_spool);
+		output->delay_spool = NULL;
+		bfree(dt);
+		return;
+	}
+
+	output->delay_thread = dt;
+}
+
 void process_delay(void *data, struct encoder_packet *packet)
 {
 	struct obs_output *output = data;
 	uint64_t t = os_gettime_ns();
 	push_packet(output, packet, t);
-	while (pop_packet(output, t));
+
+	if (output->delay_thread)
+		os_event_signal(output->delay_event);
+	else
+		while (pop_packet(output, t, NULL));
 }
 
 void obs_output_signal_delay(obs_output_t *output, const char *signal)
@@ -197,6 +551,18 @@ void obs_output_set_delay(obs_output_t *output, uint32_t delay_sec,
 	output->delay_flags = flags;
 }
 
+void obs_output_set_delay_spool(obs_output_t *output, const char *dir,
+		uint64_t max_memory, uint64_t spool_size)
+{
+	if (!obs_output_valid(output, "obs_output_set_delay_spool"))
+		return;
+
+	bfree(output->delay_spool_dir);
+	output->delay_spool_dir  = dir && *dir ? bstrdup(dir) : NULL;
+	output->delay_max_memory = max_memory;
+	output->delay_spool_size = spool_size;
+}
+
 uint32_t obs_output_get_delay(const obs_output_t *output)
 {
 	return obs_output_valid(output, "obs_output_set_delay") ?
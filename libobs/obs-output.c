@@ -20,11 +20,6 @@
 #include "obs.h"
 #include "obs-internal.h"
 
-#if BUILD_CAPTIONS
-#include <caption/caption.h>
-#include <caption/avc.h>
-#endif
-
 static inline bool active(const struct obs_output *output)
 {
 	return os_atomic_load_bool(&output->active);
@@ -97,23 +92,25 @@ static bool init_output_handlers(struct obs_output *output, const char *name,
 obs_output_t *obs_output_create(const char *id, const char *name,
 		obs_data_t *settings, obs_data_t *hotkey_data)
 {
-	const struct obs_output_info *info = find_output(id);
+	const struct obs_output_info *info;
 	struct obs_output *output;
 	int ret;
 
+	obs_load_deferred_module(OBS_OBJ_TYPE_OUTPUT, id);
+	info = find_output(id);
+
 	output = bzalloc(sizeof(struct obs_output));
 	pthread_mutex_init_value(&output->interleaved_mutex);
 	pthread_mutex_init_value(&output->delay_mutex);
-	pthread_mutex_init_value(&output->caption_mutex);
 
 	if (pthread_mutex_init(&output->interleaved_mutex, NULL) != 0)
 		goto fail;
 	if (pthread_mutex_init(&output->delay_mutex, NULL) != 0)
 		goto fail;
-	if (pthread_mutex_init(&output->caption_mutex, NULL) != 0)
-		goto fail;
 	if (os_event_init(&output->stopping_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
+	if (os_event_init(&output->delay_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
 	if (!init_output_handlers(output, name, settings, hotkey_data))
 		goto fail;
 
@@ -189,6 +186,7 @@ void obs_output_destroy(obs_output_t *output)
 			output->info.destroy(output->context.data);
 
 		free_packets(output);
+		obs_output_cleanup_delay(output);
 
 		if (output->video_encoder) {
 			obs_encoder_remove_output(output->video_encoder,
@@ -204,12 +202,13 @@ void obs_output_destroy(obs_output_t *output)
 		}
 
 		os_event_destroy(output->stopping_event);
-		pthread_mutex_destroy(&output->caption_mutex);
+		os_event_destroy(output->delay_event);
 		pthread_mutex_destroy(&output->interleaved_mutex);
 		pthread_mutex_destroy(&output->delay_mutex);
 		os_event_destroy(output->reconnect_stop_event);
 		obs_context_data_free(&output->context);
 		circlebuf_free(&output->delay_data);
+		bfree(output->delay_spool_dir);
 		if (output->owns_info_id)
 			bfree((void*)output->info.id);
 		if (output->last_error_message)
@@ -248,7 +247,6 @@ bool obs_output_actual_start(obs_output_t *output)
 	if (os_atomic_load_long(&output->delay_restart_refs))
 		os_atomic_dec_long(&output->delay_restart_refs);
 
-	output->caption_timestamp = 0;
 	return success;
 }
 
@@ -368,12 +366,6 @@ void obs_output_actual_stop(obs_output_t *output, bool force, uint64_t ts)
 		signal_stop(output);
 		os_event_signal(output->stopping_event);
 	}
-
-	while (output->caption_head) {
-		output->caption_tail = output->caption_head->next;
-		bfree(output->caption_head);
-		output->caption_head = output->caption_tail;
-	}
 }
 
 void obs_output_stop(obs_output_t *output)
@@ -429,12 +421,16 @@ static inline obs_data_t *get_defaults(const struct obs_output_info *info)
 
 obs_data_t *obs_output_defaults(const char *id)
 {
+	obs_load_deferred_module(OBS_OBJ_TYPE_OUTPUT, id);
+
 	const struct obs_output_info *info = find_output(id);
 	return (info) ? get_defaults(info) : NULL;
 }
 
 obs_properties_t *obs_get_output_properties(const char *id)
 {
+	obs_load_deferred_module(OBS_OBJ_TYPE_OUTPUT, id);
+
 	const struct obs_output_info *info = find_output(id);
 	if (info && info->get_properties) {
 		obs_data_t       *defaults = get_defaults(info);
@@ -683,12 +679,22 @@ uint64_t obs_output_get_total_bytes(const obs_output_t *output)
 
 int obs_output_get_frames_dropped(const obs_output_t *output)
 {
+	struct obs_encoder_queue_stats stats;
+	int dropped = 0;
+
 	if (!obs_output_valid(output, "obs_output_get_frames_dropped"))
 		return 0;
-	if (!output->info.get_dropped_frames)
-		return 0;
 
-	return output->info.get_dropped_frames(output->context.data);
+	if (output->info.get_dropped_frames)
+		dropped = output->info.get_dropped_frames(
+				output->context.data);
+
+	/* frames the encoder thread couldn't keep up with */
+	if (output->video_encoder && output->video_encoder->threaded &&
+	    obs_encoder_get_queue_stats(output->video_encoder, &stats))
+		dropped += (int)stats.dropped;
+
+	return dropped;
 }
 
 int obs_output_get_total_frames(const obs_output_t *output)
@@ -960,56 +966,6 @@ static inline bool has_higher_opposing_ts(struct obs_output *output,
 		return output->highest_video_ts > packet->dts_usec;
 }
 
-#if BUILD_CAPTIONS
-static const uint8_t nal_start[4] = {0, 0, 0, 1};
-
-static bool add_caption(struct obs_output *output, struct encoder_packet *out)
-{
-	struct encoder_packet backup = *out;
-	caption_frame_t cf;
-	sei_t sei;
-	uint8_t *data;
-	size_t size;
-	long ref = 1;
-
-	DARRAY(uint8_t) out_data;
-
-	if (out->priority > 1)
-		return false;
-
-	sei_init(&sei);
-
-	da_init(out_data);
-	da_push_back_array(out_data, &ref, sizeof(ref));
-	da_push_back_array(out_data, out->data, out->size);
-
-	caption_frame_init(&cf);
-	caption_frame_from_text(&cf, &output->caption_head->text[0]);
-
-	sei_from_caption_frame(&sei, &cf);
-
-	data = malloc(sei_render_size(&sei));
-	size = sei_render(&sei, data);
-	/* TODO SEI should come after AUD/SPS/PPS, but before any VCL */
-	da_push_back_array(out_data, nal_start, 4);
-	da_push_back_array(out_data, data, size);
-	free(data);
-
-	obs_encoder_packet_release(out);
-
-	*out = backup;
-	out->data = (uint8_t*)out_data.array + sizeof(ref);
-	out->size = out_data.num - sizeof(ref);
-
-	sei_free(&sei);
-
-	struct caption_text *next = output->caption_head->next;
-	bfree(output->caption_head);
-	output->caption_head = next;
-	return true;
-}
-#endif
-
 static inline void send_interleaved(struct obs_output *output)
 {
 	struct encoder_packet out = output->interleaved_packets.array[0];
@@ -1022,33 +978,9 @@ static inline void send_interleaved(struct obs_output *output)
 
 	da_erase(output->interleaved_packets, 0);
 
-	if (out.type == OBS_ENCODER_VIDEO) {
+	if (out.type == OBS_ENCODER_VIDEO)
 		output->total_frames++;
 
-#if BUILD_CAPTIONS
-		pthread_mutex_lock(&output->caption_mutex);
-
-		double frame_timestamp = (out.pts * out.timebase_num) /
-			(double)out.timebase_den;
-
-		/* TODO if output->caption_timestamp is more than 5 seconds
-		 * old, send empty frame */
-		if (output->caption_head &&
-		    output->caption_timestamp <= frame_timestamp) {
-			blog(LOG_INFO,"Sending caption: %f \"%s\"",
-					frame_timestamp,
-					&output->caption_head->text[0]);
-
-			if (add_caption(output, &out)) {
-				output->caption_timestamp =
-					frame_timestamp + 2.0;
-			}
-		}
-
-		pthread_mutex_unlock(&output->caption_mutex);
-#endif
-	}
-
 	output->info.encoded_packet(output->context.data, &out);
 	obs_encoder_packet_release(&out);
 }
@@ -1390,6 +1322,8 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 
 	if (packet->type == OBS_ENCODER_AUDIO)
 		packet->track_idx = get_track_index(output, packet);
+	else
+		obs_output_dbr_update(output);
 
 	pthread_mutex_lock(&output->interleaved_mutex);
 
@@ -1410,7 +1344,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->active_delay_ns)
 		out = *packet;
 	else
-		obs_encoder_packet_create_instance(&out, packet);
+		obs_encoder_packet_ref(&out, packet);
 
 	if (was_started)
 		apply_interleaved_packet_offset(output, &out);
@@ -1448,8 +1382,10 @@ static void default_encoded_callback(void *param, struct encoder_packet *packet)
 
 		output->info.encoded_packet(output->context.data, packet);
 
-		if (packet->type == OBS_ENCODER_VIDEO)
+		if (packet->type == OBS_ENCODER_VIDEO) {
 			output->total_frames++;
+			obs_output_dbr_update(output);
+		}
 	}
 
 	if (output->active_delay_ns)
@@ -1526,6 +1462,7 @@ static void hook_data_capture(struct obs_output *output, bool encoded,
 			output->delay_callback = encoded_callback;
 			encoded_callback = process_delay;
 			os_atomic_set_bool(&output->delay_active, true);
+			obs_output_delay_init(output);
 
 			blog(LOG_INFO, "Output '%s': %"PRIu32" second delay "
 			               "active, preserve on disconnect is %s",
@@ -1740,6 +1677,9 @@ bool obs_output_begin_data_capture(obs_output_t *output, uint32_t flags)
 				has_service))
 		return false;
 
+	if (encoded && has_video)
+		obs_output_dbr_start(output);
+
 	os_atomic_set_bool(&output->data_active, true);
 	hook_data_capture(output, encoded, has_video, has_audio);
 
@@ -1795,6 +1735,8 @@ static void *end_data_capture_thread(void *data)
 					encoded_callback, output);
 		if (has_audio)
 			stop_audio_encoders(output, encoded_callback);
+		if (has_video)
+			obs_output_dbr_stop(output);
 	} else {
 		if (has_video)
 			video_output_disconnect(output->video,
@@ -2057,21 +1999,6 @@ const char *obs_output_get_id(const obs_output_t *output)
 }
 
 #if BUILD_CAPTIONS
-static struct caption_text *caption_text_new(const char *text, size_t bytes,
-		struct caption_text *tail, struct caption_text **head)
-{
-	struct caption_text *next = bzalloc(sizeof(struct caption_text));
-	snprintf(&next->text[0], CAPTION_LINE_BYTES + 1, "%.*s", bytes, text);
-
-	if (!*head) {
-		*head = next;
-	} else {
-		tail->next = next;
-	}
-
-	return next;
-}
-
 void obs_output_output_caption_text1(obs_output_t *output, const char *text)
 {
 	if (!obs_output_valid(output, "obs_output_output_caption_text1"))
@@ -2079,38 +2006,10 @@ void obs_output_output_caption_text1(obs_output_t *output, const char *text)
 	if (!active(output))
 		return;
 
-	// split text into 32 character strings
-	int size = (int)strlen(text);
-	int r;
-	size_t char_count;
-	size_t line_length = 0;
-	size_t trimmed_length = 0;
-
-	blog(LOG_DEBUG, "Caption text: %s", text);
-
-	pthread_mutex_lock(&output->caption_mutex);
-
-	for (r = 0 ; 0 < size && CAPTION_LINE_CHARS > r; ++r) {
-		line_length = utf8_line_length(text);
-		trimmed_length = utf8_trimmed_length(text, line_length);
-		char_count = utf8_char_count(text, trimmed_length);
-
-		if (SCREEN_COLS < char_count) {
-			char_count = utf8_wrap_length(text, CAPTION_LINE_CHARS);
-			line_length = utf8_string_length(text, char_count + 1);
-		}
-
-		output->caption_tail = caption_text_new(
-				text,
-				line_length,
-				output->caption_tail,
-				&output->caption_head);
-
-		text += line_length;
-		size -= (int)line_length;
-	}
-
-	pthread_mutex_unlock(&output->caption_mutex);
+	/* captions are inserted by the video encoder, so that the packets it
+	 * sends out are already captioned for every output */
+	if (output->video_encoder)
+		obs_encoder_add_caption_text(output->video_encoder, text);
 }
 #endif
 
@@ -211,6 +211,7 @@ static inline void detach_sceneitem(struct obs_scene_item *item)
 	if (item->next)
 		item->next->prev = item->prev;
 
+	obs_source_dirty(item->parent->source);
 	item->parent = NULL;
 }
 
@@ -231,6 +232,8 @@ static inline void attach_sceneitem(struct obs_scene *parent,
 			parent->first_item->prev = item;
 		parent->first_item = item;
 	}
+
+	obs_source_dirty(parent->source);
 }
 
 void add_alignment(struct vec2 *v, uint32_t align, int cx, int cy)
@@ -326,6 +329,9 @@ static void update_item_transform(struct obs_scene_item *item)
 	if (os_atomic_load_long(&item->defer_update) > 0)
 		return;
 
+	if (item->parent)
+		obs_source_dirty(item->parent->source);
+
 	width = cx;
 	height = cy;
 
@@ -1411,6 +1417,8 @@ obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source)
 
 	full_unlock(scene);
 
+	obs_source_dirty(scene->source);
+
 	if (!scene->source->context.private)
 		init_hotkeys(scene, item, obs_source_get_name(source));
 
@@ -1561,6 +1569,8 @@ static inline void signal_reorder(struct obs_scene_item *item)
 
 	command = "reorder";
 
+	obs_source_dirty(item->parent->source);
+
 	calldata_init_fixed(&params, stack, sizeof(stack));
 	calldata_set_ptr(&params, "scene", item->parent);
 
@@ -1784,6 +1794,7 @@ bool obs_sceneitem_set_visible(obs_sceneitem_t *item, bool visible)
 	}
 
 	item->user_visible = visible;
+	obs_source_dirty(item->parent->source);
 
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "scene", item->parent);
@@ -1820,6 +1831,7 @@ bool obs_sceneitem_set_locked(obs_sceneitem_t *item, bool lock)
 		return false;
 
 	item->locked = lock;
+	obs_source_dirty(item->parent->source);
 
 	return true;
 }
@@ -2019,6 +2031,9 @@ obs_data_t *obs_sceneitem_get_private_settings(obs_sceneitem_t *item)
 	if (!obs_ptr_valid(item, "obs_sceneitem_get_private_settings"))
 		return NULL;
 
+	if (item->parent)
+		obs_source_dirty(item->parent->source);
+
 	obs_data_addref(item->private_settings);
 	return item->private_settings;
 }
@@ -37,9 +37,12 @@ static obs_service_t *obs_service_create_internal(const char *id,
 		const char *name, obs_data_t *settings, obs_data_t *hotkey_data,
 		bool private)
 {
-	const struct obs_service_info *info = find_service(id);
+	const struct obs_service_info *info;
 	struct obs_service *service;
 
+	obs_load_deferred_module(OBS_OBJ_TYPE_SERVICE, id);
+	info = find_service(id);
+
 	if (!info) {
 		blog(LOG_ERROR, "Service '%s' not found", id);
 		return NULL;
@@ -129,12 +132,16 @@ static inline obs_data_t *get_defaults(const struct obs_service_info *info)
 
 obs_data_t *obs_service_defaults(const char *id)
 {
+	obs_load_deferred_module(OBS_OBJ_TYPE_SERVICE, id);
+
 	const struct obs_service_info *info = find_service(id);
 	return (info) ? get_defaults(info) : NULL;
 }
 
 obs_properties_t *obs_get_service_properties(const char *id)
 {
+	obs_load_deferred_module(OBS_OBJ_TYPE_SERVICE, id);
+
 	const struct obs_service_info *info = find_service(id);
 	if (info && info->get_properties) {
 		obs_data_t       *defaults = get_defaults(info);
@@ -176,6 +176,14 @@ bool obs_source_init(struct obs_source *source)
 	source->control->source = source;
 	source->audio_mixers = 0xFF;
 
+	source->private_settings = obs_data_create();
+	return true;
+}
+
+/* makes the source visible to the rest of libobs: the source list, name
+ * lookups, the tick loop and the audio thread */
+static void obs_source_publish(obs_source_t *source)
+{
 	if (is_audio_source(source)) {
 		pthread_mutex_lock(&obs->data.audio_sources_mutex);
 
@@ -190,12 +198,9 @@ bool obs_source_init(struct obs_source *source)
 		pthread_mutex_unlock(&obs->data.audio_sources_mutex);
 	}
 
-	source->private_settings = obs_data_create();
-
 	obs_context_data_insert(&source->context,
 			&obs->data.sources_mutex,
 			&obs->data.first_source);
-	return true;
 }
 
 static bool obs_source_hotkey_mute(void *data,
@@ -292,12 +297,14 @@ static void obs_source_init_audio_hotkeys(struct obs_source *source)
 			obs_source_hotkey_push_to_talk, source);
 }
 
-static obs_source_t *obs_source_create_internal(const char *id,
+static obs_source_t *obs_source_create_begin(const char *id,
 		const char *name, obs_data_t *settings,
-		obs_data_t *hotkey_data, bool private)
+		obs_data_t *hotkey_data, bool private, bool publish)
 {
 	struct obs_source *source = bzalloc(sizeof(struct obs_source));
 
+	obs_load_deferred_module(OBS_OBJ_TYPE_SOURCE, id);
+
 	const struct obs_source_info *info = get_source_info(id);
 	if (!info) {
 		blog(LOG_ERROR, "Source ID '%s' not found", id);
@@ -329,29 +336,69 @@ static obs_source_t *obs_source_create_internal(const char *id,
 	if (!obs_source_init(source))
 		goto fail;
 
+	if (publish)
+		obs_source_publish(source);
+
 	if (!private)
 		obs_source_init_audio_hotkeys(source);
 
+	return source;
+
+fail:
+	blog(LOG_ERROR, "obs_source_create failed");
+	obs_source_destroy(source);
+	return NULL;
+}
+
+void *obs_source_create_data(obs_source_t *source)
+{
 	/* allow the source to be created even if creation fails so that the
 	 * user's data doesn't become lost */
-	if (info)
-		source->context.data = info->create(source->context.settings,
-				source);
+	if (!source->info.create)
+		return NULL;
+
+	return source->info.create(source->context.settings, source);
+}
+
+void obs_source_create_finish(obs_source_t *source, void *data,
+		bool publish)
+{
+	const char *name = source->context.name;
+
+	source->context.data = data;
 	if (!source->context.data)
 		blog(LOG_ERROR, "Failed to create source '%s'!", name);
 
+	if (publish)
+		obs_source_publish(source);
+
 	blog(LOG_DEBUG, "%ssource '%s' (%s) created",
-			private ? "private " : "", name, id);
+			source->context.private ? "private " : "", name,
+			source->info.id);
 	obs_source_dosignal(source, "source_create", NULL);
 
 	source->flags = source->default_flags;
 	source->enabled = true;
-	return source;
+}
 
-fail:
-	blog(LOG_ERROR, "obs_source_create failed");
-	obs_source_destroy(source);
-	return NULL;
+obs_source_t *obs_source_create_deferred(const char *id, const char *name,
+		obs_data_t *settings, obs_data_t *hotkey_data)
+{
+	return obs_source_create_begin(id, name, settings, hotkey_data, false,
+			false);
+}
+
+static obs_source_t *obs_source_create_internal(const char *id,
+		const char *name, obs_data_t *settings,
+		obs_data_t *hotkey_data, bool private)
+{
+	obs_source_t *source = obs_source_create_begin(id, name, settings,
+			hotkey_data, private, true);
+	if (!source)
+		return NULL;
+
+	obs_source_create_finish(source, obs_source_create_data(source), false);
+	return source;
 }
 
 obs_source_t *obs_source_create(const char *id, const char *name,
@@ -492,10 +539,71 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 	}
 }
 
-static inline void obs_source_frame_decref(struct obs_source_frame *frame)
+static inline struct async_lent_frame *find_lent_frame(obs_source_t *source,
+		const struct obs_source_frame *frame)
 {
-	if (os_atomic_dec_long(&frame->refs) == 0)
+	for (size_t i = 0; i < source->async_lent.num; i++) {
+		struct async_lent_frame *lent = &source->async_lent.array[i];
+		if (lent->frame == frame)
+			return lent;
+	}
+
+	return NULL;
+}
+
+/* lent frames don't own their data, so they are given back to the source
+ * instead of freeing it */
+static void async_frame_destroy(obs_source_t *source,
+		struct obs_source_frame *frame)
+{
+	struct async_lent_frame *lent = find_lent_frame(source, frame);
+
+	if (lent) {
+		lent->release(lent->param);
+		da_erase(source->async_lent, lent - source->async_lent.array);
+		bfree(frame);
+	} else {
 		obs_source_frame_destroy(frame);
+	}
+}
+
+static inline void obs_source_frame_decref(obs_source_t *source,
+		struct obs_source_frame *frame)
+{
+	if (os_atomic_dec_long(&frame->refs) == 0)
+		async_frame_destroy(source, frame);
+}
+
+/* the release callbacks belong to the plugin, so all lent frames have to be
+ * given back before its data is destroyed.  frames lent after this (e.g. by a
+ * capture thread that is stopped in the destroy callback) are given back
+ * right away */
+static void release_lent_frames(obs_source_t *source)
+{
+	pthread_mutex_lock(&source->async_mutex);
+
+	source->async_lend_closed = true;
+
+	for (size_t i = source->async_cache.num; i > 0; i--) {
+		struct obs_source_frame *frame =
+			source->async_cache.array[i - 1].frame;
+
+		if (find_lent_frame(source, frame)) {
+			da_erase(source->async_cache, i - 1);
+			obs_source_frame_decref(source, frame);
+		}
+	}
+
+	da_resize(source->async_frames, 0);
+	source->cur_async_frame  = NULL;
+	source->prev_async_frame = NULL;
+
+	/* nothing should hold a frame of a destroyed source, but the data
+	 * is gone with the plugin either way */
+	while (source->async_lent.num)
+		async_frame_destroy(source, source->async_lent.array[0].frame);
+
+	pthread_mutex_unlock(&source->async_mutex);
 }
 
 static bool obs_source_filter_remove_refless(obs_source_t *source,
@@ -534,6 +642,8 @@ void obs_source_destroy(struct obs_source *source)
 
 	obs_source_dosignal(source, "source_destroy", "destroy");
 
+	release_lent_frames(source);
+
 	if (source->context.data) {
 		source->info.destroy(source->context.data);
 		source->context.data = NULL;
@@ -546,7 +656,8 @@ void obs_source_destroy(struct obs_source *source)
 	obs_hotkey_pair_unregister(source->mute_unmute_key);
 
 	for (i = 0; i < source->async_cache.num; i++)
-		obs_source_frame_decref(source->async_cache.array[i].frame);
+		obs_source_frame_decref(source,
+				source->async_cache.array[i].frame);
 
 	gs_enter_context(obs->video.graphics);
 	if (source->async_texrender)
@@ -577,6 +688,7 @@ void obs_source_destroy(struct obs_source *source)
 	da_free(source->audio_cb_list);
 	da_free(source->async_cache);
 	da_free(source->async_frames);
+	da_free(source->async_lent);
 	da_free(source->filters);
 	pthread_mutex_destroy(&source->filter_mutex);
 	pthread_mutex_destroy(&source->audio_actions_mutex);
@@ -585,6 +697,7 @@ void obs_source_destroy(struct obs_source *source)
 	pthread_mutex_destroy(&source->audio_mutex);
 	pthread_mutex_destroy(&source->async_mutex);
 	obs_data_release(source->private_settings);
+	obs_data_release(source->saved_data);
 	obs_context_data_free(&source->context);
 
 	if (source->owns_info_id)
@@ -698,18 +811,24 @@ static inline obs_data_t *get_defaults(const struct obs_source_info *info)
 
 obs_data_t *obs_source_settings(const char *id)
 {
+	obs_load_deferred_module(OBS_OBJ_TYPE_SOURCE, id);
+
 	const struct obs_source_info *info = get_source_info(id);
 	return (info) ? get_defaults(info) : NULL;
 }
 
 obs_data_t *obs_get_source_defaults(const char *id)
 {
+	obs_load_deferred_module(OBS_OBJ_TYPE_SOURCE, id);
+
 	const struct obs_source_info *info = get_source_info(id);
 	return info ? get_defaults(info) : NULL;
 }
 
 obs_properties_t *obs_get_source_properties(const char *id)
 {
+	obs_load_deferred_module(OBS_OBJ_TYPE_SOURCE, id);
+
 	const struct obs_source_info *info = get_source_info(id);
 	if (info && info->get_properties) {
 		obs_data_t       *defaults = get_defaults(info);
@@ -768,6 +887,8 @@ static void obs_source_deferred_update(obs_source_t *source)
 		source->info.update(source->context.data,
 				source->context.settings);
 
+	/* the update callback may have changed the settings */
+	obs_source_dirty(source);
 	source->defer_update = false;
 }
 
@@ -779,6 +900,8 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 	if (settings)
 		obs_data_apply(source->context.settings, settings);
 
+	obs_source_dirty(source);
+
 	if (source->info.output_flags & OBS_SOURCE_VIDEO) {
 		source->defer_update = true;
 	} else if (source->context.data && source->info.update) {
@@ -1043,6 +1166,12 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 	source->deinterlace_rendered = false;
 }
 
+uint64_t obs_source_get_tick_time(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_tick_time") ?
+		source->tick_time_ns : 0;
+}
+
 /* unless the value is 3+ hours worth of frames, this won't overflow */
 static inline uint64_t conv_frames_to_time(const size_t sample_rate,
 		const size_t frames)
@@ -1945,6 +2074,8 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_source_dirty(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -1980,6 +2111,8 @@ static bool obs_source_filter_remove_refless(obs_source_t *source,
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_source_dirty(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -2106,8 +2239,10 @@ void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
 	success = move_filter_dir(source, filter, movement);
 	pthread_mutex_unlock(&source->filter_mutex);
 
-	if (success)
+	if (success) {
+		obs_source_dirty(source);
 		obs_source_dosignal(source, NULL, "reorder_filters");
+	}
 }
 
 obs_data_t *obs_source_get_settings(const obs_source_t *source)
@@ -2265,7 +2400,8 @@ static inline bool async_texture_changed(struct obs_source *source,
 static inline void free_async_cache(struct obs_source *source)
 {
 	for (size_t i = 0; i < source->async_cache.num; i++)
-		obs_source_frame_decref(source->async_cache.array[i].frame);
+		obs_source_frame_decref(source,
+				source->async_cache.array[i].frame);
 
 	da_resize(source->async_cache, 0);
 	da_resize(source->async_frames, 0);
@@ -2380,6 +2516,87 @@ void obs_source_output_video(obs_source_t *source,
 	}
 }
 
+void obs_source_lend_video(obs_source_t *source,
+		const struct obs_source_frame *frame,
+		void (*release)(void *param), void *param)
+{
+	struct obs_source_frame *output;
+	struct async_lent_frame lent;
+	struct async_frame af;
+
+	if (!obs_source_valid(source, "obs_source_lend_video") ||
+	    !obs_ptr_valid(frame, "obs_source_lend_video")) {
+		if (frame && release)
+			release(param);
+		return;
+	}
+
+	/* Y800 is converted while caching, so it can't be used directly */
+	if (!release || frame->format == VIDEO_FORMAT_Y800) {
+		obs_source_output_video(source, frame);
+		if (release)
+			release(param);
+		return;
+	}
+
+	output = bmemdup(frame, sizeof(*frame));
+	output->refs       = 1;
+	output->prev_frame = false;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (source->async_lend_closed) {
+		pthread_mutex_unlock(&source->async_mutex);
+
+		bfree(output);
+		release(param);
+		return;
+	}
+
+	if (source->async_frames.num >= MAX_ASYNC_FRAMES) {
+		free_async_cache(source);
+		source->last_frame_ts = 0;
+		pthread_mutex_unlock(&source->async_mutex);
+
+		bfree(output);
+		release(param);
+		return;
+	}
+
+	if (async_texture_changed(source, frame)) {
+		free_async_cache(source);
+		source->async_cache_width  = frame->width;
+		source->async_cache_height = frame->height;
+		source->async_cache_format = frame->format;
+	}
+
+	lent.frame   = output;
+	lent.release = release;
+	lent.param   = param;
+	da_push_back(source->async_lent, &lent);
+
+	af.frame        = output;
+	af.used         = true;
+	af.unused_count = 0;
+	da_push_back(source->async_cache, &af);
+	da_push_back(source->async_frames, &output);
+
+	pthread_mutex_unlock(&source->async_mutex);
+
+	source->async_active = true;
+}
+
+void obs_source_reclaim_video(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_reclaim_video"))
+		return;
+
+	pthread_mutex_lock(&source->async_mutex);
+	free_async_cache(source);
+	source->last_frame_ts = 0;
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
 static inline bool preload_frame_changed(obs_source_t *source,
 		const struct obs_source_frame *in)
 {
@@ -2616,7 +2833,14 @@ void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 		struct async_frame *f = &source->async_cache.array[i];
 
 		if (f->frame == frame) {
-			f->used = false;
+			/* lent frames aren't reused, they go back to their
+			 * owner as soon as they're no longer needed */
+			if (find_lent_frame(source, frame)) {
+				da_erase(source->async_cache, i);
+				obs_source_frame_decref(source, frame);
+			} else {
+				f->used = false;
+			}
 			break;
 		}
 	}
@@ -2771,7 +2995,7 @@ void obs_source_release_frame(obs_source_t *source,
 		pthread_mutex_lock(&source->async_mutex);
 
 		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
+			async_frame_destroy(source, frame);
 		else
 			remove_async_frame(source, frame);
 
@@ -2795,6 +3019,8 @@ void obs_source_set_name(obs_source_t *source, const char *name)
 		struct calldata data;
 		char *prev_name = bstrdup(source->context.name);
 		obs_context_data_setname(&source->context, name);
+		obs_source_dirty(source);
+		obs_scenes_dirty();
 
 		calldata_init(&data);
 		calldata_set_ptr(&data, "source", source);
@@ -3058,6 +3284,7 @@ void obs_source_set_volume(obs_source_t *source, float volume)
 		pthread_mutex_unlock(&source->audio_actions_mutex);
 
 		source->user_volume = volume;
+		obs_source_dirty(source);
 	}
 }
 
@@ -3081,6 +3308,7 @@ void obs_source_set_sync_offset(obs_source_t *source, int64_t offset)
 				&data);
 
 		source->sync_offset = calldata_int(&data, "offset");
+		obs_source_dirty(source);
 	}
 }
 
@@ -3327,6 +3555,7 @@ void obs_source_set_flags(obs_source_t *source, uint32_t flags)
 
 	if (flags != source->flags) {
 		source->flags = flags;
+		obs_source_dirty(source);
 		signal_flags_updated(source);
 	}
 }
@@ -3367,6 +3596,7 @@ void obs_source_set_audio_mixers(obs_source_t *source, uint32_t mixers)
 	mixers = (uint32_t)calldata_int(&data, "mixers");
 
 	source->audio_mixers = mixers;
+	obs_source_dirty(source);
 }
 
 uint32_t obs_source_get_audio_mixers(const obs_source_t *source)
@@ -3517,6 +3747,7 @@ void obs_source_set_enabled(obs_source_t *source, bool enabled)
 		return;
 
 	source->enabled = enabled;
+	obs_source_dirty(source);
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
 	calldata_set_ptr(&data, "source", source);
@@ -3545,6 +3776,7 @@ void obs_source_set_muted(obs_source_t *source, bool muted)
 		return;
 
 	source->user_muted = muted;
+	obs_source_dirty(source);
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
 	calldata_set_ptr(&data, "source", source);
@@ -3609,6 +3841,7 @@ void obs_source_enable_push_to_mute(obs_source_t *source, bool enabled)
 				enabled ? "enabled" : "disabled");
 
 	source->push_to_mute_enabled = enabled;
+	obs_source_dirty(source);
 
 	if (changed)
 		source_signal_push_to_changed(source, "push_to_mute_changed",
@@ -3636,6 +3869,7 @@ void obs_source_set_push_to_mute_delay(obs_source_t *source, uint64_t delay)
 
 	pthread_mutex_lock(&source->audio_mutex);
 	source->push_to_mute_delay = delay;
+	obs_source_dirty(source);
 
 	source_signal_push_to_delay(source, "push_to_mute_delay", delay);
 	pthread_mutex_unlock(&source->audio_mutex);
@@ -3667,6 +3901,7 @@ void obs_source_enable_push_to_talk(obs_source_t *source, bool enabled)
 				enabled ? "enabled" : "disabled");
 
 	source->push_to_talk_enabled = enabled;
+	obs_source_dirty(source);
 
 	if (changed)
 		source_signal_push_to_changed(source, "push_to_talk_changed",
@@ -3694,6 +3929,7 @@ void obs_source_set_push_to_talk_delay(obs_source_t *source, uint64_t delay)
 
 	pthread_mutex_lock(&source->audio_mutex);
 	source->push_to_talk_delay = delay;
+	obs_source_dirty(source);
 
 	source_signal_push_to_delay(source, "push_to_talk_delay", delay);
 	pthread_mutex_unlock(&source->audio_mutex);
@@ -4042,6 +4278,7 @@ void obs_source_set_monitoring_type(obs_source_t *source,
 	}
 
 	source->monitoring_type = type;
+	obs_source_dirty(source);
 }
 
 enum obs_monitoring_type obs_source_get_monitoring_type(
@@ -130,6 +130,20 @@ enum obs_source_type {
  */
 #define OBS_SOURCE_DO_NOT_SELF_MONITOR (1<<9)
 
+/**
+ * Source create function can be called from any thread
+ *
+ * When used, specifies that the create callback can safely run on a worker
+ * thread at the same time as the create callbacks of other sources.  When a
+ * scene collection is loaded, sources of such types are created in parallel.
+ * Graphics work done in create must still be wrapped in
+ * obs_enter_graphics/obs_leave_graphics, which serializes it.
+ *
+ * The source's context data is assigned and the source_create signal is sent
+ * on the loading thread once the callback returns.
+ */
+#define OBS_SOURCE_CREATE_THREADSAFE (1<<10)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -24,6 +24,12 @@
 #include "media-io/format-conversion.h"
 #include "media-io/video-frame.h"
 
+/* smooths out the tick times shown to the user */
+static inline void update_tick_time(struct obs_source *source, uint64_t ns)
+{
+	source->tick_time_ns = (source->tick_time_ns * 7 + ns) / 8;
+}
+
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
 	struct obs_core_data *data = &obs->data;
@@ -43,7 +49,11 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 	/* call the tick function of each source */
 	source = data->first_source;
 	while (source) {
+		uint64_t start = os_gettime_ns();
+
 		obs_source_video_tick(source, seconds);
+		update_tick_time(source, os_gettime_ns() - start);
+
 		source = (struct obs_source*)source->context.next;
 	}
 
@@ -87,14 +97,51 @@ static inline void set_render_size(uint32_t width, uint32_t height)
 	gs_set_viewport(0, 0, width, height);
 }
 
-static inline void unmap_last_surface(struct obs_core_video *video)
+static inline void unmap_last_surface(struct obs_video_rendition *r)
 {
-	if (video->mapped_surface) {
-		gs_stagesurface_unmap(video->mapped_surface);
-		video->mapped_surface = NULL;
+	if (r->mapped_surface) {
+		gs_stagesurface_unmap(r->mapped_surface);
+		r->mapped_surface = NULL;
 	}
 }
 
+/* index 0 is the main rendition */
+static inline size_t num_renditions(struct obs_core_video *video)
+{
+	return video->frame_renditions.num;
+}
+
+static inline struct obs_video_rendition *get_rendition(
+		struct obs_core_video *video, size_t idx)
+{
+	return video->frame_renditions.array[idx];
+}
+
+/* takes the renditions to render this frame, and frees the ones removed since
+ * the last frame now that nothing refers to them anymore.  must be called
+ * within the graphics context */
+static inline void update_frame_renditions(struct obs_core_video *video)
+{
+	struct obs_video_rendition *main_rendition = &video->main_rendition;
+	DARRAY(struct obs_video_rendition*) removed;
+
+	da_init(removed);
+
+	pthread_mutex_lock(&video->renditions_mutex);
+
+	da_resize(video->frame_renditions, 0);
+	da_push_back(video->frame_renditions, &main_rendition);
+	if (video->renditions.num)
+		da_push_back_da(video->frame_renditions, video->renditions);
+	da_move(removed, video->removed_renditions);
+
+	pthread_mutex_unlock(&video->renditions_mutex);
+
+	for (size_t i = 0; i < removed.num; i++)
+		obs_free_video_rendition(removed.array[i]);
+	da_free(removed);
+}
+
 static const char *render_main_texture_name = "render_main_texture";
 static inline void render_main_texture(struct obs_core_video *video,
 		int cur_texture)
@@ -129,17 +176,17 @@ static inline void render_main_texture(struct obs_core_video *video,
 }
 
 static inline gs_effect_t *get_scale_effect_internal(
-		struct obs_core_video *video)
+		struct obs_core_video *video, struct obs_video_rendition *r)
 {
 	/* if the dimension is under half the size of the original image,
 	 * bicubic/lanczos can't sample enough pixels to create an accurate
 	 * image, so use the bilinear low resolution effect instead */
-	if (video->output_width  < (video->base_width  / 2) &&
-	    video->output_height < (video->base_height / 2)) {
+	if (r->output_width  < (video->base_width  / 2) &&
+	    r->output_height < (video->base_height / 2)) {
 		return video->bilinear_lowres_effect;
 	}
 
-	switch (video->scale_type) {
+	switch (r->scale_type) {
 	case OBS_SCALE_BILINEAR: return video->default_effect;
 	case OBS_SCALE_LANCZOS:  return video->lanczos_effect;
 	case OBS_SCALE_BICUBIC:
@@ -159,14 +206,14 @@ static inline bool resolution_close(struct obs_core_video *video,
 }
 
 static inline gs_effect_t *get_scale_effect(struct obs_core_video *video,
-		uint32_t width, uint32_t height)
+		struct obs_video_rendition *r, uint32_t width, uint32_t height)
 {
 	if (resolution_close(video, width, height)) {
 		return video->default_effect;
 	} else {
 		/* if the scale method couldn't be loaded, use either bicubic
 		 * or bilinear by default */
-		gs_effect_t *effect = get_scale_effect_internal(video);
+		gs_effect_t *effect = get_scale_effect_internal(video, r);
 		if (!effect)
 			effect = !!video->bicubic_effect ?
 				video->bicubic_effect :
@@ -177,12 +224,12 @@ static inline gs_effect_t *get_scale_effect(struct obs_core_video *video,
 
 static const char *render_output_texture_name = "render_output_texture";
 static inline void render_output_texture(struct obs_core_video *video,
-		int cur_texture, int prev_texture)
+		struct obs_video_rendition *r, int cur_texture, int prev_texture)
 {
 	profile_start(render_output_texture_name);
 
 	gs_texture_t *texture = video->render_textures[prev_texture];
-	gs_texture_t *target  = video->output_textures[cur_texture];
+	gs_texture_t *target  = r->output_textures[cur_texture];
 	uint32_t     width   = gs_texture_get_width(target);
 	uint32_t     height  = gs_texture_get_height(target);
 	struct vec2  base_i;
@@ -191,7 +238,7 @@ static inline void render_output_texture(struct obs_core_video *video,
 		1.0f / (float)video->base_width,
 		1.0f / (float)video->base_height);
 
-	gs_effect_t    *effect  = get_scale_effect(video, width, height);
+	gs_effect_t    *effect  = get_scale_effect(video, r, width, height);
 	gs_technique_t *tech    = gs_effect_get_technique(effect, "DrawMatrix");
 	gs_eparam_t    *image   = gs_effect_get_param_by_name(effect, "image");
 	gs_eparam_t    *matrix  = gs_effect_get_param_by_name(effect,
@@ -200,7 +247,7 @@ static inline void render_output_texture(struct obs_core_video *video,
 			"base_dimension_i");
 	size_t      passes, i;
 
-	if (!video->textures_rendered[prev_texture])
+	if (!video->textures_rendered[prev_texture] || !r->started)
 		goto end;
 
 	gs_set_render_target(target, NULL);
@@ -222,7 +269,7 @@ static inline void render_output_texture(struct obs_core_video *video,
 	gs_technique_end(tech);
 	gs_enable_blending(true);
 
-	video->textures_output[cur_texture] = true;
+	r->textures_output[cur_texture] = true;
 
 end:
 	profile_end(render_output_texture_name);
@@ -236,26 +283,26 @@ static inline void set_eparam(gs_effect_t *effect, const char *name, float val)
 
 static const char *render_convert_texture_name = "render_convert_texture";
 static void render_convert_texture(struct obs_core_video *video,
-		int cur_texture, int prev_texture)
+		struct obs_video_rendition *r, int cur_texture, int prev_texture)
 {
 	profile_start(render_convert_texture_name);
 
-	gs_texture_t *texture = video->output_textures[prev_texture];
-	gs_texture_t *target  = video->convert_textures[cur_texture];
-	float        fwidth  = (float)video->output_width;
-	float        fheight = (float)video->output_height;
+	gs_texture_t *texture = r->output_textures[prev_texture];
+	gs_texture_t *target  = r->convert_textures[cur_texture];
+	float        fwidth  = (float)r->output_width;
+	float        fheight = (float)r->output_height;
 	size_t       passes, i;
 
 	gs_effect_t    *effect  = video->conversion_effect;
 	gs_eparam_t    *image   = gs_effect_get_param_by_name(effect, "image");
 	gs_technique_t *tech    = gs_effect_get_technique(effect,
-			video->conversion_tech);
+			r->conversion_tech);
 
-	if (!video->textures_output[prev_texture])
+	if (!r->textures_output[prev_texture])
 		goto end;
 
-	set_eparam(effect, "u_plane_offset", (float)video->plane_offsets[1]);
-	set_eparam(effect, "v_plane_offset", (float)video->plane_offsets[2]);
+	set_eparam(effect, "u_plane_offset", (float)r->plane_offsets[1]);
+	set_eparam(effect, "v_plane_offset", (float)r->plane_offsets[2]);
 	set_eparam(effect, "width",  fwidth);
 	set_eparam(effect, "height", fheight);
 	set_eparam(effect, "width_i",  1.0f / fwidth);
@@ -264,61 +311,103 @@ static void render_convert_texture(struct obs_core_video *video,
 	set_eparam(effect, "height_d2", fheight * 0.5f);
 	set_eparam(effect, "width_d2_i",  1.0f / (fwidth  * 0.5f));
 	set_eparam(effect, "height_d2_i", 1.0f / (fheight * 0.5f));
-	set_eparam(effect, "input_height", (float)video->conversion_height);
+	set_eparam(effect, "input_height", (float)r->conversion_height);
 
 	gs_effect_set_texture(image, texture);
 
 	gs_set_render_target(target, NULL);
-	set_render_size(video->output_width, video->conversion_height);
+	set_render_size(r->output_width, r->conversion_height);
 
 	gs_enable_blending(false);
 	passes = gs_technique_begin(tech);
 	for (i = 0; i < passes; i++) {
 		gs_technique_begin_pass(tech, i);
-		gs_draw_sprite(texture, 0, video->output_width,
-				video->conversion_height);
+		gs_draw_sprite(texture, 0, r->output_width,
+				r->conversion_height);
 		gs_technique_end_pass(tech);
 	}
 	gs_technique_end(tech);
 	gs_enable_blending(true);
 
-	video->textures_converted[cur_texture] = true;
+	r->textures_converted[cur_texture] = true;
 
 end:
 	profile_end(render_convert_texture_name);
 }
 
 static const char *stage_output_texture_name = "stage_output_texture";
-static inline void stage_output_texture(struct obs_core_video *video,
+static inline void stage_output_texture(struct obs_video_rendition *r,
 		int cur_texture, int prev_texture)
 {
 	profile_start(stage_output_texture_name);
 
 	gs_texture_t   *texture;
 	bool        texture_ready;
-	gs_stagesurf_t *copy = video->copy_surfaces[cur_texture];
+	gs_stagesurf_t *copy = r->copy_surfaces[cur_texture];
 
-	if (video->gpu_conversion) {
-		texture = video->convert_textures[prev_texture];
-		texture_ready = video->textures_converted[prev_texture];
+	if (r->gpu_conversion) {
+		texture = r->convert_textures[prev_texture];
+		texture_ready = r->textures_converted[prev_texture];
 	} else {
-		texture = video->output_textures[prev_texture];
-		texture_ready = video->textures_output[prev_texture];
+		texture = r->output_textures[prev_texture];
+		texture_ready = r->textures_output[prev_texture];
 	}
 
-	unmap_last_surface(video);
+	unmap_last_surface(r);
 
 	if (!texture_ready)
 		goto end;
 
 	gs_stage_texture(copy, texture);
 
-	video->textures_copied[cur_texture] = true;
+	r->textures_copied[cur_texture] = true;
 
 end:
 	profile_end(stage_output_texture_name);
 }
 
+static inline void render_rendition(struct obs_core_video *video,
+		struct obs_video_rendition *r, int cur_texture,
+		int prev_texture)
+{
+	render_output_texture(video, r, cur_texture, prev_texture);
+	if (r->gpu_conversion)
+		render_convert_texture(video, r, cur_texture, prev_texture);
+
+	stage_output_texture(r, cur_texture, prev_texture);
+
+	/* output starts with the next frame, which samples the main texture
+	 * rendered in this one */
+	r->started = true;
+}
+
+/* renditions nothing is connected to are not rendered, staged or downloaded.
+ * the main rendition is always rendered */
+static inline bool rendition_active(struct obs_core_video *video,
+		struct obs_video_rendition *r)
+{
+	return r == &video->main_rendition || video_output_active(r->video);
+}
+
+/* drops everything in flight for an inactive rendition, so that it starts
+ * over like a new rendition once something connects to it again */
+static inline void stop_rendition(struct obs_video_rendition *r)
+{
+	if (!r->started)
+		return;
+
+	unmap_last_surface(r);
+
+	memset(r->textures_output, 0, sizeof(r->textures_output));
+	memset(r->textures_converted, 0, sizeof(r->textures_converted));
+	memset(r->textures_copied, 0, sizeof(r->textures_copied));
+
+	circlebuf_pop_front(&r->vframe_info_buffer, NULL,
+			r->vframe_info_buffer.size);
+
+	r->started = false;
+}
+
 static inline void render_video(struct obs_core_video *video, int cur_texture,
 		int prev_texture)
 {
@@ -328,11 +417,15 @@ static inline void render_video(struct obs_core_video *video, int cur_texture,
 	gs_set_cull_mode(GS_NEITHER);
 
 	render_main_texture(video, cur_texture);
-	render_output_texture(video, cur_texture, prev_texture);
-	if (video->gpu_conversion)
-		render_convert_texture(video, cur_texture, prev_texture);
 
-	stage_output_texture(video, cur_texture, prev_texture);
+	for (size_t i = 0; i < num_renditions(video); i++) {
+		struct obs_video_rendition *r = get_rendition(video, i);
+
+		if (rendition_active(video, r))
+			render_rendition(video, r, cur_texture, prev_texture);
+		else
+			stop_rendition(r);
+	}
 
 	gs_set_render_target(NULL, NULL);
 	gs_enable_blending(true);
@@ -340,21 +433,32 @@ static inline void render_video(struct obs_core_video *video, int cur_texture,
 	gs_end_scene();
 }
 
-static inline bool download_frame(struct obs_core_video *video,
+static inline bool download_frame(struct obs_video_rendition *r,
 		int prev_texture, struct video_data *frame)
 {
-	gs_stagesurf_t *surface = video->copy_surfaces[prev_texture];
+	gs_stagesurf_t *surface = r->copy_surfaces[prev_texture];
 
-	if (!video->textures_copied[prev_texture])
+	if (!r->textures_copied[prev_texture])
 		return false;
 
 	if (!gs_stagesurface_map(surface, &frame->data[0], &frame->linesize[0]))
 		return false;
 
-	video->mapped_surface = surface;
+	r->mapped_surface = surface;
 	return true;
 }
 
+static inline void download_frames(struct obs_core_video *video,
+		int prev_texture)
+{
+	for (size_t i = 0; i < num_renditions(video); i++) {
+		struct obs_video_rendition *r = get_rendition(video, i);
+
+		memset(&r->frame, 0, sizeof(struct video_data));
+		r->frame_ready = download_frame(r, prev_texture, &r->frame);
+	}
+}
+
 static inline uint32_t calc_linesize(uint32_t pos, uint32_t linesize)
 {
 	uint32_t size = pos % linesize;
@@ -392,7 +496,7 @@ static inline uint32_t make_aligned_linesize_offset(uint32_t offset,
 	return (offset / dst_linesize) * src_linesize + remainder;
 }
 
-static void fix_gpu_converted_alignment(struct obs_core_video *video,
+static void fix_gpu_converted_alignment(struct obs_video_rendition *r,
 		struct video_frame *output, const struct video_data *input)
 {
 	uint32_t src_linesize = input->linesize[0];
@@ -400,38 +504,38 @@ static void fix_gpu_converted_alignment(struct obs_core_video *video,
 	uint32_t src_pos      = 0;
 
 	for (size_t i = 0; i < 3; i++) {
-		if (video->plane_linewidth[i] == 0)
+		if (r->plane_linewidth[i] == 0)
 			break;
 
-		src_pos = make_aligned_linesize_offset(video->plane_offsets[i],
+		src_pos = make_aligned_linesize_offset(r->plane_offsets[i],
 				dst_linesize, src_linesize);
 
 		copy_dealign(output->data[i], 0, dst_linesize,
 				input->data[0], src_pos, src_linesize,
-				video->plane_sizes[i]);
+				r->plane_sizes[i]);
 	}
 }
 
-static void set_gpu_converted_data(struct obs_core_video *video,
+static void set_gpu_converted_data(struct obs_video_rendition *r,
 		struct video_frame *output, const struct video_data *input,
 		const struct video_output_info *info)
 {
-	if (input->linesize[0] == video->output_width*4) {
+	if (input->linesize[0] == r->output_width*4) {
 		struct video_frame frame;
 
 		for (size_t i = 0; i < 3; i++) {
-			if (video->plane_linewidth[i] == 0)
+			if (r->plane_linewidth[i] == 0)
 				break;
 
-			frame.linesize[i] = video->plane_linewidth[i];
+			frame.linesize[i] = r->plane_linewidth[i];
 			frame.data[i] =
-				input->data[0] + video->plane_offsets[i];
+				input->data[0] + r->plane_offsets[i];
 		}
 
 		video_frame_copy(output, &frame, info->format, info->height);
 
 	} else {
-		fix_gpu_converted_alignment(video, output, input);
+		fix_gpu_converted_alignment(r, output, input);
 	}
 }
 
@@ -481,20 +585,20 @@ static inline void copy_rgbx_frame(
 	}
 }
 
-static inline void output_video_data(struct obs_core_video *video,
+static inline void output_video_data(struct obs_video_rendition *r,
 		struct video_data *input_frame, int count)
 {
 	const struct video_output_info *info;
 	struct video_frame output_frame;
 	bool locked;
 
-	info = video_output_get_info(video->video);
+	info = video_output_get_info(r->video);
 
-	locked = video_output_lock_frame(video->video, &output_frame, count,
+	locked = video_output_lock_frame(r->video, &output_frame, count,
 			input_frame->timestamp);
 	if (locked) {
-		if (video->gpu_conversion) {
-			set_gpu_converted_data(video, &output_frame,
+		if (r->gpu_conversion) {
+			set_gpu_converted_data(r, &output_frame,
 					input_frame, info);
 
 		} else if (format_is_yuv(info->format)) {
@@ -503,7 +607,29 @@ static inline void output_video_data(struct obs_core_video *video,
 			copy_rgbx_frame(&output_frame, input_frame, info);
 		}
 
-		video_output_unlock_frame(video->video);
+		video_output_unlock_frame(r->video);
+	}
+}
+
+static inline void output_frames(struct obs_core_video *video)
+{
+	for (size_t i = 0; i < num_renditions(video); i++) {
+		struct obs_video_rendition *r = get_rendition(video, i);
+		struct obs_vframe_info vframe_info;
+
+		if (!r->frame_ready)
+			continue;
+
+		circlebuf_pop_front(&r->vframe_info_buffer, &vframe_info,
+				sizeof(vframe_info));
+
+		/* the last consumer may have disconnected since the frame
+		 * was rendered */
+		if (!rendition_active(video, r))
+			continue;
+
+		r->frame.timestamp = vframe_info.timestamp;
+		output_video_data(r, &r->frame, vframe_info.count);
 	}
 }
 
@@ -528,53 +654,61 @@ static inline void video_sleep(struct obs_core_video *video,
 
 	vframe_info.timestamp = cur_time;
 	vframe_info.count = count;
-	circlebuf_push_back(&video->vframe_info_buffer, &vframe_info,
-			sizeof(vframe_info));
+
+	for (size_t i = 0; i < num_renditions(video); i++) {
+		struct obs_video_rendition *r = get_rendition(video, i);
+
+		if (r->started)
+			circlebuf_push_back(&r->vframe_info_buffer,
+					&vframe_info, sizeof(vframe_info));
+	}
 }
 
 static const char *output_frame_gs_context_name = "gs_context(video->graphics)";
 static const char *output_frame_render_video_name = "render_video";
 static const char *output_frame_download_frame_name = "download_frame";
 static const char *output_frame_gs_flush_name = "gs_flush";
+static const char *output_frame_texture_pool_name = "gs_texture_pool_tick";
 static const char *output_frame_output_video_data_name = "output_video_data";
 static inline void output_frame(void)
 {
 	struct obs_core_video *video = &obs->video;
 	int cur_texture  = video->cur_texture;
 	int prev_texture = cur_texture == 0 ? NUM_TEXTURES-1 : cur_texture-1;
-	struct video_data frame;
-	bool frame_ready;
-
-	memset(&frame, 0, sizeof(struct video_data));
+	struct gs_texture_pool_stats pool_stats;
 
 	profile_start(output_frame_gs_context_name);
 	gs_enter_context(video->graphics);
 
+	update_frame_renditions(video);
+
 	profile_start(output_frame_render_video_name);
 	render_video(video, cur_texture, prev_texture);
 	profile_end(output_frame_render_video_name);
 
 	profile_start(output_frame_download_frame_name);
-	frame_ready = download_frame(video, prev_texture, &frame);
+	download_frames(video, prev_texture);
 	profile_end(output_frame_download_frame_name);
 
 	profile_start(output_frame_gs_flush_name);
 	gs_flush();
 	profile_end(output_frame_gs_flush_name);
 
+	profile_start(output_frame_texture_pool_name);
+	gs_texture_pool_tick();
+	gs_texture_pool_get_stats(&pool_stats);
+	profile_end(output_frame_texture_pool_name);
+
 	gs_leave_context();
 	profile_end(output_frame_gs_context_name);
 
-	if (frame_ready) {
-		struct obs_vframe_info vframe_info;
-		circlebuf_pop_front(&video->vframe_info_buffer, &vframe_info,
-				sizeof(vframe_info));
+	pthread_mutex_lock(&video->texture_pool_mutex);
+	video->texture_pool_stats = pool_stats;
+	pthread_mutex_unlock(&video->texture_pool_mutex);
 
-		frame.timestamp = vframe_info.timestamp;
-		profile_start(output_frame_output_video_data_name);
-		output_video_data(video, &frame, vframe_info.count);
-		profile_end(output_frame_output_video_data_name);
-	}
+	profile_start(output_frame_output_video_data_name);
+	output_frames(video);
+	profile_end(output_frame_output_video_data_name);
 
 	if (++video->cur_texture == NUM_TEXTURES)
 		video->cur_texture = 0;
@@ -47,172 +47,215 @@ static inline void make_video_info(struct video_output_info *vi,
 #define GET_ALIGN(val, align) \
 	(((val) + (align-1)) & ~(align-1))
 
-static inline void set_420p_sizes(const struct obs_video_info *ovi)
+static inline void set_420p_sizes(struct obs_video_rendition *r)
 {
-	struct obs_core_video *video = &obs->video;
 	uint32_t chroma_pixels;
 	uint32_t total_bytes;
 
-	chroma_pixels = (ovi->output_width * ovi->output_height / 4);
+	chroma_pixels = (r->output_width * r->output_height / 4);
 	chroma_pixels = GET_ALIGN(chroma_pixels, PIXEL_SIZE);
 
-	video->plane_offsets[0] = 0;
-	video->plane_offsets[1] = ovi->output_width * ovi->output_height;
-	video->plane_offsets[2] = video->plane_offsets[1] + chroma_pixels;
+	r->plane_offsets[0] = 0;
+	r->plane_offsets[1] = r->output_width * r->output_height;
+	r->plane_offsets[2] = r->plane_offsets[1] + chroma_pixels;
 
-	video->plane_linewidth[0] = ovi->output_width;
-	video->plane_linewidth[1] = ovi->output_width/2;
-	video->plane_linewidth[2] = ovi->output_width/2;
+	r->plane_linewidth[0] = r->output_width;
+	r->plane_linewidth[1] = r->output_width/2;
+	r->plane_linewidth[2] = r->output_width/2;
 
-	video->plane_sizes[0] = video->plane_offsets[1];
-	video->plane_sizes[1] = video->plane_sizes[0]/4;
-	video->plane_sizes[2] = video->plane_sizes[1];
+	r->plane_sizes[0] = r->plane_offsets[1];
+	r->plane_sizes[1] = r->plane_sizes[0]/4;
+	r->plane_sizes[2] = r->plane_sizes[1];
 
-	total_bytes = video->plane_offsets[2] + chroma_pixels;
+	total_bytes = r->plane_offsets[2] + chroma_pixels;
 
-	video->conversion_height =
-		(total_bytes/PIXEL_SIZE + ovi->output_width-1) /
-		ovi->output_width;
+	r->conversion_height =
+		(total_bytes/PIXEL_SIZE + r->output_width-1) /
+		r->output_width;
 
-	video->conversion_height = GET_ALIGN(video->conversion_height, 2);
-	video->conversion_tech = "Planar420";
+	r->conversion_height = GET_ALIGN(r->conversion_height, 2);
+	r->conversion_tech = "Planar420";
 }
 
-static inline void set_nv12_sizes(const struct obs_video_info *ovi)
+static inline void set_nv12_sizes(struct obs_video_rendition *r)
 {
-	struct obs_core_video *video = &obs->video;
 	uint32_t chroma_pixels;
 	uint32_t total_bytes;
 
-	chroma_pixels = (ovi->output_width * ovi->output_height / 2);
+	chroma_pixels = (r->output_width * r->output_height / 2);
 	chroma_pixels = GET_ALIGN(chroma_pixels, PIXEL_SIZE);
 
-	video->plane_offsets[0] = 0;
-	video->plane_offsets[1] = ovi->output_width * ovi->output_height;
+	r->plane_offsets[0] = 0;
+	r->plane_offsets[1] = r->output_width * r->output_height;
 
-	video->plane_linewidth[0] = ovi->output_width;
-	video->plane_linewidth[1] = ovi->output_width;
+	r->plane_linewidth[0] = r->output_width;
+	r->plane_linewidth[1] = r->output_width;
 
-	video->plane_sizes[0] = video->plane_offsets[1];
-	video->plane_sizes[1] = video->plane_sizes[0]/2;
+	r->plane_sizes[0] = r->plane_offsets[1];
+	r->plane_sizes[1] = r->plane_sizes[0]/2;
 
-	total_bytes = video->plane_offsets[1] + chroma_pixels;
+	total_bytes = r->plane_offsets[1] + chroma_pixels;
 
-	video->conversion_height =
-		(total_bytes/PIXEL_SIZE + ovi->output_width-1) /
-		ovi->output_width;
+	r->conversion_height =
+		(total_bytes/PIXEL_SIZE + r->output_width-1) /
+		r->output_width;
 
-	video->conversion_height = GET_ALIGN(video->conversion_height, 2);
-	video->conversion_tech = "NV12";
+	r->conversion_height = GET_ALIGN(r->conversion_height, 2);
+	r->conversion_tech = "NV12";
 }
 
-static inline void set_444p_sizes(const struct obs_video_info *ovi)
+static inline void set_444p_sizes(struct obs_video_rendition *r)
 {
-	struct obs_core_video *video = &obs->video;
 	uint32_t chroma_pixels;
 	uint32_t total_bytes;
 
-	chroma_pixels = (ovi->output_width * ovi->output_height);
+	chroma_pixels = (r->output_width * r->output_height);
 	chroma_pixels = GET_ALIGN(chroma_pixels, PIXEL_SIZE);
 
-	video->plane_offsets[0] = 0;
-	video->plane_offsets[1] = chroma_pixels;
-	video->plane_offsets[2] = chroma_pixels + chroma_pixels;
+	r->plane_offsets[0] = 0;
+	r->plane_offsets[1] = chroma_pixels;
+	r->plane_offsets[2] = chroma_pixels + chroma_pixels;
 
-	video->plane_linewidth[0] = ovi->output_width;
-	video->plane_linewidth[1] = ovi->output_width;
-	video->plane_linewidth[2] = ovi->output_width;
+	r->plane_linewidth[0] = r->output_width;
+	r->plane_linewidth[1] = r->output_width;
+	r->plane_linewidth[2] = r->output_width;
 
-	video->plane_sizes[0] = chroma_pixels;
-	video->plane_sizes[1] = chroma_pixels;
-	video->plane_sizes[2] = chroma_pixels;
+	r->plane_sizes[0] = chroma_pixels;
+	r->plane_sizes[1] = chroma_pixels;
+	r->plane_sizes[2] = chroma_pixels;
 
-	total_bytes = video->plane_offsets[2] + chroma_pixels;
+	total_bytes = r->plane_offsets[2] + chroma_pixels;
 
-	video->conversion_height =
-		(total_bytes/PIXEL_SIZE + ovi->output_width-1) /
-		ovi->output_width;
+	r->conversion_height =
+		(total_bytes/PIXEL_SIZE + r->output_width-1) /
+		r->output_width;
 
-	video->conversion_height = GET_ALIGN(video->conversion_height, 2);
-	video->conversion_tech = "Planar444";
+	r->conversion_height = GET_ALIGN(r->conversion_height, 2);
+	r->conversion_tech = "Planar444";
 }
 
-static inline void calc_gpu_conversion_sizes(const struct obs_video_info *ovi)
+static inline void calc_gpu_conversion_sizes(struct obs_video_rendition *r,
+		enum video_format format)
 {
-	obs->video.conversion_height = 0;
-	memset(obs->video.plane_offsets, 0, sizeof(obs->video.plane_offsets));
-	memset(obs->video.plane_sizes, 0, sizeof(obs->video.plane_sizes));
-	memset(obs->video.plane_linewidth, 0,
-		sizeof(obs->video.plane_linewidth));
+	r->conversion_height = 0;
+	memset(r->plane_offsets, 0, sizeof(r->plane_offsets));
+	memset(r->plane_sizes, 0, sizeof(r->plane_sizes));
+	memset(r->plane_linewidth, 0, sizeof(r->plane_linewidth));
 
-	switch ((uint32_t)ovi->output_format) {
+	switch ((uint32_t)format) {
 	case VIDEO_FORMAT_I420:
-		set_420p_sizes(ovi);
+		set_420p_sizes(r);
 		break;
 	case VIDEO_FORMAT_NV12:
-		set_nv12_sizes(ovi);
+		set_nv12_sizes(r);
 		break;
 	case VIDEO_FORMAT_I444:
-		set_444p_sizes(ovi);
+		set_444p_sizes(r);
 		break;
 	}
 }
 
-static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
+static bool obs_init_gpu_conversion(struct obs_video_rendition *r,
+		enum video_format format)
 {
-	struct obs_core_video *video = &obs->video;
-
-	calc_gpu_conversion_sizes(ovi);
+	calc_gpu_conversion_sizes(r, format);
 
-	if (!video->conversion_height) {
+	if (!r->conversion_height) {
 		blog(LOG_INFO, "GPU conversion not available for format: %u",
-				(unsigned int)ovi->output_format);
-		video->gpu_conversion = false;
+				(unsigned int)format);
+		r->gpu_conversion = false;
 		return true;
 	}
 
 	for (size_t i = 0; i < NUM_TEXTURES; i++) {
-		video->convert_textures[i] = gs_texture_create(
-				ovi->output_width, video->conversion_height,
+		r->convert_textures[i] = gs_texture_create(
+				r->output_width, r->conversion_height,
 				GS_RGBA, 1, NULL, GS_RENDER_TARGET);
 
-		if (!video->convert_textures[i])
+		if (!r->convert_textures[i])
 			return false;
 	}
 
 	return true;
 }
 
-static bool obs_init_textures(struct obs_video_info *ovi)
+static bool obs_init_rendition_textures(struct obs_video_rendition *r,
+		enum video_format format)
 {
-	struct obs_core_video *video = &obs->video;
-	uint32_t output_height = video->gpu_conversion ?
-		video->conversion_height : ovi->output_height;
-	size_t i;
+	uint32_t output_height;
+
+	if (r->gpu_conversion && !obs_init_gpu_conversion(r, format))
+		return false;
 
-	for (i = 0; i < NUM_TEXTURES; i++) {
-		video->copy_surfaces[i] = gs_stagesurface_create(
-				ovi->output_width, output_height, GS_RGBA);
+	output_height = r->gpu_conversion ?
+		r->conversion_height : r->output_height;
 
-		if (!video->copy_surfaces[i])
+	for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		r->copy_surfaces[i] = gs_stagesurface_create(
+				r->output_width, output_height, GS_RGBA);
+
+		if (!r->copy_surfaces[i])
 			return false;
 
-		video->render_textures[i] = gs_texture_create(
-				ovi->base_width, ovi->base_height,
+		r->output_textures[i] = gs_texture_create(
+				r->output_width, r->output_height,
 				GS_RGBA, 1, NULL, GS_RENDER_TARGET);
 
-		if (!video->render_textures[i])
+		if (!r->output_textures[i])
 			return false;
+	}
 
-		video->output_textures[i] = gs_texture_create(
-				ovi->output_width, ovi->output_height,
+	return true;
+}
+
+static void obs_free_rendition_textures(struct obs_video_rendition *r)
+{
+	if (r->mapped_surface) {
+		gs_stagesurface_unmap(r->mapped_surface);
+		r->mapped_surface = NULL;
+	}
+
+	for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		gs_stagesurface_destroy(r->copy_surfaces[i]);
+		gs_texture_destroy(r->convert_textures[i]);
+		gs_texture_destroy(r->output_textures[i]);
+
+		r->copy_surfaces[i]    = NULL;
+		r->convert_textures[i] = NULL;
+		r->output_textures[i]  = NULL;
+	}
+
+	circlebuf_free(&r->vframe_info_buffer);
+
+	memset(&r->textures_output, 0, sizeof(r->textures_output));
+	memset(&r->textures_copied, 0, sizeof(r->textures_copied));
+	memset(&r->textures_converted, 0, sizeof(r->textures_converted));
+	r->started = false;
+}
+
+/* must be called within the graphics context */
+void obs_free_video_rendition(struct obs_video_rendition *r)
+{
+	video_output_close(r->video);
+	obs_free_rendition_textures(r);
+	bfree(r);
+}
+
+static bool obs_init_textures(struct obs_video_info *ovi)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		video->render_textures[i] = gs_texture_create(
+				ovi->base_width, ovi->base_height,
 				GS_RGBA, 1, NULL, GS_RENDER_TARGET);
 
-		if (!video->output_textures[i])
+		if (!video->render_textures[i])
 			return false;
 	}
 
-	return true;
+	return obs_init_rendition_textures(&video->main_rendition,
+			ovi->output_format);
 }
 
 gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file)
@@ -356,14 +399,16 @@ static int obs_init_video(struct obs_video_info *ovi)
 	make_video_info(&vi, ovi);
 	video->base_width     = ovi->base_width;
 	video->base_height    = ovi->base_height;
-	video->output_width   = ovi->output_width;
-	video->output_height  = ovi->output_height;
-	video->gpu_conversion = ovi->gpu_conversion;
-	video->scale_type     = ovi->scale_type;
+
+	video->main_rendition.output_width   = ovi->output_width;
+	video->main_rendition.output_height  = ovi->output_height;
+	video->main_rendition.gpu_conversion = ovi->gpu_conversion;
+	video->main_rendition.scale_type     = ovi->scale_type;
 
 	set_video_matrix(video, ovi);
 
 	errorcode = video_output_open(&video->video, &vi);
+	video->main_rendition.video = video->video;
 
 	if (errorcode != VIDEO_OUTPUT_SUCCESS) {
 		if (errorcode == VIDEO_OUTPUT_INVALIDPARAM) {
@@ -377,8 +422,6 @@ static int obs_init_video(struct obs_video_info *ovi)
 
 	gs_enter_context(video->graphics);
 
-	if (ovi->gpu_conversion && !obs_init_gpu_conversion(ovi))
-		return OBS_VIDEO_FAIL;
 	if (!obs_init_textures(ovi))
 		return OBS_VIDEO_FAIL;
 
@@ -413,44 +456,50 @@ static void obs_free_video(void)
 {
 	struct obs_core_video *video = &obs->video;
 
+	/* renditions are derived from the main video, so they do not survive
+	 * a video reset */
+	if (video->renditions.num)
+		da_push_back_da(video->removed_renditions, video->renditions);
+	da_free(video->renditions);
+	da_free(video->frame_renditions);
+
+	for (size_t i = 0; i < video->removed_renditions.num; i++) {
+		struct obs_video_rendition *r =
+			video->removed_renditions.array[i];
+
+		if (video->graphics) {
+			gs_enter_context(video->graphics);
+			obs_free_video_rendition(r);
+			gs_leave_context();
+		} else {
+			video_output_close(r->video);
+			bfree(r);
+		}
+	}
+
+	da_free(video->removed_renditions);
+
 	if (video->video) {
 		video_output_close(video->video);
 		video->video = NULL;
+		video->main_rendition.video = NULL;
 
 		if (!video->graphics)
 			return;
 
 		gs_enter_context(video->graphics);
 
-		if (video->mapped_surface) {
-			gs_stagesurface_unmap(video->mapped_surface);
-			video->mapped_surface = NULL;
-		}
+		obs_free_rendition_textures(&video->main_rendition);
 
 		for (size_t i = 0; i < NUM_TEXTURES; i++) {
-			gs_stagesurface_destroy(video->copy_surfaces[i]);
 			gs_texture_destroy(video->render_textures[i]);
-			gs_texture_destroy(video->convert_textures[i]);
-			gs_texture_destroy(video->output_textures[i]);
-
-			video->copy_surfaces[i]    = NULL;
-			video->render_textures[i]  = NULL;
-			video->convert_textures[i] = NULL;
-			video->output_textures[i]  = NULL;
+			video->render_textures[i] = NULL;
 		}
 
 		gs_leave_context();
 
-		circlebuf_free(&video->vframe_info_buffer);
-
 		memset(&video->textures_rendered, 0,
 				sizeof(video->textures_rendered));
-		memset(&video->textures_output, 0,
-				sizeof(video->textures_output));
-		memset(&video->textures_copied, 0,
-				sizeof(video->textures_copied));
-		memset(&video->textures_converted, 0,
-				sizeof(video->textures_converted));
 
 		video->cur_texture = 0;
 	}
@@ -534,6 +583,137 @@ static void obs_free_audio(void)
 	memset(audio, 0, sizeof(struct obs_core_audio));
 }
 
+/* ------------------------------------------------------------------------- */
+/* context name index */
+
+#define CONTEXT_INDEX_MIN_BUCKETS 64
+
+static inline uint32_t context_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static bool context_index_init(struct obs_context_index *index)
+{
+	if (pthread_rwlock_init(&index->rwlock, NULL) != 0)
+		return false;
+
+	index->num_buckets = CONTEXT_INDEX_MIN_BUCKETS;
+	index->buckets = bzalloc(sizeof(struct obs_context_data*) *
+			index->num_buckets);
+	index->count = 0;
+	return true;
+}
+
+static void context_index_free(struct obs_context_index *index)
+{
+	if (!index->buckets)
+		return;
+
+	bfree(index->buckets);
+	pthread_rwlock_destroy(&index->rwlock);
+	memset(index, 0, sizeof(*index));
+}
+
+static inline struct obs_context_data **context_index_bucket(
+		struct obs_context_index *index, uint32_t hash)
+{
+	return &index->buckets[hash & (index->num_buckets - 1)];
+}
+
+/* both functions below expect the write lock to be held */
+
+static void context_index_grow(struct obs_context_index *index)
+{
+	struct obs_context_data **old_buckets = index->buckets;
+	size_t old_num = index->num_buckets;
+
+	index->num_buckets *= 2;
+	index->buckets = bzalloc(sizeof(struct obs_context_data*) *
+			index->num_buckets);
+
+	/* walk each chain from the tail so that newer contexts stay in front
+	 * of older ones with the same name, like in the linked lists */
+	for (size_t i = 0; i < old_num; i++) {
+		DARRAY(struct obs_context_data*) chain;
+		struct obs_context_data *context = old_buckets[i];
+
+		da_init(chain);
+		while (context) {
+			da_push_back(chain, &context);
+			context = context->hash_next;
+		}
+
+		for (size_t j = chain.num; j > 0; j--) {
+			struct obs_context_data **bucket;
+
+			context = chain.array[j - 1];
+			bucket = context_index_bucket(index,
+					context->name_hash);
+			context->hash_next = *bucket;
+			*bucket = context;
+		}
+
+		da_free(chain);
+	}
+
+	bfree(old_buckets);
+}
+
+static void context_index_add(struct obs_context_index *index,
+		struct obs_context_data *context)
+{
+	struct obs_context_data **bucket;
+
+	if (index->count >= index->num_buckets * 2)
+		context_index_grow(index);
+
+	context->name_hash = context_name_hash(context->name);
+	bucket = context_index_bucket(index, context->name_hash);
+
+	context->hash_next = *bucket;
+	*bucket = context;
+	index->count++;
+}
+
+static void context_index_del(struct obs_context_index *index,
+		struct obs_context_data *context)
+{
+	struct obs_context_data **next =
+		context_index_bucket(index, context->name_hash);
+
+	while (*next) {
+		if (*next == context) {
+			*next = context->hash_next;
+			context->hash_next = NULL;
+			index->count--;
+			break;
+		}
+
+		next = &(*next)->hash_next;
+	}
+}
+
+static struct obs_context_index *get_context_index(enum obs_obj_type type)
+{
+	switch (type) {
+	case OBS_OBJ_TYPE_SOURCE:  return &obs->data.source_index;
+	case OBS_OBJ_TYPE_OUTPUT:  return &obs->data.output_index;
+	case OBS_OBJ_TYPE_ENCODER: return &obs->data.encoder_index;
+	case OBS_OBJ_TYPE_SERVICE: return &obs->data.service_index;
+	case OBS_OBJ_TYPE_INVALID:;
+	}
+
+	return NULL;
+}
+
 static bool obs_init_data(void)
 {
 	struct obs_core_data *data = &obs->data;
@@ -562,6 +742,14 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init(&obs->data.draw_callbacks_mutex, NULL) != 0)
 		goto fail;
+	if (!context_index_init(&data->source_index))
+		goto fail;
+	if (!context_index_init(&data->output_index))
+		goto fail;
+	if (!context_index_init(&data->encoder_index))
+		goto fail;
+	if (!context_index_init(&data->service_index))
+		goto fail;
 	if (!obs_view_init(&data->main_view))
 		goto fail;
 
@@ -619,6 +807,11 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->services_mutex);
 	pthread_mutex_destroy(&data->draw_callbacks_mutex);
 	da_free(data->draw_callbacks);
+
+	context_index_free(&data->source_index);
+	context_index_free(&data->output_index);
+	context_index_free(&data->encoder_index);
+	context_index_free(&data->service_index);
 }
 
 static const char *obs_signals[] = {
@@ -749,6 +942,17 @@ static bool obs_init(const char *locale, const char *module_config_path,
 	obs = bzalloc(sizeof(struct obs_core));
 
 	pthread_mutex_init_value(&obs->audio.monitoring_mutex);
+	pthread_mutex_init_value(&obs->video.renditions_mutex);
+	pthread_mutex_init_value(&obs->video.texture_pool_mutex);
+	pthread_mutex_init_value(&obs->deferred_mutex);
+	pthread_mutex_init_value(&obs->audio_encode_pool.mutex);
+
+	if (pthread_mutex_init(&obs->video.renditions_mutex, NULL) != 0)
+		return false;
+	if (pthread_mutex_init(&obs->video.texture_pool_mutex, NULL) != 0)
+		return false;
+	if (pthread_mutex_init(&obs->deferred_mutex, NULL) != 0)
+		return false;
 
 	obs->name_store_owned = !store;
 	obs->name_store = store ? store : profiler_name_store_create();
@@ -765,6 +969,9 @@ static bool obs_init(const char *locale, const char *module_config_path,
 		return false;
 	if (!obs_init_hotkeys())
 		return false;
+	if (!obs_init_audio_encode_pool())
+		blog(LOG_WARNING, "Failed to create the audio encode pool, "
+		                  "audio will be encoded on the audio thread");
 
 	if (module_config_path)
 		obs->module_config_path = bstrdup(module_config_path);
@@ -841,9 +1048,12 @@ void obs_shutdown(void)
 
 	obs_free_audio();
 	obs_free_data();
+	obs_free_audio_encode_pool();
 	obs_free_video();
 	obs_free_hotkeys();
 	obs_free_graphics();
+	pthread_mutex_destroy(&obs->video.renditions_mutex);
+	pthread_mutex_destroy(&obs->video.texture_pool_mutex);
 	proc_handler_destroy(obs->procs);
 	signal_handler_destroy(obs->signals);
 	obs->procs = NULL;
@@ -860,6 +1070,8 @@ void obs_shutdown(void)
 	for (size_t i = 0; i < obs->module_paths.num; i++)
 		free_module_path(obs->module_paths.array+i);
 	da_free(obs->module_paths);
+	da_free(obs->deferred_types);
+	pthread_mutex_destroy(&obs->deferred_mutex);
 
 	if (obs->name_store_owned)
 		profiler_name_store_free(obs->name_store);
@@ -930,6 +1142,17 @@ int obs_reset_video(struct obs_video_info *ovi)
 	if (obs->video.video && video_output_active(obs->video.video))
 		return OBS_VIDEO_CURRENTLY_ACTIVE;
 
+	pthread_mutex_lock(&obs->video.renditions_mutex);
+
+	for (size_t i = 0; i < obs->video.renditions.num; i++) {
+		if (video_output_active(obs->video.renditions.array[i]->video)) {
+			pthread_mutex_unlock(&obs->video.renditions_mutex);
+			return OBS_VIDEO_CURRENTLY_ACTIVE;
+		}
+	}
+
+	pthread_mutex_unlock(&obs->video.renditions_mutex);
+
 	if (!size_valid(ovi->output_width, ovi->output_height) ||
 	    !size_valid(ovi->base_width,   ovi->base_height))
 		return OBS_VIDEO_INVALID_PARAM;
@@ -1134,6 +1357,92 @@ video_t *obs_get_video(void)
 	return (obs != NULL) ? obs->video.video : NULL;
 }
 
+video_t *obs_add_video_rendition(uint32_t width, uint32_t height,
+		enum obs_scale_type scale_type)
+{
+	struct obs_core_video *video;
+	struct obs_video_rendition *r;
+	struct video_output_info vi;
+	bool success;
+
+	if (!obs || !obs->video.video)
+		return NULL;
+	if (!size_valid(width, height))
+		return NULL;
+
+	video = &obs->video;
+
+	r = bzalloc(sizeof(struct obs_video_rendition));
+	r->output_width   = width  & 0xFFFFFFFC;
+	r->output_height  = height & 0xFFFFFFFE;
+	r->gpu_conversion = video->ovi.gpu_conversion;
+	r->scale_type     = scale_type;
+
+	make_video_info(&vi, &video->ovi);
+	vi.name   = "video rendition";
+	vi.width  = r->output_width;
+	vi.height = r->output_height;
+
+	if (video_output_open(&r->video, &vi) != VIDEO_OUTPUT_SUCCESS) {
+		blog(LOG_ERROR, "Could not open video output for rendition");
+		bfree(r);
+		return NULL;
+	}
+
+	gs_enter_context(video->graphics);
+	success = obs_init_rendition_textures(r, video->ovi.output_format);
+	if (!success)
+		obs_free_rendition_textures(r);
+	gs_leave_context();
+
+	if (!success) {
+		blog(LOG_ERROR, "Could not create textures for rendition");
+		video_output_close(r->video);
+		bfree(r);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&video->renditions_mutex);
+	da_push_back(video->renditions, &r);
+	pthread_mutex_unlock(&video->renditions_mutex);
+
+	blog(LOG_INFO, "Added video rendition: %"PRIu32"x%"PRIu32,
+			r->output_width, r->output_height);
+	return r->video;
+}
+
+bool obs_remove_video_rendition(video_t *rendition)
+{
+	struct obs_core_video *video;
+	bool removed = false;
+
+	if (!obs || !rendition)
+		return false;
+
+	video = &obs->video;
+
+	pthread_mutex_lock(&video->renditions_mutex);
+
+	for (size_t i = 0; i < video->renditions.num; i++) {
+		struct obs_video_rendition *r = video->renditions.array[i];
+
+		if (r->video != rendition)
+			continue;
+
+		/* the video thread may still be rendering it, so it's freed
+		 * there once the current frame is done */
+		removed = video_output_stop_inactive(rendition);
+		if (removed) {
+			da_erase(video->renditions, i);
+			da_push_back(video->removed_renditions, &r);
+		}
+		break;
+	}
+
+	pthread_mutex_unlock(&video->renditions_mutex);
+	return removed;
+}
+
 /* TODO: optimize this later so it's not just O(N) string lookups */
 static inline struct obs_modal_ui *get_modal_ui_callback(const char *id,
 		const char *task, const char *target)
@@ -1305,24 +1614,32 @@ void obs_enum_services(bool (*enum_proc)(void*, obs_service_t*), void *param)
 			enum_proc, param);
 }
 
-static inline void *get_context_by_name(void *vfirst, const char *name,
-		pthread_mutex_t *mutex, void *(*addref)(void*))
+/* only takes the read lock of the name index, so lookups don't contend with
+ * the graphics thread holding the sources mutex while ticking/rendering */
+static inline void *get_context_by_name(struct obs_context_index *index,
+		const char *name, void *(*addref)(void*))
 {
-	struct obs_context_data **first = vfirst;
 	struct obs_context_data *context;
+	uint32_t hash;
 
-	pthread_mutex_lock(mutex);
+	if (!name)
+		return NULL;
+
+	hash = context_name_hash(name);
 
-	context = *first;
+	pthread_rwlock_rdlock(&index->rwlock);
+
+	context = *context_index_bucket(index, hash);
 	while (context) {
-		if (!context->private && strcmp(context->name, name) == 0) {
+		if (context->name_hash == hash &&
+		    strcmp(context->name, name) == 0) {
 			context = addref(context);
 			break;
 		}
-		context = context->next;
+		context = context->hash_next;
 	}
 
-	pthread_mutex_unlock(mutex);
+	pthread_rwlock_unlock(&index->rwlock);
 	return context;
 }
 
@@ -1354,29 +1671,29 @@ static inline void *obs_id_(void *data)
 obs_source_t *obs_get_source_by_name(const char *name)
 {
 	if (!obs) return NULL;
-	return get_context_by_name(&obs->data.first_source, name,
-			&obs->data.sources_mutex, obs_source_addref_safe_);
+	return get_context_by_name(&obs->data.source_index, name,
+			obs_source_addref_safe_);
 }
 
 obs_output_t *obs_get_output_by_name(const char *name)
 {
 	if (!obs) return NULL;
-	return get_context_by_name(&obs->data.first_output, name,
-			&obs->data.outputs_mutex, obs_output_addref_safe_);
+	return get_context_by_name(&obs->data.output_index, name,
+			obs_output_addref_safe_);
 }
 
 obs_encoder_t *obs_get_encoder_by_name(const char *name)
 {
 	if (!obs) return NULL;
-	return get_context_by_name(&obs->data.first_encoder, name,
-			&obs->data.encoders_mutex, obs_encoder_addref_safe_);
+	return get_context_by_name(&obs->data.encoder_index, name,
+			obs_encoder_addref_safe_);
 }
 
 obs_service_t *obs_get_service_by_name(const char *name)
 {
 	if (!obs) return NULL;
-	return get_context_by_name(&obs->data.first_service, name,
-			&obs->data.services_mutex, obs_service_addref_safe_);
+	return get_context_by_name(&obs->data.service_index, name,
+			obs_service_addref_safe_);
 }
 
 gs_effect_t *obs_get_base_effect(enum obs_base_effect effect)
@@ -1449,14 +1766,10 @@ float obs_get_master_volume(void)
 	return obs ? obs->audio.user_volume : 0.0f;
 }
 
-static obs_source_t *obs_load_source_type(obs_data_t *source_data)
+static void obs_load_source_data(obs_source_t *source,
+		obs_data_t *source_data)
 {
 	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
-	obs_source_t *source;
-	const char   *name    = obs_data_get_string(source_data, "name");
-	const char   *id      = obs_data_get_string(source_data, "id");
-	obs_data_t   *settings = obs_data_get_obj(source_data, "settings");
-	obs_data_t   *hotkeys  = obs_data_get_obj(source_data, "hotkeys");
 	double       volume;
 	int64_t      sync;
 	uint32_t     flags;
@@ -1465,10 +1778,6 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 	int          di_mode;
 	int          monitoring_type;
 
-	source = obs_source_create(id, name, settings, hotkeys);
-
-	obs_data_release(hotkeys);
-
 	obs_data_set_default_double(source_data, "volume", 1.0);
 	volume = obs_data_get_double(source_data, "volume");
 	obs_source_set_volume(source, (float)volume);
@@ -1532,8 +1841,7 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 			obs_data_t *filter_data =
 				obs_data_array_item(filters, i);
 
-			obs_source_t *filter = obs_load_source_type(
-					filter_data);
+			obs_source_t *filter = obs_load_source(filter_data);
 			if (filter) {
 				obs_source_filter_add(source, filter);
 				obs_source_release(filter);
@@ -1544,15 +1852,108 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 
 		obs_data_array_release(filters);
 	}
+}
 
-	obs_data_release(settings);
+obs_source_t *obs_load_source(obs_data_t *source_data)
+{
+	const char   *name    = obs_data_get_string(source_data, "name");
+	const char   *id      = obs_data_get_string(source_data, "id");
+	obs_data_t   *settings = obs_data_get_obj(source_data, "settings");
+	obs_data_t   *hotkeys  = obs_data_get_obj(source_data, "hotkeys");
+	obs_source_t *source;
 
+	source = obs_source_create(id, name, settings, hotkeys);
+	if (source)
+		obs_load_source_data(source, source_data);
+
+	obs_data_release(hotkeys);
+	obs_data_release(settings);
 	return source;
 }
 
-obs_source_t *obs_load_source(obs_data_t *source_data)
+/* ------------------------------------------------------------------------- */
+/* scene collection loading */
+
+#define MAX_LOAD_THREADS     8
+#define SLOW_SOURCE_LOAD_NS  100000000ULL
+
+struct source_load_job {
+	obs_data_t   *source_data;
+	obs_source_t *source;
+	void         *data;
+	uint64_t     create_ns;
+	bool         parallel;
+};
+
+struct source_loader {
+	struct source_load_job *jobs;
+	size_t                 num_jobs;
+	volatile long          next_job;
+};
+
+static void source_load_job_create(struct source_load_job *job)
 {
-	return obs_load_source_type(source_data);
+	uint64_t start = os_gettime_ns();
+	job->data = obs_source_create_data(job->source);
+	job->create_ns = os_gettime_ns() - start;
+}
+
+static void *source_load_thread(void *param)
+{
+	struct source_loader *loader = param;
+	long idx;
+
+	os_set_thread_name("libobs: source load thread");
+
+	while ((idx = os_atomic_inc_long(&loader->next_job) - 1) <
+			(long)loader->num_jobs) {
+		struct source_load_job *job = loader->jobs + idx;
+		if (job->parallel)
+			source_load_job_create(job);
+	}
+
+	return NULL;
+}
+
+/* runs the create callbacks of thread-safe source types on a temporary
+ * worker pool.  the calling thread takes part as well, so this still works
+ * if no threads could be created */
+static void create_sources_parallel(struct source_load_job *jobs,
+		size_t num_jobs, size_t num_parallel)
+{
+	struct source_loader loader = {jobs, num_jobs, 0};
+	pthread_t threads[MAX_LOAD_THREADS];
+	size_t num_threads = (size_t)os_get_logical_cores();
+
+	if (num_threads > MAX_LOAD_THREADS)
+		num_threads = MAX_LOAD_THREADS;
+	if (num_threads > num_parallel)
+		num_threads = num_parallel;
+
+	for (size_t i = 1; i < num_threads; i++) {
+		if (pthread_create(&threads[i], NULL, source_load_thread,
+					&loader) != 0) {
+			num_threads = i;
+			break;
+		}
+	}
+
+	source_load_thread(&loader);
+
+	for (size_t i = 1; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+}
+
+static void log_source_load_time(obs_source_t *source,
+		uint64_t create_ns, uint64_t total_ns)
+{
+	int level = total_ns >= SLOW_SOURCE_LOAD_NS ? LOG_INFO : LOG_DEBUG;
+
+	blog(level, "Loaded source '%s' (%s) in %.1f ms "
+			"(create: %.1f ms)",
+			obs_source_get_name(source), obs_source_get_id(source),
+			(double)total_ns / 1000000.0,
+			(double)create_ns / 1000000.0);
 }
 
 void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
@@ -1561,52 +1962,195 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 	if (!obs) return;
 
 	struct obs_core_data *data = &obs->data;
-	DARRAY(obs_source_t*) sources;
+	DARRAY(struct source_load_job) jobs;
+	size_t num_parallel = 0;
+	uint64_t start = os_gettime_ns();
 	size_t count;
 	size_t i;
 
-	da_init(sources);
+	da_init(jobs);
 
 	count = obs_data_array_count(array);
-	da_reserve(sources, count);
+	da_resize(jobs, count);
 
-	pthread_mutex_lock(&data->sources_mutex);
+	/* first pass: create the sources without calling their create
+	 * callbacks and without publishing them yet */
 
 	for (i = 0; i < count; i++) {
-		obs_data_t   *source_data = obs_data_array_item(array, i);
-		obs_source_t *source      = obs_load_source(source_data);
+		struct source_load_job *job = jobs.array + i;
+		obs_data_t *source_data = obs_data_array_item(array, i);
+		const char *name = obs_data_get_string(source_data, "name");
+		const char *id   = obs_data_get_string(source_data, "id");
+		obs_data_t *settings = obs_data_get_obj(source_data,
+				"settings");
+		obs_data_t *hotkeys  = obs_data_get_obj(source_data,
+				"hotkeys");
+
+		job->source_data = source_data;
+		job->source = obs_source_create_deferred(id, name, settings,
+				hotkeys);
+		job->parallel = job->source && (job->source->info.output_flags &
+				OBS_SOURCE_CREATE_THREADSAFE) != 0;
+		if (job->parallel)
+			num_parallel++;
+
+		obs_data_release(hotkeys);
+		obs_data_release(settings);
+	}
 
-		da_push_back(sources, &source);
+	/* second pass: thread-safe create callbacks run in parallel.  the
+	 * sources mutex must not be held here, create callbacks are allowed
+	 * to use it */
+	if (num_parallel)
+		create_sources_parallel(jobs.array, jobs.num, num_parallel);
 
-		obs_data_release(source_data);
+	/* third pass: everything else runs in order on this thread.  sources
+	 * only become visible here, once their create callback has run, so
+	 * nothing else ever sees a half created source */
+	pthread_mutex_lock(&data->sources_mutex);
+
+	for (i = 0; i < jobs.num; i++) {
+		struct source_load_job *job = jobs.array + i;
+		uint64_t load_start = os_gettime_ns();
+
+		if (!job->source)
+			continue;
+
+		if (!job->parallel)
+			source_load_job_create(job);
+
+		obs_source_create_finish(job->source, job->data, true);
+		obs_load_source_data(job->source, job->source_data);
+
+		log_source_load_time(job->source, job->create_ns,
+				os_gettime_ns() - load_start + job->create_ns);
 	}
 
 	/* tell sources that we want to load */
-	for (i = 0; i < sources.num; i++) {
-		obs_source_t *source = sources.array[i];
-		obs_data_t *source_data = obs_data_array_item(array, i);
+	for (i = 0; i < jobs.num; i++) {
+		struct source_load_job *job = jobs.array + i;
+		obs_source_t *source = job->source;
+
 		if (source) {
 			if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
-				obs_transition_load(source, source_data);
+				obs_transition_load(source, job->source_data);
 			obs_source_load(source);
 			cb(private_data, source);
 		}
-		obs_data_release(source_data);
 	}
 
-	for (i = 0; i < sources.num; i++)
-		obs_source_release(sources.array[i]);
+	for (i = 0; i < jobs.num; i++) {
+		obs_source_release(jobs.array[i].source);
+		obs_data_release(jobs.array[i].source_data);
+	}
 
 	pthread_mutex_unlock(&data->sources_mutex);
 
-	da_free(sources);
+	blog(LOG_INFO, "Loaded %d sources (%d in parallel) in %.1f ms",
+			(int)jobs.num, (int)num_parallel,
+			(double)(os_gettime_ns() - start) / 1000000.0);
+
+	da_free(jobs);
 }
 
-obs_data_t *obs_save_source(obs_source_t *source)
+void obs_scenes_dirty(void)
 {
+	struct obs_core_data *data = &obs->data;
+	obs_source_t *source;
+
+	pthread_mutex_lock(&data->sources_mutex);
+
+	source = data->first_source;
+	while (source) {
+		if (source->info.type == OBS_SOURCE_TYPE_SCENE)
+			os_atomic_inc_long(&source->save_generation);
+
+		source = (obs_source_t*)source->context.next;
+	}
+
+	pthread_mutex_unlock(&data->sources_mutex);
+}
+
+/* sources with a save callback (other than scenes, which are tracked through
+ * their items) or transition state can change without any notice, so they
+ * are always saved again */
+static inline bool save_data_cacheable(const obs_source_t *source)
+{
+	if (source->info.type == OBS_SOURCE_TYPE_SCENE)
+		return true;
+	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
+		return false;
+	return !source->info.save;
+}
+
+static inline uint64_t data_save_version(uint64_t version, obs_data_t *data)
+{
+	version = version * 31 + (uint64_t)(uintptr_t)data;
+	return version * 31 + (uint64_t)obs_data_get_changes(data);
+}
+
+/* covers everything obs_save_source stores for the source and its filters,
+ * other than state that can't be tracked (see save_data_cacheable).  the
+ * settings count their own changes, so nothing here walks them */
+static uint64_t get_save_version(obs_source_t *source)
+{
+	uint64_t version = (uint64_t)os_atomic_load_long(
+			&source->save_generation);
+
+	version = data_save_version(version, source->context.settings);
+	version = data_save_version(version, source->private_settings);
+
+	pthread_mutex_lock(&source->filter_mutex);
+	for (size_t i = 0; i < source->filters.num; i++)
+		version = version * 31 +
+			get_save_version(source->filters.array[i]);
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return version;
+}
+
+/* the saved data is also checked against its own change count, so a caller
+ * that modified data it got from obs_save_sources can't corrupt later
+ * saves */
+static inline obs_data_t *get_saved_data(obs_source_t *source,
+		uint64_t version)
+{
+	obs_data_t *source_data = NULL;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	if (source->saved_data && source->saved_version == version &&
+	    obs_data_get_changes(source->saved_data) ==
+			source->saved_data_changes) {
+		source_data = source->saved_data;
+		obs_data_addref(source_data);
+	}
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return source_data;
+}
+
+static inline obs_data_t *copy_data(obs_data_t *data)
+{
+	obs_data_t *copy = obs_data_create();
+	obs_data_apply(copy, data);
+	return copy;
+}
+
+/* returns the data kept for the next save when the source is cacheable, so
+ * the result must not be modified when *shared is set */
+static obs_data_t *save_source(obs_source_t *source, bool *shared)
+{
+	uint64_t version = get_save_version(source);
+	obs_data_t *source_data = get_saved_data(source, version);
+	if (source_data) {
+		*shared = true;
+		return source_data;
+	}
+
+	bool cacheable = save_data_cacheable(source);
 	obs_data_array_t *filters = obs_data_array_create();
-	obs_data_t *source_data = obs_data_create();
-	obs_data_t *settings    = obs_source_get_settings(source);
+	obs_data_t *settings;
+	obs_data_t *private_settings;
 	obs_data_t *hotkey_data = source->context.hotkey_data;
 	obs_data_t *hotkeys;
 	float      volume      = obs_source_get_volume(source);
@@ -1629,6 +2173,16 @@ obs_data_t *obs_save_source(obs_source_t *source)
 	obs_source_save(source);
 	hotkeys = obs_hotkeys_save_source(source);
 
+	/* scenes write their items to their settings when saved, so the
+	 * version is only taken after that */
+	version = get_save_version(source);
+
+	/* the saved data is reused by later saves and may be written out on
+	 * another thread, so it must not share anything with the source */
+	source_data      = obs_data_create();
+	settings         = copy_data(source->context.settings);
+	private_settings = copy_data(source->private_settings);
+
 	if (hotkeys) {
 		obs_data_release(hotkey_data);
 		source->context.hotkey_data = hotkeys;
@@ -1653,8 +2207,7 @@ obs_data_t *obs_save_source(obs_source_t *source)
 	obs_data_set_int   (source_data, "deinterlace_field_order", di_order);
 	obs_data_set_int   (source_data, "monitoring_type", m_type);
 
-	obs_data_set_obj(source_data, "private_settings",
-			source->private_settings);
+	obs_data_set_obj(source_data, "private_settings", private_settings);
 
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_save(source, source_data);
@@ -1664,22 +2217,55 @@ obs_data_t *obs_save_source(obs_source_t *source)
 	if (source->filters.num) {
 		for (size_t i = source->filters.num; i > 0; i--) {
 			obs_source_t *filter = source->filters.array[i - 1];
-			obs_data_t *filter_data = obs_save_source(filter);
+			bool filter_shared;
+			obs_data_t *filter_data = save_source(filter,
+					&filter_shared);
 			obs_data_array_push_back(filters, filter_data);
 			obs_data_release(filter_data);
+
+			if (!save_data_cacheable(filter))
+				cacheable = false;
 		}
 
 		obs_data_set_array(source_data, "filters", filters);
 	}
 
+	obs_data_release(source->saved_data);
+	source->saved_data = NULL;
+
+	if (cacheable) {
+		source->saved_data = source_data;
+		source->saved_version = version;
+		source->saved_data_changes =
+			obs_data_get_changes(source_data);
+		obs_data_addref(source_data);
+	}
+
+	*shared = cacheable;
+
 	pthread_mutex_unlock(&source->filter_mutex);
 
 	obs_data_release(settings);
+	obs_data_release(private_settings);
 	obs_data_array_release(filters);
 
 	return source_data;
 }
 
+obs_data_t *obs_save_source(obs_source_t *source)
+{
+	bool shared;
+	obs_data_t *source_data = save_source(source, &shared);
+
+	if (shared) {
+		obs_data_t *copy = copy_data(source_data);
+		obs_data_release(source_data);
+		source_data = copy;
+	}
+
+	return source_data;
+}
+
 obs_data_array_t *obs_save_sources_filtered(obs_save_source_filter_cb cb,
 		void *data_)
 {
@@ -1698,7 +2284,8 @@ obs_data_array_t *obs_save_sources_filtered(obs_save_source_filter_cb cb,
 	while (source) {
 		if ((source->info.type != OBS_SOURCE_TYPE_FILTER) != 0 &&
 				!source->context.private && cb(data_, source)) {
-			obs_data_t *source_data = obs_save_source(source);
+			bool shared;
+			obs_data_t *source_data = save_source(source, &shared);
 
 			obs_data_array_push_back(array, source_data);
 			obs_data_release(source_data);
@@ -1823,6 +2410,19 @@ void obs_context_data_insert(struct obs_context_data *context,
 	*first              = context;
 	if (context->next)
 		context->next->prev_next = &context->next;
+
+	/* private contexts can't be looked up by name */
+	if (!context->private && context->name) {
+		struct obs_context_index *index =
+			get_context_index(context->type);
+
+		if (index) {
+			pthread_rwlock_wrlock(&index->rwlock);
+			context_index_add(index, context);
+			pthread_rwlock_unlock(&index->rwlock);
+			context->index = index;
+		}
+	}
 	pthread_mutex_unlock(mutex);
 }
 
@@ -1834,6 +2434,13 @@ void obs_context_data_remove(struct obs_context_data *context)
 			*context->prev_next = context->next;
 		if (context->next)
 			context->next->prev_next = context->prev_next;
+
+		if (context->index) {
+			pthread_rwlock_wrlock(&context->index->rwlock);
+			context_index_del(context->index, context);
+			pthread_rwlock_unlock(&context->index->rwlock);
+			context->index = NULL;
+		}
 		pthread_mutex_unlock(context->mutex);
 
 		context->mutex = NULL;
@@ -1843,13 +2450,24 @@ void obs_context_data_remove(struct obs_context_data *context)
 void obs_context_data_setname(struct obs_context_data *context,
 		const char *name)
 {
+	struct obs_context_index *index = context->index;
+
+	if (index)
+		pthread_rwlock_wrlock(&index->rwlock);
 	pthread_mutex_lock(&context->rename_cache_mutex);
 
 	if (context->name)
 		da_push_back(context->rename_cache, &context->name);
 	context->name = dup_name(name, context->private);
 
+	if (index) {
+		context_index_del(index, context);
+		context_index_add(index, context);
+	}
+
 	pthread_mutex_unlock(&context->rename_cache_mutex);
+	if (index)
+		pthread_rwlock_unlock(&index->rwlock);
 }
 
 profiler_name_store_t *obs_get_profiler_name_store(void)
@@ -1875,6 +2493,22 @@ uint64_t obs_get_average_frame_time_ns(void)
 	return obs ? obs->video.video_avg_frame_time_ns : 0;
 }
 
+void obs_get_texture_pool_usage(uint64_t *used_bytes, uint64_t *idle_bytes)
+{
+	struct gs_texture_pool_stats stats = {0};
+
+	if (obs) {
+		pthread_mutex_lock(&obs->video.texture_pool_mutex);
+		stats = obs->video.texture_pool_stats;
+		pthread_mutex_unlock(&obs->video.texture_pool_mutex);
+	}
+
+	if (used_bytes)
+		*used_bytes = stats.used_bytes;
+	if (idle_bytes)
+		*idle_bytes = stats.idle_bytes;
+}
+
 enum obs_obj_type obs_obj_get_type(void *obj)
 {
 	struct obs_context_data *context = obj;
@@ -374,7 +374,12 @@ EXPORT const char *obs_get_module_data_path(obs_module_t *module);
  */
 EXPORT void obs_add_module_path(const char *bin, const char *data);
 
-/** Automatically loads all modules from module paths (convenience function) */
+/**
+ * Automatically loads all modules from module paths (convenience function).
+ *
+ *   Module files and their locale data are loaded on multiple threads, then
+ * each module is initialized in turn on the calling thread.
+ */
 EXPORT void obs_load_all_modules(void);
 
 /** Notifies modules that all modules have been loaded.  This function should
@@ -475,6 +480,28 @@ EXPORT audio_t *obs_get_audio(void);
 /** Gets the main video output handler for this OBS context */
 EXPORT video_t *obs_get_video(void);
 
+/**
+ * Adds a video rendition: an additional video output that is derived from the
+ * same rendered frame as the main video, but scaled and color converted on
+ * the GPU to a different size.  It uses the frame rate, format, color space
+ * and range of the main video.  Attach encoders to it with
+ * obs_encoder_set_video.  Renditions are removed when video is reset.
+ *
+ * @param  width       Width of the rendition
+ * @param  height      Height of the rendition
+ * @param  scale_type  Scale filter used to scale the rendered frame
+ * @return             The video output of the rendition, or NULL on failure
+ */
+EXPORT video_t *obs_add_video_rendition(uint32_t width, uint32_t height,
+		enum obs_scale_type scale_type);
+
+/**
+ * Removes a video rendition created with obs_add_video_rendition.  Fails if
+ * the rendition is still in use.  On success the rendition's video output
+ * must not be used anymore, it is freed by the video thread.
+ */
+EXPORT bool obs_remove_video_rendition(video_t *rendition);
+
 /** Sets the primary output source for a channel. */
 EXPORT void obs_set_output_source(uint32_t channel, obs_source_t *source);
 
@@ -570,7 +597,14 @@ typedef void (*obs_load_source_cb)(void *private_data, obs_source_t *source);
 EXPORT void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 		void *private_data);
 
-/** Saves sources to a data array */
+/**
+ * Saves sources to a data array
+ *
+ *   The data of sources that have not changed since they were last saved is
+ * shared with the previous save, so the objects in the array should not be
+ * modified.  Sources whose saved data was modified are saved again the next
+ * time.
+ */
 EXPORT obs_data_array_t *obs_save_sources(void);
 
 typedef bool (*obs_save_source_filter_cb)(void *data, obs_source_t *source);
@@ -636,6 +670,13 @@ EXPORT uint64_t obs_get_video_frame_time(void);
 EXPORT double obs_get_active_fps(void);
 EXPORT uint64_t obs_get_average_frame_time_ns(void);
 
+/**
+ * Gets the amount of video memory held by the render target texture pool,
+ * split into textures currently in use and idle textures kept for reuse.
+ */
+EXPORT void obs_get_texture_pool_usage(uint64_t *used_bytes,
+		uint64_t *idle_bytes);
+
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
@@ -735,6 +776,12 @@ EXPORT uint32_t obs_source_get_output_flags(const obs_source_t *source);
 /** Returns capability flags of a source type */
 EXPORT uint32_t obs_get_source_output_flags(const char *id);
 
+/**
+ * Returns the averaged time in nanoseconds spent in the video tick of the
+ * source each frame
+ */
+EXPORT uint64_t obs_source_get_tick_time(const obs_source_t *source);
+
 /** Gets the default settings for a source type */
 EXPORT obs_data_t *obs_get_source_defaults(const char *id);
 
@@ -1001,6 +1048,23 @@ EXPORT void obs_source_draw(gs_texture_t *image, int x, int y,
 EXPORT void obs_source_output_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
 
+/**
+ * Outputs asynchronous video data without copying it.  The frame data must
+ * stay valid until the release callback is called, which happens once libobs
+ * no longer uses the frame.  The callback may be called from any thread while
+ * libobs holds the source's frame lock, so it must not call back in to the
+ * source.
+ */
+EXPORT void obs_source_lend_video(obs_source_t *source,
+		const struct obs_source_frame *frame,
+		void (*release)(void *param), void *param);
+
+/**
+ * Releases all lent frames that are still queued.  Frames that are currently
+ * in use are released as soon as libobs is done with them.
+ */
+EXPORT void obs_source_reclaim_video(obs_source_t *source);
+
 /** Preloads asynchronous video data to allow instantaneous playback */
 EXPORT void obs_source_preload_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
@@ -1409,12 +1473,51 @@ EXPORT void obs_output_stop(obs_output_t *output);
 EXPORT void obs_output_set_delay(obs_output_t *output, uint32_t delay_sec,
 		uint32_t flags);
 
+/**
+ * Sets where delayed packets go once they exceed a memory budget.
+ *
+ *   With long delays, keeping every delayed packet in memory can use a lot of
+ * it.  Once the delayed packets use more than max_memory bytes, new packets
+ * are written to a ring file of spool_size bytes created in dir, and read back
+ * when they are sent.  Pass NULL for dir to keep all packets in memory (the
+ * default).  Like the delay value, this takes effect the next time the
+ * output is activated.
+ */
+EXPORT void obs_output_set_delay_spool(obs_output_t *output, const char *dir,
+		uint64_t max_memory, uint64_t spool_size);
+
 /** Gets the currently set delay value, in seconds. */
 EXPORT uint32_t obs_output_get_delay(const obs_output_t *output);
 
 /** If delay is active, gets the currently active delay value, in seconds. */
 EXPORT uint32_t obs_output_get_active_delay(const obs_output_t *output);
 
+/**
+ * Enables or disables dynamic bitrate for the output's video encoder.
+ *
+ *   When enabled, the video encoder bitrate is lowered while the output
+ * reports congestion or drops frames, and raised again once the connection
+ * has been clear for a while.  This requires a video encoder with the
+ * OBS_ENCODER_CAP_DYN_BITRATE capability that isn't shared with other
+ * outputs.  If another output starts using the encoder, dynamic bitrate is
+ * turned off.  The original bitrate is restored when the output stops.  Like
+ * delay, this takes effect the next time the output starts.
+ *
+ * @param  min_kbps  Lowest bitrate to use, or 0 for a quarter of the ceiling
+ * @param  max_kbps  Highest bitrate to use, or 0 for the encoder's bitrate
+ */
+EXPORT void obs_output_set_dynamic_bitrate(obs_output_t *output, bool enable,
+		uint32_t min_kbps, uint32_t max_kbps);
+
+/** Returns whether dynamic bitrate is enabled for the output */
+EXPORT bool obs_output_dynamic_bitrate_enabled(const obs_output_t *output);
+
+/**
+ * Gets the video bitrate currently chosen by dynamic bitrate, in kbps, or 0 if
+ * dynamic bitrate is not active.
+ */
+EXPORT uint32_t obs_output_get_dynamic_bitrate(const obs_output_t *output);
+
 /** Forces the output to stop.  Usually only used with delay. */
 EXPORT void obs_output_force_stop(obs_output_t *output);
 
@@ -1696,6 +1799,24 @@ EXPORT void obs_encoder_set_preferred_video_format(obs_encoder_t *encoder,
 EXPORT enum video_format obs_encoder_get_preferred_video_format(
 		const obs_encoder_t *encoder);
 
+/**
+ * Makes a video encoder encode on its own thread rather than on the video
+ * output thread.  Frames are copied in to a queue of up to max_frames frames
+ * (0 to use the default), and policy determines what happens to new frames
+ * when the queue is full.  If the encoder is active, this function will
+ * trigger a warning, and do nothing.
+ */
+EXPORT void obs_encoder_set_threaded(obs_encoder_t *encoder, bool threaded,
+		size_t max_frames, enum obs_encoder_queue_policy policy);
+EXPORT bool obs_encoder_threaded(const obs_encoder_t *encoder);
+
+/**
+ * Gets the frame queue statistics of a threaded video encoder for the
+ * current (or last) session.  Returns false if the encoder is not threaded.
+ */
+EXPORT bool obs_encoder_get_queue_stats(const obs_encoder_t *encoder,
+		struct obs_encoder_queue_stats *stats);
+
 /** Gets the default settings for an encoder type */
 EXPORT obs_data_t *obs_encoder_defaults(const char *id);
 
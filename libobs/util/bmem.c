@@ -21,122 +21,372 @@
 #include "platform.h"
 #include "threading.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 /*
  * NOTE: totally jacked the mem alignment trick from ffmpeg, credit to them:
  *   http://www.ffmpeg.org/
+ *
+ * Blocks are allocated with enough slack to move the returned pointer up to
+ * the next ALIGNMENT boundary.  The two bytes right before that pointer store
+ * the size class of the block and its offset from the start of the
+ * allocation; large blocks also store their size in front of those for the
+ * statistics.  This keeps a 16 byte block at about the cost of the alignment
+ * slack alone.
  */
 
 #define ALIGNMENT 32
 
-/* TODO: use memalign for non-windows systems */
-#if defined(_WIN32)
-#define ALIGNED_MALLOC 1
+static struct base_allocator alloc = {malloc, realloc, free};
+
+/*
+ * Small blocks are rounded up to one of the size classes, and freed small
+ * blocks are kept on per-thread free lists so that the next allocation of the
+ * same size class on that thread doesn't have to go through the system
+ * allocator.  Each thread only keeps a limited amount of memory cached per
+ * size class; anything beyond that is freed normally.
+ */
+
+#define LARGE_CLASS      BMEM_NUM_SIZE_CLASSES
+#define SMALL_HEADER     2
+#define LARGE_HEADER     (SMALL_HEADER + sizeof(uint64_t))
+#define MAX_CACHED_BYTES (16 * 1024)
+
+static const size_t class_sizes[BMEM_NUM_SIZE_CLASSES] = {
+	16, 32, 64, 128, 256, 512
+};
+
+/* currently allocated blocks per size class (last is large blocks) */
+static long class_allocs[BMEM_NUM_SIZE_CLASSES + 1] = {0};
+static volatile uint64_t large_bytes = 0;
+
+/* incremented by base_set_allocator, thread caches holding blocks from an
+ * older allocator free them the next time they're used */
+static volatile long allocator_generation = 0;
+
+struct free_block {
+	struct free_block *next;
+};
+
+struct thread_cache {
+	struct free_block *lists[BMEM_NUM_SIZE_CLASSES];
+	size_t            counts[BMEM_NUM_SIZE_CLASSES];
+	long              generation;
+	void              (*free)(void *);
+	bool              registered;
+	bool              exiting;
+};
+
+#ifdef _MSC_VER
+static __declspec(thread) struct thread_cache thread_cache = {0};
 #else
-#define ALIGNMENT_HACK 1
+static __thread struct thread_cache thread_cache = {0};
 #endif
 
-static void *a_malloc(size_t size)
-{
-#ifdef ALIGNED_MALLOC
-	return _aligned_malloc(size, ALIGNMENT);
-#elif ALIGNMENT_HACK
-	void *ptr = NULL;
-	long diff;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+static bool cache_key_valid = false;
 
-	ptr  = malloc(size + ALIGNMENT);
-	if (ptr) {
-		diff = ((~(long)ptr) & (ALIGNMENT - 1)) + 1;
-		ptr  = (char *)ptr + diff;
-		((char *)ptr)[-1] = (char)diff;
-	}
+static inline void add_large_bytes(uint64_t bytes)
+{
+#ifdef _MSC_VER
+	_InterlockedExchangeAdd64((volatile long long*)&large_bytes,
+			(long long)bytes);
+#else
+	__atomic_fetch_add(&large_bytes, bytes, __ATOMIC_RELAXED);
+#endif
+}
 
-	return ptr;
+static inline uint64_t get_large_bytes(void)
+{
+#ifdef _MSC_VER
+	return (uint64_t)_InterlockedCompareExchange64(
+			(volatile long long*)&large_bytes, 0, 0);
 #else
-	return malloc(size);
+	return __atomic_load_n(&large_bytes, __ATOMIC_RELAXED);
 #endif
 }
 
-static void *a_realloc(void *ptr, size_t size)
+static inline size_t header_size(uint32_t size_class)
 {
-#ifdef ALIGNED_MALLOC
-	return _aligned_realloc(ptr, size, ALIGNMENT);
-#elif ALIGNMENT_HACK
-	long diff;
+	return size_class == LARGE_CLASS ? LARGE_HEADER : SMALL_HEADER;
+}
+
+static inline size_t alloc_size(size_t size, uint32_t size_class)
+{
+	return size + header_size(size_class) + ALIGNMENT - 1;
+}
+
+static inline uint8_t *get_aligned(uint8_t *raw, uint32_t size_class)
+{
+	uintptr_t addr = (uintptr_t)raw + header_size(size_class);
+	return (uint8_t*)((addr + ALIGNMENT - 1) &
+			~(uintptr_t)(ALIGNMENT - 1));
+}
+
+static inline void *init_block(uint8_t *raw, uint32_t size_class, size_t size)
+{
+	uint8_t *ptr = get_aligned(raw, size_class);
+
+	ptr[-1] = (uint8_t)(ptr - raw);
+	ptr[-2] = (uint8_t)size_class;
+
+	if (size_class == LARGE_CLASS) {
+		uint64_t size64 = (uint64_t)size;
+		memcpy(ptr - LARGE_HEADER, &size64, sizeof(size64));
+	}
 
-	if (!ptr)
-		return a_malloc(size);
-	diff = ((char *)ptr)[-1];
-	ptr = realloc((char*)ptr - diff, size + diff);
-	if (ptr)
-		ptr = (char *)ptr + diff;
 	return ptr;
-#else
-	return realloc(ptr, size);
-#endif
 }
 
-static void a_free(void *ptr)
+static inline uint32_t get_block_class(const void *ptr)
 {
-#ifdef ALIGNED_MALLOC
-	_aligned_free(ptr);
-#elif ALIGNMENT_HACK
-	if (ptr)
-		free((char *)ptr - ((char*)ptr)[-1]);
-#else
-	free(ptr);
-#endif
+	return ((const uint8_t*)ptr)[-2];
+}
+
+static inline void *get_block_raw(void *ptr)
+{
+	return (uint8_t*)ptr - ((uint8_t*)ptr)[-1];
+}
+
+static inline uint64_t get_large_size(const void *ptr)
+{
+	uint64_t size;
+	memcpy(&size, (const uint8_t*)ptr - LARGE_HEADER, sizeof(size));
+	return size;
+}
+
+static inline uint32_t get_size_class(size_t size)
+{
+	for (uint32_t i = 0; i < BMEM_NUM_SIZE_CLASSES; i++) {
+		if (size <= class_sizes[i])
+			return i;
+	}
+
+	return LARGE_CLASS;
+}
+
+static void flush_thread_cache(struct thread_cache *cache)
+{
+	for (size_t i = 0; i < BMEM_NUM_SIZE_CLASSES; i++) {
+		struct free_block *block = cache->lists[i];
+
+		while (block) {
+			struct free_block *next = block->next;
+			cache->free(get_block_raw(block));
+			block = next;
+		}
+
+		cache->lists[i] = NULL;
+		cache->counts[i] = 0;
+	}
+}
+
+/* blocks freed after this runs (by other thread exit handlers) are returned
+ * to the system allocator directly */
+static void thread_cache_destroy(void *data)
+{
+	struct thread_cache *cache = data;
+	flush_thread_cache(cache);
+	cache->exiting = true;
+}
+
+static void create_cache_key(void)
+{
+	cache_key_valid =
+		pthread_key_create(&cache_key, thread_cache_destroy) == 0;
+}
+
+static inline struct thread_cache *get_thread_cache(void)
+{
+	struct thread_cache *cache = &thread_cache;
+	long generation;
+
+	if (cache->exiting)
+		return NULL;
+
+	/* the key is only used so that the cache of an exiting thread is
+	 * freed, without it the cache can't be used safely */
+	if (!cache->registered) {
+		pthread_once(&cache_key_once, create_cache_key);
+		if (!cache_key_valid)
+			return NULL;
+
+		pthread_setspecific(cache_key, cache);
+		cache->registered = true;
+		cache->generation = os_atomic_load_long(&allocator_generation);
+		cache->free = alloc.free;
+	}
+
+	generation = os_atomic_load_long(&allocator_generation);
+	if (cache->generation != generation) {
+		flush_thread_cache(cache);
+		cache->generation = generation;
+		cache->free = alloc.free;
+	}
+
+	return cache;
 }
 
-static struct base_allocator alloc = {a_malloc, a_realloc, a_free};
-static long num_allocs = 0;
+static inline void *alloc_block(uint32_t size_class, size_t size)
+{
+	uint8_t *raw;
+
+	if (size_class != LARGE_CLASS) {
+		struct thread_cache *cache = get_thread_cache();
+		struct free_block *block = cache ?
+			cache->lists[size_class] : NULL;
+
+		if (block) {
+			cache->lists[size_class] = block->next;
+			cache->counts[size_class]--;
+			return block;
+		}
+
+		size = class_sizes[size_class];
+	}
+
+	raw = alloc.malloc(alloc_size(size, size_class));
+	if (!raw)
+		return NULL;
+
+	if (size_class == LARGE_CLASS)
+		add_large_bytes((uint64_t)size);
+	return init_block(raw, size_class, size);
+}
+
+static inline void free_block(void *ptr, uint32_t size_class)
+{
+	if (size_class != LARGE_CLASS) {
+		struct thread_cache *cache = get_thread_cache();
+
+		if (cache && cache->counts[size_class] <
+				MAX_CACHED_BYTES / class_sizes[size_class]) {
+			struct free_block *block = ptr;
+			block->next = cache->lists[size_class];
+			cache->lists[size_class] = block;
+			cache->counts[size_class]++;
+			return;
+		}
+	} else {
+		add_large_bytes(0 - get_large_size(ptr));
+	}
+
+	alloc.free(get_block_raw(ptr));
+}
 
 void base_set_allocator(struct base_allocator *defs)
 {
+	/* cached blocks belong to the previous allocator, the cache of each
+	 * thread is flushed with it when that thread next uses its cache */
 	memcpy(&alloc, defs, sizeof(struct base_allocator));
+	os_atomic_inc_long(&allocator_generation);
 }
 
 void *bmalloc(size_t size)
 {
-	void *ptr = alloc.malloc(size);
-	if (!ptr && !size)
-		ptr = alloc.malloc(1);
+	uint32_t size_class = get_size_class(size);
+	void *ptr = alloc_block(size_class, size);
 	if (!ptr) {
 		os_breakpoint();
 		bcrash("Out of memory while trying to allocate %lu bytes",
 				(unsigned long)size);
 	}
 
-	os_atomic_inc_long(&num_allocs);
+	os_atomic_inc_long(&class_allocs[size_class]);
 	return ptr;
 }
 
 void *brealloc(void *ptr, size_t size)
 {
+	uint32_t size_class;
+	uint64_t old_size;
+	size_t old_offset;
+	uint8_t *raw;
+	uint8_t *new_ptr;
+
 	if (!ptr)
-		os_atomic_inc_long(&num_allocs);
+		return bmalloc(size);
 
-	ptr = alloc.realloc(ptr, size);
-	if (!ptr && !size)
-		ptr = alloc.realloc(ptr, 1);
-	if (!ptr) {
+	size_class = get_block_class(ptr);
+
+	if (size_class != LARGE_CLASS) {
+		if (size <= class_sizes[size_class])
+			return ptr;
+
+		new_ptr = bmalloc(size);
+		memcpy(new_ptr, ptr, class_sizes[size_class]);
+		bfree(ptr);
+		return new_ptr;
+	}
+
+	old_size   = get_large_size(ptr);
+	old_offset = (size_t)((uint8_t*)ptr - (uint8_t*)get_block_raw(ptr));
+
+	raw = alloc.realloc(get_block_raw(ptr), alloc_size(size, LARGE_CLASS));
+	if (!raw) {
 		os_breakpoint();
 		bcrash("Out of memory while trying to allocate %lu bytes",
 				(unsigned long)size);
 	}
 
-	return ptr;
+	/* the new allocation isn't necessarily aligned the same way */
+	new_ptr = get_aligned(raw, LARGE_CLASS);
+	if (new_ptr != raw + old_offset)
+		memmove(new_ptr, raw + old_offset,
+				old_size < size ? (size_t)old_size : size);
+
+	add_large_bytes((uint64_t)size - old_size);
+	return init_block(raw, LARGE_CLASS, size);
 }
 
 void bfree(void *ptr)
 {
-	if (ptr)
-		os_atomic_dec_long(&num_allocs);
-	alloc.free(ptr);
+	uint32_t size_class;
+
+	if (!ptr)
+		return;
+
+	size_class = get_block_class(ptr);
+	os_atomic_dec_long(&class_allocs[size_class]);
+	free_block(ptr, size_class);
 }
 
 long bnum_allocs(void)
 {
-	return num_allocs;
+	long num = 0;
+
+	for (size_t i = 0; i <= BMEM_NUM_SIZE_CLASSES; i++)
+		num += os_atomic_load_long(&class_allocs[i]);
+
+	return num;
+}
+
+void bmem_get_stats(struct bmem_stats *stats)
+{
+	if (!stats)
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (size_t i = 0; i <= BMEM_NUM_SIZE_CLASSES; i++) {
+		struct bmem_size_class_stats *cs = &stats->size_classes[i];
+		long allocs = os_atomic_load_long(&class_allocs[i]);
+
+		cs->allocs = allocs;
+
+		if (i < BMEM_NUM_SIZE_CLASSES) {
+			cs->block_size = class_sizes[i];
+			cs->bytes = (uint64_t)allocs * (uint64_t)cs->block_size;
+		} else {
+			cs->bytes = get_large_bytes();
+		}
+
+		stats->allocs += allocs;
+		stats->bytes  += cs->bytes;
+	}
 }
 
 int base_get_alignment(void)
@@ -152,3 +402,145 @@ void *bmemdup(const void *ptr, size_t size)
 
 	return out;
 }
+
+/* ------------------------------------------------------------------------- */
+/* arenas */
+
+#define ARENA_ALIGNMENT     16
+#define ARENA_DEFAULT_BLOCK 4096
+
+struct arena_block {
+	struct arena_block *next;
+	size_t             size;
+	size_t             used;
+};
+
+#define ARENA_BLOCK_HEADER \
+	((sizeof(struct arena_block) + ARENA_ALIGNMENT - 1) & \
+	 ~(size_t)(ARENA_ALIGNMENT - 1))
+
+struct bmem_arena {
+	struct arena_block *first;
+	struct arena_block *cur;
+	size_t             block_size;
+};
+
+static inline uint8_t *arena_block_data(struct arena_block *block)
+{
+	return (uint8_t*)block + ARENA_BLOCK_HEADER;
+}
+
+bmem_arena_t *bmem_arena_create(size_t block_size)
+{
+	struct bmem_arena *arena = bzalloc(sizeof(struct bmem_arena));
+	arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK;
+	return arena;
+}
+
+void bmem_arena_destroy(bmem_arena_t *arena)
+{
+	struct arena_block *block;
+
+	if (!arena)
+		return;
+
+	block = arena->first;
+	while (block) {
+		struct arena_block *next = block->next;
+		bfree(block);
+		block = next;
+	}
+
+	bfree(arena);
+}
+
+void *bmem_arena_alloc(bmem_arena_t *arena, size_t size)
+{
+	struct arena_block *block;
+	void *ptr;
+
+	if (!arena)
+		return NULL;
+
+	size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+	if (!size)
+		size = ARENA_ALIGNMENT;
+
+	block = arena->cur;
+
+	/* after a reset, reuse the blocks that were already allocated */
+	while (block && block->used + size > block->size)
+		block = block->next;
+
+	if (!block) {
+		size_t block_size = arena->block_size > size ?
+			arena->block_size : size;
+
+		block = bmalloc(ARENA_BLOCK_HEADER + block_size);
+		block->size = block_size;
+		block->used = 0;
+
+		if (arena->cur) {
+			block->next = arena->cur->next;
+			arena->cur->next = block;
+		} else {
+			block->next = NULL;
+			arena->first = block;
+		}
+	}
+
+	arena->cur = block;
+
+	ptr = arena_block_data(block) + block->used;
+	block->used += size;
+	return ptr;
+}
+
+void bmem_arena_reset(bmem_arena_t *arena)
+{
+	if (!arena)
+		return;
+
+	for (struct arena_block *block = arena->first; block;
+			block = block->next)
+		block->used = 0;
+
+	arena->cur = arena->first;
+}
+
+bmem_arena_mark_t bmem_arena_mark(bmem_arena_t *arena)
+{
+	bmem_arena_mark_t mark = {NULL, 0};
+
+	if (arena && arena->cur) {
+		mark.block = arena->cur;
+		mark.used = arena->cur->used;
+	}
+
+	return mark;
+}
+
+void bmem_arena_release(bmem_arena_t *arena, bmem_arena_mark_t mark)
+{
+	struct arena_block *block;
+
+	if (!arena)
+		return;
+	if (!mark.block) {
+		bmem_arena_reset(arena);
+		return;
+	}
+
+	/* blocks after the current one are always empty, so everything that
+	 * was allocated after the mark lives between the marked block and the
+	 * current one */
+	block = mark.block;
+	while (block != arena->cur) {
+		block = block->next;
+		block->used = 0;
+	}
+
+	block = mark.block;
+	block->used = mark.used;
+	arena->cur = block;
+}
@@ -41,6 +41,28 @@ EXPORT int base_get_alignment(void);
 
 EXPORT long bnum_allocs(void);
 
+/*
+ * Allocation statistics.  Small allocations are rounded up to one of the size
+ * classes, the last entry counts allocations larger than the biggest size
+ * class (its block_size is 0, its bytes are the requested sizes).
+ */
+
+#define BMEM_NUM_SIZE_CLASSES 6
+
+struct bmem_size_class_stats {
+	size_t   block_size;
+	long     allocs;
+	uint64_t bytes;
+};
+
+struct bmem_stats {
+	long     allocs;
+	uint64_t bytes;
+	struct bmem_size_class_stats size_classes[BMEM_NUM_SIZE_CLASSES + 1];
+};
+
+EXPORT void bmem_get_stats(struct bmem_stats *stats);
+
 EXPORT void *bmemdup(const void *ptr, size_t size);
 
 static inline void *bzalloc(size_t size)
@@ -91,6 +113,53 @@ static inline wchar_t *bwstrdup(const wchar_t *str)
 	return bwstrdup_n(str, wcslen(str));
 }
 
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Arena allocator for short-lived scratch memory
+ *
+ *   Allocations are carved out of larger blocks and can't be freed
+ * individually; bmem_arena_reset releases everything at once (keeping the
+ * blocks for reuse), which makes arenas suited for memory that only lives for
+ * the duration of a frame, a tick or a single parse.  bmem_arena_mark and
+ * bmem_arena_release release everything allocated after the mark, for memory
+ * that only lives while a nested part of the work is done.  Returned memory is
+ * aligned to 16 bytes.  An arena must not be used by multiple threads at once.
+ */
+
+struct bmem_arena;
+typedef struct bmem_arena bmem_arena_t;
+
+/** Creates an arena, block_size of 0 uses the default block size */
+EXPORT bmem_arena_t *bmem_arena_create(size_t block_size);
+EXPORT void bmem_arena_destroy(bmem_arena_t *arena);
+
+EXPORT void *bmem_arena_alloc(bmem_arena_t *arena, size_t size);
+EXPORT void bmem_arena_reset(bmem_arena_t *arena);
+
+struct bmem_arena_mark {
+	void   *block;
+	size_t used;
+};
+typedef struct bmem_arena_mark bmem_arena_mark_t;
+
+EXPORT bmem_arena_mark_t bmem_arena_mark(bmem_arena_t *arena);
+EXPORT void bmem_arena_release(bmem_arena_t *arena, bmem_arena_mark_t mark);
+
+static inline char *bmem_arena_strdup_n(bmem_arena_t *arena, const char *str,
+		size_t n)
+{
+	char *dup;
+	if (!str)
+		return NULL;
+
+	dup = (char*)bmem_arena_alloc(arena, n+1);
+	memcpy(dup, str, n);
+	dup[n] = 0;
+
+	return dup;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,6 +15,7 @@
  */
 
 #include <inttypes.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <wchar.h>
 #include "config-file.h"
@@ -26,9 +27,19 @@
 #include "lexer.h"
 #include "dstr.h"
 
+/*
+ * Items are looked up by a case-insensitive hash of their name.  Sections with
+ * more than a handful of items also keep an open addressing index of their
+ * items (item index + 1, 0 for an empty slot) so that lookups do not need to
+ * walk the entire section.
+ */
+
+#define INDEX_MIN_ITEMS 8
+
 struct config_item {
 	char *name;
 	char *value;
+	uint32_t hash;
 };
 
 static inline void config_item_free(struct config_item *item)
@@ -39,7 +50,10 @@ static inline void config_item_free(struct config_item *item)
 
 struct config_section {
 	char *name;
+	uint32_t hash;
 	struct darray items; /* struct config_item */
+	uint32_t *index;
+	size_t index_size;
 };
 
 static inline void config_section_free(struct config_section *section)
@@ -51,26 +65,118 @@ static inline void config_section_free(struct config_section *section)
 		config_item_free(items+i);
 
 	darray_free(&section->items);
+	bfree(section->index);
 	bfree(section->name);
 }
 
+static inline uint32_t config_hash(const char *str)
+{
+	uint32_t hash = 2166136261U;
+
+	if (!str)
+		return 0;
+
+	while (*str) {
+		hash ^= (uint32_t)tolower((unsigned char)*(str++));
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static inline void index_insert(uint32_t *index, size_t size, uint32_t hash,
+		size_t idx)
+{
+	size_t mask = size - 1;
+	size_t pos  = hash & mask;
+
+	while (index[pos])
+		pos = (pos + 1) & mask;
+
+	index[pos] = (uint32_t)idx + 1;
+}
+
+static void section_rebuild_index(struct config_section *section)
+{
+	struct config_item *items = section->items.array;
+	size_t num = section->items.num;
+	size_t size = 16;
+
+	bfree(section->index);
+	section->index = NULL;
+	section->index_size = 0;
+
+	if (num < INDEX_MIN_ITEMS)
+		return;
+
+	while (size < num * 4)
+		size <<= 1;
+
+	section->index = bzalloc(size * sizeof(uint32_t));
+	section->index_size = size;
+
+	for (size_t i = 0; i < num; i++)
+		index_insert(section->index, size, items[i].hash, i);
+}
+
+/* must be called right after an item has been pushed to the section */
+static inline void section_index_last_item(struct config_section *section)
+{
+	struct config_item *items = section->items.array;
+	size_t num = section->items.num;
+
+	if (num < INDEX_MIN_ITEMS)
+		return;
+
+	if (num * 2 > section->index_size)
+		section_rebuild_index(section);
+	else
+		index_insert(section->index, section->index_size,
+				items[num - 1].hash, num - 1);
+}
+
+static struct config_item *section_find_item(
+		const struct config_section *section, const char *name,
+		uint32_t hash)
+{
+	struct config_item *items = section->items.array;
+
+	if (section->index) {
+		size_t mask = section->index_size - 1;
+		size_t pos  = hash & mask;
+
+		while (section->index[pos]) {
+			struct config_item *item =
+				items + (section->index[pos] - 1);
+
+			if (item->hash == hash &&
+			    astrcmpi(item->name, name) == 0)
+				return item;
+
+			pos = (pos + 1) & mask;
+		}
+
+		return NULL;
+	}
+
+	for (size_t i = 0; i < section->items.num; i++) {
+		struct config_item *item = items + i;
+
+		if (item->hash == hash && astrcmpi(item->name, name) == 0)
+			return item;
+	}
+
+	return NULL;
+}
+
 struct config_data {
 	char *file;
 	struct darray sections; /* struct config_section */
 	struct darray defaults; /* struct config_section */
-	pthread_mutex_t mutex;
+	pthread_rwlock_t rwlock;
+	volatile bool dirty;
 };
 
-static inline bool init_mutex(config_t *config)
-{
-	pthread_mutexattr_t attr;
-	if (pthread_mutexattr_init(&attr) != 0)
-		return false;
-	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
-		return false;
-	return pthread_mutex_init(&config->mutex, &attr) == 0;
-}
-
 config_t *config_create(const char *file)
 {
 	struct config_data *config;
@@ -83,7 +189,7 @@ config_t *config_create(const char *file)
 
 	config = bzalloc(sizeof(struct config_data));
 
-	if (!init_mutex(config)) {
+	if (pthread_rwlock_init(&config->rwlock, NULL) != 0) {
 		bfree(config);
 		return NULL;
 	}
@@ -163,8 +269,8 @@ static void unescape(struct dstr *str)
 		*write = '\0';
 }
 
-static void config_add_item(struct darray *items, struct strref *name,
-		struct strref *value)
+static void config_add_item(struct config_section *section,
+		struct strref *name, struct strref *value)
 {
 	struct config_item item;
 	struct dstr item_value;
@@ -174,7 +280,9 @@ static void config_add_item(struct darray *items, struct strref *name,
 
 	item.name  = bstrdup_n(name->array,  name->len);
 	item.value = item_value.array;
-	darray_push_back(sizeof(struct config_item), items, &item);
+	item.hash  = config_hash(item.name);
+	darray_push_back(sizeof(struct config_item), &section->items, &item);
+	section_index_last_item(section);
 }
 
 static void config_parse_section(struct config_section *section,
@@ -213,7 +321,7 @@ static void config_parse_section(struct config_section *section,
 		config_parse_string(lex, &value, 0);
 
 		if (!strref_is_empty(&value))
-			config_add_item(&section->items, &name, &value);
+			config_add_item(section, &name, &value);
 	}
 }
 
@@ -251,6 +359,7 @@ static void parse_config_data(struct darray *sections, struct lexer *lex)
 				sections);
 		section->name = bstrdup_n(section_name.array,
 				section_name.len);
+		section->hash = config_hash(section->name);
 		config_parse_section(section, lex);
 	}
 }
@@ -296,7 +405,7 @@ int config_open(config_t **config, const char *file,
 	if (!*config)
 		return CONFIG_ERROR;
 
-	if (!init_mutex(*config)) {
+	if (pthread_rwlock_init(&(*config)->rwlock, NULL) != 0) {
 		bfree(*config);
 		return CONFIG_ERROR;
 	}
@@ -324,7 +433,7 @@ int config_open_string(config_t **config, const char *str)
 	if (!*config)
 		return CONFIG_ERROR;
 
-	if (!init_mutex(*config)) {
+	if (pthread_rwlock_init(&(*config)->rwlock, NULL) != 0) {
 		bfree(*config);
 		return CONFIG_ERROR;
 	}
@@ -347,28 +456,19 @@ int config_open_defaults(config_t *config, const char *file)
 	return config_parse_file(&config->defaults, file, false);
 }
 
-int config_save(config_t *config)
+static int config_save_file(config_t *config, const char *file)
 {
 	FILE *f;
 	struct dstr str, tmp;
 	size_t i, j;
 
-	if (!config)
-		return CONFIG_ERROR;
-	if (!config->file)
-		return CONFIG_ERROR;
+	f = os_fopen(file, "wb");
+	if (!f)
+		return CONFIG_FILENOTFOUND;
 
 	dstr_init(&str);
 	dstr_init(&tmp);
 
-	pthread_mutex_lock(&config->mutex);
-
-	f = os_fopen(config->file, "wb");
-	if (!f) {
-		pthread_mutex_unlock(&config->mutex);
-		return CONFIG_FILENOTFOUND;
-	}
-
 	for (i = 0; i < config->sections.num; i++) {
 		struct config_section *section = darray_item(
 				sizeof(struct config_section),
@@ -403,21 +503,53 @@ int config_save(config_t *config)
 	fwrite(str.array, 1, str.len, f);
 	fclose(f);
 
-	pthread_mutex_unlock(&config->mutex);
-
 	dstr_free(&tmp);
 	dstr_free(&str);
 
 	return CONFIG_SUCCESS;
 }
 
+/* the file only needs to be rewritten if a user value changed since the last
+ * save, or if it does not exist yet.  only called with the read lock held, so
+ * no value can be changed while the file is being written. */
+static inline bool config_needs_save(config_t *config)
+{
+	return os_atomic_set_bool(&config->dirty, false) ||
+	       !os_file_exists(config->file);
+}
+
+int config_save(config_t *config)
+{
+	int ret = CONFIG_SUCCESS;
+
+	if (!config)
+		return CONFIG_ERROR;
+	if (!config->file)
+		return CONFIG_ERROR;
+
+	pthread_rwlock_rdlock(&config->rwlock);
+
+	if (config_needs_save(config)) {
+		ret = config_save_file(config, config->file);
+		if (ret != CONFIG_SUCCESS)
+			os_atomic_set_bool(&config->dirty, true);
+	}
+
+	pthread_rwlock_unlock(&config->rwlock);
+	return ret;
+}
+
 int config_save_safe(config_t *config, const char *temp_ext,
 		const char *backup_ext)
 {
 	struct dstr temp_file = {0};
 	struct dstr backup_file = {0};
-	char *file = config->file;
-	int ret;
+	int ret = CONFIG_SUCCESS;
+
+	if (!config)
+		return CONFIG_ERROR;
+	if (!config->file)
+		return CONFIG_ERROR;
 
 	if (!temp_ext || !*temp_ext) {
 		blog(LOG_ERROR, "config_save_safe: invalid "
@@ -425,20 +557,19 @@ int config_save_safe(config_t *config, const char *temp_ext,
 		return CONFIG_ERROR;
 	}
 
-	pthread_mutex_lock(&config->mutex);
+	pthread_rwlock_rdlock(&config->rwlock);
+
+	if (!config_needs_save(config))
+		goto cleanup;
 
 	dstr_copy(&temp_file, config->file);
 	if (*temp_ext != '.')
 		dstr_cat(&temp_file, ".");
 	dstr_cat(&temp_file, temp_ext);
 
-	config->file = temp_file.array;
-	ret = config_save(config);
-	config->file = file;
-
-	if (ret != CONFIG_SUCCESS) {
-		goto cleanup;
-	}
+	ret = config_save_file(config, temp_file.array);
+	if (ret != CONFIG_SUCCESS)
+		goto fail;
 
 	if (backup_ext && *backup_ext) {
 		dstr_copy(&backup_file, config->file);
@@ -447,11 +578,19 @@ int config_save_safe(config_t *config, const char *temp_ext,
 		dstr_cat(&backup_file, backup_ext);
 	}
 
-	if (os_safe_replace(file, temp_file.array, backup_file.array) != 0)
+	if (os_safe_replace(config->file, temp_file.array,
+				backup_file.array) != 0) {
 		ret = CONFIG_ERROR;
+		goto fail;
+	}
+
+	goto cleanup;
+
+fail:
+	os_atomic_set_bool(&config->dirty, true);
 
 cleanup:
-	pthread_mutex_unlock(&config->mutex);
+	pthread_rwlock_unlock(&config->rwlock);
 	dstr_free(&temp_file);
 	dstr_free(&backup_file);
 	return ret;
@@ -475,7 +614,7 @@ void config_close(config_t *config)
 	darray_free(&config->defaults);
 	darray_free(&config->sections);
 	bfree(config->file);
-	pthread_mutex_destroy(&config->mutex);
+	pthread_rwlock_destroy(&config->rwlock);
 	bfree(config);
 }
 
@@ -489,7 +628,7 @@ const char *config_get_section(config_t *config, size_t idx)
 	struct config_section *section;
 	const char *name = NULL;
 
-	pthread_mutex_lock(&config->mutex);
+	pthread_rwlock_rdlock(&config->rwlock);
 
 	if (idx >= config->sections.num)
 		goto unlock;
@@ -499,29 +638,43 @@ const char *config_get_section(config_t *config, size_t idx)
 	name = section->name;
 
 unlock:
-	pthread_mutex_unlock(&config->mutex);
+	pthread_rwlock_unlock(&config->rwlock);
 	return name;
 }
 
+static inline struct config_section *config_find_section(
+		const struct darray *sections, size_t start,
+		const char *section, uint32_t hash)
+{
+	struct config_section *array = sections->array;
+
+	for (size_t i = start; i < sections->num; i++) {
+		struct config_section *sec = array + i;
+
+		if (sec->hash == hash && astrcmpi(sec->name, section) == 0)
+			return sec;
+	}
+
+	return NULL;
+}
+
 static const struct config_item *config_find_item(const struct darray *sections,
 		const char *section, const char *name)
 {
-	size_t i, j;
-
-	for (i = 0; i < sections->num; i++) {
-		const struct config_section *sec = darray_item(
-				sizeof(struct config_section), sections, i);
+	const struct config_section *array = sections->array;
+	const struct config_section *sec;
+	uint32_t section_hash = config_hash(section);
+	uint32_t hash = config_hash(name);
+	size_t start = 0;
 
-		if (astrcmpi(sec->name, section) == 0) {
-			for (j = 0; j < sec->items.num; j++) {
-				struct config_item *item = darray_item(
-						sizeof(struct config_item),
-						&sec->items, j);
+	/* a section may appear more than once in a file */
+	while ((sec = config_find_section(sections, start, section,
+					section_hash)) != NULL) {
+		struct config_item *item = section_find_item(sec, name, hash);
+		if (item)
+			return item;
 
-				if (astrcmpi(item->name, name) == 0)
-					return item;
-			}
-		}
+		start = (size_t)(sec - array) + 1;
 	}
 
 	return NULL;
@@ -530,45 +683,47 @@ static const struct config_item *config_find_item(const struct darray *sections,
 static void config_set_item(config_t *config, struct darray *sections,
 		const char *section, const char *name, char *value)
 {
-	struct config_section *sec = NULL;
-	struct config_section *array = sections->array;
+	struct config_section *sec;
 	struct config_item *item;
-	size_t i, j;
+	uint32_t section_hash = config_hash(section);
+	uint32_t hash = config_hash(name);
+	bool user_value = sections == &config->sections;
 
-	pthread_mutex_lock(&config->mutex);
+	pthread_rwlock_wrlock(&config->rwlock);
 
-	for (i = 0; i < sections->num; i++) {
-		struct config_section *cur_sec = array+i;
-		struct config_item *items = cur_sec->items.array;
+	sec = config_find_section(sections, 0, section, section_hash);
+	item = sec ? section_find_item(sec, name, hash) : NULL;
 
-		if (astrcmpi(cur_sec->name, section) == 0) {
-			for (j = 0; j < cur_sec->items.num; j++) {
-				item = items+j;
-
-				if (astrcmpi(item->name, name) == 0) {
-					bfree(item->value);
-					item->value = value;
-					goto unlock;
-				}
-			}
-
-			sec = cur_sec;
-			break;
+	if (item) {
+		if (strcmp(item->value, value) == 0) {
+			bfree(value);
+			goto unlock;
 		}
+
+		bfree(item->value);
+		item->value = value;
+		goto mark_dirty;
 	}
 
 	if (!sec) {
 		sec = darray_push_back_new(sizeof(struct config_section),
 				sections);
 		sec->name = bstrdup(section);
+		sec->hash = section_hash;
 	}
 
 	item = darray_push_back_new(sizeof(struct config_item), &sec->items);
 	item->name  = bstrdup(name);
 	item->value = value;
+	item->hash  = hash;
+	section_index_last_item(sec);
+
+mark_dirty:
+	if (user_value)
+		os_atomic_set_bool(&config->dirty, true);
 
 unlock:
-	pthread_mutex_unlock(&config->mutex);
+	pthread_rwlock_unlock(&config->rwlock);
 }
 
 void config_set_string(config_t *config, const char *section,
@@ -662,7 +817,7 @@ const char *config_get_string(config_t *config, const char *section,
 	const struct config_item *item;
 	const char *value = NULL;
 
-	pthread_mutex_lock(&config->mutex);
+	pthread_rwlock_rdlock(&config->rwlock);
 
 	item = config_find_item(&config->sections, section, name);
 	if (!item)
@@ -670,7 +825,7 @@ const char *config_get_string(config_t *config, const char *section,
 	if (item)
 		value = item->value;
 
-	pthread_mutex_unlock(&config->mutex);
+	pthread_rwlock_unlock(&config->rwlock);
 	return value;
 }
 
@@ -741,34 +896,39 @@ bool config_remove_value(config_t *config, const char *section,
 		const char *name)
 {
 	struct darray *sections = &config->sections;
+	struct config_section *array;
+	struct config_section *sec;
+	uint32_t section_hash = config_hash(section);
+	uint32_t hash = config_hash(name);
+	size_t start = 0;
 	bool success = false;
 
-	pthread_mutex_lock(&config->mutex);
+	pthread_rwlock_wrlock(&config->rwlock);
 
-	for (size_t i = 0; i < sections->num; i++) {
-		struct config_section *sec = darray_item(
-				sizeof(struct config_section), sections, i);
+	array = sections->array;
 
-		if (astrcmpi(sec->name, section) != 0)
-			continue;
+	while ((sec = config_find_section(sections, start, section,
+					section_hash)) != NULL) {
+		struct config_item *item = section_find_item(sec, name, hash);
 
-		for (size_t j = 0; j < sec->items.num; j++) {
-			struct config_item *item = darray_item(
-					sizeof(struct config_item),
-					&sec->items, j);
+		if (item) {
+			size_t idx = (size_t)(item - (struct config_item*)
+					sec->items.array);
 
-			if (astrcmpi(item->name, name) == 0) {
-				config_item_free(item);
-				darray_erase(sizeof(struct config_item),
-						&sec->items, j);
-				success = true;
-				goto unlock;
-			}
+			config_item_free(item);
+			darray_erase(sizeof(struct config_item), &sec->items,
+					idx);
+			section_rebuild_index(sec);
+
+			os_atomic_set_bool(&config->dirty, true);
+			success = true;
+			break;
 		}
+
+		start = (size_t)(sec - array) + 1;
 	}
 
-unlock:
-	pthread_mutex_unlock(&config->mutex);
+	pthread_rwlock_unlock(&config->rwlock);
 	return success;
 }
 
@@ -778,13 +938,13 @@ const char *config_get_default_string(config_t *config,
 	const struct config_item *item;
 	const char *value = NULL;
 
-	pthread_mutex_lock(&config->mutex);
+	pthread_rwlock_rdlock(&config->rwlock);
 
 	item = config_find_item(&config->defaults, section, name);
 	if (item)
 		value = item->value;
 
-	pthread_mutex_unlock(&config->mutex);
+	pthread_rwlock_unlock(&config->rwlock);
 	return value;
 }
 
@@ -833,9 +993,9 @@ bool config_has_user_value(config_t *config, const char *section,
 		const char *name)
 {
 	bool success;
-	pthread_mutex_lock(&config->mutex);
+	pthread_rwlock_rdlock(&config->rwlock);
 	success = config_find_item(&config->sections, section, name) != NULL;
-	pthread_mutex_unlock(&config->mutex);
+	pthread_rwlock_unlock(&config->rwlock);
 	return success;
 }
 
@@ -843,9 +1003,9 @@ bool config_has_default_value(config_t *config, const char *section,
 		const char *name)
 {
 	bool success;
-	pthread_mutex_lock(&config->mutex);
+	pthread_rwlock_rdlock(&config->rwlock);
 	success = config_find_item(&config->defaults, section, name) != NULL;
-	pthread_mutex_unlock(&config->mutex);
+	pthread_rwlock_unlock(&config->rwlock);
 	return success;
 }
 
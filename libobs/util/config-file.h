@@ -45,6 +45,8 @@ EXPORT config_t *config_create(const char *file);
 EXPORT int config_open(config_t **config, const char *file,
 		enum config_open_type open_type);
 EXPORT int config_open_string(config_t **config, const char *str);
+/* Saving only rewrites the file if a user value has changed since the last
+ * save (or the file does not exist yet), otherwise it does nothing. */
 EXPORT int config_save(config_t *config);
 EXPORT int config_save_safe(config_t *config, const char *temp_ext,
 		const char *backup_ext);
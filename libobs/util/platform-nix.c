@@ -27,6 +27,7 @@
 #include <glob.h>
 #include <time.h>
 #include <signal.h>
+#include <fcntl.h>
 
 #include "obsconfig.h"
 
@@ -374,6 +375,36 @@ int64_t os_get_free_space(const char *path)
 	return ret;
 }
 
+int os_fpreallocate(FILE *file, int64_t size)
+{
+	int fd;
+
+	if (fflush(file) != 0)
+		return -1;
+
+	fd = fileno(file);
+
+#ifdef __APPLE__
+	fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, (off_t)size, 0};
+
+	if (fcntl(fd, F_PREALLOCATE, &store) == -1) {
+		store.fst_flags = F_ALLOCATEALL;
+		if (fcntl(fd, F_PREALLOCATE, &store) == -1)
+			return -1;
+	}
+
+	return ftruncate(fd, (off_t)size);
+#else
+	int ret = posix_fallocate(fd, 0, (off_t)size);
+	if (ret != 0) {
+		errno = ret;
+		return -1;
+	}
+
+	return 0;
+#endif
+}
+
 struct posix_glob_info {
 	struct os_glob_info base;
 	glob_t gl;
@@ -21,6 +21,7 @@
 #include <shlobj.h>
 #include <intrin.h>
 #include <psapi.h>
+#include <io.h>
 
 #include "base.h"
 #include "platform.h"
@@ -53,12 +54,17 @@ static inline uint32_t get_winver(void)
 	return winver;
 }
 
+/* SetDllDirectory is process wide, so modules opened on several threads
+ * would otherwise search each other's directories for their dependencies */
+static pthread_mutex_t dll_directory_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 void *os_dlopen(const char *path)
 {
 	struct dstr dll_name;
 	wchar_t *wpath;
 	wchar_t *wpath_slash;
 	HMODULE h_library = NULL;
+	DWORD error;
 
 	if (!path)
 		return NULL;
@@ -73,6 +79,8 @@ void *os_dlopen(const char *path)
 	/* to make module dependency issues easier to deal with, allow
 	 * dynamically loaded libraries on windows to search for dependent
 	 * libraries that are within the library's own directory */
+	pthread_mutex_lock(&dll_directory_mutex);
+
 	wpath_slash = wcsrchr(wpath, L'/');
 	if (wpath_slash) {
 		*wpath_slash = 0;
@@ -81,14 +89,16 @@ void *os_dlopen(const char *path)
 	}
 
 	h_library = LoadLibraryW(wpath);
+	error = h_library ? 0 : GetLastError();
 	bfree(wpath);
 	dstr_free(&dll_name);
 
 	if (wpath_slash)
 		SetDllDirectoryW(NULL);
 
+	pthread_mutex_unlock(&dll_directory_mutex);
+
 	if (!h_library) {
-		DWORD error = GetLastError();
 		char *message = NULL;
 
 		FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM |
@@ -421,6 +431,32 @@ int64_t os_get_free_space(const char *path)
 	return -1;
 }
 
+int os_fpreallocate(FILE *file, int64_t size)
+{
+	FILE_ALLOCATION_INFO alloc_info;
+	LARGE_INTEGER        end;
+	HANDLE               handle;
+
+	if (fflush(file) != 0)
+		return -1;
+
+	handle = (HANDLE)_get_osfhandle(_fileno(file));
+	if (handle == INVALID_HANDLE_VALUE)
+		return -1;
+
+	alloc_info.AllocationSize.QuadPart = size;
+	if (!SetFileInformationByHandle(handle, FileAllocationInfo,
+				&alloc_info, sizeof(alloc_info)))
+		return -1;
+
+	end.QuadPart = size;
+	if (!SetFilePointerEx(handle, end, NULL, FILE_BEGIN) ||
+	    !SetEndOfFile(handle))
+		return -1;
+
+	return 0;
+}
+
 static void make_globent(struct os_globent *ent, WIN32_FIND_DATA *wfd,
 		const char *pattern)
 {
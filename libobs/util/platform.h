@@ -43,6 +43,11 @@ EXPORT int os_stat(const char *file, struct stat *st);
 EXPORT int os_fseeki64(FILE *file, int64_t offset, int origin);
 EXPORT int64_t os_ftelli64(FILE *file);
 
+/* allocates disk space for the first size bytes of the file and extends it to
+ * that size if it is smaller, so later writes can't run out of space.  the
+ * file position is undefined afterwards */
+EXPORT int os_fpreallocate(FILE *file, int64_t size);
+
 EXPORT size_t os_fread_mbs(FILE *file, char **pstr);
 EXPORT size_t os_fread_utf8(FILE *file, char **pstr);
 
@@ -443,6 +443,35 @@ void profile_end(const char *name)
 	merge_context(call);
 }
 
+void profile_record_time(const char *name, uint64_t duration_ns)
+{
+	uint64_t end = os_gettime_ns();
+	if (!thread_enabled)
+		return;
+
+	profile_call new_call = {
+		.name = name,
+		.start_time = end > duration_ns ? end - duration_ns : 0,
+		.end_time = end,
+#ifdef TRACK_OVERHEAD
+		.overhead_end = end,
+#endif
+		.parent = thread_context,
+	};
+
+#ifdef TRACK_OVERHEAD
+	new_call.overhead_start = new_call.start_time;
+#endif
+
+	if (new_call.parent) {
+		da_push_back(new_call.parent->children, &new_call);
+	} else {
+		profile_call *call = bmalloc(sizeof(profile_call));
+		memcpy(call, &new_call, sizeof(profile_call));
+		merge_context(call);
+	}
+}
+
 static int profiler_time_entry_compare(const void *first, const void *second)
 {
 	int64_t diff = ((profiler_time_entry*)second)->time_delta -
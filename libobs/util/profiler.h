@@ -20,6 +20,10 @@ EXPORT void profile_register_root(const char *name,
 EXPORT void profile_start(const char *name);
 EXPORT void profile_end(const char *name);
 
+/** Records a call that took duration_ns and ended now, for durations that
+ * were measured elsewhere (for example across threads) */
+EXPORT void profile_record_time(const char *name, uint64_t duration_ns);
+
 EXPORT void profile_reenable_thread(void);
 
 /* ------------------------------------------------------------------------- */
@@ -15,168 +15,160 @@
  */
 
 #include "dstr.h"
+#include "darray.h"
 #include "text-lookup.h"
 #include "lexer.h"
 #include "platform.h"
 
 /* ------------------------------------------------------------------------- */
 
-struct text_leaf {
-	char *lookup, *value;
+/*
+ *   Strings are stored in large blocks rather than allocated one by one.  A
+ * new block is usually only needed for each file that gets added, and strings
+ * never move once they're stored, so returned values stay valid until the
+ * lookup is destroyed.
+ */
+
+#define MIN_BLOCK_SIZE 4096
+#define INITIAL_TABLE_SIZE 64
+
+struct text_block {
+	struct text_block *next;
+	size_t size;
+	size_t used;
+	char data[];
 };
 
-static inline void text_leaf_destroy(struct text_leaf *leaf)
-{
-	if (leaf) {
-		bfree(leaf->lookup);
-		bfree(leaf->value);
-		bfree(leaf);
-	}
-}
+struct text_item {
+	uint32_t hash;
+	const char *lookup;
+	const char *value;
+};
 
-/* ------------------------------------------------------------------------- */
+struct text_lookup {
+	struct dstr language;
+	struct text_block *blocks;
 
-struct text_node {
-	struct dstr str;
-	struct text_node *first_subnode;
-	struct text_leaf *leaf;
+	DARRAY(struct text_item) items;
 
-	struct text_node *next;
+	/* open addressing table of item indices + 1, 0 being empty */
+	uint32_t *table;
+	size_t table_size;
 };
 
-static void text_node_destroy(struct text_node *node)
+static void lookup_reserve(struct text_lookup *lookup, size_t size)
 {
-	struct text_node *subnode;
+	struct text_block *block = lookup->blocks;
 
-	if (!node)
+	if (block && block->size - block->used >= size)
 		return;
 
-	subnode = node->first_subnode;
-	while (subnode) {
-		struct text_node *destroy_node = subnode;
-
-		subnode = subnode->next;
-		text_node_destroy(destroy_node);
-	}
+	if (size < MIN_BLOCK_SIZE)
+		size = MIN_BLOCK_SIZE;
 
-	dstr_free(&node->str);
-	if (node->leaf)
-		text_leaf_destroy(node->leaf);
-	bfree(node);
+	block = bmalloc(sizeof(struct text_block) + size);
+	block->next = lookup->blocks;
+	block->size = size;
+	block->used = 0;
+	lookup->blocks = block;
 }
 
-static struct text_node *text_node_bychar(struct text_node *node, char ch)
+static char *lookup_alloc(struct text_lookup *lookup, size_t size)
 {
-	struct text_node *subnode = node->first_subnode;
+	struct text_block *block;
 
-	while (subnode) {
-		if (!dstr_is_empty(&subnode->str) &&
-		    subnode->str.array[0] == ch)
-			return subnode;
+	lookup_reserve(lookup, size);
 
-		subnode = subnode->next;
-	}
-
-	return NULL;
+	block = lookup->blocks;
+	block->used += size;
+	return block->data + block->used - size;
 }
 
-static struct text_node *text_node_byname(struct text_node *node,
-		const char *name)
+/* lookups are case insensitive, so the hash is as well */
+static inline uint32_t lookup_hash(const char *str, size_t len)
 {
-	struct text_node *subnode = node->first_subnode;
+	uint32_t hash = 2166136261U;
 
-	while (subnode) {
-		if (astrcmpi_n(subnode->str.array, name, subnode->str.len) == 0)
-			return subnode;
+	for (size_t i = 0; i < len; i++) {
+		uint8_t ch = (uint8_t)str[i];
+		if (ch >= 'A' && ch <= 'Z')
+			ch += 0x20;
 
-		subnode = subnode->next;
+		hash ^= ch;
+		hash *= 16777619U;
 	}
 
-	return NULL;
+	return hash;
 }
 
-/* ------------------------------------------------------------------------- */
+static void lookup_rehash(struct text_lookup *lookup, size_t size)
+{
+	size_t mask = size - 1;
 
-struct text_lookup {
-	struct dstr language;
-	struct text_node *top;
-};
+	bfree(lookup->table);
+	lookup->table = bzalloc(size * sizeof(uint32_t));
+	lookup->table_size = size;
 
-static void lookup_createsubnode(const char *lookup_val,
-		struct text_leaf *leaf, struct text_node *node)
-{
-	struct text_node *new = bzalloc(sizeof(struct text_node));
-	new->leaf = leaf;
-	new->next = node->first_subnode;
-	dstr_copy(&new->str, lookup_val);
+	for (size_t i = 0; i < lookup->items.num; i++) {
+		size_t slot = lookup->items.array[i].hash & mask;
 
-	node->first_subnode = new;
+		while (lookup->table[slot])
+			slot = (slot + 1) & mask;
+
+		lookup->table[slot] = (uint32_t)(i + 1);
+	}
 }
 
-static void lookup_splitnode(const char *lookup_val, size_t len,
-		struct text_leaf *leaf, struct text_node *node)
+static struct text_item *lookup_find(struct text_lookup *lookup,
+		const char *lookup_val, size_t len, uint32_t hash,
+		size_t *p_slot)
 {
-	struct text_node *split = bzalloc(sizeof(struct text_node));
+	size_t mask = lookup->table_size - 1;
+	size_t slot = hash & mask;
+	uint32_t idx;
 
-	dstr_copy(&split->str, node->str.array+len);
-	split->leaf = node->leaf;
-	split->first_subnode = node->first_subnode;
-	node->first_subnode = split;
+	while ((idx = lookup->table[slot]) != 0) {
+		struct text_item *item = lookup->items.array + (idx - 1);
 
-	dstr_resize(&node->str, len);
+		if (item->hash == hash &&
+		    astrcmpi_n(item->lookup, lookup_val, len) == 0 &&
+		    item->lookup[len] == 0)
+			return item;
 
-	if (lookup_val[len] != 0) {
-		node->leaf = NULL;
-		lookup_createsubnode(lookup_val+len, leaf, node);
-	} else {
-		node->leaf = leaf;
+		slot = (slot + 1) & mask;
 	}
-}
 
-static inline void lookup_replaceleaf(struct text_node *node,
-		struct text_leaf *leaf)
-{
-	text_leaf_destroy(node->leaf);
-	node->leaf = leaf;
+	if (p_slot)
+		*p_slot = slot;
+	return NULL;
 }
 
-static void lookup_addstring(const char *lookup_val, struct text_leaf *leaf,
-		struct text_node *node)
+static void lookup_addstring(struct text_lookup *lookup,
+		const char *lookup_val, const char *value)
 {
-	struct text_node *child;
+	size_t len = strlen(lookup_val);
+	uint32_t hash = lookup_hash(lookup_val, len);
+	struct text_item *item;
+	size_t slot;
+
+	/* keep the load factor at or below one half */
+	if ((lookup->items.num + 1) * 2 > lookup->table_size)
+		lookup_rehash(lookup, lookup->table_size ?
+				lookup->table_size * 2 : INITIAL_TABLE_SIZE);
 
 	/* value already exists, so replace */
-	if (!lookup_val || !*lookup_val) {
-		lookup_replaceleaf(node, leaf);
+	item = lookup_find(lookup, lookup_val, len, hash, &slot);
+	if (item) {
+		item->value = value;
 		return;
 	}
 
-	child = text_node_bychar(node, *lookup_val);
-	if (child) {
-		size_t len;
-
-		for (len = 0; len < child->str.len; len++) {
-			char val1 = child->str.array[len],
-			        val2 = lookup_val[len];
+	item = da_push_back_new(lookup->items);
+	item->hash   = hash;
+	item->lookup = lookup_val;
+	item->value  = value;
 
-			if (val1 >= 'A' && val1 <= 'Z')
-				val1 += 0x20;
-			if (val2 >= 'A' && val2 <= 'Z')
-				val2 += 0x20;
-
-			if (val1 != val2)
-				break;
-		}
-
-		if (len == child->str.len) {
-			lookup_addstring(lookup_val+len, leaf, child);
-			return;
-		} else {
-			lookup_splitnode(lookup_val, len, leaf, child);
-		}
-	} else {
-		lookup_createsubnode(lookup_val, leaf, node);
-	}
+	lookup->table[slot] = (uint32_t)lookup->items.num;
 }
 
 static void lookup_getstringtoken(struct lexer *lex, struct strref *token)
@@ -277,34 +269,59 @@ static inline bool lookup_goto_nextline(struct lexer *p)
 	return success;
 }
 
-static char *convert_string(const char *str, size_t len)
+static char *lookup_copy_name(struct text_lookup *lookup,
+		const struct strref *name)
+{
+	char *out = lookup_alloc(lookup, name->len + 1);
+	memcpy(out, name->array, name->len);
+	out[name->len] = 0;
+	return out;
+}
+
+/* escape sequences only ever shrink the string */
+static char *lookup_copy_value(struct text_lookup *lookup,
+		const struct strref *value)
 {
-	struct dstr out;
-	out.array    = bstrdup_n(str, len);
-	out.capacity = len+1;
-	out.len      = len;
+	char *out = lookup_alloc(lookup, value->len + 1);
+	const char *str = value->array;
+	const char *end = str + value->len;
+	char *cur = out;
+
+	while (str < end) {
+		if (*str == '\\' && str + 1 < end) {
+			char ch = str[1];
+
+			if (ch == 'n' || ch == 't' || ch == 'r' || ch == '"') {
+				*(cur++) = ch == 'n' ? '\n' :
+				           ch == 't' ? '\t' :
+				           ch == 'r' ? '\r' : '"';
+				str += 2;
+				continue;
+			}
+		}
 
-	dstr_replace(&out, "\\n", "\n");
-	dstr_replace(&out, "\\t", "\t");
-	dstr_replace(&out, "\\r", "\r");
-	dstr_replace(&out, "\\\"", "\"");
+		*(cur++) = *(str++);
+	}
 
-	return out.array;
+	*cur = 0;
+	return out;
 }
 
 static void lookup_addfiledata(struct text_lookup *lookup,
-		const char *file_data)
+		const char *file_data, size_t size)
 {
 	struct lexer lex;
 	struct strref name, value;
 
+	/* names and values of a file nearly always fit in a single block */
+	lookup_reserve(lookup, size + size / 4 + 64);
+
 	lexer_init(&lex);
 	lexer_start(&lex, file_data);
 	strref_clear(&name);
 	strref_clear(&value);
 
 	while (lookup_gettoken(&lex, &name)) {
-		struct text_leaf *leaf;
 		bool got_eq = false;
 
 		if (*name.array == '\n')
@@ -319,11 +336,8 @@ getval:
 			goto getval;
 		}
 
-		leaf = bmalloc(sizeof(struct text_leaf));
-		leaf->lookup = bstrdup_n(name.array,  name.len);
-		leaf->value  = convert_string(value.array, value.len);
-
-		lookup_addstring(leaf->lookup, leaf, lookup->top);
+		lookup_addstring(lookup, lookup_copy_name(lookup, &name),
+				lookup_copy_value(lookup, &value));
 
 		if (!lookup_goto_nextline(&lex))
 			break;
@@ -332,28 +346,22 @@ getval:
 	lexer_free(&lex);
 }
 
-static inline bool lookup_getstring(const char *lookup_val,
-		const char **out, struct text_node *node)
+static inline bool lookup_getstring(struct text_lookup *lookup,
+		const char *lookup_val, const char **out)
 {
-	struct text_node *child;
-	char ch;
+	struct text_item *item;
+	size_t len;
 
-	if (!node)
+	if (!lookup->table || !lookup_val)
 		return false;
 
-	child = text_node_byname(node, lookup_val);
-	if (!child)
+	len = strlen(lookup_val);
+	item = lookup_find(lookup, lookup_val, len,
+			lookup_hash(lookup_val, len), NULL);
+	if (!item)
 		return false;
 
-	lookup_val += child->str.len;
-	ch = *lookup_val;
-	if (ch)
-		return lookup_getstring(lookup_val, out, child);
-
-	if (!child->leaf)
-		return false;
-
-	*out = child->leaf->value;
+	*out = item->value;
 	return true;
 }
 
@@ -388,11 +396,8 @@ bool text_lookup_add(lookup_t *lookup, const char *path)
 	if (!file_str.array)
 		return false;
 
-	if (!lookup->top)
-		lookup->top = bzalloc(sizeof(struct text_node));
-
 	dstr_replace(&file_str, "\r", " ");
-	lookup_addfiledata(lookup, file_str.array);
+	lookup_addfiledata(lookup, file_str.array, file_str.len);
 	dstr_free(&file_str);
 
 	return true;
@@ -401,8 +406,17 @@ bool text_lookup_add(lookup_t *lookup, const char *path)
 void text_lookup_destroy(lookup_t *lookup)
 {
 	if (lookup) {
+		struct text_block *block = lookup->blocks;
+
+		while (block) {
+			struct text_block *next = block->next;
+			bfree(block);
+			block = next;
+		}
+
 		dstr_free(&lookup->language);
-		text_node_destroy(lookup->top);
+		da_free(lookup->items);
+		bfree(lookup->table);
 
 		bfree(lookup);
 	}
@@ -412,6 +426,6 @@ bool text_lookup_getstr(lookup_t *lookup, const char *lookup_val,
 		const char **out)
 {
 	if (lookup)
-		return lookup_getstring(lookup_val, out, lookup->top);
+		return lookup_getstring(lookup, lookup_val, out);
 	return false;
 }
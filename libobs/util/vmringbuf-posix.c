@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "base.h"
+#include "threading.h"
+#include "vmringbuf.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+static size_t round_capacity(size_t capacity)
+{
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	size_t size = page_size;
+
+	while (size < capacity)
+		size <<= 1;
+	return size;
+}
+
+/* creates an anonymous shared memory file that can be mapped twice */
+static int create_shared_file(size_t size)
+{
+	int fd = -1;
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+	fd = (int)syscall(SYS_memfd_create, "libobs-vmringbuf", 0);
+#endif
+
+#ifdef __linux__
+	if (fd == -1) {
+		char path[] = "/dev/shm/libobs-vmringbuf-XXXXXX";
+
+		fd = mkstemp(path);
+		if (fd != -1)
+			unlink(path);
+	}
+#elif defined(SHM_ANON)
+	fd = shm_open(SHM_ANON, O_RDWR | O_CREAT, 0600);
+#else
+	static volatile long counter = 0;
+	char name[64];
+
+	snprintf(name, sizeof(name), "/libobs-vmringbuf-%ld-%ld",
+			(long)getpid(), os_atomic_inc_long(&counter));
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd != -1)
+		shm_unlink(name);
+#endif
+
+	if (fd != -1 && ftruncate(fd, (off_t)size) != 0) {
+		close(fd);
+		fd = -1;
+	}
+
+	return fd;
+}
+
+void *os_mirrored_alloc(size_t *capacity)
+{
+	size_t size = round_capacity(*capacity);
+	uint8_t *data;
+	void *first;
+	void *second;
+	int fd;
+
+	fd = create_shared_file(size);
+	if (fd == -1) {
+		blog(LOG_ERROR, "os_mirrored_alloc: Failed to create shared "
+		                "memory of %llu bytes",
+		                (unsigned long long)size);
+		return NULL;
+	}
+
+	/* reserve twice the address space, then map the file over both
+	 * halves of it */
+	data = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0);
+	if (data == MAP_FAILED)
+		goto fail;
+
+	first = mmap(data, size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_FIXED, fd, 0);
+	second = mmap(data + size, size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_FIXED, fd, 0);
+
+	if (first != data || second != data + size) {
+		munmap(data, size * 2);
+		goto fail;
+	}
+
+	close(fd);
+	*capacity = size;
+	return data;
+
+fail:
+	blog(LOG_ERROR, "os_mirrored_alloc: Failed to map %llu bytes",
+			(unsigned long long)size);
+	close(fd);
+	return NULL;
+}
+
+void os_mirrored_free(void *data, size_t capacity)
+{
+	if (data)
+		munmap(data, capacity * 2);
+}
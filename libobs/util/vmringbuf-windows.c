@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include "base.h"
+#include "vmringbuf.h"
+
+/* another thread can map something in to the address range between it being
+ * found and both views being mapped, in which case it's tried again */
+#define MAX_MAP_ATTEMPTS 10
+
+static size_t round_capacity(size_t capacity)
+{
+	SYSTEM_INFO info;
+	size_t size;
+
+	GetSystemInfo(&info);
+	size = info.dwAllocationGranularity;
+
+	while (size < capacity)
+		size <<= 1;
+	return size;
+}
+
+void *os_mirrored_alloc(size_t *capacity)
+{
+	size_t size = round_capacity(*capacity);
+	uint64_t size64 = (uint64_t)size;
+	uint8_t *data = NULL;
+	HANDLE mapping;
+
+	mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL,
+			PAGE_READWRITE, (DWORD)(size64 >> 32), (DWORD)size64,
+			NULL);
+	if (!mapping) {
+		blog(LOG_ERROR, "os_mirrored_alloc: Failed to create file "
+		                "mapping of %llu bytes: %lu",
+		                (unsigned long long)size, GetLastError());
+		return NULL;
+	}
+
+	for (int i = 0; i < MAX_MAP_ATTEMPTS; i++) {
+		uint8_t *first;
+		uint8_t *second;
+
+		data = VirtualAlloc(NULL, size * 2, MEM_RESERVE,
+				PAGE_NOACCESS);
+		if (!data)
+			break;
+
+		VirtualFree(data, 0, MEM_RELEASE);
+
+		first = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0,
+				size, data);
+		second = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0,
+				size, data + size);
+
+		if (first == data && second == data + size)
+			break;
+
+		if (first)
+			UnmapViewOfFile(first);
+		if (second)
+			UnmapViewOfFile(second);
+		data = NULL;
+	}
+
+	/* the views keep the mapping alive */
+	CloseHandle(mapping);
+
+	if (!data) {
+		blog(LOG_ERROR, "os_mirrored_alloc: Failed to map %llu bytes",
+				(unsigned long long)size);
+		return NULL;
+	}
+
+	*capacity = size;
+	return data;
+}
+
+void os_mirrored_free(void *data, size_t capacity)
+{
+	if (data) {
+		UnmapViewOfFile((uint8_t*)data + capacity);
+		UnmapViewOfFile(data);
+	}
+}
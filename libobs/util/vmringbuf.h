@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+#include <string.h>
+#include <assert.h>
+
+#include "threading.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *   Mirrored circular buffer
+ *
+ *   The same memory is mapped twice, back to back, so that data[i] and
+ * data[i + capacity] are the same byte.  Any range of up to capacity bytes
+ * starting inside the buffer is therefore contiguous, and both reading and
+ * writing can be done in place without splitting at the wrap point.
+ *
+ *   The capacity is always a power of two and a multiple of the page size
+ * (allocation granularity on windows), so even small buffers use at least a
+ * page of memory and twice that in address space.
+ */
+
+/**
+ * Maps a mirrored buffer of at least *capacity bytes.  On success *capacity
+ * is set to the actual size of the buffer.
+ *
+ * @return  The start of the mapping, or NULL on failure
+ */
+EXPORT void *os_mirrored_alloc(size_t *capacity);
+EXPORT void os_mirrored_free(void *data, size_t capacity);
+
+/* ------------------------------------------------------------------------- */
+/* single-threaded, grows as needed like circlebuf */
+
+struct vmringbuf {
+	uint8_t *data;
+	size_t  size;
+
+	size_t  start_pos;
+	size_t  capacity;
+};
+
+static inline void vmringbuf_init(struct vmringbuf *rb)
+{
+	memset(rb, 0, sizeof(struct vmringbuf));
+}
+
+static inline void vmringbuf_free(struct vmringbuf *rb)
+{
+	if (rb->data)
+		os_mirrored_free(rb->data, rb->capacity);
+	memset(rb, 0, sizeof(struct vmringbuf));
+}
+
+static inline bool vmringbuf_reserve(struct vmringbuf *rb, size_t capacity)
+{
+	uint8_t *data;
+
+	if (capacity <= rb->capacity)
+		return true;
+
+	data = (uint8_t*)os_mirrored_alloc(&capacity);
+	if (!data)
+		return false;
+
+	if (rb->data) {
+		memcpy(data, rb->data + rb->start_pos, rb->size);
+		os_mirrored_free(rb->data, rb->capacity);
+	}
+
+	rb->data      = data;
+	rb->start_pos = 0;
+	rb->capacity  = capacity;
+	return true;
+}
+
+static inline bool vmringbuf_ensure_capacity(struct vmringbuf *rb,
+		size_t size)
+{
+	size_t new_capacity;
+
+	if (size <= rb->capacity)
+		return true;
+
+	new_capacity = rb->capacity * 2;
+	if (size > new_capacity)
+		new_capacity = size;
+
+	return vmringbuf_reserve(rb, new_capacity);
+}
+
+/** Returns a contiguous pointer to the buffered data starting at idx */
+static inline void *vmringbuf_data(struct vmringbuf *rb, size_t idx)
+{
+	if (idx > rb->size)
+		return NULL;
+
+	return rb->data + rb->start_pos + idx;
+}
+
+/**
+ * Returns a contiguous pointer to size bytes of free space at the back of
+ * the buffer, growing it if necessary.  Call vmringbuf_commit to add the
+ * written data to the buffer.
+ */
+static inline void *vmringbuf_write_span(struct vmringbuf *rb, size_t size)
+{
+	if (!vmringbuf_ensure_capacity(rb, rb->size + size))
+		return NULL;
+
+	return rb->data + rb->start_pos + rb->size;
+}
+
+static inline void vmringbuf_commit(struct vmringbuf *rb, size_t size)
+{
+	assert(rb->size + size <= rb->capacity);
+	rb->size += size;
+}
+
+static inline bool vmringbuf_push_back(struct vmringbuf *rb, const void *data,
+		size_t size)
+{
+	void *span = vmringbuf_write_span(rb, size);
+	if (!span)
+		return false;
+
+	memcpy(span, data, size);
+	rb->size += size;
+	return true;
+}
+
+static inline void vmringbuf_peek_front(struct vmringbuf *rb, void *data,
+		size_t size)
+{
+	assert(size <= rb->size);
+
+	if (data)
+		memcpy(data, rb->data + rb->start_pos, size);
+}
+
+static inline void vmringbuf_pop_front(struct vmringbuf *rb, void *data,
+		size_t size)
+{
+	vmringbuf_peek_front(rb, data, size);
+
+	rb->size -= size;
+	rb->start_pos = (rb->start_pos + size) & (rb->capacity - 1);
+}
+
+/* ------------------------------------------------------------------------- */
+/* lock-free, fixed size, one producer thread and one consumer thread */
+
+struct vmringbuf_spsc {
+	uint8_t       *data;
+	size_t        capacity;
+
+	/* free-running byte counters, only the producer writes write_pos and
+	 * only the consumer writes read_pos */
+	volatile long write_pos;
+	volatile long read_pos;
+};
+
+static inline bool vmringbuf_spsc_init(struct vmringbuf_spsc *rb,
+		size_t capacity)
+{
+	memset(rb, 0, sizeof(struct vmringbuf_spsc));
+
+	/* the counters wrap around at 2^32 on windows */
+	if (capacity > 0x40000000)
+		return false;
+
+	rb->data = (uint8_t*)os_mirrored_alloc(&capacity);
+	rb->capacity = capacity;
+	return rb->data != NULL;
+}
+
+static inline void vmringbuf_spsc_free(struct vmringbuf_spsc *rb)
+{
+	if (rb->data)
+		os_mirrored_free(rb->data, rb->capacity);
+	memset(rb, 0, sizeof(struct vmringbuf_spsc));
+}
+
+/* each counter has a single writer, so the swap can't fail.  it's used
+ * instead of os_atomic_set_long because it is a full barrier everywhere,
+ * which makes the data copied before it visible to the other thread first */
+static inline void vmringbuf_spsc_publish(volatile long *pos, size_t val)
+{
+	os_atomic_compare_swap_long(pos, *pos, (long)val);
+}
+
+static inline size_t vmringbuf_spsc_distance(long from, long to)
+{
+	return (size_t)((unsigned long)to - (unsigned long)from);
+}
+
+/** Number of bytes that can be read (consumer) */
+static inline size_t vmringbuf_spsc_size(struct vmringbuf_spsc *rb)
+{
+	return vmringbuf_spsc_distance(rb->read_pos,
+			os_atomic_load_long(&rb->write_pos));
+}
+
+/**
+ * Returns a contiguous pointer to the free space and sets *avail to its size
+ * (producer).  Call vmringbuf_spsc_commit to make the written data available
+ * to the consumer.
+ */
+static inline void *vmringbuf_spsc_write_span(struct vmringbuf_spsc *rb,
+		size_t *avail)
+{
+	unsigned long pos = (unsigned long)rb->write_pos;
+
+	*avail = rb->capacity - vmringbuf_spsc_distance(
+			os_atomic_load_long(&rb->read_pos), rb->write_pos);
+	return rb->data + (pos & (rb->capacity - 1));
+}
+
+static inline void vmringbuf_spsc_commit(struct vmringbuf_spsc *rb,
+		size_t size)
+{
+	vmringbuf_spsc_publish(&rb->write_pos,
+			(unsigned long)rb->write_pos + size);
+}
+
+/**
+ * Returns a contiguous pointer to the buffered data and sets *avail to its
+ * size (consumer).  Call vmringbuf_spsc_consume once done with the data.
+ */
+static inline const void *vmringbuf_spsc_read_span(struct vmringbuf_spsc *rb,
+		size_t *avail)
+{
+	unsigned long pos = (unsigned long)rb->read_pos;
+
+	*avail = vmringbuf_spsc_size(rb);
+	return rb->data + (pos & (rb->capacity - 1));
+}
+
+static inline void vmringbuf_spsc_consume(struct vmringbuf_spsc *rb,
+		size_t size)
+{
+	vmringbuf_spsc_publish(&rb->read_pos,
+			(unsigned long)rb->read_pos + size);
+}
+
+/** Copies all of data in to the buffer, or nothing if it doesn't fit */
+static inline bool vmringbuf_spsc_push(struct vmringbuf_spsc *rb,
+		const void *data, size_t size)
+{
+	size_t avail;
+	void *span = vmringbuf_spsc_write_span(rb, &avail);
+
+	if (avail < size)
+		return false;
+
+	memcpy(span, data, size);
+	vmringbuf_spsc_commit(rb, size);
+	return true;
+}
+
+/** Copies out exactly size bytes, or nothing if not enough are buffered */
+static inline bool vmringbuf_spsc_pop(struct vmringbuf_spsc *rb, void *data,
+		size_t size)
+{
+	size_t avail;
+	const void *span = vmringbuf_spsc_read_span(rb, &avail);
+
+	if (avail < size)
+		return false;
+
+	if (data)
+		memcpy(data, span, size);
+	vmringbuf_spsc_consume(rb, size);
+	return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -18,12 +18,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <errno.h>
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
 #include <xcb/xinerama.h>
+#include <xcb/damage.h>
 
 #include <obs-module.h>
 #include <util/dstr.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/profiler.h>
 #include "xcursor-xcb.h"
 #include "xhelpers.h"
 
@@ -31,12 +37,26 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+/* above this many damaged row spans or this fraction of the screen it is
+ * cheaper to fetch the whole screen in one request */
+#define MAX_DAMAGE_SPANS 32
+#define MAX_DAMAGE_AREA_DIV 2
+
+/* rows [y1, y2) of the captured area.  damage is fetched as full width
+ * spans, which have the same layout in the shm segment as in the frame, so
+ * the server writes them straight in to place */
+struct xshm_span {
+	int_fast32_t y1;
+	int_fast32_t y2;
+};
+
+typedef DARRAY(struct xshm_span) xshm_spans_t;
+
 struct xshm_data {
 	obs_source_t     *source;
 
 	xcb_connection_t *xcb;
 	xcb_screen_t     *xcb_screen;
-	xcb_shm_t        *xshm;
 	xcb_xcursor_t    *cursor;
 
 	char             *server;
@@ -51,8 +71,40 @@ struct xshm_data {
 	bool             show_cursor;
 	bool             use_xinerama;
 	bool             advanced;
+
+	/* capture thread */
+	pthread_t        thread;
+	os_event_t       *stop_event;
+	bool             thread_active;
+	uint64_t         interval_ns;
+
+	bool             use_damage;
+	xcb_damage_damage_t damage;
+	xcb_xfixes_region_t region;
+
+	/* two shm segments, the capture thread fetches in to the back one
+	 * while the graphics thread uploads from the front one.  stale holds
+	 * the spans of each segment that are older than the other one, they
+	 * are fetched again together with the new damage */
+	xcb_shm_t        *xshm[2];
+	int              back;
+	bool             stale_full[2];
+	xshm_spans_t     stale[2];
+
+	/* shared with the graphics thread.  dirty_y1/y2 is the union of the
+	 * rows swapped in since the last upload */
+	pthread_mutex_t  frame_mutex;
+	int              front;
+	int_fast32_t     dirty_y1;
+	int_fast32_t     dirty_y2;
+	xcb_xfixes_get_cursor_image_reply_t *cursor_reply;
 };
 
+static const char *capture_thread_name = "xshm_capture_thread";
+static const char *capture_damage_name = "xshm_fetch_damage";
+static const char *capture_image_name = "xshm_get_image";
+static const char *upload_name = "xshm_upload";
+
 /**
  * Resize the texture
  *
@@ -83,9 +135,56 @@ static bool xshm_check_extensions(xcb_connection_t *xcb)
 	if (!xcb_get_extension_data(xcb, &xcb_xinerama_id)->present)
 		blog(LOG_INFO, "Missing Xinerama extension !");
 
+	if (!xcb_get_extension_data(xcb, &xcb_damage_id)->present)
+		blog(LOG_INFO, "Missing DAMAGE extension, capturing full "
+				"frames");
+
 	return ok;
 }
 
+/**
+ * Set up damage tracking on the root window
+ *
+ * Without damage tracking every frame is captured and uploaded in full.
+ */
+static void xshm_damage_init(struct xshm_data *data)
+{
+	xcb_damage_query_version_cookie_t dmg_c;
+	xcb_xfixes_query_version_cookie_t xfix_c;
+
+	data->use_damage = false;
+
+	if (!xcb_get_extension_data(data->xcb, &xcb_damage_id)->present ||
+	    !xcb_get_extension_data(data->xcb, &xcb_xfixes_id)->present)
+		return;
+
+	dmg_c = xcb_damage_query_version_unchecked(data->xcb,
+			XCB_DAMAGE_MAJOR_VERSION, XCB_DAMAGE_MINOR_VERSION);
+	xfix_c = xcb_xfixes_query_version_unchecked(data->xcb,
+			XCB_XFIXES_MAJOR_VERSION, XCB_XFIXES_MINOR_VERSION);
+	free(xcb_damage_query_version_reply(data->xcb, dmg_c, NULL));
+	free(xcb_xfixes_query_version_reply(data->xcb, xfix_c, NULL));
+
+	data->damage = xcb_generate_id(data->xcb);
+	xcb_damage_create(data->xcb, data->damage, data->xcb_screen->root,
+			XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+
+	data->region = xcb_generate_id(data->xcb);
+	xcb_xfixes_create_region(data->xcb, data->region, 0, NULL);
+
+	data->use_damage = true;
+}
+
+static void xshm_damage_free(struct xshm_data *data)
+{
+	if (!data->use_damage)
+		return;
+
+	xcb_damage_destroy(data->xcb, data->damage);
+	xcb_xfixes_destroy_region(data->xcb, data->region);
+	data->use_damage = false;
+}
+
 /**
  * Update the capture
  *
@@ -143,6 +242,14 @@ static const char* xshm_getname(void *unused)
  */
 static void xshm_capture_stop(struct xshm_data *data)
 {
+	if (data->thread_active) {
+		os_event_signal(data->stop_event);
+		pthread_join(data->thread, NULL);
+		os_event_reset(data->stop_event);
+		data->thread_active = false;
+	}
+
+	pthread_mutex_lock(&data->frame_mutex);
 	obs_enter_graphics();
 
 	if (data->texture) {
@@ -156,9 +263,21 @@ static void xshm_capture_stop(struct xshm_data *data)
 
 	obs_leave_graphics();
 
-	if (data->xshm) {
-		xshm_xcb_detach(data->xshm);
-		data->xshm = NULL;
+	data->front = -1;
+	free(data->cursor_reply);
+	data->cursor_reply = NULL;
+
+	pthread_mutex_unlock(&data->frame_mutex);
+
+	if (data->xcb)
+		xshm_damage_free(data);
+
+	for (size_t i = 0; i < 2; i++) {
+		if (data->xshm[i]) {
+			xshm_xcb_detach(data->xshm[i]);
+			data->xshm[i] = NULL;
+		}
+		da_free(data->stale[i]);
 	}
 
 	if (data->xcb) {
@@ -172,6 +291,276 @@ static void xshm_capture_stop(struct xshm_data *data)
 	}
 }
 
+/**
+ * Add the rows of a rectangle in root window coordinates to a list of spans,
+ * clipped to the captured area
+ */
+static void xshm_add_rect_span(struct xshm_data *data,
+		const xcb_rectangle_t *rect, xshm_spans_t *spans)
+{
+	struct xshm_span span;
+	int_fast32_t x1 = rect->x - data->x_org;
+	int_fast32_t x2 = x1 + rect->width;
+
+	span.y1 = rect->y - data->y_org;
+	span.y2 = span.y1 + rect->height;
+
+	if (span.y1 < 0)            span.y1 = 0;
+	if (span.y2 > data->height) span.y2 = data->height;
+
+	if (x2 <= 0 || x1 >= data->width || span.y1 >= span.y2)
+		return;
+
+	da_push_back((*spans), &span);
+}
+
+static int cmp_span(const void *a, const void *b)
+{
+	const struct xshm_span *span_a = a;
+	const struct xshm_span *span_b = b;
+
+	return span_a->y1 < span_b->y1 ? -1 : (span_a->y1 > span_b->y1);
+}
+
+/**
+ * Sort spans and merge the ones that overlap or touch
+ *
+ * @return the number of rows covered
+ */
+static int_fast32_t xshm_merge_spans(xshm_spans_t *spans)
+{
+	int_fast32_t rows = 0;
+	size_t num = 0;
+
+	if (!spans->num)
+		return 0;
+
+	qsort(spans->array, spans->num, sizeof(struct xshm_span), cmp_span);
+
+	for (size_t i = 1; i < spans->num; i++) {
+		struct xshm_span *last = spans->array + num;
+		struct xshm_span *span = spans->array + i;
+
+		if (span->y1 <= last->y2) {
+			if (span->y2 > last->y2)
+				last->y2 = span->y2;
+		} else {
+			spans->array[++num] = *span;
+		}
+	}
+
+	da_resize((*spans), num + 1);
+
+	for (size_t i = 0; i < spans->num; i++)
+		rows += spans->array[i].y2 - spans->array[i].y1;
+	return rows;
+}
+
+/**
+ * Fetch the rows damaged since the last call
+ */
+static void xshm_fetch_damage(struct xshm_data *data, xshm_spans_t *spans)
+{
+	xcb_xfixes_fetch_region_cookie_t reg_c;
+	xcb_xfixes_fetch_region_reply_t  *reg_r;
+	xcb_generic_event_t              *event;
+	xcb_rectangle_t                  *r;
+	int                              count;
+
+	/* the events themselves carry nothing we need, the region does */
+	while ((event = xcb_poll_for_event(data->xcb)) != NULL)
+		free(event);
+
+	xcb_damage_subtract(data->xcb, data->damage, XCB_XFIXES_REGION_NONE,
+			data->region);
+	reg_c = xcb_xfixes_fetch_region_unchecked(data->xcb, data->region);
+	reg_r = xcb_xfixes_fetch_region_reply(data->xcb, reg_c, NULL);
+	if (!reg_r)
+		return;
+
+	r = xcb_xfixes_fetch_region_rectangles(reg_r);
+	count = xcb_xfixes_fetch_region_rectangles_length(reg_r);
+
+	for (int i = 0; i < count; i++)
+		xshm_add_rect_span(data, &r[i], spans);
+
+	free(reg_r);
+}
+
+/**
+ * Fetch rows of the captured area in to the back segment, all requests are
+ * sent before waiting for the first reply
+ */
+static bool xshm_capture_spans(struct xshm_data *data,
+		const struct xshm_span *spans, size_t num)
+{
+	xcb_shm_get_image_cookie_t img_c[MAX_DAMAGE_SPANS];
+	xcb_shm_t *xshm = data->xshm[data->back];
+	uint32_t linesize = data->width * 4;
+	bool success = true;
+
+	for (size_t i = 0; i < num; i++)
+		img_c[i] = xcb_shm_get_image_unchecked(data->xcb,
+				data->xcb_screen->root,
+				data->x_org, data->y_org + spans[i].y1,
+				data->width, spans[i].y2 - spans[i].y1,
+				~0, XCB_IMAGE_FORMAT_Z_PIXMAP, xshm->seg,
+				spans[i].y1 * linesize);
+
+	for (size_t i = 0; i < num; i++) {
+		xcb_shm_get_image_reply_t *img_r;
+
+		img_r = xcb_shm_get_image_reply(data->xcb, img_c[i], NULL);
+		if (!img_r)
+			success = false;
+		free(img_r);
+	}
+
+	return success;
+}
+
+/**
+ * Make the back segment the front one and flag its new rows for upload
+ *
+ * @note the graphics thread holds frame_mutex while uploading, so the new
+ * back segment is no longer read once this returns
+ */
+static void xshm_swap(struct xshm_data *data, int_fast32_t y1,
+		int_fast32_t y2, xcb_xfixes_get_cursor_image_reply_t *cur_r)
+{
+	pthread_mutex_lock(&data->frame_mutex);
+
+	if (y1 < y2) {
+		if (data->dirty_y1 >= data->dirty_y2) {
+			data->dirty_y1 = y1;
+			data->dirty_y2 = y2;
+		} else {
+			if (y1 < data->dirty_y1) data->dirty_y1 = y1;
+			if (y2 > data->dirty_y2) data->dirty_y2 = y2;
+		}
+
+		data->front = data->back;
+		data->back  = 1 - data->back;
+	}
+
+	if (cur_r) {
+		free(data->cursor_reply);
+		data->cursor_reply = cur_r;
+	}
+
+	pthread_mutex_unlock(&data->frame_mutex);
+}
+
+/**
+ * Capture a frame on the capture thread
+ *
+ * Frames where nothing was damaged are skipped entirely, only the cursor is
+ * updated.
+ */
+static void xshm_capture_frame(struct xshm_data *data)
+{
+	xcb_xfixes_get_cursor_image_cookie_t cur_c;
+	xcb_xfixes_get_cursor_image_reply_t  *cur_r;
+	xshm_spans_t damage;
+	xshm_spans_t fetch;
+	int back = data->back;
+	bool full = !data->use_damage || data->stale_full[back];
+	bool captured = false;
+	int_fast32_t y1 = 0, y2 = 0;
+
+	da_init(damage);
+	da_init(fetch);
+
+	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
+
+	if (data->use_damage) {
+		profile_start(capture_damage_name);
+		xshm_fetch_damage(data, &damage);
+		xshm_merge_spans(&damage);
+		profile_end(capture_damage_name);
+	}
+
+	/* the back segment is also missing what was fetched in to the front
+	 * one last time */
+	if (!full && damage.num) {
+		int_fast32_t rows;
+
+		da_copy(fetch, data->stale[back]);
+		da_push_back_da(fetch, damage);
+		rows = xshm_merge_spans(&fetch);
+
+		if (fetch.num > MAX_DAMAGE_SPANS ||
+		    rows > data->height / MAX_DAMAGE_AREA_DIV)
+			full = true;
+	}
+
+	profile_start(capture_image_name);
+
+	if (full) {
+		struct xshm_span all = {0, data->height};
+
+		captured = xshm_capture_spans(data, &all, 1);
+		y2 = data->height;
+	} else if (damage.num) {
+		captured = xshm_capture_spans(data, fetch.array, fetch.num);
+		y1 = fetch.array[0].y1;
+		y2 = fetch.array[fetch.num - 1].y2;
+	}
+
+	profile_end(capture_image_name);
+
+	if (captured) {
+		int front = 1 - back;
+
+		/* the segment that becomes the back one is missing exactly
+		 * the new damage, unless it needs a full capture anyway */
+		data->stale_full[back] = false;
+		da_resize(data->stale[back], 0);
+
+		da_resize(data->stale[front], 0);
+		if (!data->stale_full[front] && damage.num)
+			da_push_back_da(data->stale[front], damage);
+	} else {
+		/* the damage is gone from the server, so neither segment
+		 * can be patched up anymore */
+		if (damage.num) {
+			data->stale_full[0] = true;
+			data->stale_full[1] = true;
+		}
+		y1 = y2 = 0;
+	}
+
+	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
+	xshm_swap(data, y1, y2, cur_r);
+
+	da_free(damage);
+	da_free(fetch);
+}
+
+static void *xshm_capture_thread(void *vptr)
+{
+	XSHM_DATA(vptr);
+	uint64_t next = os_gettime_ns();
+
+	os_set_thread_name("xshm-input: capture thread");
+	profile_register_root(capture_thread_name, data->interval_ns);
+
+	while (os_event_try(data->stop_event) == EAGAIN) {
+		if (obs_source_showing(data->source)) {
+			profile_start(capture_thread_name);
+			xshm_capture_frame(data);
+			profile_end(capture_thread_name);
+			profile_reenable_thread();
+		}
+
+		next += data->interval_ns;
+		if (!os_sleepto_ns(next))
+			next = os_gettime_ns();
+	}
+
+	return NULL;
+}
+
 /**
  * Start the capture
  */
@@ -196,10 +585,13 @@ static void xshm_capture_start(struct xshm_data *data)
 		goto fail;
 	}
 
-	data->xshm = xshm_xcb_attach(data->xcb, data->width, data->height);
-	if (!data->xshm) {
-		blog(LOG_ERROR, "failed to attach shm !");
-		goto fail;
+	for (size_t i = 0; i < 2; i++) {
+		data->xshm[i] = xshm_xcb_attach(data->xcb, data->width,
+				data->height);
+		if (!data->xshm[i]) {
+			blog(LOG_ERROR, "failed to attach shm !");
+			goto fail;
+		}
 	}
 
 	data->cursor = xcb_xcursor_init(data->xcb);
@@ -211,6 +603,27 @@ static void xshm_capture_start(struct xshm_data *data)
 
 	obs_leave_graphics();
 
+	xshm_damage_init(data);
+
+	data->back          = 0;
+	data->front         = -1;
+	data->stale_full[0] = true;
+	data->stale_full[1] = true;
+	data->dirty_y1      = 0;
+	data->dirty_y2      = 0;
+
+	struct obs_video_info ovi;
+	data->interval_ns = obs_get_video_info(&ovi)
+		? (uint64_t)ovi.fps_den * 1000000000ULL / ovi.fps_num
+		: 16666667ULL;
+
+	if (pthread_create(&data->thread, NULL, xshm_capture_thread,
+				data) != 0) {
+		blog(LOG_ERROR, "failed to create capture thread !");
+		goto fail;
+	}
+
+	data->thread_active = true;
 	return;
 fail:
 	xshm_capture_stop(data);
@@ -367,6 +780,8 @@ static void xshm_destroy(void *vptr)
 
 	xshm_capture_stop(data);
 
+	os_event_destroy(data->stop_event);
+	pthread_mutex_destroy(&data->frame_mutex);
 	bfree(data);
 }
 
@@ -378,51 +793,62 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 	struct xshm_data *data = bzalloc(sizeof(struct xshm_data));
 	data->source = source;
 
+	pthread_mutex_init_value(&data->frame_mutex);
+	if (pthread_mutex_init(&data->frame_mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&data->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+
 	xshm_update(data, settings);
 
 	return data;
+
+fail:
+	xshm_destroy(data);
+	return NULL;
 }
 
 /**
- * Prepare the capture data
+ * Upload the rows swapped in since the last tick, in one go
  */
 static void xshm_video_tick(void *vptr, float seconds)
 {
 	UNUSED_PARAMETER(seconds);
 	XSHM_DATA(vptr);
 
-	if (!data->texture)
-		return;
 	if (!obs_source_showing(data->source))
 		return;
 
-	xcb_shm_get_image_cookie_t           img_c;
-	xcb_shm_get_image_reply_t            *img_r;
-	xcb_xfixes_get_cursor_image_cookie_t cur_c;
-	xcb_xfixes_get_cursor_image_reply_t  *cur_r;
-
-	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
-			data->x_org, data->y_org, data->width, data->height,
-			~0, XCB_IMAGE_FORMAT_Z_PIXMAP, data->xshm->seg, 0);
-	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
+	pthread_mutex_lock(&data->frame_mutex);
 
-	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
-	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
-
-	if (!img_r)
+	if (!data->texture)
+		goto exit;
+	if (data->dirty_y1 >= data->dirty_y2 && !data->cursor_reply)
 		goto exit;
 
+	profile_start(upload_name);
 	obs_enter_graphics();
 
-	gs_texture_set_image(data->texture, (void *) data->xshm->data,
-		data->width * 4, false);
-	xcb_xcursor_update(data->cursor, cur_r);
+	if (data->front >= 0 && data->dirty_y1 < data->dirty_y2)
+		gs_texture_set_image_rect(data->texture,
+				data->xshm[data->front]->data,
+				data->width * 4, 0, data->dirty_y1,
+				data->width, data->dirty_y2 - data->dirty_y1);
+
+	if (data->cursor_reply) {
+		xcb_xcursor_update(data->cursor, data->cursor_reply);
+		free(data->cursor_reply);
+		data->cursor_reply = NULL;
+	}
 
 	obs_leave_graphics();
+	profile_end(upload_name);
+
+	data->dirty_y1 = 0;
+	data->dirty_y2 = 0;
 
 exit:
-	free(img_r);
-	free(cur_r);
+	pthread_mutex_unlock(&data->frame_mutex);
 }
 
 /**
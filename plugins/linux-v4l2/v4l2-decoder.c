@@ -0,0 +1,567 @@
+/*
+Copyright (C) 2026 by agent <agent@local>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include <linux/videodev2.h>
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixfmt.h>
+
+#include <util/threading.h>
+#include <util/circlebuf.h>
+#include <util/platform.h>
+#include <util/bmem.h>
+#include <obs-avc.h>
+
+#include "v4l2-decoder.h"
+
+#define blog(level, msg, ...) blog(level, "v4l2-decoder: " msg, ##__VA_ARGS__)
+
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
+#define USE_NEW_FFMPEG_DECODE_API
+#endif
+
+#ifndef AV_INPUT_BUFFER_PADDING_SIZE
+#define AV_INPUT_BUFFER_PADDING_SIZE FF_INPUT_BUFFER_PADDING_SIZE
+#endif
+
+#define MAX_DECODE_THREADS 4
+
+/* jpeg frames are independent so every worker only gets a single frame at a
+ * time, new frames go to whichever worker is idle and are dropped while all
+ * workers are busy.  h264 frames depend on each other so they are queued on
+ * a single worker instead. */
+#define MJPEG_MAX_PENDING 1
+#define H264_MAX_PENDING  4
+
+struct decode_packet_info {
+	uint64_t seq;
+	uint64_t timestamp;
+	uint64_t submit_time;
+	size_t   size;
+};
+
+struct v4l2_decode_worker {
+	struct v4l2_decoder *dec;
+
+	pthread_t           thread;
+	bool                thread_active;
+	os_sem_t            *sem;
+
+	pthread_mutex_t     mutex;
+	struct circlebuf    packets;
+	size_t              pending;
+
+	AVCodecContext      *context;
+	AVFrame             *frame;
+	uint8_t             *packet_buffer;
+	size_t              packet_size;
+};
+
+struct v4l2_decoder {
+	obs_source_t               *source;
+	enum AVCodecID             codec_id;
+	size_t                     max_pending;
+
+	size_t                     num_workers;
+	struct v4l2_decode_worker  *workers;
+
+	/* only touched by the capture thread */
+	uint64_t                   next_seq;
+	size_t                     next_worker;
+	bool                       wait_for_keyframe;
+
+	/* frames are output strictly in submission order */
+	pthread_mutex_t            output_mutex;
+	pthread_cond_t             output_cond;
+	uint64_t                   next_output;
+	volatile bool              stop;
+
+	struct obs_source_frame    out;
+	struct v4l2_decoder_stats  stats;
+};
+
+static enum AVCodecID v4l2_pixfmt_to_codec(uint_fast32_t pixfmt)
+{
+	switch (pixfmt) {
+	case V4L2_PIX_FMT_MJPEG:
+	case V4L2_PIX_FMT_JPEG:   return AV_CODEC_ID_MJPEG;
+#ifdef V4L2_PIX_FMT_H264
+	case V4L2_PIX_FMT_H264:   return AV_CODEC_ID_H264;
+#endif
+	default:                  return AV_CODEC_ID_NONE;
+	}
+}
+
+bool v4l2_decoder_supported(uint_fast32_t pixfmt)
+{
+	enum AVCodecID id = v4l2_pixfmt_to_codec(pixfmt);
+
+	if (id == AV_CODEC_ID_NONE)
+		return false;
+
+	avcodec_register_all();
+	return avcodec_find_decoder(id) != NULL;
+}
+
+/*
+ * Point the obs frame at the decoded planes and pick the matching obs format.
+ *
+ * Most devices send 4:2:2 jpeg, which obs can't take directly.  Since the
+ * planar layout only differs in the number of chroma lines, doubling the
+ * chroma linesize makes obs pick up every other line and gives us a 4:2:0
+ * frame without an extra conversion pass.
+ */
+static bool prepare_output(struct v4l2_decoder *dec, AVFrame *frame)
+{
+	struct obs_source_frame *out = &dec->out;
+	enum video_format format;
+	bool full_range = frame->color_range == AVCOL_RANGE_JPEG;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		out->data[i]     = frame->data[i];
+		out->linesize[i] = frame->linesize[i];
+	}
+
+	switch (frame->format) {
+	case AV_PIX_FMT_YUVJ420P:
+		full_range = true;
+		/* fall through */
+	case AV_PIX_FMT_YUV420P:
+		format = VIDEO_FORMAT_I420;
+		break;
+	case AV_PIX_FMT_YUVJ422P:
+		full_range = true;
+		/* fall through */
+	case AV_PIX_FMT_YUV422P:
+		out->linesize[1] *= 2;
+		out->linesize[2] *= 2;
+		format = VIDEO_FORMAT_I420;
+		break;
+	case AV_PIX_FMT_YUVJ444P:
+		full_range = true;
+		/* fall through */
+	case AV_PIX_FMT_YUV444P:
+		format = VIDEO_FORMAT_I444;
+		break;
+	case AV_PIX_FMT_NV12:    format = VIDEO_FORMAT_NV12; break;
+	case AV_PIX_FMT_YUYV422: format = VIDEO_FORMAT_YUY2; break;
+	case AV_PIX_FMT_UYVY422: format = VIDEO_FORMAT_UYVY; break;
+	case AV_PIX_FMT_GRAY8:   format = VIDEO_FORMAT_Y800; break;
+	default:
+		return false;
+	}
+
+	if (format != out->format || full_range != out->full_range) {
+		enum video_colorspace cs = dec->codec_id == AV_CODEC_ID_MJPEG
+			? VIDEO_CS_601 : VIDEO_CS_DEFAULT;
+
+		out->format     = format;
+		out->full_range = full_range;
+
+		if (!video_format_get_parameters(cs, full_range ?
+				VIDEO_RANGE_FULL : VIDEO_RANGE_PARTIAL,
+				out->color_matrix, out->color_range_min,
+				out->color_range_max))
+			return false;
+	}
+
+	out->width     = frame->width;
+	out->height    = frame->height;
+#ifdef USE_NEW_FFMPEG_DECODE_API
+	out->timestamp = (uint64_t)frame->pts;
+#else
+	out->timestamp = (uint64_t)frame->pkt_pts;
+#endif
+	return true;
+}
+
+static inline void copy_packet(struct v4l2_decode_worker *w, size_t size)
+{
+	size_t new_size = size + AV_INPUT_BUFFER_PADDING_SIZE;
+
+	if (w->packet_size < new_size) {
+		w->packet_buffer = brealloc(w->packet_buffer, new_size);
+		w->packet_size   = new_size;
+	}
+
+	memset(w->packet_buffer + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+	circlebuf_pop_front(&w->packets, w->packet_buffer, size);
+}
+
+static void count_error(struct v4l2_decoder *dec)
+{
+	pthread_mutex_lock(&dec->output_mutex);
+	dec->stats.errors++;
+	pthread_mutex_unlock(&dec->output_mutex);
+}
+
+/* called with output_mutex locked */
+static inline bool wait_for_turn(struct v4l2_decoder *dec, uint64_t seq)
+{
+	while (dec->next_output != seq && !dec->stop)
+		pthread_cond_wait(&dec->output_cond, &dec->output_mutex);
+
+	return !dec->stop;
+}
+
+/*
+ * Wait until all frames submitted before this packet were output, then hand
+ * the decoded frame to obs.
+ */
+static void output_frame(struct v4l2_decode_worker *w, uint64_t seq)
+{
+	struct v4l2_decoder *dec = w->dec;
+
+	pthread_mutex_lock(&dec->output_mutex);
+
+	if (wait_for_turn(dec, seq) && prepare_output(dec, w->frame)) {
+		uint64_t latency = os_gettime_ns() -
+			(uint64_t)w->frame->reordered_opaque;
+
+		obs_source_output_video(dec->source, &dec->out);
+
+		dec->stats.frames++;
+		dec->stats.total_latency += latency;
+		if (latency > dec->stats.max_latency)
+			dec->stats.max_latency = latency;
+	}
+
+	pthread_mutex_unlock(&dec->output_mutex);
+}
+
+/* lets the packet submitted after this one output its frames */
+static void finish_packet(struct v4l2_decode_worker *w, uint64_t seq)
+{
+	struct v4l2_decoder *dec = w->dec;
+
+	pthread_mutex_lock(&dec->output_mutex);
+	wait_for_turn(dec, seq);
+	dec->next_output++;
+	pthread_cond_broadcast(&dec->output_cond);
+	pthread_mutex_unlock(&dec->output_mutex);
+}
+
+static void decode_packet(struct v4l2_decode_worker *w,
+		struct decode_packet_info *info)
+{
+	AVPacket packet = {0};
+	int ret;
+
+	av_init_packet(&packet);
+	packet.data = w->packet_buffer;
+	packet.size = (int)info->size;
+	packet.pts  = (int64_t)info->timestamp;
+
+	/* carried over to the decoded frame, even with frame threading */
+	w->context->reordered_opaque = (int64_t)info->submit_time;
+
+#ifdef USE_NEW_FFMPEG_DECODE_API
+	/* every frame is drained right after sending, so the decoder always
+	 * has room for the next packet */
+	ret = avcodec_send_packet(w->context, &packet);
+	if (ret < 0) {
+		count_error(w->dec);
+		return;
+	}
+
+	/* frame threaded h264 can return several frames at once, or none */
+	while ((ret = avcodec_receive_frame(w->context, w->frame)) == 0)
+		output_frame(w, info->seq);
+
+	if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+		count_error(w->dec);
+#else
+	int got_frame = false;
+
+	ret = avcodec_decode_video2(w->context, w->frame, &got_frame, &packet);
+	if (ret < 0)
+		count_error(w->dec);
+	else if (got_frame)
+		output_frame(w, info->seq);
+#endif
+}
+
+static void *decode_thread(void *param)
+{
+	struct v4l2_decode_worker *w = param;
+	struct v4l2_decoder *dec = w->dec;
+
+	os_set_thread_name("v4l2: decode");
+
+	while (os_sem_wait(w->sem) == 0) {
+		struct decode_packet_info info;
+
+		if (os_atomic_load_bool(&dec->stop))
+			break;
+
+		pthread_mutex_lock(&w->mutex);
+		circlebuf_pop_front(&w->packets, &info, sizeof(info));
+		copy_packet(w, info.size);
+		pthread_mutex_unlock(&w->mutex);
+
+		decode_packet(w, &info);
+		finish_packet(w, info.seq);
+
+		pthread_mutex_lock(&w->mutex);
+		w->pending--;
+		pthread_mutex_unlock(&w->mutex);
+	}
+
+	return NULL;
+}
+
+static bool worker_init(struct v4l2_decoder *dec,
+		struct v4l2_decode_worker *w, AVCodec *codec, int threads)
+{
+	if (pthread_mutex_init(&w->mutex, NULL) != 0)
+		return false;
+
+	w->dec = dec;
+
+	if (os_sem_init(&w->sem, 0) != 0)
+		return false;
+
+	w->context = avcodec_alloc_context3(codec);
+	w->frame   = av_frame_alloc();
+	if (!w->context || !w->frame)
+		return false;
+
+	w->context->thread_count = threads;
+	if (threads > 1)
+		w->context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+	if (avcodec_open2(w->context, codec, NULL) < 0) {
+		blog(LOG_ERROR, "Failed to open %s decoder", codec->name);
+		return false;
+	}
+
+	if (pthread_create(&w->thread, NULL, decode_thread, w) != 0)
+		return false;
+
+	w->thread_active = true;
+	return true;
+}
+
+static void worker_free(struct v4l2_decode_worker *w)
+{
+	if (!w->dec)
+		return;
+
+	if (w->thread_active)
+		pthread_join(w->thread, NULL);
+
+	if (w->context) {
+		avcodec_close(w->context);
+		av_free(w->context);
+	}
+	if (w->frame)
+		av_frame_free(&w->frame);
+
+	os_sem_destroy(w->sem);
+	pthread_mutex_destroy(&w->mutex);
+	circlebuf_free(&w->packets);
+	bfree(w->packet_buffer);
+}
+
+struct v4l2_decoder *v4l2_decoder_create(obs_source_t *source,
+		uint_fast32_t pixfmt, int threads)
+{
+	struct v4l2_decoder *dec;
+	enum AVCodecID id = v4l2_pixfmt_to_codec(pixfmt);
+	AVCodec *codec;
+
+	if (id == AV_CODEC_ID_NONE)
+		return NULL;
+
+	avcodec_register_all();
+	codec = avcodec_find_decoder(id);
+	if (!codec) {
+		blog(LOG_ERROR, "No decoder available");
+		return NULL;
+	}
+
+	if (threads <= 0)
+		threads = os_get_logical_cores() / 2;
+	if (threads < 1)
+		threads = 1;
+	if (threads > MAX_DECODE_THREADS)
+		threads = MAX_DECODE_THREADS;
+
+	dec = bzalloc(sizeof(struct v4l2_decoder));
+	dec->source   = source;
+	dec->codec_id = id;
+
+	if (pthread_mutex_init(&dec->output_mutex, NULL) != 0)
+		goto fail_mutex;
+	if (pthread_cond_init(&dec->output_cond, NULL) != 0)
+		goto fail_cond;
+
+	/* h264 has to go through a single decoder context, so let ffmpeg do
+	 * the threading there */
+	if (id == AV_CODEC_ID_MJPEG) {
+		dec->num_workers = (size_t)threads;
+		dec->max_pending = MJPEG_MAX_PENDING;
+		threads = 1;
+	} else {
+		dec->num_workers = 1;
+		dec->max_pending = H264_MAX_PENDING;
+		dec->wait_for_keyframe = true;
+	}
+
+	dec->workers = bzalloc(sizeof(struct v4l2_decode_worker) *
+			dec->num_workers);
+
+	for (size_t i = 0; i < dec->num_workers; i++) {
+		if (!worker_init(dec, &dec->workers[i], codec, threads)) {
+			v4l2_decoder_destroy(dec);
+			return NULL;
+		}
+	}
+
+	blog(LOG_INFO, "Decoding %s on %d thread(s)", codec->name,
+			(int)dec->num_workers * threads);
+	return dec;
+
+fail_cond:
+	pthread_mutex_destroy(&dec->output_mutex);
+fail_mutex:
+	bfree(dec);
+	return NULL;
+}
+
+void v4l2_decoder_destroy(struct v4l2_decoder *dec)
+{
+	struct v4l2_decoder_stats *stats;
+
+	if (!dec)
+		return;
+
+	pthread_mutex_lock(&dec->output_mutex);
+	os_atomic_set_bool(&dec->stop, true);
+	pthread_cond_broadcast(&dec->output_cond);
+	pthread_mutex_unlock(&dec->output_mutex);
+
+	for (size_t i = 0; i < dec->num_workers; i++) {
+		if (dec->workers[i].sem)
+			os_sem_post(dec->workers[i].sem);
+	}
+	for (size_t i = 0; i < dec->num_workers; i++)
+		worker_free(&dec->workers[i]);
+
+	stats = &dec->stats;
+	blog(LOG_INFO, "Decoded %"PRIu64" frames, %"PRIu64" dropped, "
+			"%"PRIu64" failed, latency avg %.2f ms / max %.2f ms",
+			stats->frames, stats->dropped, stats->errors,
+			stats->frames ? (double)stats->total_latency /
+				(double)stats->frames / 1000000.0 : 0.0,
+			(double)stats->max_latency / 1000000.0);
+
+	pthread_cond_destroy(&dec->output_cond);
+	pthread_mutex_destroy(&dec->output_mutex);
+	bfree(dec->workers);
+	bfree(dec);
+}
+
+static inline void count_dropped(struct v4l2_decoder *dec)
+{
+	pthread_mutex_lock(&dec->output_mutex);
+	dec->stats.dropped++;
+	pthread_mutex_unlock(&dec->output_mutex);
+}
+
+/*
+ * Find a worker that can take another packet, starting after the one that got
+ * the last packet so the work is spread evenly.  The worker is returned with
+ * its mutex locked.
+ */
+static struct v4l2_decode_worker *find_idle_worker(struct v4l2_decoder *dec)
+{
+	for (size_t i = 0; i < dec->num_workers; i++) {
+		size_t idx = (dec->next_worker + i) % dec->num_workers;
+		struct v4l2_decode_worker *w = &dec->workers[idx];
+
+		pthread_mutex_lock(&w->mutex);
+		if (w->pending < dec->max_pending) {
+			dec->next_worker = idx + 1;
+			return w;
+		}
+		pthread_mutex_unlock(&w->mutex);
+	}
+
+	return NULL;
+}
+
+bool v4l2_decoder_submit(struct v4l2_decoder *dec, const uint8_t *data,
+		size_t size, uint64_t timestamp)
+{
+	struct v4l2_decode_worker *w;
+	struct decode_packet_info info;
+	bool keyframe = true;
+
+	if (!dec || !data || !size)
+		return false;
+
+	if (dec->codec_id == AV_CODEC_ID_H264) {
+		keyframe = obs_avc_keyframe(data, size);
+
+		if (dec->wait_for_keyframe && !keyframe) {
+			count_dropped(dec);
+			return false;
+		}
+	}
+
+	w = find_idle_worker(dec);
+	if (!w) {
+		/* skipping an h264 frame breaks every frame referencing it,
+		 * so drop everything up to the next keyframe */
+		if (dec->codec_id == AV_CODEC_ID_H264)
+			dec->wait_for_keyframe = true;
+
+		count_dropped(dec);
+		return false;
+	}
+
+	info.seq         = dec->next_seq++;
+	info.timestamp   = timestamp;
+	info.submit_time = os_gettime_ns();
+	info.size        = size;
+
+	circlebuf_push_back(&w->packets, &info, sizeof(info));
+	circlebuf_push_back(&w->packets, data, size);
+	w->pending++;
+
+	pthread_mutex_unlock(&w->mutex);
+
+	if (keyframe)
+		dec->wait_for_keyframe = false;
+
+	os_sem_post(w->sem);
+	return true;
+}
+
+void v4l2_decoder_get_stats(struct v4l2_decoder *dec,
+		struct v4l2_decoder_stats *stats)
+{
+	if (!dec || !stats)
+		return;
+
+	pthread_mutex_lock(&dec->output_mutex);
+	*stats = dec->stats;
+	pthread_mutex_unlock(&dec->output_mutex);
+}
@@ -0,0 +1,103 @@
+/*
+Copyright (C) 2026 by agent <agent@local>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <inttypes.h>
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct v4l2_decoder;
+
+/**
+ * Decoder statistics
+ */
+struct v4l2_decoder_stats {
+	/** number of frames handed to obs */
+	uint64_t frames;
+	/** number of frames dropped because the decoders were busy */
+	uint64_t dropped;
+	/** number of frames that failed to decode */
+	uint64_t errors;
+	/** accumulated latency from submission to output in nanoseconds */
+	uint64_t total_latency;
+	/** highest latency from submission to output in nanoseconds */
+	uint64_t max_latency;
+};
+
+/**
+ * Check if a compressed pixelformat can be decoded
+ *
+ * @param pixfmt v4l2 pixelformat
+ *
+ * @return true if the format is compressed and a decoder is available
+ */
+bool v4l2_decoder_supported(uint_fast32_t pixfmt);
+
+/**
+ * Create a decoder for a compressed pixelformat
+ *
+ * Compressed frames are decoded on a small pool of worker threads. Frames are
+ * handed to obs in the order they were submitted.
+ *
+ * @param source the source decoded frames are output to
+ * @param pixfmt v4l2 pixelformat of the compressed data
+ * @param threads number of decoder threads, 0 to pick automatically
+ *
+ * @return the decoder or NULL on failure
+ */
+struct v4l2_decoder *v4l2_decoder_create(obs_source_t *source,
+		uint_fast32_t pixfmt, int threads);
+
+/**
+ * Stop all decoder threads and free the decoder
+ *
+ * @param dec the decoder
+ */
+void v4l2_decoder_destroy(struct v4l2_decoder *dec);
+
+/**
+ * Submit a compressed frame for decoding
+ *
+ * The data is copied so the capture buffer can be requeued right after this
+ * returns.
+ *
+ * @param dec the decoder
+ * @param data compressed frame data
+ * @param size size of the compressed data
+ * @param timestamp timestamp of the frame in nanoseconds
+ *
+ * @return false if the frame was dropped
+ */
+bool v4l2_decoder_submit(struct v4l2_decoder *dec, const uint8_t *data,
+		size_t size, uint64_t timestamp);
+
+/**
+ * Get the current decoder statistics
+ *
+ * @param dec the decoder
+ * @param stats receives the statistics
+ */
+void v4l2_decoder_get_stats(struct v4l2_decoder *dec,
+		struct v4l2_decoder_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -41,6 +41,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "v4l2-udev.h"
 #endif
 
+#if HAVE_FFMPEG
+#include "v4l2-decoder.h"
+#endif
+
 /* The new dv timing api was introduced in Linux 3.4
  * Currently we simply disable dv timings when this is not defined */
 #if !defined(VIDIOC_ENUM_DV_TIMINGS) || !defined(V4L2_IN_CAP_DV_TIMINGS)
@@ -49,6 +53,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define V4L2_DATA(voidptr) struct v4l2_data *data = voidptr;
 
+/* number of buffers that always stay queued when lending buffers to obs */
+#define MIN_QUEUED_BUFFERS 2
+
 #define timeval2ns(tv) \
 	(((uint64_t) tv.tv_sec * 1000000000) + ((uint64_t) tv.tv_usec * 1000))
 
@@ -63,6 +70,30 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
 
+struct v4l2_lent_set;
+
+/**
+ * State of a capture buffer that can be lent to obs
+ */
+struct v4l2_lent_buffer {
+	struct v4l2_lent_set *set;
+	bool lent;
+	volatile bool returned;
+};
+
+/**
+ * Lending state of all capture buffers
+ *
+ * Holds a reference for the source and one for every buffer obs has not
+ * returned yet.  When the source stops while obs still uses some buffers the
+ * mapping is handed over to the set and unmapped with the last reference.
+ */
+struct v4l2_lent_set {
+	volatile long refs;
+	struct v4l2_buffer_data buffers;
+	struct v4l2_lent_buffer lent[];
+};
+
 /**
  * Data structure for the v4l2 source
  */
@@ -75,6 +106,8 @@ struct v4l2_data {
 	int dv_timing;
 	int resolution;
 	int framerate;
+	int buffer_count;
+	bool lend_buffers;
 
 	/* internal data */
 	obs_source_t *source;
@@ -86,12 +119,35 @@ struct v4l2_data {
 	int height;
 	int linesize;
 	struct v4l2_buffer_data buffers;
+	struct v4l2_lent_set *lent_set;
+	struct v4l2_lent_buffer *lent;
+	uint_fast32_t lent_count;
+#if HAVE_FFMPEG
+	struct v4l2_decoder *decoder;
+#endif
 };
 
 /* forward declarations */
 static void v4l2_init(struct v4l2_data *data);
 static void v4l2_terminate(struct v4l2_data *data);
 
+/**
+ * Check if frames in the pixelformat can be passed to obs
+ *
+ * Compressed formats are supported if the plugin was built with a decoder
+ * for them.
+ */
+static bool v4l2_format_supported(uint_fast32_t pixfmt)
+{
+	if (v4l2_to_obs_video_format(pixfmt) != VIDEO_FORMAT_NONE)
+		return true;
+#if HAVE_FFMPEG
+	return v4l2_decoder_supported(pixfmt);
+#else
+	return false;
+#endif
+}
+
 /**
  * Prepare the output frame structure for obs and compute plane offsets
  *
@@ -142,6 +198,124 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 	}
 }
 
+static struct v4l2_lent_set *v4l2_lent_set_create(uint_fast32_t count)
+{
+	struct v4l2_lent_set *set = bzalloc(sizeof(struct v4l2_lent_set) +
+			count * sizeof(struct v4l2_lent_buffer));
+
+	set->refs = 1;
+	for (uint_fast32_t i = 0; i < count; ++i)
+		set->lent[i].set = set;
+
+	return set;
+}
+
+static void v4l2_lent_set_release(struct v4l2_lent_set *set)
+{
+	if (os_atomic_dec_long(&set->refs) == 0) {
+		v4l2_destroy_mmap(&set->buffers);
+		bfree(set);
+	}
+}
+
+/*
+ * Called by obs once it no longer needs a lent buffer
+ *
+ * This may happen on any thread, so the buffer is only marked here and put
+ * back into the queue by the capture thread.  It may also happen after the
+ * source stopped, in which case this unmaps the buffers once the last one
+ * is returned.
+ */
+static void v4l2_buffer_returned(void *vptr)
+{
+	struct v4l2_lent_buffer *lent = vptr;
+	struct v4l2_lent_set *set = lent->set;
+
+	os_atomic_set_bool(&lent->returned, true);
+	v4l2_lent_set_release(set);
+}
+
+/*
+ * Requeue all buffers that were returned by obs
+ */
+static int v4l2_requeue_returned(struct v4l2_data *data)
+{
+	struct v4l2_buffer buf;
+
+	if (!data->lent_count)
+		return 0;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = V4L2_MEMORY_MMAP;
+
+	for (uint_fast32_t i = 0; i < data->buffers.count; ++i) {
+		struct v4l2_lent_buffer *lent = &data->lent[i];
+
+		if (!lent->lent || !os_atomic_load_bool(&lent->returned))
+			continue;
+
+		lent->lent = false;
+		lent->returned = false;
+		data->lent_count--;
+
+		buf.index = i;
+		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
+			blog(LOG_DEBUG, "failed to enqueue buffer");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Check if the dequeued buffer can be lent to obs
+ *
+ * A few buffers always stay with the driver, otherwise capture would stall
+ * whenever obs holds on to frames for a while.
+ */
+static inline bool v4l2_can_lend(struct v4l2_data *data)
+{
+	if (!data->lend_buffers || !data->lent)
+		return false;
+#if HAVE_FFMPEG
+	if (data->decoder)
+		return false;
+#endif
+
+	return data->buffers.count - data->lent_count - 1 >=
+		MIN_QUEUED_BUFFERS;
+}
+
+/*
+ * Take back the lent buffers and release the lending state
+ *
+ * Buffers that are queued in obs are returned right away.  Frames that are
+ * currently in use by the renderer are returned a little later, the buffer
+ * mapping is handed over to the lending state then, which unmaps it once
+ * the last one is returned instead of blocking here.
+ */
+static void v4l2_reclaim_buffers(struct v4l2_data *data)
+{
+	struct v4l2_lent_set *set = data->lent_set;
+
+	if (!set)
+		return;
+
+	if (data->lent_count)
+		obs_source_reclaim_video(data->source);
+
+	set->buffers = data->buffers;
+	memset(&data->buffers, 0, sizeof(data->buffers));
+
+	data->lent_set = NULL;
+	data->lent = NULL;
+	data->lent_count = 0;
+
+	v4l2_lent_set_release(set);
+}
+
 /*
  * Worker thread to get video data
  */
@@ -166,6 +340,9 @@ static void *v4l2_thread(void *vptr)
 	v4l2_prep_obs_frame(data, &out, plane_offsets);
 
 	while (os_event_try(data->event) == EAGAIN) {
+		if (v4l2_requeue_returned(data) < 0)
+			break;
+
 		FD_ZERO(&fds);
 		FD_SET(data->dev, &fds);
 		tv.tv_sec = 1;
@@ -198,9 +375,34 @@ static void *v4l2_thread(void *vptr)
 		out.timestamp -= first_ts;
 
 		start = (uint8_t *) data->buffers.info[buf.index].start;
-		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
-			out.data[i] = start + plane_offsets[i];
-		obs_source_output_video(data->source, &out);
+#if HAVE_FFMPEG
+		if (data->decoder) {
+			/* the decoder copies the data so the buffer can be
+			 * requeued right away */
+			v4l2_decoder_submit(data->decoder, start,
+					buf.bytesused, out.timestamp);
+		} else
+#endif
+		{
+			for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
+				out.data[i] = start + plane_offsets[i];
+
+			if (v4l2_can_lend(data)) {
+				/* the buffer stays dequeued until obs is done
+				 * with it, which saves copying the frame */
+				data->lent[buf.index].lent = true;
+				data->lent_count++;
+				os_atomic_inc_long(&data->lent_set->refs);
+				obs_source_lend_video(data->source, &out,
+						v4l2_buffer_returned,
+						&data->lent[buf.index]);
+
+				frames++;
+				continue;
+			}
+
+			obs_source_output_video(data->source, &out);
+		}
 
 		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
 			blog(LOG_DEBUG, "failed to enqueue buffer");
@@ -232,6 +434,8 @@ static void v4l2_defaults(obs_data_t *settings)
 	obs_data_set_default_int(settings, "resolution", -1);
 	obs_data_set_default_int(settings, "framerate", -1);
 	obs_data_set_default_bool(settings, "buffering", true);
+	obs_data_set_default_int(settings, "buffer_count", 4);
+	obs_data_set_default_bool(settings, "lend_buffers", false);
 }
 
 /**
@@ -388,8 +592,7 @@ static void v4l2_format_list(int dev, obs_property_t *prop)
 		if (fmt.flags & V4L2_FMT_FLAG_EMULATED)
 			dstr_cat(&buffer, " (Emulated)");
 
-		if (v4l2_to_obs_video_format(fmt.pixelformat)
-				!= VIDEO_FORMAT_NONE) {
+		if (v4l2_format_supported(fmt.pixelformat)) {
 			obs_property_list_add_int(prop, buffer.array,
 					fmt.pixelformat);
 			blog(LOG_INFO, "Pixelformat: %s (available)",
@@ -762,6 +965,13 @@ static obs_properties_t *v4l2_properties(void *vptr)
 	obs_properties_add_bool(props,
 			"buffering", obs_module_text("UseBuffering"));
 
+	obs_properties_add_int(props,
+			"buffer_count", obs_module_text("BufferCount"),
+			2, 32, 1);
+
+	obs_properties_add_bool(props,
+			"lend_buffers", obs_module_text("LendBuffers"));
+
 	obs_data_t *settings = obs_source_get_settings(data->source);
 	v4l2_device_list(device_list, settings);
 	obs_data_release(settings);
@@ -784,6 +994,12 @@ static void v4l2_terminate(struct v4l2_data *data)
 		data->thread = 0;
 	}
 
+#if HAVE_FFMPEG
+	v4l2_decoder_destroy(data->decoder);
+	data->decoder = NULL;
+#endif
+
+	v4l2_reclaim_buffers(data);
 	v4l2_destroy_mmap(&data->buffers);
 
 	if (data->dev != -1) {
@@ -874,7 +1090,7 @@ static void v4l2_init(struct v4l2_data *data)
 		blog(LOG_ERROR, "Unable to set format");
 		goto fail;
 	}
-	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE) {
+	if (!v4l2_format_supported(data->pixfmt)) {
 		blog(LOG_ERROR, "Selected video format not supported");
 		goto fail;
 	}
@@ -891,11 +1107,30 @@ static void v4l2_init(struct v4l2_data *data)
 	v4l2_unpack_tuple(&fps_num, &fps_denom, data->framerate);
 	blog(LOG_INFO, "Framerate: %.2f fps", (float) fps_denom / fps_num);
 
+#if HAVE_FFMPEG
+	/* set up the decoder for compressed formats */
+	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE) {
+		data->decoder = v4l2_decoder_create(data->source,
+				data->pixfmt, 0);
+		if (!data->decoder) {
+			blog(LOG_ERROR, "Unable to create decoder");
+			goto fail;
+		}
+	}
+#endif
+
 	/* map buffers */
-	if (v4l2_create_mmap(data->dev, &data->buffers) < 0) {
+	if (v4l2_create_mmap(data->dev, &data->buffers,
+			data->buffer_count) < 0) {
 		blog(LOG_ERROR, "Failed to map buffers");
 		goto fail;
 	}
+	blog(LOG_INFO, "Buffers: %"PRIuFAST32"%s", data->buffers.count,
+			data->lend_buffers ? " (lent to obs)" : "");
+
+	data->lent_set = v4l2_lent_set_create(data->buffers.count);
+	data->lent = data->lent_set->lent;
+	data->lent_count = 0;
 
 	/* start the capture thread */
 	if (os_event_init(&data->event, OS_EVENT_TYPE_MANUAL) != 0)
@@ -940,6 +1175,8 @@ static void v4l2_update(void *vptr, obs_data_t *settings)
 	data->dv_timing  = obs_data_get_int(settings, "dv_timing");
 	data->resolution = obs_data_get_int(settings, "resolution");
 	data->framerate  = obs_data_get_int(settings, "framerate");
+	data->buffer_count = obs_data_get_int(settings, "buffer_count");
+	data->lend_buffers = obs_data_get_bool(settings, "lend_buffers");
 
 	v4l2_update_source_flags(data, settings);
 
@@ -234,13 +234,9 @@ static void *opus_create(obs_data_t *settings, obs_encoder_t *encoder)
 	return enc_create(settings, encoder, "libopus", "opus");
 }
 
-static bool do_encode(struct enc_encoder *enc,
-		struct encoder_packet *packet, bool *received_packet)
+static bool fill_frame(struct enc_encoder *enc)
 {
-	AVRational time_base = {1, enc->context->sample_rate};
-	AVPacket   avpacket  = {0};
-	int        got_packet;
-	int        ret;
+	int ret;
 
 	enc->aframe->nb_samples = enc->frame_size;
 	enc->aframe->pts = av_rescale_q(enc->total_samples,
@@ -256,42 +252,121 @@ static bool do_encode(struct enc_encoder *enc,
 	}
 
 	enc->total_samples += enc->frame_size;
+	return true;
+}
 
-	ret = avcodec_encode_audio2(enc->context, &avpacket, enc->aframe,
-			&got_packet);
-	if (ret < 0) {
-		warn("avcodec_encode_audio2 failed: %s", av_err2str(ret));
-		return false;
-	}
-
-	*received_packet = !!got_packet;
-	if (!got_packet)
-		return true;
+static void copy_packet(struct enc_encoder *enc,
+		struct encoder_packet *packet, AVPacket *avpacket)
+{
+	AVRational time_base = {1, enc->context->sample_rate};
 
 	da_resize(enc->packet_buffer, 0);
-	da_push_back_array(enc->packet_buffer, avpacket.data, avpacket.size);
+	da_push_back_array(enc->packet_buffer, avpacket->data, avpacket->size);
 
-	packet->pts  = rescale_ts(avpacket.pts, enc->context, time_base);
-	packet->dts  = rescale_ts(avpacket.dts, enc->context, time_base);
+	packet->pts  = rescale_ts(avpacket->pts, enc->context, time_base);
+	packet->dts  = rescale_ts(avpacket->dts, enc->context, time_base);
 	packet->data = enc->packet_buffer.array;
-	packet->size = avpacket.size;
+	packet->size = avpacket->size;
 	packet->type = OBS_ENCODER_AUDIO;
 	packet->timebase_num = 1;
 	packet->timebase_den = (int32_t)enc->context->sample_rate;
-	av_free_packet(&avpacket);
+}
+
+static inline void copy_samples(struct enc_encoder *enc,
+		struct encoder_frame *frame)
+{
+	for (size_t i = 0; i < enc->audio_planes; i++)
+		memcpy(enc->samples[i], frame->data[i], enc->frame_size_bytes);
+}
+
+#if HAVE_AVCODEC_SEND_RECEIVE
+static bool enc_encode_submit(void *data, struct encoder_frame *frame)
+{
+	struct enc_encoder *enc = data;
+	int ret;
+
+	copy_samples(enc, frame);
+
+	if (!fill_frame(enc))
+		return false;
+
+	ret = avcodec_send_frame(enc->context, enc->aframe);
+	if (ret < 0) {
+		warn("avcodec_send_frame failed: %s", av_err2str(ret));
+		return false;
+	}
+
 	return true;
 }
 
+static bool enc_encode_receive(void *data, struct encoder_packet *packet,
+		bool *received_packet)
+{
+	struct enc_encoder *enc = data;
+	AVPacket avpacket = {0};
+	int ret;
+
+	av_init_packet(&avpacket);
+
+	ret = avcodec_receive_packet(enc->context, &avpacket);
+	if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+		*received_packet = false;
+		return true;
+	} else if (ret < 0) {
+		warn("avcodec_receive_packet failed: %s", av_err2str(ret));
+		return false;
+	}
+
+	copy_packet(enc, packet, &avpacket);
+	av_packet_unref(&avpacket);
+
+	*received_packet = true;
+	return true;
+}
+
+static bool enc_flush(void *data)
+{
+	struct enc_encoder *enc = data;
+	int ret = avcodec_send_frame(enc->context, NULL);
+
+	if (ret < 0 && ret != AVERROR_EOF) {
+		warn("avcodec_send_frame failed: %s", av_err2str(ret));
+		return false;
+	}
+
+	return true;
+}
+
+#else
 static bool enc_encode(void *data, struct encoder_frame *frame,
 		struct encoder_packet *packet, bool *received_packet)
 {
 	struct enc_encoder *enc = data;
+	AVPacket avpacket = {0};
+	int got_packet;
+	int ret;
 
-	for (size_t i = 0; i < enc->audio_planes; i++)
-		memcpy(enc->samples[i], frame->data[i], enc->frame_size_bytes);
+	copy_samples(enc, frame);
+
+	if (!fill_frame(enc))
+		return false;
+
+	ret = avcodec_encode_audio2(enc->context, &avpacket, enc->aframe,
+			&got_packet);
+	if (ret < 0) {
+		warn("avcodec_encode_audio2 failed: %s", av_err2str(ret));
+		return false;
+	}
 
-	return do_encode(enc, packet, received_packet);
+	*received_packet = !!got_packet;
+	if (!got_packet)
+		return true;
+
+	copy_packet(enc, packet, &avpacket);
+	av_free_packet(&avpacket);
+	return true;
 }
+#endif
 
 static void enc_defaults(obs_data_t *settings)
 {
@@ -338,7 +413,13 @@ struct obs_encoder_info aac_encoder_info = {
 	.get_name       = aac_getname,
 	.create         = aac_create,
 	.destroy        = enc_destroy,
+#if HAVE_AVCODEC_SEND_RECEIVE
+	.encode_submit  = enc_encode_submit,
+	.encode_receive = enc_encode_receive,
+	.flush          = enc_flush,
+#else
 	.encode         = enc_encode,
+#endif
 	.get_frame_size = enc_frame_size,
 	.get_defaults   = enc_defaults,
 	.get_properties = enc_properties,
@@ -353,7 +434,13 @@ struct obs_encoder_info opus_encoder_info = {
 	.get_name       = opus_getname,
 	.create         = opus_create,
 	.destroy        = enc_destroy,
+#if HAVE_AVCODEC_SEND_RECEIVE
+	.encode_submit  = enc_encode_submit,
+	.encode_receive = enc_encode_receive,
+	.flush          = enc_flush,
+#else
 	.encode         = enc_encode,
+#endif
 	.get_frame_size = enc_frame_size,
 	.get_defaults   = enc_defaults,
 	.get_properties = enc_properties,
@@ -23,3 +23,7 @@
 #if LIBAVCODEC_VERSION_MAJOR >= 57
 #define av_free_packet av_packet_unref
 #endif
+
+/* decoupled send/receive encoding API (avcodec_send_frame and
+ * avcodec_receive_packet) */
+#define HAVE_AVCODEC_SEND_RECEIVE LIBAVCODEC_VERSION_CHECK(57, 16, 0, 37, 100)
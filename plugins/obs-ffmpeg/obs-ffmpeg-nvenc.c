@@ -27,6 +27,7 @@
 #include <libavformat/avformat.h>
 
 #include "obs-ffmpeg-formats.h"
+#include "obs-ffmpeg-compat.h"
 
 #define do_log(level, format, ...) \
 	blog(level, "[NVENC encoder: '%s'] " format, \
@@ -242,6 +243,12 @@ static void nvenc_destroy(void *data)
 
 	if (enc->initialized) {
 		AVPacket pkt = {0};
+#if HAVE_AVCODEC_SEND_RECEIVE
+		avcodec_send_frame(enc->context, NULL);
+
+		while (avcodec_receive_packet(enc->context, &pkt) == 0)
+			av_packet_unref(&pkt);
+#else
 		int r_pkt = 1;
 
 		while (r_pkt) {
@@ -252,6 +259,7 @@ static void nvenc_destroy(void *data)
 			if (r_pkt)
 				av_free_packet(&pkt);
 		}
+#endif
 	}
 
 	avcodec_close(enc->context);
@@ -326,6 +334,95 @@ static inline void copy_data(AVPicture *pic, const struct encoder_frame *frame,
 	}
 }
 
+static void parse_packet(struct nvenc_encoder *enc,
+		struct encoder_packet *packet, AVPacket *av_pkt)
+{
+	if (enc->first_packet) {
+		uint8_t *new_packet;
+		size_t size;
+
+		enc->first_packet = false;
+		obs_extract_avc_headers(av_pkt->data, av_pkt->size,
+				&new_packet, &size,
+				&enc->header, &enc->header_size,
+				&enc->sei, &enc->sei_size);
+
+		da_copy_array(enc->buffer, new_packet, size);
+		bfree(new_packet);
+	} else {
+		da_copy_array(enc->buffer, av_pkt->data, av_pkt->size);
+	}
+
+	packet->pts = av_pkt->pts;
+	packet->dts = av_pkt->dts;
+	packet->data = enc->buffer.array;
+	packet->size = enc->buffer.num;
+	packet->type = OBS_ENCODER_VIDEO;
+	packet->keyframe = obs_avc_keyframe(packet->data, packet->size);
+}
+
+#if HAVE_AVCODEC_SEND_RECEIVE
+static bool nvenc_encode_submit(void *data, struct encoder_frame *frame)
+{
+	struct nvenc_encoder *enc = data;
+	int ret;
+
+	copy_data(&enc->dst_picture, frame, enc->height, enc->context->pix_fmt);
+
+	enc->vframe->pts = frame->pts;
+	ret = avcodec_send_frame(enc->context, enc->vframe);
+	if (ret < 0) {
+		warn("nvenc_encode_submit: Error encoding: %s",
+				av_err2str(ret));
+		return false;
+	}
+
+	return true;
+}
+
+static bool nvenc_encode_receive(void *data, struct encoder_packet *packet,
+		bool *received_packet)
+{
+	struct nvenc_encoder *enc = data;
+	AVPacket av_pkt = {0};
+	int ret;
+
+	av_init_packet(&av_pkt);
+
+	*received_packet = false;
+
+	ret = avcodec_receive_packet(enc->context, &av_pkt);
+	if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+		return true;
+	} else if (ret < 0) {
+		warn("nvenc_encode_receive: Error encoding: %s",
+				av_err2str(ret));
+		return false;
+	}
+
+	if (av_pkt.size) {
+		parse_packet(enc, packet, &av_pkt);
+		*received_packet = true;
+	}
+
+	av_packet_unref(&av_pkt);
+	return true;
+}
+
+static bool nvenc_flush(void *data)
+{
+	struct nvenc_encoder *enc = data;
+	int ret = avcodec_send_frame(enc->context, NULL);
+
+	if (ret < 0 && ret != AVERROR_EOF) {
+		warn("nvenc_flush: Error flushing: %s", av_err2str(ret));
+		return false;
+	}
+
+	return true;
+}
+
+#else
 static bool nvenc_encode(void *data, struct encoder_frame *frame,
 		struct encoder_packet *packet, bool *received_packet)
 {
@@ -347,28 +444,7 @@ static bool nvenc_encode(void *data, struct encoder_frame *frame,
 	}
 
 	if (got_packet && av_pkt.size) {
-		if (enc->first_packet) {
-			uint8_t *new_packet;
-			size_t size;
-
-			enc->first_packet = false;
-			obs_extract_avc_headers(av_pkt.data, av_pkt.size,
-					&new_packet, &size,
-					&enc->header, &enc->header_size,
-					&enc->sei, &enc->sei_size);
-
-			da_copy_array(enc->buffer, new_packet, size);
-			bfree(new_packet);
-		} else {
-			da_copy_array(enc->buffer, av_pkt.data, av_pkt.size);
-		}
-
-		packet->pts = av_pkt.pts;
-		packet->dts = av_pkt.dts;
-		packet->data = enc->buffer.array;
-		packet->size = enc->buffer.num;
-		packet->type = OBS_ENCODER_VIDEO;
-		packet->keyframe = obs_avc_keyframe(packet->data, packet->size);
+		parse_packet(enc, packet, &av_pkt);
 		*received_packet = true;
 	} else {
 		*received_packet = false;
@@ -377,6 +453,7 @@ static bool nvenc_encode(void *data, struct encoder_frame *frame,
 	av_free_packet(&av_pkt);
 	return true;
 }
+#endif
 
 static void nvenc_defaults(obs_data_t *settings)
 {
@@ -530,7 +607,13 @@ struct obs_encoder_info nvenc_encoder_info = {
 	.get_name       = nvenc_getname,
 	.create         = nvenc_create,
 	.destroy        = nvenc_destroy,
+#if HAVE_AVCODEC_SEND_RECEIVE
+	.encode_submit  = nvenc_encode_submit,
+	.encode_receive = nvenc_encode_receive,
+	.flush          = nvenc_flush,
+#else
 	.encode         = nvenc_encode,
+#endif
 	.get_defaults   = nvenc_defaults,
 	.get_properties = nvenc_properties,
 	.get_extra_data = nvenc_extra_data,
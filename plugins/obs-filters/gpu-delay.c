@@ -1,8 +1,24 @@
 #include <obs-module.h>
 #include <util/circlebuf.h>
+#include <util/dstr.h>
 
 #define S_DELAY_MS                     "delay_ms"
+#define S_STORAGE                      "storage"
 #define T_DELAY_MS                     obs_module_text("DelayMs")
+#define T_STORAGE                      obs_module_text("GPUDelay.Storage")
+#define T_STORAGE_FULL                 obs_module_text("GPUDelay.Storage.Full")
+#define T_STORAGE_HALF                 obs_module_text("GPUDelay.Storage.Half")
+#define T_STORAGE_NV12                 obs_module_text("GPUDelay.Storage.NV12")
+
+#define S_STORAGE_FULL                 "full"
+#define S_STORAGE_HALF                 "half"
+#define S_STORAGE_NV12                 "nv12"
+
+enum storage_mode {
+	STORAGE_FULL,
+	STORAGE_HALF,
+	STORAGE_NV12
+};
 
 struct frame {
 	gs_texrender_t *render;
@@ -18,6 +34,13 @@ struct gpu_delay_filter_data {
 	uint32_t                       cy;
 	bool                           target_valid;
 	bool                           processed_frame;
+
+	enum storage_mode              storage;
+	gs_texrender_t                 *scratch;
+	gs_effect_t                    *effect;
+	gs_eparam_t                    *param_image;
+	gs_eparam_t                    *param_width;
+	gs_eparam_t                    *param_height;
 };
 
 static const char *gpu_delay_filter_get_name(void *unused)
@@ -35,9 +58,41 @@ static void free_textures(struct gpu_delay_filter_data *f)
 		gs_texrender_destroy(frame.render);
 	}
 	circlebuf_free(&f->frames);
+	gs_texrender_destroy(f->scratch);
+	f->scratch = NULL;
 	obs_leave_graphics();
 }
 
+/* Frame textures are allocated through the libobs texture pool (via
+ * gs_texrender), so textures freed on a resize or settings change are reused
+ * rather than reallocated.  The reduced storage modes cut the memory of each
+ * stored frame: half resolution RGBA takes 1/4 of the memory, and NV12
+ * packing (8-bit luma plus 2x2 subsampled chroma, no alpha) takes 3/8. */
+static inline void get_storage_size(struct gpu_delay_filter_data *f,
+		uint32_t *cx, uint32_t *cy)
+{
+	switch (f->storage) {
+	case STORAGE_HALF:
+		*cx = (f->cx + 1) / 2;
+		*cy = (f->cy + 1) / 2;
+		break;
+	case STORAGE_NV12:
+		*cx = f->cx;
+		*cy = f->cy + f->cy / 2;
+		break;
+	case STORAGE_FULL:
+	default:
+		*cx = f->cx;
+		*cy = f->cy;
+	}
+}
+
+static inline enum gs_color_format get_storage_format(
+		struct gpu_delay_filter_data *f)
+{
+	return f->storage == STORAGE_NV12 ? GS_R8 : GS_RGBA;
+}
+
 static size_t num_frames(struct circlebuf *buf)
 {
 	return buf->size / sizeof(struct frame);
@@ -64,7 +119,8 @@ static void update_interval(struct gpu_delay_filter_data *f,
 		for (size_t i = prev_num; i < num; i++) {
 			struct frame *frame = circlebuf_data(&f->frames,
 					i * sizeof(*frame));
-			frame->render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+			frame->render = gs_texrender_create(
+					get_storage_format(f), GS_ZS_NONE);
 		}
 
 		obs_leave_graphics();
@@ -120,6 +176,16 @@ static inline bool check_size(struct gpu_delay_filter_data *f)
 	if (!f->target_valid)
 		return true;
 
+	/* NV12 packing works on 2x2 blocks */
+	if (f->storage == STORAGE_NV12) {
+		cx &= ~1;
+		cy &= ~1;
+
+		f->target_valid = !!cx && !!cy;
+		if (!f->target_valid)
+			return true;
+	}
+
 	if (cx != f->cx || cy != f->cy) {
 		f->cx = cx;
 		f->cy = cy;
@@ -133,9 +199,17 @@ static inline bool check_size(struct gpu_delay_filter_data *f)
 static void gpu_delay_filter_update(void *data, obs_data_t *s)
 {
 	struct gpu_delay_filter_data *f = data;
+	const char *storage = obs_data_get_string(s, S_STORAGE);
 
 	f->delay_ns = (uint64_t)obs_data_get_int(s, S_DELAY_MS) * 1000000ULL;
 
+	if (astrcmpi(storage, S_STORAGE_HALF) == 0)
+		f->storage = STORAGE_HALF;
+	else if (astrcmpi(storage, S_STORAGE_NV12) == 0 && f->effect)
+		f->storage = STORAGE_NV12;
+	else
+		f->storage = STORAGE_FULL;
+
 	/* full reset */
 	f->cx = 0;
 	f->cy = 0;
@@ -147,17 +221,52 @@ static obs_properties_t *gpu_delay_filter_properties(void *data)
 {
 	obs_properties_t *props = obs_properties_create();
 
+	obs_property_t *p;
+
 	obs_properties_add_int(props, S_DELAY_MS, T_DELAY_MS, 0, 500, 1);
 
+	p = obs_properties_add_list(props, S_STORAGE, T_STORAGE,
+			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(p, T_STORAGE_FULL, S_STORAGE_FULL);
+	obs_property_list_add_string(p, T_STORAGE_HALF, S_STORAGE_HALF);
+	obs_property_list_add_string(p, T_STORAGE_NV12, S_STORAGE_NV12);
+
 	UNUSED_PARAMETER(data);
 	return props;
 }
 
+static void gpu_delay_filter_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_string(settings, S_STORAGE, S_STORAGE_FULL);
+}
+
 static void *gpu_delay_filter_create(obs_data_t *settings, obs_source_t *context)
 {
 	struct gpu_delay_filter_data *f = bzalloc(sizeof(*f));
+	char *effect_path;
+
 	f->context = context;
 
+	effect_path = obs_module_file("gpu_delay.effect");
+
+	obs_enter_graphics();
+	f->effect = gs_effect_create_from_file(effect_path, NULL);
+	obs_leave_graphics();
+
+	bfree(effect_path);
+
+	if (f->effect) {
+		f->param_image = gs_effect_get_param_by_name(f->effect,
+				"image");
+		f->param_width = gs_effect_get_param_by_name(f->effect,
+				"width");
+		f->param_height = gs_effect_get_param_by_name(f->effect,
+				"height");
+	} else {
+		blog(LOG_WARNING, "gpu_delay: failed to load effect, "
+				"NV12 frame storage will be unavailable");
+	}
+
 	obs_source_update(context, settings);
 	return f;
 }
@@ -167,6 +276,11 @@ static void gpu_delay_filter_destroy(void *data)
 	struct gpu_delay_filter_data *f = data;
 
 	free_textures(f);
+
+	obs_enter_graphics();
+	gs_effect_destroy(f->effect);
+	obs_leave_graphics();
+
 	bfree(f);
 }
 
@@ -188,9 +302,19 @@ static void draw_frame(struct gpu_delay_filter_data *f)
 	struct frame frame;
 	circlebuf_peek_front(&f->frames, &frame, sizeof(frame));
 
-	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
 	gs_texture_t *tex = gs_texrender_get_texture(frame.render);
-	if (tex) {
+	if (!tex)
+		return;
+
+	if (f->storage == STORAGE_NV12) {
+		gs_effect_set_texture(f->param_image, tex);
+		gs_effect_set_float(f->param_width, (float)f->cx);
+		gs_effect_set_float(f->param_height, (float)f->cy);
+
+		while (gs_effect_loop(f->effect, "UnpackNV12"))
+			gs_draw_sprite(tex, 0, f->cx, f->cy);
+	} else {
+		gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
 		gs_eparam_t *image =
 			gs_effect_get_param_by_name(effect, "image");
 		gs_effect_set_texture(image, tex);
@@ -200,6 +324,67 @@ static void draw_frame(struct gpu_delay_filter_data *f)
 	}
 }
 
+static void render_target(struct gpu_delay_filter_data *f,
+		gs_texrender_t *render, obs_source_t *target,
+		obs_source_t *parent)
+{
+	if (gs_texrender_begin(render, f->cx, f->cy)) {
+		uint32_t parent_flags = obs_source_get_output_flags(target);
+		bool custom_draw = (parent_flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
+		bool async = (parent_flags & OBS_SOURCE_ASYNC) != 0;
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)f->cx, 0.0f, (float)f->cy,
+				-100.0f, 100.0f);
+
+		if (target == parent && !custom_draw && !async)
+			obs_source_default_render(target);
+		else
+			obs_source_video_render(target);
+
+		gs_texrender_end(render);
+	}
+}
+
+/* renders the full size scratch texture into the reduced storage format */
+static void store_scratch(struct gpu_delay_filter_data *f,
+		gs_texrender_t *render)
+{
+	gs_texture_t *tex = gs_texrender_get_texture(f->scratch);
+	uint32_t cx, cy;
+
+	if (!tex)
+		return;
+
+	get_storage_size(f, &cx, &cy);
+
+	if (gs_texrender_begin(render, cx, cy)) {
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+		if (f->storage == STORAGE_NV12) {
+			gs_effect_set_texture(f->param_image, tex);
+			gs_effect_set_float(f->param_width, (float)f->cx);
+			gs_effect_set_float(f->param_height, (float)f->cy);
+
+			while (gs_effect_loop(f->effect, "PackNV12"))
+				gs_draw_sprite(tex, 0, cx, cy);
+		} else {
+			gs_effect_t *effect =
+				obs_get_base_effect(OBS_EFFECT_DEFAULT);
+			gs_eparam_t *image =
+				gs_effect_get_param_by_name(effect, "image");
+			gs_effect_set_texture(image, tex);
+
+			while (gs_effect_loop(effect, "Draw"))
+				gs_draw_sprite(tex, 0, cx, cy);
+		}
+
+		gs_texrender_end(render);
+	}
+}
+
 static void gpu_delay_filter_render(void *data, gs_effect_t *effect)
 {
 	struct gpu_delay_filter_data *f = data;
@@ -224,23 +409,15 @@ static void gpu_delay_filter_render(void *data, gs_effect_t *effect)
 	gs_blend_state_push();
 	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
 
-	if (gs_texrender_begin(frame.render, f->cx, f->cy)) {
-		uint32_t parent_flags = obs_source_get_output_flags(target);
-		bool custom_draw = (parent_flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
-		bool async = (parent_flags & OBS_SOURCE_ASYNC) != 0;
-		struct vec4 clear_color;
-
-		vec4_zero(&clear_color);
-		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
-		gs_ortho(0.0f, (float)f->cx, 0.0f, (float)f->cy,
-				-100.0f, 100.0f);
-
-		if (target == parent && !custom_draw && !async)
-			obs_source_default_render(target);
-		else
-			obs_source_video_render(target);
+	if (f->storage == STORAGE_FULL) {
+		render_target(f, frame.render, target, parent);
+	} else {
+		if (!f->scratch)
+			f->scratch = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
 
-		gs_texrender_end(frame.render);
+		gs_texrender_reset(f->scratch);
+		render_target(f, f->scratch, target, parent);
+		store_scratch(f, frame.render);
 	}
 
 	gs_blend_state_pop();
@@ -261,6 +438,7 @@ struct obs_source_info gpu_delay_filter = {
 	.destroy                       = gpu_delay_filter_destroy,
 	.update                        = gpu_delay_filter_update,
 	.get_properties                = gpu_delay_filter_properties,
+	.get_defaults                  = gpu_delay_filter_defaults,
 	.video_tick                    = gpu_delay_filter_tick,
 	.video_render                  = gpu_delay_filter_render
 };
@@ -47,6 +47,12 @@ struct obs_x264 {
 
 	DARRAY(uint8_t)        packet_data;
 
+	/* output of the last x264_encoder_encode call, until received */
+	x264_nal_t             *nals;
+	int                    nal_count;
+	x264_picture_t         pic_out;
+	bool                   flushing;
+
 	uint8_t                *extra_data;
 	uint8_t                *sei;
 
@@ -670,6 +676,27 @@ static void parse_packet(struct obs_x264 *obsx264,
 	packet->keyframe      = pic_out->b_keyframe != 0;
 }
 
+/* x264 holds on to the SEI until the frame leaves the lookahead, and frees it
+ * with sei_free once it has been written */
+static void init_pic_sei(x264_picture_t *pic, struct encoder_frame *frame)
+{
+	x264_sei_payload_t *payloads;
+
+	payloads = bzalloc(sizeof(x264_sei_payload_t) * frame->num_sei);
+
+	for (size_t i = 0; i < frame->num_sei; i++) {
+		const struct encoder_sei *sei = frame->sei + i;
+
+		payloads[i].payload_type = sei->type;
+		payloads[i].payload_size = (int)sei->size;
+		payloads[i].payload      = bmemdup(sei->data, sei->size);
+	}
+
+	pic->extra_sei.num_payloads = (int)frame->num_sei;
+	pic->extra_sei.payloads     = payloads;
+	pic->extra_sei.sei_free     = bfree;
+}
+
 static inline void init_pic_data(struct obs_x264 *obsx264, x264_picture_t *pic,
 		struct encoder_frame *frame)
 {
@@ -689,33 +716,64 @@ static inline void init_pic_data(struct obs_x264 *obsx264, x264_picture_t *pic,
 		pic->img.i_stride[i] = (int)frame->linesize[i];
 		pic->img.plane[i]    = frame->data[i];
 	}
+
+	if (frame->num_sei)
+		init_pic_sei(pic, frame);
 }
 
-static bool obs_x264_encode(void *data, struct encoder_frame *frame,
-		struct encoder_packet *packet, bool *received_packet)
+static inline bool encode_pic(struct obs_x264 *obsx264, x264_picture_t *pic)
+{
+	int ret = x264_encoder_encode(obsx264->context, &obsx264->nals,
+			&obsx264->nal_count, pic, &obsx264->pic_out);
+	if (ret < 0) {
+		obsx264->nal_count = 0;
+		warn("encode failed");
+		return false;
+	}
+
+	return true;
+}
+
+static bool obs_x264_encode_submit(void *data, struct encoder_frame *frame)
 {
 	struct obs_x264 *obsx264 = data;
-	x264_nal_t      *nals;
-	int             nal_count;
-	int             ret;
-	x264_picture_t  pic, pic_out;
+	x264_picture_t  pic;
 
-	if (!frame || !packet || !received_packet)
+	if (!frame)
 		return false;
 
-	if (frame)
-		init_pic_data(obsx264, &pic, frame);
+	init_pic_data(obsx264, &pic, frame);
+	return encode_pic(obsx264, &pic);
+}
 
-	ret = x264_encoder_encode(obsx264->context, &nals, &nal_count,
-			(frame ? &pic : NULL), &pic_out);
-	if (ret < 0) {
-		warn("encode failed");
+static bool obs_x264_encode_receive(void *data, struct encoder_packet *packet,
+		bool *received_packet)
+{
+	struct obs_x264 *obsx264 = data;
+
+	if (!packet || !received_packet)
 		return false;
+
+	/* when flushing, pull the delayed frames out of the lookahead and
+	 * b-frame queues one at a time */
+	while (!obsx264->nal_count && obsx264->flushing &&
+	       x264_encoder_delayed_frames(obsx264->context) > 0) {
+		if (!encode_pic(obsx264, NULL))
+			return false;
 	}
 
-	*received_packet = (nal_count != 0);
-	parse_packet(obsx264, packet, nals, nal_count, &pic_out);
+	*received_packet = (obsx264->nal_count != 0);
+	parse_packet(obsx264, packet, obsx264->nals, obsx264->nal_count,
+			&obsx264->pic_out);
+
+	obsx264->nal_count = 0;
+	return true;
+}
 
+static bool obs_x264_flush(void *data)
+{
+	struct obs_x264 *obsx264 = data;
+	obsx264->flushing = true;
 	return true;
 }
 
@@ -769,10 +827,13 @@ struct obs_encoder_info obs_x264_encoder = {
 	.id             = "obs_x264",
 	.type           = OBS_ENCODER_VIDEO,
 	.codec          = "h264",
+	.caps           = OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_SEI,
 	.get_name       = obs_x264_getname,
 	.create         = obs_x264_create,
 	.destroy        = obs_x264_destroy,
-	.encode         = obs_x264_encode,
+	.encode_submit  = obs_x264_encode_submit,
+	.encode_receive = obs_x264_encode_receive,
+	.flush          = obs_x264_flush,
 	.update         = obs_x264_update,
 	.get_properties = obs_x264_props,
 	.get_defaults   = obs_x264_defaults,
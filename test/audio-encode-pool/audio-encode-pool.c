@@ -0,0 +1,431 @@
+/*
+ * Audio encode pool test.  Runs several slow audio encoders on separate mixes
+ * of a synthetic audio output and checks that:
+ *
+ *  - every encoder receives every sample exactly once and in order (the
+ *    synthetic audio is a running sample counter, so each frame has to
+ *    continue exactly where the previous one ended)
+ *  - frame and packet pts advance by exactly one frame each time
+ *  - no encoding happens on the audio thread
+ *  - encoders run in parallel when there is more than one core
+ *
+ * Exits with 0 on success, 1 on failure.
+ *
+ *   audio-encode-pool [--seconds <n>] [--verbose]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <media-io/audio-io.h>
+#include <obs.h>
+
+#define SAMPLE_RATE         48000
+#define FRAME_SIZE          1024
+#define NUM_TRACKS          6
+#define ENCODE_DELAY_MS     3
+
+/* audio-io clamps samples to -1.0..1.0, so the counter is scaled down to
+ * that range; with 20 bits it stays exactly representable as a float */
+#define COUNTER_WRAP        (1 << 20)
+
+struct test_encoder {
+	int64_t              next_pts;
+	uint32_t             next_sample;
+	bool                 started;
+	uint8_t              payload[4];
+};
+
+struct track_stats {
+	uint64_t             packets;
+	int64_t              next_pts;
+};
+
+static struct {
+	bool                 verbose;
+	audio_t              *audio;
+	uint32_t             audio_samples;
+	pthread_t            audio_thread;
+	volatile bool        audio_thread_set;
+
+	volatile long        encoding;
+	volatile long        max_encoding;
+	volatile long        encodes_on_audio_thread;
+	volatile long        sample_errors;
+	volatile long        frame_pts_errors;
+
+	pthread_mutex_t      mutex;
+	struct track_stats   tracks[NUM_TRACKS];
+	long                 packet_pts_errors;
+} test;
+
+/* ------------------------------------------------------------------------- */
+/* slow test encoder that verifies its input */
+
+static const char *test_encoder_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Audio encode pool test encoder";
+}
+
+static void *test_encoder_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(encoder);
+	return bzalloc(sizeof(struct test_encoder));
+}
+
+static void test_encoder_destroy(void *data)
+{
+	bfree(data);
+}
+
+static void check_samples(struct test_encoder *enc, const float *samples,
+		uint32_t frames)
+{
+	for (uint32_t i = 0; i < frames; i++) {
+		uint32_t val = (uint32_t)(samples[i] * COUNTER_WRAP + 0.5f);
+
+		if (enc->started && val != enc->next_sample) {
+			os_atomic_inc_long(&test.sample_errors);
+			blog(LOG_WARNING, "expected sample %u, got %u",
+					enc->next_sample, val);
+		}
+
+		enc->next_sample = (val + 1) % COUNTER_WRAP;
+		enc->started = true;
+	}
+}
+
+static bool test_encoder_encode(void *data, struct encoder_frame *frame,
+		struct encoder_packet *packet, bool *received_packet)
+{
+	struct test_encoder *enc = data;
+	long encoding = os_atomic_inc_long(&test.encoding);
+	long max_encoding = os_atomic_load_long(&test.max_encoding);
+
+	while (encoding > max_encoding &&
+	       !os_atomic_compare_swap_long(&test.max_encoding,
+		       max_encoding, encoding))
+		max_encoding = os_atomic_load_long(&test.max_encoding);
+
+	if (os_atomic_load_bool(&test.audio_thread_set) &&
+	    pthread_equal(pthread_self(), test.audio_thread))
+		os_atomic_inc_long(&test.encodes_on_audio_thread);
+
+	if (frame->pts != enc->next_pts) {
+		os_atomic_inc_long(&test.frame_pts_errors);
+		blog(LOG_WARNING, "expected frame pts %lld, got %lld",
+				(long long)enc->next_pts,
+				(long long)frame->pts);
+	}
+	enc->next_pts = frame->pts + frame->frames;
+
+	check_samples(enc, (const float*)frame->data[0], frame->frames);
+
+	/* simulate an expensive encoder */
+	os_sleep_ms(ENCODE_DELAY_MS);
+
+	packet->data     = enc->payload;
+	packet->size     = sizeof(enc->payload);
+	packet->pts      = frame->pts;
+	packet->dts      = frame->pts;
+	packet->type     = OBS_ENCODER_AUDIO;
+	packet->keyframe = true;
+	*received_packet = true;
+
+	os_atomic_dec_long(&test.encoding);
+	return true;
+}
+
+static size_t test_encoder_frame_size(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return FRAME_SIZE;
+}
+
+static struct obs_encoder_info test_encoder = {
+	.id             = "audio_encode_pool_test",
+	.type           = OBS_ENCODER_AUDIO,
+	.codec          = "test",
+	.get_name       = test_encoder_getname,
+	.create         = test_encoder_create,
+	.destroy        = test_encoder_destroy,
+	.encode         = test_encoder_encode,
+	.get_frame_size = test_encoder_frame_size
+};
+
+/* ------------------------------------------------------------------------- */
+/* multi-track output that verifies packet timing */
+
+static const char *test_output_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Audio encode pool test output";
+}
+
+static void *test_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	UNUSED_PARAMETER(settings);
+	return output;
+}
+
+static void test_output_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static bool test_output_start(void *data)
+{
+	obs_output_t *output = data;
+
+	if (!obs_output_can_begin_data_capture(output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(output, 0))
+		return false;
+
+	return obs_output_begin_data_capture(output, 0);
+}
+
+static void test_output_stop(void *data, uint64_t ts)
+{
+	obs_output_end_data_capture(data);
+	UNUSED_PARAMETER(ts);
+}
+
+static void test_output_packet(void *data, struct encoder_packet *packet)
+{
+	struct track_stats *track;
+
+	if (packet->track_idx >= NUM_TRACKS)
+		return;
+
+	pthread_mutex_lock(&test.mutex);
+
+	track = &test.tracks[packet->track_idx];
+	if (track->packets && packet->pts != track->next_pts) {
+		test.packet_pts_errors++;
+		blog(LOG_WARNING, "track %u: expected packet pts %lld, "
+				"got %lld", (unsigned)packet->track_idx,
+				(long long)track->next_pts,
+				(long long)packet->pts);
+	}
+
+	track->next_pts = packet->pts + FRAME_SIZE;
+	track->packets++;
+
+	pthread_mutex_unlock(&test.mutex);
+
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_output_info test_output = {
+	.id             = "audio_encode_pool_test_output",
+	.flags          = OBS_OUTPUT_AUDIO | OBS_OUTPUT_ENCODED |
+	                  OBS_OUTPUT_MULTI_TRACK,
+	.get_name       = test_output_getname,
+	.create         = test_output_create,
+	.destroy        = test_output_destroy,
+	.start          = test_output_start,
+	.stop           = test_output_stop,
+	.encoded_packet = test_output_packet
+};
+
+/* ------------------------------------------------------------------------- */
+/* synthetic audio: a running sample counter on every mix */
+
+static bool audio_input(void *param, uint64_t start_ts, uint64_t end_ts,
+		uint64_t *new_ts, uint32_t active_mixers,
+		struct audio_output_data *mixes)
+{
+	if (!os_atomic_load_bool(&test.audio_thread_set)) {
+		test.audio_thread = pthread_self();
+		os_atomic_set_bool(&test.audio_thread_set, true);
+	}
+
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
+		if ((active_mixers & (1 << mix)) == 0)
+			continue;
+
+		for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++) {
+			float val = (float)((test.audio_samples + i) %
+					COUNTER_WRAP) / (float)COUNTER_WRAP;
+			mixes[mix].data[0][i] = val;
+			mixes[mix].data[1][i] = val;
+		}
+	}
+
+	test.audio_samples += AUDIO_OUTPUT_FRAMES;
+	*new_ts = start_ts;
+
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(end_ts);
+	return true;
+}
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	if (test.verbose || log_level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fprintf(stderr, "\n");
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool run(uint32_t seconds, obs_encoder_t **encoders,
+		obs_output_t **output)
+{
+	struct audio_output_info ai = {
+		.name            = "audio encode pool test",
+		.samples_per_sec = SAMPLE_RATE,
+		.format          = AUDIO_FORMAT_FLOAT_PLANAR,
+		.speakers        = SPEAKERS_STEREO,
+		.input_callback  = audio_input
+	};
+
+	if (audio_output_open(&test.audio, &ai) != AUDIO_OUTPUT_SUCCESS) {
+		fprintf(stderr, "failed to open audio output\n");
+		return false;
+	}
+
+	*output = obs_output_create(test_output.id, "test", NULL, NULL);
+	if (!*output)
+		return false;
+
+	obs_output_set_media(*output, NULL, test.audio);
+
+	for (size_t i = 0; i < NUM_TRACKS; i++) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "track %d", (int)i + 1);
+		encoders[i] = obs_audio_encoder_create(test_encoder.id, name,
+				NULL, i, NULL);
+		if (!encoders[i])
+			return false;
+
+		obs_encoder_set_audio(encoders[i], test.audio);
+		obs_output_set_audio_encoder(*output, encoders[i], i);
+	}
+
+	if (!obs_output_start(*output)) {
+		fprintf(stderr, "failed to start output\n");
+		return false;
+	}
+
+	os_sleep_ms(seconds * 1000);
+	obs_output_stop(*output);
+
+	while (obs_output_active(*output))
+		os_sleep_ms(10);
+
+	return true;
+}
+
+static bool check_results(void)
+{
+	uint64_t min_packets = UINT64_MAX;
+	uint64_t max_packets = 0;
+	bool success = true;
+
+	for (size_t i = 0; i < NUM_TRACKS; i++) {
+		uint64_t packets = test.tracks[i].packets;
+		printf("track %d: %llu packets\n", (int)i + 1,
+				(unsigned long long)packets);
+
+		if (packets < min_packets) min_packets = packets;
+		if (packets > max_packets) max_packets = packets;
+	}
+
+	printf("max concurrent encodes: %ld\n", test.max_encoding);
+
+#define CHECK(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "FAILED: " __VA_ARGS__); \
+			fprintf(stderr, "\n"); \
+			success = false; \
+		} \
+	} while (false)
+
+	CHECK(min_packets > 0, "a track received no packets");
+	CHECK(max_packets - min_packets <= 2,
+			"tracks received %llu to %llu packets",
+			(unsigned long long)min_packets,
+			(unsigned long long)max_packets);
+	CHECK(!test.sample_errors, "%ld sample discontinuities",
+			test.sample_errors);
+	CHECK(!test.frame_pts_errors, "%ld frame pts errors",
+			test.frame_pts_errors);
+	CHECK(!test.packet_pts_errors, "%ld packet pts errors",
+			test.packet_pts_errors);
+	CHECK(!test.encodes_on_audio_thread,
+			"%ld frames encoded on the audio thread",
+			test.encodes_on_audio_thread);
+
+	if (os_get_physical_cores() > 1)
+		CHECK(test.max_encoding > 1,
+				"audio encoders did not run in parallel");
+
+#undef CHECK
+
+	return success;
+}
+
+int main(int argc, char *argv[])
+{
+	obs_encoder_t *encoders[NUM_TRACKS] = {0};
+	obs_output_t *output = NULL;
+	uint32_t seconds = 3;
+	int ret = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			seconds = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--verbose") == 0) {
+			test.verbose = true;
+		} else {
+			fprintf(stderr, "usage: %s [--seconds <n>] "
+					"[--verbose]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	pthread_mutex_init_value(&test.mutex);
+	base_set_log_handler(do_log, NULL);
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		fprintf(stderr, "failed to initialize libobs\n");
+		return 1;
+	}
+
+	if (pthread_mutex_init(&test.mutex, NULL) != 0)
+		goto exit;
+
+	obs_register_encoder(&test_encoder);
+	obs_register_output(&test_output);
+
+	if (run(seconds, encoders, &output) && check_results()) {
+		printf("PASSED\n");
+		ret = 0;
+	}
+
+exit:
+	obs_output_release(output);
+	for (size_t i = 0; i < NUM_TRACKS; i++)
+		obs_encoder_release(encoders[i]);
+
+	audio_output_close(test.audio);
+	obs_shutdown();
+	pthread_mutex_destroy(&test.mutex);
+
+	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	return ret;
+}
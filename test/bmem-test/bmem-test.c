@@ -0,0 +1,319 @@
+/*
+ * bmem test.  Checks that:
+ *
+ *  - blocks of every size are aligned to base_get_alignment()
+ *  - brealloc keeps the contents when blocks move between size classes and
+ *    when large blocks are moved by the allocator to a differently aligned
+ *    address
+ *  - bmem_get_stats counts the bytes of large blocks
+ *  - base_set_allocator returns the blocks cached by every thread to the
+ *    allocator they came from
+ *  - bmem_arena_release hands out the memory allocated after a mark again,
+ *    also when the allocations after the mark spilled into new blocks
+ *
+ * Exits with 0 on success, 1 on failure.
+ *
+ *   bmem-test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/threading.h>
+
+static int failures = 0;
+
+#define CHECK(x) \
+	do { \
+		if (!(x)) { \
+			printf("FAIL (line %d): %s\n", __LINE__, #x); \
+			failures++; \
+		} \
+	} while (false)
+
+/* an allocator that counts its blocks and returns them at alternating
+ * alignments, so brealloc has to deal with blocks that move to an address
+ * with a different alignment */
+struct test_allocator {
+	struct base_allocator funcs;
+	volatile long         blocks;
+	volatile long         shift;
+};
+
+static struct test_allocator allocators[2];
+
+#define SHIFTING_ALLOCATOR(n) \
+	static uint8_t *place_##n(uint8_t *raw) \
+	{ \
+		uint8_t offset = (os_atomic_inc_long( \
+				&allocators[n].shift) & 1) ? 8 : 16; \
+		raw[offset - 1] = offset; \
+		return raw + offset; \
+	} \
+	static void *malloc_##n(size_t size) \
+	{ \
+		uint8_t *raw = malloc(size + 16); \
+		if (!raw) \
+			return NULL; \
+		os_atomic_inc_long(&allocators[n].blocks); \
+		return place_##n(raw); \
+	} \
+	static void *realloc_##n(void *ptr, size_t size) \
+	{ \
+		uint8_t offset, *raw, *new_ptr; \
+		if (!ptr) \
+			return malloc_##n(size); \
+		offset = ((uint8_t*)ptr)[-1]; \
+		raw = realloc((uint8_t*)ptr - offset, size + 16); \
+		if (!raw) \
+			return NULL; \
+		new_ptr = place_##n(raw); \
+		memmove(new_ptr, raw + offset, size); \
+		return new_ptr; \
+	} \
+	static void free_##n(void *ptr) \
+	{ \
+		if (ptr) { \
+			os_atomic_dec_long(&allocators[n].blocks); \
+			free((uint8_t*)ptr - ((uint8_t*)ptr)[-1]); \
+		} \
+	}
+
+SHIFTING_ALLOCATOR(0)
+SHIFTING_ALLOCATOR(1)
+
+static void fill(uint8_t *ptr, size_t size, uint8_t seed)
+{
+	for (size_t i = 0; i < size; i++)
+		ptr[i] = (uint8_t)(seed + i * 7);
+}
+
+static bool check_fill(const uint8_t *ptr, size_t size, uint8_t seed)
+{
+	for (size_t i = 0; i < size; i++) {
+		if (ptr[i] != (uint8_t)(seed + i * 7))
+			return false;
+	}
+
+	return true;
+}
+
+static bool aligned(const void *ptr)
+{
+	return ((uintptr_t)ptr % (uintptr_t)base_get_alignment()) == 0;
+}
+
+static void test_alignment(void)
+{
+	for (size_t size = 0; size <= 4096; size++) {
+		void *ptr = bmalloc(size);
+		CHECK(aligned(ptr));
+		bfree(ptr);
+	}
+}
+
+static void test_realloc(void)
+{
+	static const size_t sizes[] = {
+		1, 16, 17, 100, 512, 513, 4000, 100000, 3000, 600, 200, 20,
+		1000000, 5
+	};
+	size_t prev_size = 0;
+	uint8_t *ptr = NULL;
+
+	for (int round = 0; round < 16; round++) {
+		for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+			size_t size = sizes[i] + (size_t)round;
+			size_t keep = prev_size < size ? prev_size : size;
+
+			ptr = brealloc(ptr, size);
+			CHECK(aligned(ptr));
+			CHECK(check_fill(ptr, keep, (uint8_t)i));
+
+			fill(ptr, size, (uint8_t)(i + 1));
+			prev_size = size;
+		}
+
+		/* the seed of the next round's first check */
+		fill(ptr, prev_size, 0);
+	}
+
+	bfree(ptr);
+}
+
+static void test_stats(void)
+{
+	struct bmem_stats before, after;
+	struct bmem_size_class_stats *large_before, *large_after;
+	void *ptr;
+
+	large_before = &before.size_classes[BMEM_NUM_SIZE_CLASSES];
+	large_after  = &after.size_classes[BMEM_NUM_SIZE_CLASSES];
+
+	bmem_get_stats(&before);
+	ptr = bmalloc(10000);
+	bmem_get_stats(&after);
+	CHECK(large_after->allocs == large_before->allocs + 1);
+	CHECK(large_after->bytes == large_before->bytes + 10000);
+
+	ptr = brealloc(ptr, 30000);
+	bmem_get_stats(&after);
+	CHECK(large_after->bytes == large_before->bytes + 30000);
+
+	ptr = brealloc(ptr, 20000);
+	bmem_get_stats(&after);
+	CHECK(large_after->bytes == large_before->bytes + 20000);
+
+	bfree(ptr);
+	bmem_get_stats(&after);
+	CHECK(large_after->allocs == large_before->allocs);
+	CHECK(large_after->bytes == large_before->bytes);
+}
+
+struct worker {
+	os_event_t *filled;
+	os_event_t *switched;
+};
+
+static void churn(void)
+{
+	void *ptrs[64];
+
+	for (size_t i = 0; i < 64; i++)
+		ptrs[i] = bmalloc(16 << (i % 6));
+	for (size_t i = 0; i < 64; i++)
+		bfree(ptrs[i]);
+}
+
+static void *worker_thread(void *param)
+{
+	struct worker *w = param;
+
+	/* leaves blocks of the first allocator in this thread's cache */
+	churn();
+	os_event_signal(w->filled);
+
+	/* the cache has to be flushed to the first allocator before blocks of
+	 * the second are cached */
+	os_event_wait(w->switched);
+	churn();
+	return NULL;
+}
+
+static void test_set_allocator(void)
+{
+	struct base_allocator defaults = {malloc, realloc, free};
+	struct worker w;
+	pthread_t thread;
+
+	/* blocks have to be freed with the allocator they came from */
+	os_event_init(&w.filled, OS_EVENT_TYPE_MANUAL);
+	os_event_init(&w.switched, OS_EVENT_TYPE_MANUAL);
+
+	base_set_allocator(&allocators[0].funcs);
+
+	if (pthread_create(&thread, NULL, worker_thread, &w) != 0) {
+		printf("FAIL: couldn't create a thread\n");
+		failures++;
+		base_set_allocator(&defaults);
+		return;
+	}
+
+	os_event_wait(w.filled);
+	churn();
+	CHECK(os_atomic_load_long(&allocators[0].blocks) > 0);
+
+	base_set_allocator(&allocators[1].funcs);
+	os_event_signal(w.switched);
+	pthread_join(thread, NULL);
+
+	/* the worker flushed its cache when it used it again, this thread
+	 * flushes its own here */
+	churn();
+	CHECK(os_atomic_load_long(&allocators[0].blocks) == 0);
+
+	/* the worker's cache of the second allocator was flushed when the
+	 * thread exited */
+	base_set_allocator(&defaults);
+	bfree(bmalloc(16));
+	CHECK(os_atomic_load_long(&allocators[1].blocks) == 0);
+
+	os_event_destroy(w.filled);
+	os_event_destroy(w.switched);
+}
+
+static void test_arena(void)
+{
+	bmem_arena_t *arena = bmem_arena_create(256);
+	bmem_arena_mark_t outer, inner;
+	uint8_t *kept, *first, *ptr;
+
+	kept = bmem_arena_alloc(arena, 100);
+	fill(kept, 100, 1);
+
+	outer = bmem_arena_mark(arena);
+	first = bmem_arena_alloc(arena, 16);
+	bmem_arena_release(arena, outer);
+	CHECK(bmem_arena_alloc(arena, 16) == first);
+	bmem_arena_release(arena, outer);
+
+	/* nested marks, with allocations spilling into more blocks */
+	for (int round = 0; round < 4; round++) {
+		ptr = bmem_arena_alloc(arena, 16);
+		CHECK(ptr == first);
+
+		inner = bmem_arena_mark(arena);
+		for (size_t i = 0; i < 20; i++) {
+			ptr = bmem_arena_alloc(arena, 100);
+			CHECK(((uintptr_t)ptr % 16) == 0);
+			fill(ptr, 100, (uint8_t)i);
+		}
+		bmem_arena_release(arena, inner);
+		CHECK(bmem_arena_alloc(arena, 16) == first + 16);
+
+		bmem_arena_release(arena, outer);
+	}
+
+	CHECK(check_fill(kept, 100, 1));
+
+	/* releasing a mark taken before anything was allocated resets */
+	bmem_arena_reset(arena);
+	outer = bmem_arena_mark(arena);
+	CHECK(bmem_arena_alloc(arena, 16) == kept);
+	bmem_arena_release(arena, outer);
+	CHECK(bmem_arena_alloc(arena, 16) == kept);
+
+	bmem_arena_destroy(arena);
+}
+
+int main(void)
+{
+	long start_allocs = bnum_allocs();
+
+	allocators[0].funcs = (struct base_allocator){
+		malloc_0, realloc_0, free_0};
+	allocators[1].funcs = (struct base_allocator){
+		malloc_1, realloc_1, free_1};
+
+	test_alignment();
+	test_realloc();
+	test_stats();
+	test_set_allocator();
+	test_arena();
+
+	/* and again with blocks that move between alignments */
+	base_set_allocator(&allocators[0].funcs);
+	test_alignment();
+	test_realloc();
+	test_stats();
+	base_set_allocator(&(struct base_allocator){malloc, realloc, free});
+	bfree(bmalloc(16));
+	CHECK(os_atomic_load_long(&allocators[0].blocks) == 0);
+
+	CHECK(bnum_allocs() == start_allocs);
+
+	printf("%s\n", failures ? "FAIL" : "PASS");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,475 @@
+/*
+ * Dynamic bitrate test.  Drives the dynamic bitrate controller of an output
+ * with a fake clock and a fake output that reports whatever congestion,
+ * throughput and dropped frames the test asks for, and checks that:
+ *
+ *  - congestion lowers the bitrate, at most once per decrease interval,
+ *    and never below the floor
+ *  - a connection measurably slower than the stream drops the bitrate
+ *    straight to what it can carry
+ *  - newly dropped frames count as congestion
+ *  - congestion between the two thresholds neither lowers nor raises the
+ *    bitrate (hysteresis)
+ *  - the bitrate is only raised once the connection has been clear for the
+ *    recovery delay, in steps, and never above the ceiling
+ *  - the original bitrate is restored when the output stops
+ *  - dynamic bitrate turns itself off when the encoder becomes shared
+ *
+ * Exits with 0 on success, 1 on failure.
+ *
+ *   dynamic-bitrate-test [--verbose]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the controller is built in to the test so that it runs on the fake clock
+ * instead of the real one */
+#define os_gettime_ns test_gettime_ns
+#include "../../libobs/obs-output-bitrate.c"
+#undef os_gettime_ns
+
+#include <util/base.h>
+
+#define SECOND_NS           1000000000ULL
+#define START_KBPS          4000
+#define FLOOR_KBPS          (START_KBPS / DBR_DEFAULT_FLOOR_DIVISOR)
+
+static struct {
+	bool                 verbose;
+	uint64_t             now;
+	int                  failed;
+
+	float                congestion;
+	uint32_t             throughput_kbps;
+	uint64_t             total_bytes;
+	int                  dropped;
+} test;
+
+uint64_t test_gettime_ns(void)
+{
+	return test.now;
+}
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	UNUSED_PARAMETER(param);
+
+	if (test.verbose || log_level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fprintf(stderr, "\n");
+	}
+}
+
+static void check(bool success, const char *what)
+{
+	if (!success) {
+		printf("FAIL: %s\n", what);
+		test.failed = 1;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* video encoder that only needs to be able to change its bitrate */
+
+static const char *test_encoder_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "dynamic bitrate test encoder";
+}
+
+static void *test_encoder_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	UNUSED_PARAMETER(settings);
+	return encoder;
+}
+
+static void test_encoder_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static bool test_encoder_encode(void *data, struct encoder_frame *frame,
+		struct encoder_packet *packet, bool *received_packet)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(frame);
+	UNUSED_PARAMETER(packet);
+	*received_packet = false;
+	return true;
+}
+
+static struct obs_encoder_info test_encoder = {
+	.id             = "dynamic_bitrate_test",
+	.type           = OBS_ENCODER_VIDEO,
+	.codec          = "test",
+	.caps           = OBS_ENCODER_CAP_DYN_BITRATE,
+	.get_name       = test_encoder_getname,
+	.create         = test_encoder_create,
+	.destroy        = test_encoder_destroy,
+	.encode         = test_encoder_encode
+};
+
+/* ------------------------------------------------------------------------- */
+/* output that reports the congestion and throughput set by the test */
+
+static const char *test_output_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "dynamic bitrate test output";
+}
+
+static void *test_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	UNUSED_PARAMETER(settings);
+	return output;
+}
+
+static void test_output_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static bool test_output_start(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return false;
+}
+
+static void test_output_stop(void *data, uint64_t ts)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(ts);
+}
+
+static void test_output_packet(void *data, struct encoder_packet *packet)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(packet);
+}
+
+static float test_output_congestion(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return test.congestion;
+}
+
+static uint64_t test_output_total_bytes(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return test.total_bytes;
+}
+
+static int test_output_dropped_frames(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return test.dropped;
+}
+
+static struct obs_output_info test_output = {
+	.id                 = "dynamic_bitrate_test",
+	.flags              = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED,
+	.get_name           = test_output_getname,
+	.create             = test_output_create,
+	.destroy            = test_output_destroy,
+	.start              = test_output_start,
+	.stop               = test_output_stop,
+	.encoded_packet     = test_output_packet,
+	.get_congestion     = test_output_congestion,
+	.get_total_bytes    = test_output_total_bytes,
+	.get_dropped_frames = test_output_dropped_frames
+};
+
+/* ------------------------------------------------------------------------- */
+
+static uint32_t encoder_bitrate(obs_output_t *output)
+{
+	return get_encoder_bitrate(obs_output_get_video_encoder(output));
+}
+
+static uint32_t cur_bitrate(obs_output_t *output)
+{
+	return obs_output_get_dynamic_bitrate(output);
+}
+
+/**
+ * Advance the fake clock by a second, let the connection carry a second
+ * worth of data and run the controller
+ *
+ * @return true if the bitrate was changed
+ */
+static bool tick(obs_output_t *output)
+{
+	uint32_t prev = cur_bitrate(output);
+
+	test.now         += SECOND_NS;
+	test.total_bytes += (uint64_t)test.throughput_kbps * 1000 / 8;
+
+	obs_output_dbr_update(output);
+
+	if (test.verbose)
+		printf("%3"PRIu64" s: congestion %.2f, %"PRIu32" kbps\n",
+				(uint64_t)(test.now / SECOND_NS),
+				test.congestion, cur_bitrate(output));
+
+	return cur_bitrate(output) != prev;
+}
+
+static void reset(obs_output_t *output)
+{
+	obs_data_t *settings = obs_data_create();
+
+	obs_output_dbr_stop(output);
+
+	obs_data_set_int(settings, "bitrate", START_KBPS);
+	obs_encoder_update(obs_output_get_video_encoder(output), settings);
+	obs_data_release(settings);
+
+	test.congestion      = 0.0f;
+	test.throughput_kbps = START_KBPS;
+	test.dropped         = 0;
+
+	obs_output_dbr_start(output);
+}
+
+static void test_decrease(obs_output_t *output)
+{
+	uint64_t last_change = test.now;
+	uint32_t prev = START_KBPS;
+
+	reset(output);
+	check(output->dbr_active, "dynamic bitrate is not active");
+	check(cur_bitrate(output) == START_KBPS,
+			"the starting bitrate is not the encoder's bitrate");
+
+	test.congestion = 0.8f;
+
+	for (int i = 0; i < 30; i++) {
+		if (!tick(output))
+			continue;
+
+		check(test.now - last_change >= DBR_DECREASE_INTERVAL_NS,
+				"lowered more than once per decrease interval");
+		check(cur_bitrate(output) < prev,
+				"congestion raised the bitrate");
+		check(cur_bitrate(output) >= prev * DBR_DECREASE_FACTOR - 1,
+				"lowered by more than the decrease factor");
+
+		last_change = test.now;
+		prev = cur_bitrate(output);
+	}
+
+	check(cur_bitrate(output) == FLOOR_KBPS,
+			"the bitrate did not end up at the floor");
+	check(encoder_bitrate(output) == FLOOR_KBPS,
+			"the encoder did not get the lowered bitrate");
+}
+
+static void test_throughput(obs_output_t *output)
+{
+	reset(output);
+
+	test.congestion      = 0.8f;
+	test.throughput_kbps = 2000;
+
+	tick(output);
+	tick(output);
+
+	check(cur_bitrate(output) ==
+			(uint32_t)(2000 * DBR_THROUGHPUT_FACTOR),
+			"did not drop to what the connection can carry");
+}
+
+static void test_dropped_frames(obs_output_t *output)
+{
+	reset(output);
+
+	tick(output);
+	tick(output);
+	check(cur_bitrate(output) == START_KBPS,
+			"lowered without congestion");
+
+	test.dropped += 10;
+	tick(output);
+	check(cur_bitrate(output) < START_KBPS,
+			"dropped frames did not lower the bitrate");
+}
+
+static void test_hysteresis(obs_output_t *output)
+{
+	uint32_t lowered;
+
+	reset(output);
+
+	test.congestion = 0.8f;
+	tick(output);
+	tick(output);
+	lowered = cur_bitrate(output);
+	check(lowered < START_KBPS, "congestion did not lower the bitrate");
+
+	/* between the thresholds: not congested enough to lower further,
+	 * not clear enough to recover */
+	test.congestion = (DBR_CONGESTED + DBR_CLEAR) / 2.0f;
+	for (int i = 0; i < 30; i++)
+		tick(output);
+
+	check(cur_bitrate(output) == lowered,
+			"the bitrate changed between the thresholds");
+}
+
+static void test_recovery(obs_output_t *output)
+{
+	uint64_t clear_since;
+	uint64_t last_change;
+	uint32_t step = START_KBPS * DBR_RECOVER_STEP;
+	uint32_t prev;
+
+	reset(output);
+
+	test.congestion = 0.8f;
+	for (int i = 0; i < 30; i++)
+		tick(output);
+	check(cur_bitrate(output) == FLOOR_KBPS,
+			"the bitrate did not end up at the floor");
+
+	test.congestion = 0.0f;
+	clear_since = test.now;
+	last_change = test.now;
+	prev = cur_bitrate(output);
+
+	for (int i = 0; i < 600; i++) {
+		if (!tick(output))
+			continue;
+
+		check(test.now - clear_since >= DBR_RECOVER_DELAY_NS,
+				"raised before the recovery delay");
+		check(test.now - last_change >= DBR_RECOVER_INTERVAL_NS,
+				"raised more than once per recovery interval");
+		check(cur_bitrate(output) > prev,
+				"a clear connection lowered the bitrate");
+		check(cur_bitrate(output) - prev <= step,
+				"raised by more than a step");
+
+		last_change = test.now;
+		prev = cur_bitrate(output);
+	}
+
+	check(cur_bitrate(output) == START_KBPS,
+			"the bitrate did not recover to the ceiling");
+
+	/* congestion above the clear threshold restarts the recovery delay */
+	test.congestion = 0.8f;
+	tick(output);
+	tick(output);
+	prev = cur_bitrate(output);
+
+	test.congestion = 0.0f;
+	for (int i = 0; i < (int)(DBR_RECOVER_DELAY_NS / SECOND_NS) - 1; i++)
+		tick(output);
+	check(cur_bitrate(output) == prev,
+			"raised before the recovery delay after congestion");
+}
+
+static void test_stop(obs_output_t *output)
+{
+	reset(output);
+
+	test.congestion = 0.8f;
+	tick(output);
+	tick(output);
+	check(encoder_bitrate(output) < START_KBPS,
+			"congestion did not lower the bitrate");
+
+	obs_output_dbr_stop(output);
+	check(encoder_bitrate(output) == START_KBPS,
+			"the original bitrate was not restored on stop");
+	check(cur_bitrate(output) == 0,
+			"dynamic bitrate still reports a bitrate after stop");
+}
+
+static void test_shared(obs_output_t *output, obs_output_t *other)
+{
+	reset(output);
+
+	obs_output_set_video_encoder(other,
+			obs_output_get_video_encoder(output));
+
+	test.congestion = 0.8f;
+	tick(output);
+	tick(output);
+
+	check(!output->dbr_active,
+			"dynamic bitrate stayed on with a shared encoder");
+	check(encoder_bitrate(output) == START_KBPS,
+			"lowered the bitrate of a shared encoder");
+
+	obs_output_set_video_encoder(other, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	obs_output_t  *output = NULL;
+	obs_output_t  *other = NULL;
+	obs_encoder_t *encoder = NULL;
+	obs_data_t    *settings;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--verbose") == 0) {
+			test.verbose = true;
+		} else {
+			printf("usage: %s [--verbose]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	base_set_log_handler(do_log, NULL);
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		printf("FAIL: couldn't start obs\n");
+		return 1;
+	}
+
+	obs_register_encoder(&test_encoder);
+	obs_register_output(&test_output);
+
+	settings = obs_data_create();
+	obs_data_set_int(settings, "bitrate", START_KBPS);
+	encoder = obs_video_encoder_create("dynamic_bitrate_test", "video",
+			settings, NULL);
+	obs_data_release(settings);
+
+	output = obs_output_create("dynamic_bitrate_test", "stream", NULL,
+			NULL);
+	other = obs_output_create("dynamic_bitrate_test", "recording", NULL,
+			NULL);
+
+	if (!encoder || !output || !other) {
+		printf("FAIL: couldn't create the encoder and outputs\n");
+		test.failed = 1;
+		goto done;
+	}
+
+	obs_output_set_video_encoder(output, encoder);
+	obs_output_set_dynamic_bitrate(output, true, 0, 0);
+
+	test.now = SECOND_NS;
+
+	test_decrease(output);
+	test_throughput(output);
+	test_dropped_frames(output);
+	test_hysteresis(output);
+	test_recovery(output);
+	test_stop(output);
+	test_shared(output, other);
+
+done:
+	obs_output_release(other);
+	obs_output_release(output);
+	obs_encoder_release(encoder);
+	obs_shutdown();
+
+	if (!test.failed)
+		printf("PASS\n");
+	return test.failed;
+}
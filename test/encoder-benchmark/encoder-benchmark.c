@@ -0,0 +1,721 @@
+/*
+ * Headless encoder benchmark.  Feeds deterministic synthetic video or audio
+ * into any registered encoder without a graphics context or scene, and prints
+ * encode speed, per-packet latency percentiles, CPU usage and output bitrate
+ * as JSON.
+ *
+ *   encoder-benchmark [options] <encoder id>
+ *
+ *   --list                   list the available encoders and exit
+ *   --module-path <bin> <data>
+ *                            additional module search path (repeatable)
+ *   --settings <json>        encoder settings, e.g. '{"preset":"veryfast"}'
+ *   --width <n>              video width (default 1280)
+ *   --height <n>             video height (default 720)
+ *   --fps <num>[/<den>]      video frame rate (default 30)
+ *   --format <i420|nv12|i444>
+ *                            video format (default nv12)
+ *   --frames <n>             number of video frames (default 600)
+ *   --seconds <n>            audio duration in seconds (default 10)
+ *   --realtime               submit video frames at the frame rate instead of
+ *                            as fast as the encoder accepts them
+ *   --threaded               encode video on the encoder's own thread
+ *   --output <file>          write the JSON report to a file
+ *   --verbose                show libobs log output
+ *
+ * Audio is always produced in real time by the audio output thread, so audio
+ * runs are mainly useful for CPU usage and latency.
+ *
+ * x264-presets.py runs this for each x264 preset and compares the results
+ * against a saved baseline to catch regressions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <media-io/video-io.h>
+#include <media-io/video-frame.h>
+#include <media-io/audio-io.h>
+#include <obs.h>
+
+#define VIDEO_CACHE_SIZE    6
+#define IDLE_TIMEOUT_NS     2000000000ULL
+#define SAMPLE_RATE         48000
+#define TONE_HZ             440.0
+
+struct benchmark {
+	/* options */
+	const char           *encoder_id;
+	obs_data_t           *settings;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             fps_num;
+	uint32_t             fps_den;
+	enum video_format    format;
+	uint32_t             frames;
+	uint32_t             seconds;
+	bool                 realtime;
+	bool                 threaded;
+	const char           *output_file;
+	bool                 verbose;
+
+	enum obs_encoder_type type;
+	video_t              *video;
+	audio_t              *audio;
+	obs_encoder_t        *encoder;
+	obs_output_t         *output;
+
+	/* time each video frame was submitted, indexed by frame */
+	uint64_t             *submit_ts;
+	volatile long        frames_consumed;
+	uint64_t             audio_samples;
+
+	pthread_mutex_t      mutex;
+	DARRAY(uint64_t)     latencies;
+	uint64_t             packets;
+	uint64_t             bytes;
+	uint64_t             first_submit_ts;
+	volatile uint64_t    last_packet_ts;
+};
+
+/* ------------------------------------------------------------------------- */
+/* benchmark output: receives the encoded packets and records statistics */
+
+static const char *bench_output_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Encoder benchmark output";
+}
+
+static void *bench_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	UNUSED_PARAMETER(settings);
+	return output;
+}
+
+static void bench_output_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static bool bench_output_start(void *data)
+{
+	obs_output_t *output = data;
+
+	if (!obs_output_can_begin_data_capture(output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(output, 0))
+		return false;
+
+	return obs_output_begin_data_capture(output, 0);
+}
+
+static void bench_output_stop(void *data, uint64_t ts)
+{
+	obs_output_end_data_capture(data);
+	UNUSED_PARAMETER(ts);
+}
+
+static void bench_output_packet(void *data, struct encoder_packet *packet)
+{
+	obs_output_t *output = data;
+	struct benchmark *bench = obs_output_get_type_data(output);
+	uint64_t now = os_gettime_ns();
+	uint64_t submitted = 0;
+
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		int64_t idx = packet->pts / packet->timebase_num;
+		if (idx >= 0 && idx < (int64_t)bench->frames)
+			submitted = bench->submit_ts[idx];
+	} else {
+		/* audio packets are timestamped with the system time of their
+		 * first sample, so audio latency includes the time it takes
+		 * to gather a full encoder frame */
+		submitted = (uint64_t)packet->dts_usec * 1000;
+	}
+
+	pthread_mutex_lock(&bench->mutex);
+
+	if (submitted && submitted <= now) {
+		uint64_t latency = now - submitted;
+		da_push_back(bench->latencies, &latency);
+	}
+
+	bench->packets++;
+	bench->bytes += packet->size;
+
+	pthread_mutex_unlock(&bench->mutex);
+
+	bench->last_packet_ts = now;
+}
+
+static struct obs_output_info bench_video_output = {
+	.id             = "encoder_benchmark_video",
+	.flags          = OBS_OUTPUT_VIDEO | OBS_OUTPUT_ENCODED,
+	.get_name       = bench_output_getname,
+	.create         = bench_output_create,
+	.destroy        = bench_output_destroy,
+	.start          = bench_output_start,
+	.stop           = bench_output_stop,
+	.encoded_packet = bench_output_packet
+};
+
+static struct obs_output_info bench_audio_output = {
+	.id             = "encoder_benchmark_audio",
+	.flags          = OBS_OUTPUT_AUDIO | OBS_OUTPUT_ENCODED,
+	.get_name       = bench_output_getname,
+	.create         = bench_output_create,
+	.destroy        = bench_output_destroy,
+	.start          = bench_output_start,
+	.stop           = bench_output_stop,
+	.encoded_packet = bench_output_packet
+};
+
+/* ------------------------------------------------------------------------- */
+/* synthetic media */
+
+static void fill_plane(uint8_t *data, uint32_t linesize, uint32_t cx,
+		uint32_t cy, uint32_t frame, uint32_t seed)
+{
+	/* diagonal gradient that scrolls each frame, plus a moving box so
+	 * that motion estimation has something to do */
+	uint32_t box_size = cx / 8;
+	uint32_t box_x = (frame * 4) % (cx - box_size + 1);
+	uint32_t box_y = (frame * 2) % (cy - box_size + 1);
+
+	for (uint32_t y = 0; y < cy; y++) {
+		uint8_t *line = data + y * linesize;
+
+		for (uint32_t x = 0; x < cx; x++)
+			line[x] = (uint8_t)(x + y * seed + frame * 3);
+
+		if (y >= box_y && y < box_y + box_size)
+			memset(line + box_x, (int)(seed * 60), box_size);
+	}
+}
+
+static void fill_frame(struct benchmark *bench, struct video_frame *frame,
+		uint32_t idx)
+{
+	uint32_t cx = bench->width;
+	uint32_t cy = bench->height;
+
+	fill_plane(frame->data[0], frame->linesize[0], cx, cy, idx, 1);
+
+	switch (bench->format) {
+	case VIDEO_FORMAT_I420:
+		fill_plane(frame->data[1], frame->linesize[1],
+				cx / 2, cy / 2, idx, 2);
+		fill_plane(frame->data[2], frame->linesize[2],
+				cx / 2, cy / 2, idx, 3);
+		break;
+	case VIDEO_FORMAT_NV12:
+		fill_plane(frame->data[1], frame->linesize[1],
+				cx, cy / 2, idx, 2);
+		break;
+	case VIDEO_FORMAT_I444:
+		fill_plane(frame->data[1], frame->linesize[1],
+				cx, cy, idx, 2);
+		fill_plane(frame->data[2], frame->linesize[2],
+				cx, cy, idx, 3);
+		break;
+	default:;
+	}
+}
+
+static void frame_consumed(void *param, struct video_data *frame)
+{
+	struct benchmark *bench = param;
+	os_atomic_inc_long(&bench->frames_consumed);
+	UNUSED_PARAMETER(frame);
+}
+
+static bool audio_input(void *param, uint64_t start_ts, uint64_t end_ts,
+		uint64_t *new_ts, uint32_t active_mixers,
+		struct audio_output_data *mixes)
+{
+	struct benchmark *bench = param;
+
+	for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++) {
+		double t = (double)(bench->audio_samples + i) / SAMPLE_RATE;
+		float val = (float)(sin(2.0 * M_PI * TONE_HZ * t) * 0.5);
+
+		mixes[0].data[0][i] = val;
+		mixes[0].data[1][i] = val;
+	}
+
+	bench->audio_samples += AUDIO_OUTPUT_FRAMES;
+	*new_ts = start_ts;
+
+	UNUSED_PARAMETER(end_ts);
+	UNUSED_PARAMETER(active_mixers);
+	return true;
+}
+
+static bool open_media(struct benchmark *bench)
+{
+	if (bench->type == OBS_ENCODER_VIDEO) {
+		struct video_output_info vi = {
+			.name       = "benchmark",
+			.format     = bench->format,
+			.fps_num    = bench->fps_num,
+			.fps_den    = bench->fps_den,
+			.width      = bench->width,
+			.height     = bench->height,
+			.range      = VIDEO_RANGE_PARTIAL,
+			.colorspace = VIDEO_CS_709,
+			.cache_size = VIDEO_CACHE_SIZE
+		};
+
+		return video_output_open(&bench->video, &vi) ==
+			VIDEO_OUTPUT_SUCCESS;
+	} else {
+		struct audio_output_info ai = {
+			.name            = "benchmark",
+			.samples_per_sec = SAMPLE_RATE,
+			.format          = AUDIO_FORMAT_FLOAT_PLANAR,
+			.speakers        = SPEAKERS_STEREO,
+			.input_callback  = audio_input,
+			.input_param     = bench
+		};
+
+		return audio_output_open(&bench->audio, &ai) ==
+			AUDIO_OUTPUT_SUCCESS;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* running */
+
+static void submit_frames(struct benchmark *bench)
+{
+	uint64_t interval = video_output_get_frame_time(bench->video);
+	uint64_t start = os_gettime_ns();
+
+	bench->first_submit_ts = start;
+
+	for (uint32_t i = 0; i < bench->frames; i++) {
+		struct video_frame frame;
+
+		if (bench->realtime)
+			os_sleepto_ns(start + interval * i);
+
+		/* never let the video output cache overflow, it would
+		 * duplicate frames instead of queueing them */
+		while ((long)i - os_atomic_load_long(&bench->frames_consumed) >=
+				VIDEO_CACHE_SIZE - 1)
+			os_sleep_ms(0);
+
+		if (!video_output_lock_frame(bench->video, &frame, 1,
+					start + interval * i))
+			continue;
+
+		fill_frame(bench, &frame, i);
+		bench->submit_ts[i] = os_gettime_ns();
+		video_output_unlock_frame(bench->video);
+	}
+
+	/* wait for delayed packets, some encoders hold back frames until
+	 * they are flushed, so give up once packets stop arriving */
+	while (bench->packets < bench->frames) {
+		uint64_t last = bench->last_packet_ts;
+		uint64_t now = os_gettime_ns();
+
+		if (now - (last ? last : start) > IDLE_TIMEOUT_NS)
+			break;
+
+		os_sleep_ms(10);
+	}
+}
+
+static bool run(struct benchmark *bench)
+{
+	obs_data_t *enc_settings = bench->settings;
+	const char *output_id;
+
+	if (!open_media(bench)) {
+		fprintf(stderr, "failed to open synthetic media\n");
+		return false;
+	}
+
+	if (bench->type == OBS_ENCODER_VIDEO) {
+		bench->encoder = obs_video_encoder_create(bench->encoder_id,
+				"benchmark", enc_settings, NULL);
+		output_id = bench_video_output.id;
+	} else {
+		bench->encoder = obs_audio_encoder_create(bench->encoder_id,
+				"benchmark", enc_settings, 0, NULL);
+		output_id = bench_audio_output.id;
+	}
+
+	if (!bench->encoder) {
+		fprintf(stderr, "failed to create encoder '%s'\n",
+				bench->encoder_id);
+		return false;
+	}
+
+	bench->output = obs_output_create(output_id, "benchmark", NULL, NULL);
+	if (!bench->output)
+		return false;
+
+	obs_output_set_media(bench->output, bench->video, bench->audio);
+
+	if (bench->type == OBS_ENCODER_VIDEO) {
+		obs_encoder_set_video(bench->encoder, bench->video);
+		if (bench->threaded)
+			obs_encoder_set_threaded(bench->encoder, true, 0,
+					OBS_ENCODER_QUEUE_BLOCK);
+		obs_output_set_video_encoder(bench->output, bench->encoder);
+	} else {
+		obs_encoder_set_audio(bench->encoder, bench->audio);
+		obs_output_set_audio_encoder(bench->output, bench->encoder, 0);
+	}
+
+	if (!obs_output_start(bench->output)) {
+		fprintf(stderr, "failed to start encoder '%s'\n",
+				bench->encoder_id);
+		return false;
+	}
+
+	if (bench->type == OBS_ENCODER_VIDEO) {
+		/* connected after the encoder, so it is called once the
+		 * encoder has taken the frame */
+		video_output_connect(bench->video, NULL, frame_consumed,
+				bench);
+		submit_frames(bench);
+		video_output_disconnect(bench->video, frame_consumed, bench);
+	} else {
+		bench->first_submit_ts = os_gettime_ns();
+		os_sleep_ms(bench->seconds * 1000);
+	}
+
+	obs_output_stop(bench->output);
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* report */
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t val_a = *(const uint64_t*)a;
+	uint64_t val_b = *(const uint64_t*)b;
+	return val_a < val_b ? -1 : (val_a > val_b ? 1 : 0);
+}
+
+static inline double ns_to_ms(uint64_t ns)
+{
+	return (double)ns / 1000000.0;
+}
+
+static double percentile(struct benchmark *bench, double pct)
+{
+	size_t idx;
+
+	if (!bench->latencies.num)
+		return 0.0;
+
+	idx = (size_t)(pct / 100.0 * (double)(bench->latencies.num - 1) + 0.5);
+	return ns_to_ms(bench->latencies.array[idx]);
+}
+
+static obs_data_t *make_latency_report(struct benchmark *bench)
+{
+	obs_data_t *latency = obs_data_create();
+	uint64_t total = 0;
+
+	qsort(bench->latencies.array, bench->latencies.num, sizeof(uint64_t),
+			cmp_u64);
+
+	for (size_t i = 0; i < bench->latencies.num; i++)
+		total += bench->latencies.array[i];
+
+	obs_data_set_double(latency, "min", percentile(bench, 0.0));
+	obs_data_set_double(latency, "p50", percentile(bench, 50.0));
+	obs_data_set_double(latency, "p90", percentile(bench, 90.0));
+	obs_data_set_double(latency, "p99", percentile(bench, 99.0));
+	obs_data_set_double(latency, "max", percentile(bench, 100.0));
+	obs_data_set_double(latency, "mean", bench->latencies.num ?
+			ns_to_ms(total / bench->latencies.num) : 0.0);
+	return latency;
+}
+
+static obs_data_t *make_report(struct benchmark *bench, uint64_t wall_ns,
+		double cpu_usage, uint64_t cpu_interval_ns)
+{
+	obs_data_t *report = obs_data_create();
+	obs_data_t *latency = make_latency_report(bench);
+	obs_data_t *settings = obs_encoder_get_settings(bench->encoder);
+	double wall_sec = (double)wall_ns / 1000000000.0;
+	double media_sec;
+
+	obs_data_set_string(report, "encoder", bench->encoder_id);
+	obs_data_set_string(report, "codec",
+			obs_encoder_get_codec(bench->encoder));
+	obs_data_set_obj(report, "settings", settings);
+
+	if (bench->type == OBS_ENCODER_VIDEO) {
+		media_sec = (double)bench->frames *
+			(double)bench->fps_den / (double)bench->fps_num;
+
+		obs_data_set_string(report, "type", "video");
+		obs_data_set_int(report, "width", bench->width);
+		obs_data_set_int(report, "height", bench->height);
+		obs_data_set_int(report, "fps_num", bench->fps_num);
+		obs_data_set_int(report, "fps_den", bench->fps_den);
+		obs_data_set_string(report, "format",
+				get_video_format_name(bench->format));
+		obs_data_set_bool(report, "realtime", bench->realtime);
+		obs_data_set_bool(report, "threaded", bench->threaded);
+		obs_data_set_int(report, "frames_submitted", bench->frames);
+		obs_data_set_int(report, "frames_encoded", bench->packets);
+		obs_data_set_int(report, "frames_skipped",
+				video_output_get_skipped_frames(bench->video));
+		obs_data_set_double(report, "encode_fps", wall_sec > 0.0 ?
+				(double)bench->packets / wall_sec : 0.0);
+	} else {
+		media_sec = (double)bench->seconds;
+
+		obs_data_set_string(report, "type", "audio");
+		obs_data_set_int(report, "sample_rate", SAMPLE_RATE);
+		obs_data_set_int(report, "packets", bench->packets);
+	}
+
+	obs_data_set_double(report, "wall_time_ms", ns_to_ms(wall_ns));
+	obs_data_set_obj(report, "latency_ms", latency);
+	obs_data_set_double(report, "cpu_usage_percent", cpu_usage);
+	/* the usage is averaged over all cores and over the whole run, not
+	 * just the time packets were arriving */
+	obs_data_set_double(report, "cpu_time_sec", cpu_usage / 100.0 *
+			(double)cpu_interval_ns / 1000000000.0 *
+			(double)os_get_logical_cores());
+	obs_data_set_int(report, "bytes", bench->bytes);
+	obs_data_set_double(report, "bitrate_kbps", media_sec > 0.0 ?
+			(double)bench->bytes * 8.0 / 1000.0 / media_sec : 0.0);
+
+	obs_data_release(latency);
+	obs_data_release(settings);
+	return report;
+}
+
+/* ------------------------------------------------------------------------- */
+/* setup */
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	struct benchmark *bench = param;
+
+	if (bench->verbose || log_level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fprintf(stderr, "\n");
+	}
+}
+
+static bool parse_format(const char *name, enum video_format *format)
+{
+	if (astrcmpi(name, "i420") == 0)
+		*format = VIDEO_FORMAT_I420;
+	else if (astrcmpi(name, "nv12") == 0)
+		*format = VIDEO_FORMAT_NV12;
+	else if (astrcmpi(name, "i444") == 0)
+		*format = VIDEO_FORMAT_I444;
+	else
+		return false;
+
+	return true;
+}
+
+static void list_encoders(void)
+{
+	const char *id;
+
+	for (size_t i = 0; obs_enum_encoder_types(i, &id); i++)
+		printf("%-24s %s\n", id, obs_get_encoder_type(id) ==
+				OBS_ENCODER_VIDEO ? "video" : "audio");
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [--list] [--module-path <bin> <data>] "
+	       "[--settings <json>]\n"
+	       "       [--width <n>] [--height <n>] [--fps <num>[/<den>]] "
+	       "[--format <i420|nv12|i444>]\n"
+	       "       [--frames <n>] [--seconds <n>] [--realtime] "
+	       "[--threaded]\n"
+	       "       [--output <file>] [--verbose] <encoder id>\n", name);
+}
+
+static bool parse_args(struct benchmark *bench, int argc, char *argv[],
+		bool *list)
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		bool has_val = i + 1 < argc;
+
+		if (strcmp(arg, "--list") == 0) {
+			*list = true;
+		} else if (strcmp(arg, "--realtime") == 0) {
+			bench->realtime = true;
+		} else if (strcmp(arg, "--threaded") == 0) {
+			bench->threaded = true;
+		} else if (strcmp(arg, "--verbose") == 0) {
+			bench->verbose = true;
+		} else if (strcmp(arg, "--module-path") == 0 && i + 2 < argc) {
+			obs_add_module_path(argv[i + 1], argv[i + 2]);
+			i += 2;
+		} else if (strcmp(arg, "--settings") == 0 && has_val) {
+			obs_data_release(bench->settings);
+			bench->settings = obs_data_create_from_json(argv[++i]);
+			if (!bench->settings)
+				return false;
+		} else if (strcmp(arg, "--width") == 0 && has_val) {
+			bench->width = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(arg, "--height") == 0 && has_val) {
+			bench->height = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(arg, "--fps") == 0 && has_val) {
+			char *end;
+			bench->fps_num = (uint32_t)strtoul(argv[++i], &end,
+					10);
+			bench->fps_den = *end == '/' ?
+				(uint32_t)strtoul(end + 1, NULL, 10) : 1;
+		} else if (strcmp(arg, "--format") == 0 && has_val) {
+			if (!parse_format(argv[++i], &bench->format))
+				return false;
+		} else if (strcmp(arg, "--frames") == 0 && has_val) {
+			bench->frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(arg, "--seconds") == 0 && has_val) {
+			bench->seconds = (uint32_t)strtoul(argv[++i], NULL,
+					10);
+		} else if (strcmp(arg, "--output") == 0 && has_val) {
+			bench->output_file = argv[++i];
+		} else if (arg[0] != '-' && !bench->encoder_id) {
+			bench->encoder_id = arg;
+		} else {
+			return false;
+		}
+	}
+
+	return (*list || bench->encoder_id) &&
+		bench->width >= 16 && bench->height >= 16 &&
+		bench->fps_num && bench->fps_den &&
+		bench->frames && bench->seconds;
+}
+
+static void free_benchmark(struct benchmark *bench)
+{
+	obs_output_release(bench->output);
+	obs_encoder_release(bench->encoder);
+	obs_data_release(bench->settings);
+
+	video_output_close(bench->video);
+	audio_output_close(bench->audio);
+
+	da_free(bench->latencies);
+	bfree(bench->submit_ts);
+	pthread_mutex_destroy(&bench->mutex);
+}
+
+int main(int argc, char *argv[])
+{
+	struct benchmark bench = {0};
+	os_cpu_usage_info_t *cpu_info;
+	obs_data_t *report;
+	uint64_t wall_ns;
+	uint64_t cpu_start_ns;
+	uint64_t cpu_interval_ns;
+	double cpu_usage;
+	bool list = false;
+	bool success;
+	int ret = 1;
+
+	bench.width   = 1280;
+	bench.height  = 720;
+	bench.fps_num = 30;
+	bench.fps_den = 1;
+	bench.format  = VIDEO_FORMAT_NV12;
+	bench.frames  = 600;
+	bench.seconds = 10;
+
+	pthread_mutex_init_value(&bench.mutex);
+	base_set_log_handler(do_log, &bench);
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		fprintf(stderr, "failed to initialize libobs\n");
+		return 1;
+	}
+
+	if (pthread_mutex_init(&bench.mutex, NULL) != 0)
+		goto exit;
+
+	if (!parse_args(&bench, argc, argv, &list)) {
+		usage(argv[0]);
+		goto exit;
+	}
+
+	obs_load_all_modules();
+	obs_post_load_modules();
+
+	if (list) {
+		list_encoders();
+		ret = 0;
+		goto exit;
+	}
+
+	bench.type = obs_get_encoder_type(bench.encoder_id);
+	if (!obs_get_encoder_codec(bench.encoder_id)) {
+		fprintf(stderr, "encoder '%s' not found\n", bench.encoder_id);
+		goto exit;
+	}
+
+	bench_video_output.type_data = &bench;
+	bench_audio_output.type_data = &bench;
+	obs_register_output(&bench_video_output);
+	obs_register_output(&bench_audio_output);
+
+	bench.submit_ts = bzalloc(sizeof(uint64_t) * bench.frames);
+
+	cpu_info = os_cpu_usage_info_start();
+	cpu_start_ns = os_gettime_ns();
+	success = run(&bench);
+	cpu_usage = os_cpu_usage_info_query(cpu_info);
+	cpu_interval_ns = os_gettime_ns() - cpu_start_ns;
+	os_cpu_usage_info_destroy(cpu_info);
+
+	if (!success)
+		goto exit;
+
+	wall_ns = bench.last_packet_ts > bench.first_submit_ts ?
+		bench.last_packet_ts - bench.first_submit_ts : 0;
+
+	report = make_report(&bench, wall_ns, cpu_usage, cpu_interval_ns);
+
+	if (bench.output_file) {
+		if (obs_data_save_json(report, bench.output_file))
+			ret = 0;
+		else
+			fprintf(stderr, "failed to write '%s'\n",
+					bench.output_file);
+	} else {
+		printf("%s\n", obs_data_get_json(report));
+		ret = 0;
+	}
+
+	obs_data_release(report);
+
+exit:
+	free_benchmark(&bench);
+	obs_shutdown();
+	return ret;
+}
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+
+"""
+Runs encoder-benchmark with obs_x264 once per preset and tracks the results
+against a baseline, so encoder or libobs changes that slow down a preset or
+change its output size are noticed.
+
+    x264-presets.py [options] <encoder-benchmark binary> [-- <benchmark args>]
+
+Without --baseline the results are only printed (and written with --save).
+With --baseline every preset is compared against the baseline run, and the
+script exits with 1 if any preset got slower, used more CPU time or produced
+a different bitrate than the tolerances allow.
+
+Arguments after -- are passed to every benchmark run, e.g.
+--module-path, --width, --height or --frames.  Compare runs made with the
+same arguments on the same machine only.
+"""
+
+import argparse
+import json
+import subprocess
+import sys
+
+PRESETS = ["ultrafast", "superfast", "veryfast", "faster", "fast", "medium",
+           "slow", "slower", "veryslow", "placebo"]
+
+# metric, what a regression is, default tolerance in percent
+METRICS = [
+    ("encode_fps",    "lower",  10.0),
+    ("cpu_time_sec",  "higher", 10.0),
+    ("bitrate_kbps",  "change",  2.0),
+]
+
+
+def run_preset(binary, preset, rate_control, bitrate, extra_args):
+    settings = {"preset": preset, "rate_control": rate_control}
+    if rate_control == "CBR":
+        settings["bitrate"] = bitrate
+    else:
+        settings["crf"] = 23
+
+    cmd = [binary, "--settings", json.dumps(settings)] + extra_args + \
+          ["obs_x264"]
+    out = subprocess.run(cmd, stdout=subprocess.PIPE, check=True)
+    return json.loads(out.stdout.decode("utf-8"))
+
+
+def compare(preset, result, base, tolerances):
+    failures = []
+
+    for metric, regression, _ in METRICS:
+        old = base.get(metric, 0.0)
+        new = result.get(metric, 0.0)
+        if not old:
+            continue
+
+        change = (new - old) / old * 100.0
+        tolerance = tolerances[metric]
+
+        if regression == "lower":
+            failed = change < -tolerance
+        elif regression == "higher":
+            failed = change > tolerance
+        else:
+            failed = abs(change) > tolerance
+
+        print("  %-14s %12.2f -> %12.2f  %+7.1f%%%s" %
+              (metric, old, new, change, "  REGRESSION" if failed else ""))
+        if failed:
+            failures.append("%s %s" % (preset, metric))
+
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Track obs_x264 preset performance with encoder-benchmark")
+    parser.add_argument("binary", help="path to encoder-benchmark")
+    parser.add_argument("--presets", default=",".join(PRESETS[:6]),
+                        help="comma separated presets to run "
+                             "(default: ultrafast through medium)")
+    parser.add_argument("--rate-control", default="CRF",
+                        choices=["CBR", "CRF"],
+                        help="rate control, CRF makes the bitrate track "
+                             "encoder quality changes (default: CRF)")
+    parser.add_argument("--bitrate", type=int, default=2500,
+                        help="CBR bitrate in kbps (default: 2500)")
+    parser.add_argument("--runs", type=int, default=3,
+                        help="runs per preset, the fastest one is kept "
+                             "(default: 3)")
+    parser.add_argument("--baseline", help="results to compare against")
+    parser.add_argument("--save", help="write the results to this file")
+    for metric, _, tolerance in METRICS:
+        parser.add_argument("--%s-tolerance" % metric.replace("_", "-"),
+                            dest=metric, type=float, default=tolerance,
+                            help="allowed change of %s in percent "
+                                 "(default: %g)" % (metric, tolerance))
+
+    argv = sys.argv[1:]
+    extra_args = []
+    if "--" in argv:
+        idx = argv.index("--")
+        extra_args = argv[idx + 1:]
+        argv = argv[:idx]
+
+    args = parser.parse_args(argv)
+    tolerances = {metric: getattr(args, metric) for metric, _, _ in METRICS}
+
+    baseline = {}
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)["presets"]
+
+    results = {}
+    failures = []
+
+    for preset in args.presets.split(","):
+        runs = [run_preset(args.binary, preset, args.rate_control,
+                           args.bitrate, extra_args)
+                for _ in range(args.runs)]
+        result = max(runs, key=lambda r: r.get("encode_fps", 0.0))
+        results[preset] = result
+
+        print("%-10s %8.1f fps  %8.2f s cpu  %8.0f kbps  p99 %.1f ms" %
+              (preset, result.get("encode_fps", 0.0),
+               result.get("cpu_time_sec", 0.0),
+               result.get("bitrate_kbps", 0.0),
+               result["latency_ms"]["p99"]))
+
+        if preset in baseline:
+            failures += compare(preset, result, baseline[preset],
+                                tolerances)
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump({"args": extra_args,
+                       "rate_control": args.rate_control,
+                       "presets": results}, f, indent=4, sort_keys=True)
+
+    if failures:
+        print("FAIL: " + ", ".join(failures))
+        return 1
+
+    if baseline:
+        print("PASS")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
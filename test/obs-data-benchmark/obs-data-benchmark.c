@@ -0,0 +1,218 @@
+/*
+ * obs_data microbenchmark.  For settings objects with 10, 100 and 10000 keys
+ * it measures:
+ *
+ *  - set: setting every key of an existing object
+ *  - get: looking up every key
+ *  - apply: obs_data_apply of a full copy onto the object
+ *  - grow: setting string values that keep getting longer, so items are
+ *    reallocated and relinked
+ *  - erase: erasing every other key
+ *  - insert: setting the erased keys again, in an order that isn't the name
+ *    order the items are iterated in
+ *
+ * After each step the object is checked: every key has to be found with the
+ * right value, and walking the items has to visit every key once, in order.
+ * Exits with 0 on success, 1 on failure.
+ *
+ *   obs-data-benchmark [--iterations <n>]
+ *
+ *   --iterations <n>   total number of key operations per step and size,
+ *                      default 2000000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/platform.h>
+#include <obs-data.h>
+
+#define GROW_ROUNDS 8
+
+static bool failed = false;
+
+static inline void key_name(char *name, size_t size, int idx)
+{
+	snprintf(name, size, "key_%d", idx);
+}
+
+static void grow_string(char *str, size_t size, int idx, int round)
+{
+	int len = 8 << round;
+
+	if ((size_t)len >= size)
+		len = (int)size - 1;
+
+	memset(str, 'a' + idx % 26, (size_t)len);
+	str[len] = 0;
+}
+
+static void check(obs_data_t *data, int keys, const char *step, int round)
+{
+	obs_data_item_t *item = obs_data_first(data);
+	char prev[64] = "";
+	char name[64];
+	char str[2048];
+	int count = 0;
+
+	for (; item; obs_data_item_next(&item)) {
+		const char *cur = obs_data_item_get_name(item);
+
+		if (count && strcmp(prev, cur) >= 0) {
+			printf("FAIL: %s: '%s' listed after '%s'\n", step, cur,
+					prev);
+			failed = true;
+		}
+
+		snprintf(prev, sizeof(prev), "%s", cur);
+		count++;
+	}
+
+	if (count != keys * 2) {
+		printf("FAIL: %s: %d items listed, expected %d\n", step, count,
+				keys * 2);
+		failed = true;
+	}
+
+	for (int i = 0; i < keys; i++) {
+		key_name(name, sizeof(name), i);
+		if (obs_data_get_int(data, name) != i) {
+			printf("FAIL: %s: wrong value for '%s'\n", step, name);
+			failed = true;
+			return;
+		}
+
+		if (round < 0)
+			continue;
+
+		name[0] = 's';
+		grow_string(str, sizeof(str), i, round);
+		if (strcmp(obs_data_get_string(data, name), str) != 0) {
+			printf("FAIL: %s: wrong string for '%s'\n", step, name);
+			failed = true;
+			return;
+		}
+	}
+}
+
+static void print_result(const char *step, int keys, uint64_t ops,
+		uint64_t elapsed)
+{
+	printf("%6d keys  %-6s %10.1f ns/op\n", keys, step,
+			(double)elapsed / (double)ops);
+}
+
+static void run(int keys, int iterations)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_t *copy = obs_data_create();
+	int rounds = iterations / keys;
+	char name[64];
+	char str[2048];
+	uint64_t start;
+	long long sum = 0;
+
+	if (rounds < 1)
+		rounds = 1;
+
+	/* "key_" and "sey_" names are interleaved in the item list */
+	for (int i = 0; i < keys; i++) {
+		key_name(name, sizeof(name), i);
+		obs_data_set_int(data, name, i);
+		name[0] = 's';
+		obs_data_set_string(data, name, "");
+	}
+
+	start = os_gettime_ns();
+	for (int r = 0; r < rounds; r++) {
+		for (int i = 0; i < keys; i++) {
+			key_name(name, sizeof(name), i);
+			obs_data_set_int(data, name, i);
+		}
+	}
+	print_result("set", keys, (uint64_t)rounds * keys,
+			os_gettime_ns() - start);
+	check(data, keys, "set", -1);
+
+	start = os_gettime_ns();
+	for (int r = 0; r < rounds; r++) {
+		for (int i = 0; i < keys; i++) {
+			key_name(name, sizeof(name), i);
+			sum += obs_data_get_int(data, name);
+		}
+	}
+	print_result("get", keys, (uint64_t)rounds * keys,
+			os_gettime_ns() - start);
+	if (sum != (long long)rounds * keys * (keys - 1) / 2) {
+		printf("FAIL: get: wrong sum\n");
+		failed = true;
+	}
+
+	obs_data_apply(copy, data);
+
+	start = os_gettime_ns();
+	for (int r = 0; r < rounds; r++)
+		obs_data_apply(data, copy);
+	print_result("apply", keys, (uint64_t)rounds * keys * 2,
+			os_gettime_ns() - start);
+	check(data, keys, "apply", -1);
+
+	start = os_gettime_ns();
+	for (int r = 0; r < GROW_ROUNDS; r++) {
+		for (int i = 0; i < keys; i++) {
+			key_name(name, sizeof(name), i);
+			name[0] = 's';
+			grow_string(str, sizeof(str), i, r);
+			obs_data_set_string(data, name, str);
+		}
+	}
+	print_result("grow", keys, (uint64_t)GROW_ROUNDS * keys,
+			os_gettime_ns() - start);
+	check(data, keys, "grow", GROW_ROUNDS - 1);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < keys; i += 2) {
+		key_name(name, sizeof(name), i);
+		obs_data_erase(data, name);
+	}
+	print_result("erase", keys, (uint64_t)(keys + 1) / 2,
+			os_gettime_ns() - start);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < keys; i += 2) {
+		key_name(name, sizeof(name), i);
+		obs_data_set_int(data, name, i);
+	}
+	print_result("insert", keys, (uint64_t)(keys + 1) / 2,
+			os_gettime_ns() - start);
+	check(data, keys, "insert", GROW_ROUNDS - 1);
+
+	obs_data_release(copy);
+	obs_data_release(data);
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = 2000000;
+	static const int sizes[] = {10, 100, 10000};
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+		} else {
+			printf("usage: %s [--iterations <n>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (iterations < 1) {
+		fprintf(stderr, "invalid arguments\n");
+		return 1;
+	}
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		run(sizes[i], iterations);
+
+	return failed ? 1 : 0;
+}
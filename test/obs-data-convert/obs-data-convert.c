@@ -0,0 +1,84 @@
+/*
+ * Converts obs_data files between JSON and the binary container, and prints
+ * file sizes and load times of both formats.
+ *
+ *   obs-data-convert <input> <output>
+ *
+ * Files ending in .json are JSON, anything else is treated as binary.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <obs-data.h>
+
+static bool is_json(const char *path)
+{
+	const char *ext = strrchr(path, '.');
+	return ext && astrcmpi(ext, ".json") == 0;
+}
+
+static obs_data_t *load(const char *path, double *ms)
+{
+	uint64_t start = os_gettime_ns();
+	obs_data_t *data = is_json(path) ?
+		obs_data_create_from_json_file(path) :
+		obs_data_create_from_binary_file(path);
+
+	*ms = (double)(os_gettime_ns() - start) / 1000000.0;
+	return data;
+}
+
+static bool save(obs_data_t *data, const char *path, double *ms)
+{
+	uint64_t start = os_gettime_ns();
+	bool success = is_json(path) ?
+		obs_data_save_json(data, path) :
+		obs_data_save_binary(data, path);
+
+	*ms = (double)(os_gettime_ns() - start) / 1000000.0;
+	return success;
+}
+
+int main(int argc, char *argv[])
+{
+	obs_data_t *data;
+	double load_ms, save_ms, reload_ms;
+
+	if (argc != 3) {
+		printf("usage: %s <input> <output>\n", argv[0]);
+		return 1;
+	}
+
+	data = load(argv[1], &load_ms);
+	if (!data) {
+		printf("failed to load '%s'\n", argv[1]);
+		return 1;
+	}
+
+	if (!save(data, argv[2], &save_ms)) {
+		printf("failed to save '%s'\n", argv[2]);
+		obs_data_release(data);
+		return 1;
+	}
+
+	obs_data_release(data);
+
+	data = load(argv[2], &reload_ms);
+	if (!data) {
+		printf("failed to load '%s' after saving\n", argv[2]);
+		return 1;
+	}
+
+	obs_data_release(data);
+
+	printf("%-8s %12s %12s %12s\n", "", "size", "load", "save");
+	printf("%-8s %12lld %9.1f ms %12s\n", "input",
+			(long long)os_get_file_size(argv[1]), load_ms, "");
+	printf("%-8s %12lld %9.1f ms %9.1f ms\n", "output",
+			(long long)os_get_file_size(argv[2]), reload_ms,
+			save_ms);
+	return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * obs_data JSON benchmark.  Generates a scene collection of about the given
+ * size, then times saving and loading it as JSON and reports the peak
+ * resident set size.  Loading and saving each run in their own process so
+ * the peak RSS of one doesn't hide the other:
+ *
+ *   obs-data-json-benchmark generate <file> [<megabytes>]
+ *   obs-data-json-benchmark load <file>
+ *   obs-data-json-benchmark save <file>
+ *
+ * "generate" writes a collection of about <megabytes> (default 56) MB.
+ * "load" loads the file.  "save" loads the file and then saves it to
+ * <file>.out, and checks that the output is identical to the input.
+ *
+ * On Linux, "save" also checks that saving to /dev/full fails.
+ *
+ * Exits with 0 on success, 1 on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <obs-data.h>
+
+static double peak_rss_mb(void)
+{
+#ifdef _WIN32
+	return 0.0;
+#else
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0.0;
+#ifdef __APPLE__
+	return (double)usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+	return (double)usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+static double ms_since(uint64_t start)
+{
+	return (double)(os_gettime_ns() - start) / 1000000.0;
+}
+
+static void set_point(obs_data_t *data, const char *name, double x, double y)
+{
+	obs_data_t *point = obs_data_create();
+
+	obs_data_set_double(point, "x", x);
+	obs_data_set_double(point, "y", y);
+	obs_data_set_obj(data, name, point);
+	obs_data_release(point);
+}
+
+static obs_data_t *make_source(int idx)
+{
+	obs_data_t *source = obs_data_create();
+	obs_data_t *settings = obs_data_create();
+	obs_data_array_t *items = obs_data_array_create();
+	obs_data_array_t *filters = obs_data_array_create();
+	char name[64];
+
+	snprintf(name, sizeof(name), "Source %d \"\xc3\xa9\xf0\x9f\x8e\xa5\"",
+			idx);
+	obs_data_set_string(source, "name", name);
+	obs_data_set_string(source, "id", idx % 10 ? "image_source" : "scene");
+	obs_data_set_int(source, "flags", 0);
+	obs_data_set_double(source, "volume", 1.0 / (idx % 7 + 1));
+	obs_data_set_bool(source, "muted", (idx & 1) != 0);
+	obs_data_set_int(source, "sync", (long long)idx * 1000003LL);
+
+	obs_data_set_string(settings, "file",
+			"C:\\Users\\streamer\\Pictures\\overlay\tframe.png");
+	obs_data_set_int(settings, "width", 1920);
+	obs_data_set_int(settings, "height", 1080);
+	obs_data_set_double(settings, "opacity", 0.75);
+
+	for (int i = 0; i < 20; i++) {
+		obs_data_t *item = obs_data_create();
+
+		snprintf(name, sizeof(name), "Source %d", (idx * 31 + i) % 5000);
+		obs_data_set_string(item, "name", name);
+		obs_data_set_int(item, "id", i + 1);
+		obs_data_set_bool(item, "visible", true);
+		obs_data_set_double(item, "rot", (double)i * 1.5);
+		set_point(item, "pos", (double)i * 10.0, (double)idx);
+		set_point(item, "scale", 1.0, 1.0);
+		obs_data_set_int(item, "align", 5);
+		obs_data_array_push_back(items, item);
+		obs_data_release(item);
+	}
+
+	for (int i = 0; i < 2; i++) {
+		obs_data_t *filter = obs_data_create();
+		obs_data_t *filter_settings = obs_data_create();
+
+		obs_data_set_string(filter, "name", i ? "Color" : "Crop");
+		obs_data_set_string(filter, "id", i ? "color_filter" :
+				"crop_filter");
+		obs_data_set_int(filter_settings, "left", i * 10);
+		obs_data_set_double(filter_settings, "gamma", -0.125);
+		obs_data_set_obj(filter, "settings", filter_settings);
+		obs_data_array_push_back(filters, filter);
+		obs_data_release(filter_settings);
+		obs_data_release(filter);
+	}
+
+	obs_data_set_array(settings, "items", items);
+	obs_data_set_obj(source, "settings", settings);
+	obs_data_set_array(source, "filters", filters);
+
+	obs_data_array_release(filters);
+	obs_data_array_release(items);
+	obs_data_release(settings);
+	return source;
+}
+
+static bool generate(const char *file, int megabytes)
+{
+	obs_data_t *collection = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+	size_t target = (size_t)megabytes * 1024 * 1024;
+	size_t size;
+	bool success;
+	int count;
+
+	/* size one source at the depth it's saved at to work out how many are
+	 * needed */
+	obs_data_t *source = make_source(0);
+	obs_data_array_push_back(sources, source);
+	obs_data_set_array(collection, "sources", sources);
+	size = strlen(obs_data_get_json(collection));
+	obs_data_array_erase(sources, 0);
+	obs_data_release(source);
+
+	count = (int)(target / (size ? size : 1)) + 1;
+
+	for (int i = 0; i < count; i++) {
+		source = make_source(i);
+		obs_data_array_push_back(sources, source);
+		obs_data_release(source);
+	}
+
+	obs_data_set_string(collection, "name", "Benchmark");
+	obs_data_set_string(collection, "current_scene", "Source 0");
+	obs_data_set_array(collection, "sources", sources);
+
+	success = obs_data_save_json(collection, file);
+	if (success)
+		printf("generated %d sources\n", count);
+	else
+		fprintf(stderr, "Failed to write '%s'\n", file);
+
+	obs_data_array_release(sources);
+	obs_data_release(collection);
+	return success;
+}
+
+static bool load(const char *file)
+{
+	uint64_t start = os_gettime_ns();
+	obs_data_t *data = obs_data_create_from_json_file(file);
+	double ms = ms_since(start);
+
+	if (!data) {
+		fprintf(stderr, "Failed to load '%s'\n", file);
+		return false;
+	}
+
+	printf("load  %10.1f ms  peak rss %8.1f MB\n", ms, peak_rss_mb());
+	obs_data_release(data);
+	return true;
+}
+
+static char *read_file(const char *file)
+{
+	char *text = os_quick_read_utf8_file(file);
+	if (!text)
+		fprintf(stderr, "Failed to read '%s'\n", file);
+	return text;
+}
+
+static bool save(const char *file)
+{
+	obs_data_t *data = obs_data_create_from_json_file(file);
+	struct dstr out_file = {0};
+	char *in_text = NULL;
+	char *out_text = NULL;
+	bool success = false;
+	uint64_t start;
+	double ms;
+
+	if (!data) {
+		fprintf(stderr, "Failed to load '%s'\n", file);
+		return false;
+	}
+
+	dstr_printf(&out_file, "%s.out", file);
+
+	start = os_gettime_ns();
+	if (!obs_data_save_json(data, out_file.array)) {
+		fprintf(stderr, "Failed to save '%s'\n", out_file.array);
+		goto cleanup;
+	}
+	ms = ms_since(start);
+
+	printf("save  %10.1f ms  peak rss %8.1f MB\n", ms, peak_rss_mb());
+
+	in_text  = read_file(file);
+	out_text = read_file(out_file.array);
+	if (!in_text || !out_text)
+		goto cleanup;
+
+	if (strcmp(in_text, out_text) != 0) {
+		printf("FAIL: saved output differs from '%s'\n", file);
+		goto cleanup;
+	}
+
+#ifdef __linux__
+	if (obs_data_save_json(data, "/dev/full")) {
+		printf("FAIL: saving to /dev/full succeeded\n");
+		goto cleanup;
+	}
+#endif
+
+	success = true;
+
+cleanup:
+	if (out_file.array)
+		os_unlink(out_file.array);
+	bfree(in_text);
+	bfree(out_text);
+	dstr_free(&out_file);
+	obs_data_release(data);
+	return success;
+}
+
+int main(int argc, char *argv[])
+{
+	bool success;
+
+	if (argc == 3 || argc == 4) {
+		if (strcmp(argv[1], "generate") == 0) {
+			int megabytes = argc == 4 ? atoi(argv[3]) : 56;
+			success = megabytes > 0 && generate(argv[2], megabytes);
+			return success ? 0 : 1;
+		} else if (argc == 3 && strcmp(argv[1], "load") == 0) {
+			return load(argv[2]) ? 0 : 1;
+		} else if (argc == 3 && strcmp(argv[1], "save") == 0) {
+			return save(argv[2]) ? 0 : 1;
+		}
+	}
+
+	printf("usage: %s generate <file> [<megabytes>]\n"
+	       "       %s load <file>\n"
+	       "       %s save <file>\n", argv[0], argv[0], argv[0]);
+	return 1;
+}
@@ -0,0 +1,300 @@
+/*
+ * Loads a synthetic scene collection and measures how long it takes, then
+ * measures source lookups by name on the loaded collection:
+ *
+ *  - load: obs_load_sources on the collection.  Every scene item is looked
+ *    up by name while its scene loads, so with a linear lookup this grows
+ *    with sources * items
+ *  - index: obs_get_source_by_name, which goes through the name index
+ *  - walk: the same lookups done by walking the source list with
+ *    obs_enum_sources and strcmp, which is what a lookup used to cost
+ *
+ * The collection has the given number of sources spread over scenes with
+ * the given number of items in total.  Every item is checked to be loaded.
+ *
+ *   source-lookup-benchmark [--sources <n>] [--items <n>] [--scenes <n>]
+ *                           [--lookups <n>]
+ *
+ *   --sources <n>   number of (non-scene) sources, default 5000
+ *   --items <n>     total number of scene items, default 12000
+ *   --scenes <n>    number of scenes, default 50
+ *   --lookups <n>   number of lookups through the index, default 1000000.
+ *                   the list walk does a hundredth of that
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <obs.h>
+
+static const char *bench_source_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Benchmark Source";
+}
+
+static void *bench_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void bench_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static uint32_t bench_source_size(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return 16;
+}
+
+static void bench_source_render(void *data, gs_effect_t *effect)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(effect);
+}
+
+static struct obs_source_info bench_source_info = {
+	.id           = "benchmark_source",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name     = bench_source_name,
+	.create       = bench_source_create,
+	.destroy      = bench_source_destroy,
+	.get_width    = bench_source_size,
+	.get_height   = bench_source_size,
+	.video_render = bench_source_render,
+};
+
+static DARRAY(obs_source_t*) loaded;
+
+static void loaded_source(void *param, obs_source_t *source)
+{
+	UNUSED_PARAMETER(param);
+
+	obs_source_addref(source);
+	da_push_back(loaded, &source);
+}
+
+static void do_log(int level, const char *msg, va_list args, void *param)
+{
+	UNUSED_PARAMETER(param);
+
+	if (level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fprintf(stderr, "\n");
+	}
+}
+
+static obs_data_array_t *make_collection(int sources, int items, int scenes)
+{
+	obs_data_array_t *array = obs_data_array_create();
+	char name[64];
+	int item = 0;
+
+	for (int i = 0; i < sources; i++) {
+		obs_data_t *source = obs_data_create();
+
+		snprintf(name, sizeof(name), "Source %d", i);
+		obs_data_set_string(source, "name", name);
+		obs_data_set_string(source, "id", "benchmark_source");
+		obs_data_array_push_back(array, source);
+		obs_data_release(source);
+	}
+
+	for (int i = 0; i < scenes; i++) {
+		obs_data_t *scene = obs_data_create();
+		obs_data_t *settings = obs_data_create();
+		obs_data_array_t *scene_items = obs_data_array_create();
+		int end = (int)((long long)items * (i + 1) / scenes);
+
+		/* items refer to sources spread over the whole collection so
+		 * lookups don't just hit the start or end of the list */
+		for (; item < end; item++) {
+			obs_data_t *scene_item = obs_data_create();
+
+			snprintf(name, sizeof(name), "Source %d",
+					(int)(((long long)item * 7919) %
+						sources));
+			obs_data_set_string(scene_item, "name", name);
+			obs_data_array_push_back(scene_items, scene_item);
+			obs_data_release(scene_item);
+		}
+
+		snprintf(name, sizeof(name), "Scene %d", i);
+		obs_data_set_string(scene, "name", name);
+		obs_data_set_string(scene, "id", "scene");
+		obs_data_set_array(settings, "items", scene_items);
+		obs_data_set_obj(scene, "settings", settings);
+		obs_data_array_push_back(array, scene);
+
+		obs_data_array_release(scene_items);
+		obs_data_release(settings);
+		obs_data_release(scene);
+	}
+
+	return array;
+}
+
+static bool count_item(obs_scene_t *scene, obs_sceneitem_t *item, void *param)
+{
+	UNUSED_PARAMETER(scene);
+	UNUSED_PARAMETER(item);
+
+	(*(int*)param)++;
+	return true;
+}
+
+struct walk_data {
+	const char *name;
+	obs_source_t *found;
+};
+
+static bool walk_source(void *param, obs_source_t *source)
+{
+	struct walk_data *walk = param;
+
+	if (strcmp(obs_source_get_name(source), walk->name) == 0) {
+		walk->found = obs_source_get_ref(source);
+		return false;
+	}
+
+	return true;
+}
+
+static obs_source_t *walk_lookup(const char *name)
+{
+	struct walk_data walk = {name, NULL};
+
+	obs_enum_sources(walk_source, &walk);
+	return walk.found;
+}
+
+/* returns the number of names that weren't found */
+static int run_lookups(const char *label, int sources, int lookups,
+		obs_source_t *(*lookup)(const char *name))
+{
+	uint64_t start, elapsed;
+	char name[64];
+	int missing = 0;
+
+	start = os_gettime_ns();
+
+	for (int i = 0; i < lookups; i++) {
+		obs_source_t *source;
+
+		snprintf(name, sizeof(name), "Source %d",
+				(int)(((long long)i * 104729) % sources));
+
+		source = lookup(name);
+		if (!source)
+			missing++;
+		obs_source_release(source);
+	}
+
+	elapsed = os_gettime_ns() - start;
+
+	printf("%-8s %10d lookups  %10.1f ns/lookup  %12.0f lookups/s\n",
+			label, lookups, (double)elapsed / (double)lookups,
+			(double)lookups * 1000000000.0 / (double)elapsed);
+	return missing;
+}
+
+int main(int argc, char *argv[])
+{
+	int sources = 5000;
+	int items   = 12000;
+	int scenes  = 50;
+	int lookups = 1000000;
+	int loaded_items = 0;
+	int missing = 0;
+	size_t num_loaded;
+	obs_data_array_t *collection;
+	uint64_t start, elapsed;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--sources") == 0 && i + 1 < argc) {
+			sources = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--items") == 0 && i + 1 < argc) {
+			items = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--scenes") == 0 && i + 1 < argc) {
+			scenes = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--lookups") == 0 && i + 1 < argc) {
+			lookups = atoi(argv[++i]);
+		} else {
+			printf("usage: %s [--sources <n>] [--items <n>] "
+					"[--scenes <n>] [--lookups <n>]\n",
+					argv[0]);
+			return 1;
+		}
+	}
+
+	if (sources < 1 || scenes < 1 || items < 0 || lookups < 100) {
+		fprintf(stderr, "invalid arguments\n");
+		return 1;
+	}
+
+	base_set_log_handler(do_log, NULL);
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		fprintf(stderr, "obs_startup failed\n");
+		return 1;
+	}
+
+	obs_register_source(&bench_source_info);
+	if (!obs_source_get_display_name("benchmark_source")) {
+		fprintf(stderr, "failed to register the benchmark source\n");
+		obs_shutdown();
+		return 1;
+	}
+
+	collection = make_collection(sources, items, scenes);
+
+	start = os_gettime_ns();
+	obs_load_sources(collection, loaded_source, NULL);
+	elapsed = os_gettime_ns() - start;
+
+	obs_data_array_release(collection);
+
+	for (size_t i = 0; i < loaded.num; i++) {
+		obs_scene_t *scene = obs_scene_from_source(loaded.array[i]);
+		if (scene)
+			obs_scene_enum_items(scene, count_item, &loaded_items);
+	}
+
+	printf("load     %d sources, %d scenes, %d items in %.1f ms\n",
+			sources, scenes, loaded_items,
+			(double)elapsed / 1000000.0);
+
+	missing += run_lookups("index", sources, lookups,
+			obs_get_source_by_name);
+	missing += run_lookups("walk", sources, lookups / 100, walk_lookup);
+
+	num_loaded = loaded.num;
+
+	for (size_t i = 0; i < loaded.num; i++) {
+		obs_source_remove(loaded.array[i]);
+		obs_source_release(loaded.array[i]);
+	}
+	da_free(loaded);
+
+	obs_shutdown();
+
+	if (num_loaded != (size_t)(sources + scenes) ||
+	    loaded_items != items || missing) {
+		printf("FAIL: %zu of %d sources and %d of %d items loaded, "
+				"%d lookups failed\n", num_loaded,
+				sources + scenes, loaded_items, items,
+				missing);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,391 @@
+/*
+ * V4L2 decoder test.  Acts as a fake capture device for the MJPEG decoder of
+ * the linux-v4l2 plugin and checks that:
+ *
+ *  - every submitted frame is either decoded or counted as dropped
+ *  - decoded frames come out in the order they were submitted, even though
+ *    they are decoded on several threads
+ *  - no frame fails to decode
+ *  - no frame is dropped when frames arrive at a normal capture rate
+ *
+ * The frames are taken from a recorded MJPEG stream (concatenated jpeg
+ * images, as written by "ffmpeg -i <input> -c:v mjpeg -f mjpeg rec.mjpeg"
+ * or dumped from a camera), or generated with the FFmpeg MJPEG encoder when
+ * no recording is given.  With --flood frames are submitted as fast as
+ * possible instead, which shows how many frames the decoder can keep up with
+ * (drops are expected there).
+ *
+ * Exits with 0 on success, 1 on failure.
+ *
+ *   v4l2-decoder-test [--threads <n>] [--fps <n>] [--frames <n>] [--flood]
+ *                     [--verbose] [recording.mjpeg]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the decoder is built in to the test so decoded frames can be checked here
+ * instead of going to a source */
+#define obs_source_output_video test_output_video
+#include "../../plugins/linux-v4l2/v4l2-decoder.c"
+#undef obs_source_output_video
+
+#include <util/darray.h>
+
+#define GEN_WIDTH           1280
+#define GEN_HEIGHT          720
+#define GEN_FRAMES          60
+#define WAIT_TIMEOUT_NS     5000000000ULL
+
+struct test_packet {
+	uint8_t              *data;
+	size_t               size;
+};
+
+static struct {
+	bool                 verbose;
+	DARRAY(struct test_packet) packets;
+
+	/* only touched by the decoder with output_mutex held */
+	uint64_t             frames_out;
+	uint64_t             last_timestamp;
+	uint64_t             order_errors;
+	uint32_t             width;
+	uint32_t             height;
+	uint64_t             size_errors;
+} test;
+
+void test_output_video(obs_source_t *source,
+		const struct obs_source_frame *frame)
+{
+	UNUSED_PARAMETER(source);
+
+	if (test.frames_out && frame->timestamp <= test.last_timestamp) {
+		test.order_errors++;
+		if (test.verbose)
+			printf("frame %"PRIu64" out of order\n",
+					frame->timestamp);
+	}
+
+	if (!test.width) {
+		test.width  = frame->width;
+		test.height = frame->height;
+	} else if (frame->width != test.width ||
+	           frame->height != test.height) {
+		test.size_errors++;
+	}
+
+	test.last_timestamp = frame->timestamp;
+	test.frames_out++;
+}
+
+static void add_packet(const uint8_t *data, size_t size)
+{
+	struct test_packet pkt;
+
+	pkt.data = bmemdup(data, size);
+	pkt.size = size;
+	da_push_back(test.packets, &pkt);
+}
+
+static void free_packets(void)
+{
+	for (size_t i = 0; i < test.packets.num; i++)
+		bfree(test.packets.array[i].data);
+	da_free(test.packets);
+}
+
+static inline bool is_soi(const uint8_t *data, size_t i, size_t size)
+{
+	return i + 2 < size &&
+		data[i] == 0xFF && data[i + 1] == 0xD8 && data[i + 2] == 0xFF;
+}
+
+/* splits a stream of concatenated jpeg images at the start of image
+ * markers */
+static bool load_recording(const char *path)
+{
+	FILE *f = os_fopen(path, "rb");
+	uint8_t *data;
+	size_t size, start = 0;
+	int64_t file_size;
+
+	if (!f) {
+		fprintf(stderr, "Failed to open '%s'\n", path);
+		return false;
+	}
+
+	file_size = os_fgetsize(f);
+	if (file_size <= 0) {
+		fprintf(stderr, "'%s' is empty\n", path);
+		fclose(f);
+		return false;
+	}
+
+	size = (size_t)file_size;
+	data = bmalloc(size);
+	size = fread(data, 1, size, f);
+	fclose(f);
+
+	while (start < size && !is_soi(data, start, size))
+		start++;
+
+	for (size_t i = start + 1; i <= size; i++) {
+		if (i == size || is_soi(data, i, size)) {
+			add_packet(data + start, i - start);
+			start = i;
+		}
+	}
+
+	bfree(data);
+
+	if (!test.packets.num) {
+		fprintf(stderr, "No jpeg images found in '%s'\n", path);
+		return false;
+	}
+
+	return true;
+}
+
+static void fill_pattern(AVFrame *frame, size_t idx)
+{
+	for (int y = 0; y < frame->height; y++) {
+		uint8_t *line = frame->data[0] + y * frame->linesize[0];
+
+		for (int x = 0; x < frame->width; x++)
+			line[x] = (uint8_t)(x + y + idx * 8);
+	}
+
+	for (int plane = 1; plane < 3; plane++) {
+		for (int y = 0; y < frame->height; y++) {
+			uint8_t *line = frame->data[plane] +
+				y * frame->linesize[plane];
+
+			memset(line, plane == 1 ? (int)(idx * 4) : 128,
+					(size_t)frame->width / 2);
+		}
+	}
+}
+
+/* encodes a moving pattern the way a camera would send it: 4:2:2 jpeg */
+static bool generate_frames(size_t count)
+{
+	AVCodec *codec;
+	AVCodecContext *context = NULL;
+	AVFrame *frame = NULL;
+	bool success = false;
+
+	avcodec_register_all();
+
+	codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+	if (!codec) {
+		fprintf(stderr, "No MJPEG encoder available\n");
+		return false;
+	}
+
+	context = avcodec_alloc_context3(codec);
+	frame   = av_frame_alloc();
+	if (!context || !frame)
+		goto fail;
+
+	context->width     = GEN_WIDTH;
+	context->height    = GEN_HEIGHT;
+	context->pix_fmt   = AV_PIX_FMT_YUVJ422P;
+	context->time_base = (AVRational){1, 30};
+
+	if (avcodec_open2(context, codec, NULL) < 0)
+		goto fail;
+
+	frame->format = context->pix_fmt;
+	frame->width  = GEN_WIDTH;
+	frame->height = GEN_HEIGHT;
+	if (av_frame_get_buffer(frame, 32) < 0)
+		goto fail;
+
+	for (size_t i = 0; i < count; i++) {
+		AVPacket packet;
+		int ret;
+
+		av_init_packet(&packet);
+		packet.data = NULL;
+		packet.size = 0;
+
+		if (av_frame_make_writable(frame) < 0)
+			goto fail;
+
+		fill_pattern(frame, i);
+		frame->pts = (int64_t)i;
+
+#ifdef USE_NEW_FFMPEG_DECODE_API
+		ret = avcodec_send_frame(context, frame);
+		if (ret == 0)
+			ret = avcodec_receive_packet(context, &packet);
+#else
+		int got_packet = 0;
+		ret = avcodec_encode_video2(context, &packet, frame,
+				&got_packet);
+		if (ret == 0 && !got_packet)
+			ret = -1;
+#endif
+		if (ret < 0)
+			goto fail;
+
+		add_packet(packet.data, (size_t)packet.size);
+		av_packet_unref(&packet);
+	}
+
+	success = true;
+
+fail:
+	if (!success)
+		fprintf(stderr, "Failed to generate MJPEG frames\n");
+	av_frame_free(&frame);
+	if (context) {
+		avcodec_close(context);
+		av_free(context);
+	}
+	return success;
+}
+
+static void wait_for_decoder(struct v4l2_decoder *dec, uint64_t submitted,
+		struct v4l2_decoder_stats *stats)
+{
+	uint64_t timeout = os_gettime_ns() + WAIT_TIMEOUT_NS;
+
+	for (;;) {
+		v4l2_decoder_get_stats(dec, stats);
+		if (stats->frames + stats->dropped + stats->errors >= submitted)
+			break;
+		if (os_gettime_ns() > timeout)
+			break;
+		os_sleep_ms(10);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const char *recording = NULL;
+	struct v4l2_decoder_stats stats;
+	struct v4l2_decoder *dec;
+	uint64_t submitted = 0, rejected = 0;
+	uint64_t interval, start, elapsed;
+	size_t num_frames = 0;
+	int threads = 0;
+	int fps = 30;
+	bool flood = false;
+	bool success = true;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+			fps = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			num_frames = (size_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--flood") == 0)
+			flood = true;
+		else if (strcmp(argv[i], "--verbose") == 0)
+			test.verbose = true;
+		else if (argv[i][0] != '-')
+			recording = argv[i];
+		else {
+			fprintf(stderr, "Usage: %s [--threads <n>] [--fps <n>] "
+					"[--frames <n>] [--flood] [--verbose] "
+					"[recording.mjpeg]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (fps <= 0)
+		fps = 30;
+
+	if (recording ? !load_recording(recording) :
+			!generate_frames(GEN_FRAMES))
+		return 1;
+
+	if (!num_frames)
+		num_frames = (size_t)fps * 10;
+
+	dec = v4l2_decoder_create(NULL, V4L2_PIX_FMT_MJPEG, threads);
+	if (!dec) {
+		fprintf(stderr, "Failed to create the decoder\n");
+		free_packets();
+		return 1;
+	}
+
+	printf("Submitting %zu frames (%zu unique) %s\n", num_frames,
+			test.packets.num, flood ? "as fast as possible" :
+			"at the capture rate");
+
+	interval = 1000000000ULL / (uint64_t)fps;
+	start    = os_gettime_ns();
+
+	for (size_t i = 0; i < num_frames; i++) {
+		struct test_packet *pkt =
+			test.packets.array + (i % test.packets.num);
+		uint64_t ts = start + interval * i;
+
+		if (!flood)
+			os_sleepto_ns(ts);
+
+		if (!v4l2_decoder_submit(dec, pkt->data, pkt->size, ts))
+			rejected++;
+		submitted++;
+	}
+
+	wait_for_decoder(dec, submitted, &stats);
+	elapsed = os_gettime_ns() - start;
+	v4l2_decoder_destroy(dec);
+
+	printf("decoded %"PRIu64", dropped %"PRIu64", failed %"PRIu64
+			", %ux%u, %.1f fps, latency avg %.2f ms / max %.2f ms\n",
+			stats.frames, stats.dropped, stats.errors,
+			test.width, test.height,
+			(double)stats.frames * 1000000000.0 / (double)elapsed,
+			stats.frames ? (double)stats.total_latency /
+				(double)stats.frames / 1000000.0 : 0.0,
+			(double)stats.max_latency / 1000000.0);
+
+	if (stats.frames + stats.dropped + stats.errors != submitted) {
+		printf("FAIL: %"PRIu64" frames unaccounted for\n", submitted -
+				stats.frames - stats.dropped - stats.errors);
+		success = false;
+	}
+	if (stats.dropped != rejected) {
+		printf("FAIL: %"PRIu64" frames rejected but %"PRIu64
+				" counted as dropped\n", rejected,
+				stats.dropped);
+		success = false;
+	}
+	if (stats.frames != test.frames_out) {
+		printf("FAIL: %"PRIu64" frames decoded but %"PRIu64
+				" output\n", stats.frames, test.frames_out);
+		success = false;
+	}
+	if (test.order_errors) {
+		printf("FAIL: %"PRIu64" frames out of order\n",
+				test.order_errors);
+		success = false;
+	}
+	if (test.size_errors) {
+		printf("FAIL: %"PRIu64" frames changed size\n",
+				test.size_errors);
+		success = false;
+	}
+	if (stats.errors) {
+		printf("FAIL: %"PRIu64" frames failed to decode\n",
+				stats.errors);
+		success = false;
+	}
+	if (!flood && stats.dropped) {
+		printf("FAIL: %"PRIu64" frames dropped at %d fps\n",
+				stats.dropped, fps);
+		success = false;
+	}
+
+	free_packets();
+
+	printf("%s\n", success ? "PASS" : "FAIL");
+	return success ? 0 : 1;
+}
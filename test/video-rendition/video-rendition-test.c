@@ -0,0 +1,207 @@
+/*
+ * Video rendition test.  Adds a rendition to the video and checks through
+ * the profiler that:
+ *
+ *  - a rendition nothing is connected to is not staged, only the main
+ *    rendition is
+ *  - a connected rendition is staged every frame and outputs frames
+ *  - after being idle the rendition outputs frames with current timestamps,
+ *    so no timestamps from before it went idle are left over
+ *
+ * Needs the OpenGL graphics module and an X server, e.g.:
+ *
+ *   xvfb-run video-rendition-test [--seconds <n>]
+ *
+ * Exits with 0 on success, 1 on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <obs.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+
+#define TEST_FPS 30
+
+struct profile_counts {
+	uint64_t             render_video;
+	uint64_t             stage_output_texture;
+};
+
+static struct {
+	long                 frames;
+	long                 stale_frames;
+	volatile uint64_t    min_timestamp;
+} test;
+
+static void count_entry(struct profile_counts *counts,
+		profiler_snapshot_entry_t *entry);
+
+static bool count_child(void *context, profiler_snapshot_entry_t *entry)
+{
+	count_entry(context, entry);
+	return true;
+}
+
+static void count_entry(struct profile_counts *counts,
+		profiler_snapshot_entry_t *entry)
+{
+	const char *name = profiler_snapshot_entry_name(entry);
+	uint64_t count = profiler_snapshot_entry_overall_count(entry);
+
+	if (strcmp(name, "render_video") == 0)
+		counts->render_video += count;
+	else if (strcmp(name, "stage_output_texture") == 0)
+		counts->stage_output_texture += count;
+
+	profiler_snapshot_enumerate_children(entry, count_child, counts);
+}
+
+static struct profile_counts get_counts(void)
+{
+	struct profile_counts counts = {0};
+	profiler_snapshot_t *snap = profile_snapshot_create();
+
+	profiler_snapshot_enumerate_roots(snap, count_child, &counts);
+	profile_snapshot_free(snap);
+	return counts;
+}
+
+/**
+ * Run the video for a while
+ *
+ * @return stage_output_texture calls per rendered frame
+ */
+static double stages_per_frame(int seconds)
+{
+	struct profile_counts start = get_counts();
+	struct profile_counts end;
+	uint64_t frames;
+
+	os_sleep_ms(seconds * 1000);
+
+	end = get_counts();
+	frames = end.render_video - start.render_video;
+	if (!frames)
+		return 0.0;
+
+	return (double)(end.stage_output_texture -
+			start.stage_output_texture) / (double)frames;
+}
+
+static void receive_video(void *param, struct video_data *frame)
+{
+	UNUSED_PARAMETER(param);
+
+	os_atomic_inc_long(&test.frames);
+	if (frame->timestamp < test.min_timestamp)
+		os_atomic_inc_long(&test.stale_frames);
+}
+
+static bool reset_video(void)
+{
+	struct obs_video_info ovi = {0};
+
+	ovi.graphics_module = DL_OPENGL;
+	ovi.fps_num         = TEST_FPS;
+	ovi.fps_den         = 1;
+	ovi.base_width      = 640;
+	ovi.base_height     = 360;
+	ovi.output_width    = 640;
+	ovi.output_height   = 360;
+	ovi.output_format   = VIDEO_FORMAT_NV12;
+	ovi.colorspace      = VIDEO_CS_709;
+	ovi.range           = VIDEO_RANGE_PARTIAL;
+	ovi.adapter         = 0;
+	ovi.gpu_conversion  = true;
+	ovi.scale_type      = OBS_SCALE_BICUBIC;
+
+	return obs_reset_video(&ovi) == OBS_VIDEO_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+	video_t *rendition;
+	double   stages;
+	int      seconds = 2;
+	int      failed = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			seconds = atoi(argv[++i]);
+		} else {
+			printf("usage: %s [--seconds <n>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	profiler_start();
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		printf("FAIL: couldn't start obs\n");
+		return 1;
+	}
+
+	if (!reset_video()) {
+		printf("FAIL: couldn't reset video, is DISPLAY set?\n");
+		failed = 1;
+		goto done;
+	}
+
+	rendition = obs_add_video_rendition(320, 180, OBS_SCALE_BILINEAR);
+	if (!rendition) {
+		printf("FAIL: couldn't add a rendition\n");
+		failed = 1;
+		goto done;
+	}
+
+	stages = stages_per_frame(seconds);
+	printf("idle:      %.2f stages per frame\n", stages);
+	if (stages < 0.5 || stages > 1.5) {
+		printf("FAIL: the idle rendition is staged\n");
+		failed = 1;
+	}
+
+	video_output_connect(rendition, NULL, receive_video, NULL);
+	stages = stages_per_frame(seconds);
+	printf("connected: %.2f stages per frame, %ld frames\n", stages,
+			test.frames);
+	if (stages < 1.5 || !test.frames) {
+		printf("FAIL: the connected rendition is not output\n");
+		failed = 1;
+	}
+
+	video_output_disconnect(rendition, receive_video, NULL);
+	stages = stages_per_frame(seconds);
+	printf("idle:      %.2f stages per frame\n", stages);
+	if (stages > 1.5) {
+		printf("FAIL: the rendition is staged after disconnecting\n");
+		failed = 1;
+	}
+
+	test.frames = 0;
+	test.min_timestamp = os_gettime_ns() - 1000000000ULL / TEST_FPS;
+	video_output_connect(rendition, NULL, receive_video, NULL);
+	os_sleep_ms(seconds * 1000);
+	video_output_disconnect(rendition, receive_video, NULL);
+
+	printf("reconnect: %ld frames, %ld with stale timestamps\n",
+			test.frames, test.stale_frames);
+	if (!test.frames || test.stale_frames) {
+		printf("FAIL: the reconnected rendition is not output with "
+				"current timestamps\n");
+		failed = 1;
+	}
+
+done:
+	obs_shutdown();
+	profiler_stop();
+	profiler_free();
+
+	if (!failed)
+		printf("PASS\n");
+	return failed;
+}
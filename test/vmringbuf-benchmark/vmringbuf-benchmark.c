@@ -0,0 +1,407 @@
+/*
+ * Compares the mirrored vmringbuf against circlebuf on the kind of traffic
+ * libobs puts through its circular buffers:
+ *
+ *  - audio: 1024 sample planar float chunks from the audio thread, consumed
+ *    as encoder frames of 960 (opus) or 1024 (aac) samples, for 6 tracks of
+ *    stereo audio
+ *  - packets: encoded packets of varying size queued with a backlog of a
+ *    couple of megabytes, as in the output and rtmp send buffers
+ *  - threaded: the audio workload split over a producer and a consumer
+ *    thread, circlebuf with a mutex against the lock-free vmringbuf_spsc.
+ *    both sides sleep for a millisecond when the buffer is empty or full
+ *
+ * circlebuf consumers copy each frame out (pop_front), vmringbuf consumers
+ * read it in place.  Both checksum what they read, so the data is actually
+ * touched either way.
+ *
+ *   vmringbuf-benchmark [--mb <n>]
+ *
+ *   --mb <n>    megabytes pushed through each buffer per test (default 1024)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/circlebuf.h>
+#include <util/vmringbuf.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define AUDIO_CHUNK_FRAMES  1024
+#define AUDIO_PLANES        12
+#define PACKET_MIN_SIZE     64
+#define PACKET_MAX_SIZE     (256 * 1024)
+#define PACKET_BACKLOG      (2 * 1024 * 1024)
+#define MAX_QUEUED_PACKETS  4096
+#define SPSC_CAPACITY       (256 * 1024)
+
+static uint64_t total_bytes = 1024ULL * 1024ULL * 1024ULL;
+static volatile uint64_t checksum_sink = 0;
+
+static inline uint64_t checksum(const void *data, size_t size)
+{
+	const uint64_t *words = data;
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i < size / sizeof(uint64_t); i++)
+		sum += words[i];
+	return sum;
+}
+
+static inline uint32_t next_random(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static void print_result(const char *test, const char *buffer,
+		uint64_t bytes, uint64_t ns, uint64_t sum)
+{
+	double mb = (double)bytes / (1024.0 * 1024.0);
+	double sec = (double)ns / 1000000000.0;
+
+	printf("%-24s %-16s %10.1f MB/s  (checksum %016llx)\n",
+			test, buffer, mb / sec, (unsigned long long)sum);
+}
+
+/* ------------------------------------------------------------------------- */
+/* audio */
+
+static void bench_audio_circlebuf(const char *test, size_t frame_size,
+		const uint8_t *chunk)
+{
+	size_t chunk_bytes = AUDIO_CHUNK_FRAMES * sizeof(float);
+	size_t frame_bytes = frame_size * sizeof(float);
+	struct circlebuf bufs[AUDIO_PLANES] = {0};
+	uint8_t *frame = bmalloc(frame_bytes);
+	uint64_t pushed = 0;
+	uint64_t sum = 0;
+	uint64_t start = os_gettime_ns();
+
+	while (pushed < total_bytes) {
+		for (size_t i = 0; i < AUDIO_PLANES; i++) {
+			circlebuf_push_back(&bufs[i], chunk, chunk_bytes);
+
+			while (bufs[i].size >= frame_bytes) {
+				circlebuf_pop_front(&bufs[i], frame,
+						frame_bytes);
+				sum += checksum(frame, frame_bytes);
+			}
+		}
+
+		pushed += chunk_bytes * AUDIO_PLANES;
+	}
+
+	print_result(test, "circlebuf", pushed, os_gettime_ns() - start, sum);
+	checksum_sink += sum;
+
+	for (size_t i = 0; i < AUDIO_PLANES; i++)
+		circlebuf_free(&bufs[i]);
+	bfree(frame);
+}
+
+static void bench_audio_vmringbuf(const char *test, size_t frame_size,
+		const uint8_t *chunk)
+{
+	size_t chunk_bytes = AUDIO_CHUNK_FRAMES * sizeof(float);
+	size_t frame_bytes = frame_size * sizeof(float);
+	struct vmringbuf bufs[AUDIO_PLANES];
+	uint64_t pushed = 0;
+	uint64_t sum = 0;
+	uint64_t start;
+
+	for (size_t i = 0; i < AUDIO_PLANES; i++)
+		vmringbuf_init(&bufs[i]);
+
+	start = os_gettime_ns();
+
+	while (pushed < total_bytes) {
+		for (size_t i = 0; i < AUDIO_PLANES; i++) {
+			vmringbuf_push_back(&bufs[i], chunk, chunk_bytes);
+
+			while (bufs[i].size >= frame_bytes) {
+				sum += checksum(vmringbuf_data(&bufs[i], 0),
+						frame_bytes);
+				vmringbuf_pop_front(&bufs[i], NULL,
+						frame_bytes);
+			}
+		}
+
+		pushed += chunk_bytes * AUDIO_PLANES;
+	}
+
+	print_result(test, "vmringbuf", pushed, os_gettime_ns() - start, sum);
+	checksum_sink += sum;
+
+	for (size_t i = 0; i < AUDIO_PLANES; i++)
+		vmringbuf_free(&bufs[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+/* packets */
+
+struct packet_queue {
+	size_t sizes[MAX_QUEUED_PACKETS];
+	size_t first;
+	size_t num;
+};
+
+static inline void queue_push(struct packet_queue *q, size_t size)
+{
+	q->sizes[(q->first + q->num++) % MAX_QUEUED_PACKETS] = size;
+}
+
+static inline size_t queue_pop(struct packet_queue *q)
+{
+	size_t size = q->sizes[q->first];
+	q->first = (q->first + 1) % MAX_QUEUED_PACKETS;
+	q->num--;
+	return size;
+}
+
+static inline size_t packet_size(uint32_t *state)
+{
+	size_t size = PACKET_MIN_SIZE + next_random(state) %
+		(PACKET_MAX_SIZE - PACKET_MIN_SIZE);
+	return size & ~(sizeof(uint64_t) - 1);
+}
+
+static void bench_packets_circlebuf(const uint8_t *payload)
+{
+	struct circlebuf buf = {0};
+	struct packet_queue queue = {0};
+	uint8_t *packet = bmalloc(PACKET_MAX_SIZE);
+	uint32_t state = 1;
+	uint64_t pushed = 0;
+	uint64_t sum = 0;
+	uint64_t start = os_gettime_ns();
+
+	while (pushed < total_bytes) {
+		size_t size = packet_size(&state);
+
+		circlebuf_push_back(&buf, payload, size);
+		queue_push(&queue, size);
+		pushed += size;
+
+		while (buf.size > PACKET_BACKLOG ||
+		       queue.num == MAX_QUEUED_PACKETS) {
+			size = queue_pop(&queue);
+			circlebuf_pop_front(&buf, packet, size);
+			sum += checksum(packet, size);
+		}
+	}
+
+	print_result("packets", "circlebuf", pushed, os_gettime_ns() - start,
+			sum);
+	checksum_sink += sum;
+
+	circlebuf_free(&buf);
+	bfree(packet);
+}
+
+static void bench_packets_vmringbuf(const uint8_t *payload)
+{
+	struct vmringbuf buf;
+	struct packet_queue queue = {0};
+	uint32_t state = 1;
+	uint64_t pushed = 0;
+	uint64_t sum = 0;
+	uint64_t start;
+
+	vmringbuf_init(&buf);
+	start = os_gettime_ns();
+
+	while (pushed < total_bytes) {
+		size_t size = packet_size(&state);
+
+		vmringbuf_push_back(&buf, payload, size);
+		queue_push(&queue, size);
+		pushed += size;
+
+		while (buf.size > PACKET_BACKLOG ||
+		       queue.num == MAX_QUEUED_PACKETS) {
+			size = queue_pop(&queue);
+			sum += checksum(vmringbuf_data(&buf, 0), size);
+			vmringbuf_pop_front(&buf, NULL, size);
+		}
+	}
+
+	print_result("packets", "vmringbuf", pushed, os_gettime_ns() - start,
+			sum);
+	checksum_sink += sum;
+
+	vmringbuf_free(&buf);
+}
+
+/* ------------------------------------------------------------------------- */
+/* threaded audio */
+
+#define FRAME_BYTES (960 * sizeof(float))
+#define CHUNK_BYTES (AUDIO_CHUNK_FRAMES * sizeof(float))
+
+struct threaded {
+	const uint8_t         *chunk;
+	uint64_t              sum;
+
+	struct circlebuf      buf;
+	pthread_mutex_t       mutex;
+
+	struct vmringbuf_spsc spsc;
+};
+
+static void *circlebuf_consumer(void *data)
+{
+	struct threaded *t = data;
+	uint8_t frame[FRAME_BYTES];
+	uint64_t popped = 0;
+	uint64_t end = total_bytes / FRAME_BYTES * FRAME_BYTES;
+
+	while (popped < end) {
+		bool ready;
+
+		pthread_mutex_lock(&t->mutex);
+		ready = t->buf.size >= FRAME_BYTES;
+		if (ready)
+			circlebuf_pop_front(&t->buf, frame, FRAME_BYTES);
+		pthread_mutex_unlock(&t->mutex);
+
+		if (ready) {
+			t->sum += checksum(frame, FRAME_BYTES);
+			popped += FRAME_BYTES;
+		} else {
+			os_sleep_ms(1);
+		}
+	}
+
+	return NULL;
+}
+
+static void bench_threaded_circlebuf(const uint8_t *chunk)
+{
+	struct threaded t = {0};
+	pthread_t thread;
+	uint64_t pushed = 0;
+	uint64_t start;
+
+	t.chunk = chunk;
+	pthread_mutex_init(&t.mutex, NULL);
+
+	start = os_gettime_ns();
+	pthread_create(&thread, NULL, circlebuf_consumer, &t);
+
+	while (pushed < total_bytes) {
+		bool full;
+
+		pthread_mutex_lock(&t.mutex);
+		full = t.buf.size >= SPSC_CAPACITY;
+		if (!full)
+			circlebuf_push_back(&t.buf, chunk, CHUNK_BYTES);
+		pthread_mutex_unlock(&t.mutex);
+
+		if (!full)
+			pushed += CHUNK_BYTES;
+		else
+			os_sleep_ms(1);
+	}
+
+	pthread_join(thread, NULL);
+	print_result("threaded", "circlebuf+mutex", pushed,
+			os_gettime_ns() - start, t.sum);
+	checksum_sink += t.sum;
+
+	circlebuf_free(&t.buf);
+	pthread_mutex_destroy(&t.mutex);
+}
+
+static void *spsc_consumer(void *data)
+{
+	struct threaded *t = data;
+	uint64_t popped = 0;
+	uint64_t end = total_bytes / FRAME_BYTES * FRAME_BYTES;
+
+	while (popped < end) {
+		size_t avail;
+		const void *frame = vmringbuf_spsc_read_span(&t->spsc, &avail);
+
+		if (avail >= FRAME_BYTES) {
+			t->sum += checksum(frame, FRAME_BYTES);
+			vmringbuf_spsc_consume(&t->spsc, FRAME_BYTES);
+			popped += FRAME_BYTES;
+		} else {
+			os_sleep_ms(1);
+		}
+	}
+
+	return NULL;
+}
+
+static void bench_threaded_spsc(const uint8_t *chunk)
+{
+	struct threaded t = {0};
+	pthread_t thread;
+	uint64_t pushed = 0;
+	uint64_t start;
+
+	t.chunk = chunk;
+	if (!vmringbuf_spsc_init(&t.spsc, SPSC_CAPACITY)) {
+		fprintf(stderr, "failed to create vmringbuf_spsc\n");
+		return;
+	}
+
+	start = os_gettime_ns();
+	pthread_create(&thread, NULL, spsc_consumer, &t);
+
+	while (pushed < total_bytes) {
+		if (vmringbuf_spsc_push(&t.spsc, chunk, CHUNK_BYTES))
+			pushed += CHUNK_BYTES;
+		else
+			os_sleep_ms(1);
+	}
+
+	pthread_join(thread, NULL);
+	print_result("threaded", "vmringbuf_spsc", pushed,
+			os_gettime_ns() - start, t.sum);
+	checksum_sink += t.sum;
+
+	vmringbuf_spsc_free(&t.spsc);
+}
+
+/* ------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	uint8_t *data;
+	uint32_t state = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--mb") == 0 && i + 1 < argc) {
+			total_bytes = strtoull(argv[++i], NULL, 10) *
+				1024ULL * 1024ULL;
+		} else {
+			printf("usage: %s [--mb <n>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	data = bmalloc(PACKET_MAX_SIZE);
+	for (size_t i = 0; i < PACKET_MAX_SIZE; i++)
+		data[i] = (uint8_t)next_random(&state);
+
+	bench_audio_circlebuf("audio (960 frames)", 960, data);
+	bench_audio_vmringbuf("audio (960 frames)", 960, data);
+	bench_audio_circlebuf("audio (1024 frames)", 1024, data);
+	bench_audio_vmringbuf("audio (1024 frames)", 1024, data);
+	bench_packets_circlebuf(data);
+	bench_packets_vmringbuf(data);
+	bench_threaded_circlebuf(data);
+	bench_threaded_spsc(data);
+
+	bfree(data);
+	return 0;
+}
@@ -0,0 +1,287 @@
+/*
+ * XSHM capture test.  Runs the xshm_input capture against a real X server,
+ * draws rectangles on the root window and checks that:
+ *
+ *  - after every change the uploaded image matches the screen, so damage
+ *    that was fetched in to one shm segment is not lost from the other
+ *  - the texture is updated at most once per tick
+ *  - small changes only upload the damaged rows instead of the whole screen
+ *  - nothing is uploaded while the screen does not change
+ *
+ * The texture is replaced by a buffer in memory, so no graphics subsystem is
+ * needed.  Meant to be run on a virtual framebuffer, which supports both
+ * MIT-SHM and DAMAGE:
+ *
+ *   xvfb-run -s "-screen 0 640x480x24" xshm-capture-test [--rounds <n>]
+ *
+ * Exits with 0 on success, 1 on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the capture is built in to the test so the texture uploads can be checked
+ * here instead of going to the gpu */
+#define obs_source_showing        test_source_showing
+#define gs_texture_create         test_texture_create
+#define gs_texture_destroy        test_texture_destroy
+#define gs_texture_set_image_rect test_texture_set_image_rect
+#include "../../plugins/linux-capture/xshm-input.c"
+#undef obs_source_showing
+#undef gs_texture_create
+#undef gs_texture_destroy
+#undef gs_texture_set_image_rect
+
+#define DEFAULT_ROUNDS      100
+#define TICK_NS             16666667ULL
+#define CONVERGE_TIMEOUT_NS 3000000000ULL
+#define IDLE_TICKS          30
+
+static struct {
+	uint8_t              *image;
+	uint32_t             width;
+	uint32_t             height;
+
+	uint64_t             uploads;
+	uint64_t             partial_uploads;
+	uint64_t             rows_uploaded;
+	uint64_t             tick_uploads;
+	uint64_t             multi_uploads;
+} test;
+
+const char *obs_module_text(const char *val)
+{
+	return val;
+}
+
+bool test_source_showing(const obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+	return true;
+}
+
+gs_texture_t *test_texture_create(uint32_t width, uint32_t height,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+
+	bfree(test.image);
+	test.image  = bzalloc(width * height * 4);
+	test.width  = width;
+	test.height = height;
+	return (gs_texture_t*)test.image;
+}
+
+void test_texture_destroy(gs_texture_t *tex)
+{
+	if ((uint8_t*)tex == test.image) {
+		bfree(test.image);
+		test.image = NULL;
+	}
+}
+
+bool test_texture_set_image_rect(gs_texture_t *tex, const uint8_t *data,
+		uint32_t linesize, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy)
+{
+	uint8_t *out = (uint8_t*)tex;
+
+	for (uint32_t row = y; row < y + cy; row++)
+		memcpy(out + (row * test.width + x) * 4,
+				data + row * linesize + x * 4, cx * 4);
+
+	test.uploads++;
+	test.rows_uploaded += cy;
+	if (cy < test.height)
+		test.partial_uploads++;
+	if (++test.tick_uploads > 1)
+		test.multi_uploads++;
+	return true;
+}
+
+static void tick(struct xshm_data *data)
+{
+	test.tick_uploads = 0;
+	xshm_video_tick(data, (float)TICK_NS / 1000000000.0f);
+}
+
+/**
+ * Compare the uploaded image with the screen, the padding byte of each
+ * pixel is undefined and ignored
+ */
+static bool image_matches(struct xshm_data *data)
+{
+	xcb_get_image_cookie_t img_c;
+	xcb_get_image_reply_t  *img_r;
+	const uint8_t          *screen;
+	bool                   match = true;
+
+	img_c = xcb_get_image(data->xcb, XCB_IMAGE_FORMAT_Z_PIXMAP,
+			data->xcb_screen->root, data->x_org, data->y_org,
+			data->width, data->height, ~0);
+	img_r = xcb_get_image_reply(data->xcb, img_c, NULL);
+	if (!img_r)
+		return false;
+
+	screen = xcb_get_image_data(img_r);
+
+	for (uint32_t i = 0; i < test.width * test.height; i++) {
+		if (memcmp(screen + i * 4, test.image + i * 4, 3) != 0) {
+			match = false;
+			break;
+		}
+	}
+
+	free(img_r);
+	return match;
+}
+
+/**
+ * Tick until the uploaded image matches the screen
+ */
+static bool wait_converged(struct xshm_data *data)
+{
+	uint64_t start = os_gettime_ns();
+
+	while (os_gettime_ns() - start < CONVERGE_TIMEOUT_NS) {
+		os_sleepto_ns(os_gettime_ns() + TICK_NS);
+		tick(data);
+
+		if (image_matches(data))
+			return true;
+	}
+
+	return false;
+}
+
+static void fill_rect(struct xshm_data *data, xcb_gcontext_t gc,
+		uint32_t color, int16_t x, int16_t y,
+		uint16_t width, uint16_t height)
+{
+	xcb_rectangle_t rect = {x, y, width, height};
+
+	xcb_change_gc(data->xcb, gc, XCB_GC_FOREGROUND, &color);
+	xcb_poly_fill_rectangle(data->xcb, data->xcb_screen->root, gc, 1,
+			&rect);
+	xcb_flush(data->xcb);
+}
+
+static uint32_t rand_range(uint32_t max)
+{
+	return (uint32_t)rand() % max;
+}
+
+int main(int argc, char *argv[])
+{
+	struct xshm_data *data;
+	obs_data_t       *settings;
+	xcb_gcontext_t   gc;
+	int              rounds = DEFAULT_ROUNDS;
+	int              failed = 0;
+	uint64_t         idle_uploads;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+			rounds = atoi(argv[++i]);
+		} else {
+			printf("usage: %s [--rounds <n>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	settings = obs_data_create();
+	obs_data_set_int(settings, "screen", 0);
+	obs_data_set_bool(settings, "show_cursor", false);
+
+	data = xshm_create(settings, NULL);
+	obs_data_release(settings);
+
+	if (!data || !data->thread_active || !test.image) {
+		printf("FAIL: could not start the capture, is DISPLAY set to "
+				"a server with MIT-SHM?\n");
+		xshm_destroy(data);
+		return 1;
+	}
+
+	if (!data->use_damage)
+		printf("DAMAGE is not available, only full frames are "
+				"captured\n");
+
+	gc = xcb_generate_id(data->xcb);
+	xcb_create_gc(data->xcb, gc, data->xcb_screen->root, 0, NULL);
+
+	fill_rect(data, gc, 0x000000, 0, 0, data->width, data->height);
+	if (!wait_converged(data)) {
+		printf("FAIL: initial frame does not match the screen\n");
+		failed = 1;
+		goto done;
+	}
+
+	srand(1);
+
+	for (int i = 0; i < rounds; i++) {
+		int rects = 1 + rand_range(3);
+
+		/* small rectangles, sometimes several per frame, so both
+		 * segments end up with different stale rows */
+		for (int j = 0; j < rects; j++) {
+			uint16_t width  = 1 + rand_range(data->width / 4);
+			uint16_t height = 1 + rand_range(data->height / 8);
+
+			fill_rect(data, gc, rand_range(0x1000000),
+					rand_range(data->width - width),
+					rand_range(data->height - height),
+					width, height);
+		}
+
+		if (!wait_converged(data)) {
+			printf("FAIL: frame does not match the screen after "
+					"round %d\n", i);
+			failed = 1;
+			goto done;
+		}
+	}
+
+	idle_uploads = test.uploads;
+	for (int i = 0; i < IDLE_TICKS; i++) {
+		os_sleepto_ns(os_gettime_ns() + TICK_NS);
+		tick(data);
+	}
+	idle_uploads = test.uploads - idle_uploads;
+
+	printf("uploads:          %"PRIu64"\n", test.uploads);
+	printf("partial uploads:  %"PRIu64"\n", test.partial_uploads);
+	printf("rows per upload:  %"PRIu64" of %"PRIu32"\n",
+			test.uploads ? test.rows_uploaded / test.uploads : 0,
+			test.height);
+	printf("idle uploads:     %"PRIu64"\n", idle_uploads);
+
+	if (test.multi_uploads) {
+		printf("FAIL: %"PRIu64" ticks uploaded more than once\n",
+				test.multi_uploads);
+		failed = 1;
+	}
+
+	if (data->use_damage && !test.partial_uploads) {
+		printf("FAIL: damage was never uploaded partially\n");
+		failed = 1;
+	}
+
+	if (data->use_damage && idle_uploads) {
+		printf("FAIL: uploaded while the screen did not change\n");
+		failed = 1;
+	}
+
+done:
+	xcb_free_gc(data->xcb, gc);
+	xshm_destroy(data);
+
+	if (!failed)
+		printf("PASS\n");
+	return failed;
+}